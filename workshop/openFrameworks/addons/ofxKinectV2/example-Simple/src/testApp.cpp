@@ -5,6 +5,8 @@ void testApp::setup(){
 
 	
 	kinect.initSensor();
+	// without a sensor, a rendered room with people walking in it
+	//kinect.initSensor(ofPtr<ofxKinectSensorBackend>(new ofxKinectSyntheticBackend()));
 	//kinect.initColorStream(true);
 	kinect.initIRStream();
 	kinect.initDepthStream(true);
@@ -36,6 +38,32 @@ void testApp::draw()
 
 //--------------------------------------------------------------
 void testApp::keyPressed(int key){
+	if(key == 'b'){
+		// compare the depth conversion kernels, results go to the console
+		ofxKinectDepthKernel::benchmark();
+	}
+	if(key == 'm'){
+		// check the sdk free mapper against the sdk, the calibration is kept in bin/data after the first run
+		if(kinect.setupCoordinateMapper("kinect_calibration.bin")){
+			kinect.getCoordinateMapper().benchmark();
+		}
+	}
+	if(key == 'c'){
+		// lossless codec round trips and damaged data, then timing on synthetic frames and on the current depth and ir frames
+		ofxKinectDepthCodec::test();
+		ofxKinectDepthCodec::benchmark();
+		ofShortPixels& depth = kinect.getRawDepthPixelsRef();
+		ofxKinectDepthCodec::benchmark(depth.getPixels(), depth.getWidth(), depth.getHeight());
+		ofShortPixels& ir = kinect.getIRPixelsRef();
+		ofxKinectDepthCodec::benchmark(ir.getPixels(), ir.getWidth(), ir.getHeight());
+	}
+
+	if(key == 'l'){
+		// lossy depth codec at a few error curves, on a synthetic frame and on the current one
+		ofxKinectLossyDepthCodec::benchmark();
+		ofShortPixels& depth = kinect.getRawDepthPixelsRef();
+		ofxKinectLossyDepthCodec::benchmark(depth.getPixels(), depth.getWidth(), depth.getHeight());
+	}
 
 }
 
@@ -2,6 +2,8 @@
 
 #include "ofMain.h"
 #include "ofxKinectCommonBridge.h"
+#include "ofxKinectDepthCodec.h"
+#include "ofxKinectLossyDepthCodec.h"
 
 class testApp : public ofBaseApp{
 	public:
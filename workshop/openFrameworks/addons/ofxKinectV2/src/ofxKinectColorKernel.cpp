@@ -0,0 +1,642 @@
+#include "ofxKinectColorKernel.h"
+
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#endif
+
+// c = y - 16, d = u - 128, e = v - 128
+// r = clip((298c + 409e + 128) >> 8), g = clip((298c - 100d - 208e + 128) >> 8), b = clip((298c + 516d + 128) >> 8)
+static const int Y_SCALE = 298;
+static const int R_FROM_V = 409;
+static const int G_FROM_U = -100;
+static const int G_FROM_V = -208;
+static const int B_FROM_U = 516;
+
+static inline unsigned char clampByte(int v)
+{
+	return (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+//---------------------------------------------------------------------------
+// scalar, also finishes the last few pixels of the simd versions
+template<ofxKinectColorKernel::Output output>
+static void convertScalar(const unsigned char* yuy2, int count, unsigned char* dst)
+{
+	const int channels = output == ofxKinectColorKernel::OUTPUT_GRAY ? 1 : 4;
+	for(int i = 0; i + 2 <= count; i += 2, yuy2 += 4)
+	{
+		int d = yuy2[1] - 128;
+		int e = yuy2[3] - 128;
+		int r = R_FROM_V * e;
+		int g = G_FROM_U * d + G_FROM_V * e;
+		int b = B_FROM_U * d;
+
+		for(int k = 0; k < 2; k++)
+		{
+			int y = Y_SCALE * (yuy2[k * 2] - 16) + 128;
+			unsigned char* p = dst + (i + k) * channels;
+			if(output == ofxKinectColorKernel::OUTPUT_GRAY)
+			{
+				p[0] = clampByte(y >> 8);
+			}
+			else
+			{
+				p[output == ofxKinectColorKernel::OUTPUT_RGBA ? 0 : 2] = clampByte((y + r) >> 8);
+				p[1] = clampByte((y + g) >> 8);
+				p[output == ofxKinectColorKernel::OUTPUT_RGBA ? 2 : 0] = clampByte((y + b) >> 8);
+				p[3] = 255;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// pmaddwd pairs: (c, 1) with (298, 128) for the luma term, (d, e) with the chroma weights of a channel
+#define OFX_KINECT_PAIR(lo, hi) ((int)((((unsigned int)(hi) & 0xffff) << 16) | ((unsigned int)(lo) & 0xffff)))
+
+template<ofxKinectColorKernel::Output output>
+static void convertSSE2(const unsigned char* yuy2, int count, unsigned char* dst)
+{
+	const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+	const __m128i yOffset = _mm_set1_epi16(16);
+	const __m128i cOffset = _mm_set1_epi16(128);
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i yScale = _mm_set1_epi32(OFX_KINECT_PAIR(Y_SCALE, 128));
+	const __m128i rScale = _mm_set1_epi32(OFX_KINECT_PAIR(0, R_FROM_V));
+	const __m128i gScale = _mm_set1_epi32(OFX_KINECT_PAIR(G_FROM_U, G_FROM_V));
+	const __m128i bScale = _mm_set1_epi32(OFX_KINECT_PAIR(B_FROM_U, 0));
+	const __m128i alpha = _mm_set1_epi8(-1);
+
+	int i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i*)(yuy2 + i * 2));
+		__m128i c = _mm_sub_epi16(_mm_and_si128(x, lowBytes), yOffset);
+		// u, v of each pair, then each pair twice so every pixel has its own
+		__m128i de = _mm_sub_epi16(_mm_srli_epi16(x, 8), cOffset);
+		__m128i deLo = _mm_unpacklo_epi32(de, de);
+		__m128i deHi = _mm_unpackhi_epi32(de, de);
+		__m128i yLo = _mm_madd_epi16(_mm_unpacklo_epi16(c, one), yScale);
+		__m128i yHi = _mm_madd_epi16(_mm_unpackhi_epi16(c, one), yScale);
+
+		if(output == ofxKinectColorKernel::OUTPUT_GRAY)
+		{
+			__m128i g16 = _mm_packs_epi32(_mm_srai_epi32(yLo, 8), _mm_srai_epi32(yHi, 8));
+			_mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(g16, g16));
+			continue;
+		}
+
+		__m128i r16 = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(yLo, _mm_madd_epi16(deLo, rScale)), 8),
+			_mm_srai_epi32(_mm_add_epi32(yHi, _mm_madd_epi16(deHi, rScale)), 8));
+		__m128i g16 = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(yLo, _mm_madd_epi16(deLo, gScale)), 8),
+			_mm_srai_epi32(_mm_add_epi32(yHi, _mm_madd_epi16(deHi, gScale)), 8));
+		__m128i b16 = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(yLo, _mm_madd_epi16(deLo, bScale)), 8),
+			_mm_srai_epi32(_mm_add_epi32(yHi, _mm_madd_epi16(deHi, bScale)), 8));
+
+		__m128i r8 = _mm_packus_epi16(r16, r16);
+		__m128i g8 = _mm_packus_epi16(g16, g16);
+		__m128i b8 = _mm_packus_epi16(b16, b16);
+		__m128i first = output == ofxKinectColorKernel::OUTPUT_RGBA ? r8 : b8;
+		__m128i third = output == ofxKinectColorKernel::OUTPUT_RGBA ? b8 : r8;
+		__m128i p01 = _mm_unpacklo_epi8(first, g8);
+		__m128i p23 = _mm_unpacklo_epi8(third, alpha);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi16(p01, p23));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_unpackhi_epi16(p01, p23));
+	}
+
+	int channels = output == ofxKinectColorKernel::OUTPUT_GRAY ? 1 : 4;
+	convertScalar<output>(yuy2 + i * 2, count - i, dst + i * channels);
+}
+
+#ifdef OFX_KINECT_HAS_AVX2
+//---------------------------------------------------------------------------
+// the sse2 steps on both 128 bit lanes at once, 8 pixels each
+template<ofxKinectColorKernel::Output output>
+static void convertAVX2(const unsigned char* yuy2, int count, unsigned char* dst)
+{
+	const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+	const __m256i yOffset = _mm256_set1_epi16(16);
+	const __m256i cOffset = _mm256_set1_epi16(128);
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i yScale = _mm256_set1_epi32(OFX_KINECT_PAIR(Y_SCALE, 128));
+	const __m256i rScale = _mm256_set1_epi32(OFX_KINECT_PAIR(0, R_FROM_V));
+	const __m256i gScale = _mm256_set1_epi32(OFX_KINECT_PAIR(G_FROM_U, G_FROM_V));
+	const __m256i bScale = _mm256_set1_epi32(OFX_KINECT_PAIR(B_FROM_U, 0));
+	const __m256i alpha = _mm256_set1_epi8(-1);
+
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i*)(yuy2 + i * 2));
+		__m256i c = _mm256_sub_epi16(_mm256_and_si256(x, lowBytes), yOffset);
+		__m256i de = _mm256_sub_epi16(_mm256_srli_epi16(x, 8), cOffset);
+		__m256i deLo = _mm256_unpacklo_epi32(de, de);
+		__m256i deHi = _mm256_unpackhi_epi32(de, de);
+		__m256i yLo = _mm256_madd_epi16(_mm256_unpacklo_epi16(c, one), yScale);
+		__m256i yHi = _mm256_madd_epi16(_mm256_unpackhi_epi16(c, one), yScale);
+
+		if(output == ofxKinectColorKernel::OUTPUT_GRAY)
+		{
+			__m256i g16 = _mm256_packs_epi32(_mm256_srai_epi32(yLo, 8), _mm256_srai_epi32(yHi, 8));
+			// each lane packed its 8 pixels twice, take one copy of each
+			__m256i g8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(g16, g16), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(g8));
+			continue;
+		}
+
+		__m256i r16 = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(yLo, _mm256_madd_epi16(deLo, rScale)), 8),
+			_mm256_srai_epi32(_mm256_add_epi32(yHi, _mm256_madd_epi16(deHi, rScale)), 8));
+		__m256i g16 = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(yLo, _mm256_madd_epi16(deLo, gScale)), 8),
+			_mm256_srai_epi32(_mm256_add_epi32(yHi, _mm256_madd_epi16(deHi, gScale)), 8));
+		__m256i b16 = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_add_epi32(yLo, _mm256_madd_epi16(deLo, bScale)), 8),
+			_mm256_srai_epi32(_mm256_add_epi32(yHi, _mm256_madd_epi16(deHi, bScale)), 8));
+
+		__m256i r8 = _mm256_packus_epi16(r16, r16);
+		__m256i g8 = _mm256_packus_epi16(g16, g16);
+		__m256i b8 = _mm256_packus_epi16(b16, b16);
+		__m256i first = output == ofxKinectColorKernel::OUTPUT_RGBA ? r8 : b8;
+		__m256i third = output == ofxKinectColorKernel::OUTPUT_RGBA ? b8 : r8;
+		__m256i p01 = _mm256_unpacklo_epi8(first, g8);
+		__m256i p23 = _mm256_unpacklo_epi8(third, alpha);
+		// pixels 0-3 and 8-11, then 4-7 and 12-15
+		__m256i lo = _mm256_unpacklo_epi16(p01, p23);
+		__m256i hi = _mm256_unpackhi_epi16(p01, p23);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst + i * 4 + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	_mm256_zeroupper();
+	int channels = output == ofxKinectColorKernel::OUTPUT_GRAY ? 1 : 4;
+	convertScalar<output>(yuy2 + i * 2, count - i, dst + i * channels);
+}
+#endif
+
+#undef OFX_KINECT_PAIR
+
+//---------------------------------------------------------------------------
+// indexed by Output
+#define OFX_KINECT_COLOR_KERNELS(fn) \
+	{ fn<ofxKinectColorKernel::OUTPUT_RGBA>, fn<ofxKinectColorKernel::OUTPUT_BGRA>, fn<ofxKinectColorKernel::OUTPUT_GRAY> }
+
+static const ofxKinectColorKernel::ConvertFunction scalarKernels[3] = OFX_KINECT_COLOR_KERNELS(convertScalar);
+static const ofxKinectColorKernel::ConvertFunction sse2Kernels[3] = OFX_KINECT_COLOR_KERNELS(convertSSE2);
+#ifdef OFX_KINECT_HAS_AVX2
+static const ofxKinectColorKernel::ConvertFunction avx2Kernels[3] = OFX_KINECT_COLOR_KERNELS(convertAVX2);
+#endif
+
+//---------------------------------------------------------------------------
+ofxKinectColorKernel::ofxKinectColorKernel()
+{
+	isa = ofxKinectDepthKernel::getBestSupportedIsa();
+}
+
+void ofxKinectColorKernel::setIsa(ofxKinectDepthKernel::Isa requested)
+{
+	isa = (ofxKinectDepthKernel::Isa)MIN((int)requested, (int)ofxKinectDepthKernel::getBestSupportedIsa());
+}
+
+ofxKinectDepthKernel::Isa ofxKinectColorKernel::getIsa() const
+{
+	return isa;
+}
+
+int ofxKinectColorKernel::getNumChannels(Output output)
+{
+	return output == OUTPUT_GRAY ? 1 : 4;
+}
+
+string ofxKinectColorKernel::getOutputName(Output output)
+{
+	switch(output)
+	{
+	case OUTPUT_BGRA: return "BGRA";
+	case OUTPUT_GRAY: return "gray";
+	default: return "RGBA";
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectColorKernel::convert(const unsigned char* yuy2, int count, unsigned char* dst, Output output) const
+{
+	switch(isa)
+	{
+#ifdef OFX_KINECT_HAS_AVX2
+	case ofxKinectDepthKernel::ISA_AVX2:
+		avx2Kernels[output](yuy2, count, dst);
+		break;
+#endif
+	case ofxKinectDepthKernel::ISA_SSE2:
+		sse2Kernels[output](yuy2, count, dst);
+		break;
+	default:
+		scalarKernels[output](yuy2, count, dst);
+		break;
+	}
+}
+
+void ofxKinectColorKernel::convert(const unsigned char* yuy2, int width, int height, unsigned char* dst, Output output, ofxKinectTileExecutor* executor) const
+{
+	int channels = getNumChannels(output);
+	if(executor == NULL)
+	{
+		convert(yuy2, width * height, dst, output);
+		return;
+	}
+
+	executor->forEachRowTile(height, [&](int rowBegin, int rowEnd){
+		convert(yuy2 + rowBegin * width * 2, (rowEnd - rowBegin) * width, dst + rowBegin * width * channels, output);
+	});
+}
+
+//---------------------------------------------------------------------------
+// numTaps rows of 16 source bytes added up, the first 8 in lo and the last 8 in hi
+static inline void sumRows(const unsigned char* first, int stride, int numTaps, __m128i& lo, __m128i& hi)
+{
+	const __m128i zero = _mm_setzero_si128();
+	lo = hi = zero;
+	for(int ty = 0; ty < numTaps; ty++)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(first + ty * stride));
+		lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(bytes, zero));
+		hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(bytes, zero));
+	}
+}
+
+//---------------------------------------------------------------------------
+// one output row of a region as yuy2 at the output size. an output pair covers 2 * reduction source pixels,
+// reduction chroma pairs. box averages every row and column of the block, bilinear the center two
+template<int reduction, bool bBilinear>
+static void reduceRow(const unsigned char* yuy2, int width, int sourceRow, int sourceColumn, int outputWidth, unsigned char* row)
+{
+	const int firstTap = bBilinear ? reduction / 2 - 1 : 0;
+	const int numTaps = bBilinear ? 2 : reduction;
+	const int lumaShift = numTaps == 2 ? 2 : 4;
+	const int chromaShift = numTaps == 2 ? (reduction == 2 ? 2 : 3) : 4;
+	const int stride = width * 2;
+	const unsigned char* first = yuy2 + (sourceRow + firstTap) * stride + sourceColumn * 2;
+
+	// the rows are added 16 bytes at a time, then each output pair's taps across the lanes of its
+	// reduction * 4 sums: luma ends up in the first lane of every other pair of lanes, chroma in the odd
+	// lanes, two output pairs to a register. luma is doubled where its shift is the smaller so one shift
+	// rounds both. every x64 cpu has sse2
+	const short lumaScale = lumaShift < chromaShift ? 2 : 1;
+	const __m128i lumaLanes = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+	const __m128i scale = _mm_set_epi16(1, lumaScale, 1, lumaScale, 1, lumaScale, 1, lumaScale);
+	const __m128i round = _mm_set1_epi16(1 << (chromaShift - 1));
+	int o = 0;
+	for(; o + 4 <= outputWidth; o += 4, row += 8)
+	{
+		__m128i pairs[2];
+		if(reduction == 2)
+		{
+			// both output pairs from one load of each row
+			__m128i sums[2];
+			sumRows(first + o * 4, stride, numTaps, sums[0], sums[1]);
+			for(int k = 0; k < 2; k++)
+			{
+				// y0 in lane 0 and y1 in lane 4, moved to lane 2
+				__m128i luma = _mm_add_epi16(sums[k], _mm_srli_si128(sums[k], 4));
+				luma = _mm_shuffle_epi32(luma, _MM_SHUFFLE(3, 3, 2, 0));
+				__m128i chroma = _mm_add_epi16(sums[k], _mm_srli_si128(sums[k], 8));
+				pairs[k] = _mm_or_si128(_mm_and_si128(lumaLanes, luma), _mm_andnot_si128(lumaLanes, chroma));
+			}
+		}
+		else
+		{
+			for(int k = 0; k < 2; k++)
+			{
+				__m128i a, b;
+				sumRows(first + (o + k * 2) * 8, stride, numTaps, a, b);
+				__m128i luma = _mm_add_epi16(a, _mm_srli_si128(a, 4));
+				__m128i lumaB = _mm_add_epi16(b, _mm_srli_si128(b, 4));
+				if(numTaps == 4)
+				{
+					luma = _mm_add_epi16(luma, _mm_srli_si128(luma, 8));
+					lumaB = _mm_add_epi16(lumaB, _mm_srli_si128(lumaB, 8));
+				}
+				else
+				{
+					luma = _mm_srli_si128(luma, firstTap * 4);
+					lumaB = _mm_srli_si128(lumaB, firstTap * 4);
+				}
+				// y0 in lane 0, y1 in lane 2
+				luma = _mm_unpacklo_epi32(luma, lumaB);
+				__m128i both = _mm_add_epi16(a, b);
+				__m128i chroma = _mm_add_epi16(both, _mm_srli_si128(both, 8));
+				pairs[k] = _mm_or_si128(_mm_and_si128(lumaLanes, luma), _mm_andnot_si128(lumaLanes, chroma));
+			}
+		}
+		__m128i out = _mm_mullo_epi16(_mm_unpacklo_epi64(pairs[0], pairs[1]), scale);
+		out = _mm_srli_epi16(_mm_add_epi16(out, round), chromaShift);
+		_mm_storel_epi64((__m128i*)row, _mm_packus_epi16(out, out));
+	}
+
+	// the odd pair left at the end
+	for(; o + 2 <= outputWidth; o += 2, row += 4)
+	{
+		const unsigned char* src = first + o * reduction * 2;
+		int y0 = 0, y1 = 0, u = 0, v = 0;
+		for(int ty = 0; ty < numTaps; ty++, src += stride)
+		{
+			for(int p = 0; p < reduction; p++)
+			{
+				u += src[p * 4 + 1];
+				v += src[p * 4 + 3];
+			}
+			for(int tx = 0; tx < numTaps; tx++)
+			{
+				y0 += src[(firstTap + tx) * 2];
+				y1 += src[(reduction + firstTap + tx) * 2];
+			}
+		}
+		row[0] = (unsigned char)((y0 + (1 << (lumaShift - 1))) >> lumaShift);
+		row[1] = (unsigned char)((u + (1 << (chromaShift - 1))) >> chromaShift);
+		row[2] = (unsigned char)((y1 + (1 << (lumaShift - 1))) >> lumaShift);
+		row[3] = (unsigned char)((v + (1 << (chromaShift - 1))) >> chromaShift);
+	}
+}
+
+typedef void (*ReduceFunction)(const unsigned char* yuy2, int width, int sourceRow, int sourceColumn, int outputWidth, unsigned char* row);
+
+ofRectangle ofxKinectColorKernel::snapRegion(const ofRectangle& region, int width, int height, int reduction)
+{
+	int x0 = 0, y0 = 0, x1 = width, y1 = height;
+	if(region.width > 0 && region.height > 0)
+	{
+		x0 = (int)ofClamp(region.x, 0, width);
+		y0 = (int)ofClamp(region.y, 0, height);
+		x1 = (int)ofClamp(region.x + region.width, 0, width);
+		y1 = (int)ofClamp(region.y + region.height, 0, height);
+	}
+
+	// output pixels come in pairs that share a chroma pair, like the source's
+	int alignX = 2 * reduction;
+	x0 = x0 / alignX * alignX;
+	y0 = y0 / reduction * reduction;
+	int w = MAX(x1 - x0, 0) / alignX * alignX;
+	int h = MAX(y1 - y0, 0) / reduction * reduction;
+	return ofRectangle(x0, y0, w, h);
+}
+
+void ofxKinectColorKernel::convertRegion(const unsigned char* yuy2, int width, int height, const ofRectangle& region, int reduction, Filter filter,
+	unsigned char* dst, Output output, ofxKinectTileExecutor* executor)
+{
+	ReduceFunction reduce = NULL;
+	if(reduction == 2)
+	{
+		reduce = filter == FILTER_BILINEAR ? reduceRow<2, true> : reduceRow<2, false>;
+	}
+	else if(reduction == 4)
+	{
+		reduce = filter == FILTER_BILINEAR ? reduceRow<4, true> : reduceRow<4, false>;
+	}
+	else if(reduction != 1)
+	{
+		ofLogError("ofxKinectColorKernel::convertRegion") << "Frames can be reduced by 1, 2 or 4, not " << reduction;
+		return;
+	}
+
+	ofRectangle snapped = snapRegion(region, width, height, reduction);
+	int x = (int)snapped.x;
+	int y = (int)snapped.y;
+	int outputWidth = (int)snapped.width / reduction;
+	int outputHeight = (int)snapped.height / reduction;
+	int channels = getNumChannels(output);
+
+	// sized here so the tiles only ever index their own thread's rows
+	if(reduce != NULL && outputWidth > 0)
+	{
+		size_t numThreads = executor != NULL ? executor->getNumThreads() : 1;
+		regionRows.resize(MAX(regionRows.size(), numThreads));
+		for(size_t i = 0; i < numThreads; i++)
+		{
+			regionRows[i].resize(MAX(regionRows[i].size(), (size_t)(outputWidth * 2)));
+		}
+	}
+
+	ofxKinectTileExecutor::TileFunction rows = [&](int rowBegin, int rowEnd){
+		// full width rows are contiguous, one call converts the whole tile
+		if(reduce == NULL && outputWidth == width)
+		{
+			convert(yuy2 + (y + rowBegin) * width * 2, (rowEnd - rowBegin) * width, dst + rowBegin * width * channels, output);
+			return;
+		}
+
+		int thread = executor != NULL ? executor->getCurrentThread() : 0;
+		for(int row = rowBegin; row < rowEnd; row++)
+		{
+			unsigned char* out = dst + row * outputWidth * channels;
+			if(reduce == NULL)
+			{
+				convert(yuy2 + ((y + row) * width + x) * 2, outputWidth, out, output);
+			}
+			else
+			{
+				reduce(yuy2, width, y + row * reduction, x, outputWidth, &regionRows[thread][0]);
+				convert(&regionRows[thread][0], outputWidth, out, output);
+			}
+		}
+	};
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(outputHeight, rows);
+	}
+	else
+	{
+		rows(0, outputHeight);
+	}
+}
+
+//---------------------------------------------------------------------------
+// the conversion written out per pixel, what every instruction set is checked against
+static void convertReference(const unsigned char* yuy2, int count, unsigned char* dst, ofxKinectColorKernel::Output output)
+{
+	for(int i = 0; i < count; i++)
+	{
+		const unsigned char* pair = yuy2 + (i / 2) * 4;
+		int c = pair[(i % 2) * 2] - 16;
+		int d = pair[1] - 128;
+		int e = pair[3] - 128;
+		unsigned char r = clampByte((298 * c + 409 * e + 128) >> 8);
+		unsigned char g = clampByte((298 * c - 100 * d - 208 * e + 128) >> 8);
+		unsigned char b = clampByte((298 * c + 516 * d + 128) >> 8);
+
+		switch(output)
+		{
+		case ofxKinectColorKernel::OUTPUT_RGBA:
+			dst[i * 4] = r; dst[i * 4 + 1] = g; dst[i * 4 + 2] = b; dst[i * 4 + 3] = 255;
+			break;
+		case ofxKinectColorKernel::OUTPUT_BGRA:
+			dst[i * 4] = b; dst[i * 4 + 1] = g; dst[i * 4 + 2] = r; dst[i * 4 + 3] = 255;
+			break;
+		default:
+			dst[i] = clampByte((298 * c + 128) >> 8);
+			break;
+		}
+	}
+}
+
+void ofxKinectColorKernel::benchmark(int width, int height, int iterations)
+{
+	int count = width * height;
+
+	// a camera frame is smooth, noise on a gradient keeps the branches of the reference honest
+	vector<unsigned char> frame(count * 2);
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			unsigned char* p = &frame[(y * width + x) * 2];
+			p[0] = (unsigned char)ofClamp(16 + x * 219 / width + ofRandom(-20, 20), 0, 255);
+			p[1] = (unsigned char)ofClamp((x % 2 == 0 ? 128 + y * 100 / height - 50 : 128 - x * 100 / width + 50) + ofRandom(-30, 30), 0, 255);
+		}
+	}
+
+	// every y with every u, v pair
+	int exhaustiveCount = 256 * 256 * 256;
+	vector<unsigned char> exhaustive(exhaustiveCount * 2);
+	for(int i = 0; i < exhaustiveCount / 2; i++)
+	{
+		unsigned char* p = &exhaustive[i * 4];
+		int uv = i / 128;
+		p[0] = (unsigned char)((i % 128) * 2);
+		p[1] = (unsigned char)(uv & 255);
+		p[2] = (unsigned char)((i % 128) * 2 + 1);
+		p[3] = (unsigned char)(uv >> 8);
+	}
+
+	ofxKinectColorKernel kernel;
+	ofxKinectTileExecutor executor;
+	for(int o = OUTPUT_RGBA; o <= OUTPUT_GRAY; o++)
+	{
+		Output output = (Output)o;
+		int channels = getNumChannels(output);
+		vector<unsigned char> expected(count * channels), converted(count * channels);
+		vector<unsigned char> exhaustiveExpected(exhaustiveCount * channels), exhaustiveConverted(exhaustiveCount * channels);
+		convertReference(&exhaustive[0], exhaustiveCount, &exhaustiveExpected[0], output);
+
+		unsigned long long start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			convertReference(&frame[0], count, &expected[0], output);
+		}
+		float referenceMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+		ofLogNotice("ofxKinectColorKernel::benchmark") << width << "x" << height << " " << getOutputName(output) << " reference loop: " << referenceMicros << " us/frame";
+
+		for(int isa = ofxKinectDepthKernel::ISA_SCALAR; isa <= ofxKinectDepthKernel::getBestSupportedIsa(); isa++)
+		{
+			kernel.setIsa((ofxKinectDepthKernel::Isa)isa);
+
+			start = ofGetElapsedTimeMicros();
+			for(int n = 0; n < iterations; n++)
+			{
+				kernel.convert(&frame[0], count, &converted[0], output);
+			}
+			float micros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+			start = ofGetElapsedTimeMicros();
+			for(int n = 0; n < iterations; n++)
+			{
+				kernel.convert(&frame[0], width, height, &converted[0], output, &executor);
+			}
+			float tiledMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+			kernel.convert(&exhaustive[0], exhaustiveCount, &exhaustiveConverted[0], output);
+			int mismatches = 0;
+			for(int i = 0; i < count * channels; i++)
+			{
+				mismatches += converted[i] != expected[i];
+			}
+			for(int i = 0; i < exhaustiveCount * channels; i++)
+			{
+				mismatches += exhaustiveConverted[i] != exhaustiveExpected[i];
+			}
+
+			ofLogNotice("ofxKinectColorKernel::benchmark") << ofxKinectDepthKernel::getIsaName((ofxKinectDepthKernel::Isa)isa) << " " << getOutputName(output)
+				<< ": " << micros << " us/frame (" << referenceMicros / micros << "x), " << tiledMicros << " us/frame on " << executor.getNumThreads()
+				<< " threads, " << mismatches << " mismatched bytes";
+		}
+	}
+
+	// shrinking in the conversion against converting the whole frame, checked against averaging the
+	// blocks one output pixel at a time. the region is the center quarter of the frame
+	kernel.setIsa(ofxKinectDepthKernel::getBestSupportedIsa());
+	vector<unsigned char> full(count * 4);
+	unsigned long long start = ofGetElapsedTimeMicros();
+	for(int n = 0; n < iterations; n++)
+	{
+		kernel.convert(&frame[0], count, &full[0], OUTPUT_RGBA);
+	}
+	float fullMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+	ofRectangle center(width / 4, height / 4, width / 2, height / 2);
+	for(int reduction = 1; reduction <= 4; reduction *= 2)
+	{
+		for(int f = FILTER_BOX; f <= FILTER_BILINEAR; f++)
+		{
+			Filter filter = (Filter)f;
+			if(reduction == 1 && filter == FILTER_BILINEAR)
+			{
+				continue;
+			}
+			for(int r = 0; r < 2; r++)
+			{
+				ofRectangle snapped = snapRegion(r == 0 ? ofRectangle() : center, width, height, reduction);
+				int outputWidth = (int)snapped.width / reduction;
+				int outputHeight = (int)snapped.height / reduction;
+				vector<unsigned char> reduced(outputWidth * outputHeight * 4), expected(outputWidth * outputHeight * 4);
+
+				start = ofGetElapsedTimeMicros();
+				for(int n = 0; n < iterations; n++)
+				{
+					kernel.convertRegion(&frame[0], width, height, snapped, reduction, filter, &reduced[0], OUTPUT_RGBA);
+				}
+				float micros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+				int first = (filter == FILTER_BILINEAR && reduction > 1) ? reduction / 2 - 1 : 0;
+				int taps = (filter == FILTER_BILINEAR && reduction > 1) ? 2 : reduction;
+				vector<unsigned char> row(outputWidth * 2);
+				for(int oy = 0; oy < outputHeight; oy++)
+				{
+					for(int ox = 0; ox < outputWidth; ox++)
+					{
+						int sx = (int)snapped.x + ox * reduction;
+						int sy = (int)snapped.y + oy * reduction;
+						int luma = 0, chroma = 0;
+						for(int ty = first; ty < first + taps; ty++)
+						{
+							for(int tx = first; tx < first + taps; tx++)
+							{
+								luma += frame[((sy + ty) * width + sx + tx) * 2];
+							}
+							// the output pair's chroma, u for even outputs and v for odd ones
+							int pairStart = (int)snapped.x + (ox / 2) * 2 * reduction;
+							for(int p = 0; p < reduction; p++)
+							{
+								chroma += frame[((sy + ty) * width + pairStart + p * 2) * 2 + 1 + (ox % 2) * 2];
+							}
+						}
+						row[ox * 2] = (unsigned char)((luma + taps * taps / 2) / (taps * taps));
+						row[ox * 2 + 1] = (unsigned char)((chroma + taps * reduction / 2) / (taps * reduction));
+					}
+					convertReference(&row[0], outputWidth, &expected[oy * outputWidth * 4], OUTPUT_RGBA);
+				}
+
+				int mismatches = 0;
+				for(size_t i = 0; i < reduced.size(); i++)
+				{
+					mismatches += reduced[i] != expected[i];
+				}
+				ofLogNotice("ofxKinectColorKernel::benchmark") << (r == 0 ? "frame" : "center") << " 1/" << reduction << (filter == FILTER_BOX ? " box" : " bilinear")
+					<< " to " << outputWidth << "x" << outputHeight << " RGBA: " << micros << " us/frame, " << fullMicros / micros << "x the speed of converting the whole frame, "
+					<< mismatches << " mismatched bytes";
+			}
+		}
+	}
+}
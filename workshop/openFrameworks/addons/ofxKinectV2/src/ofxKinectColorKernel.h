@@ -0,0 +1,74 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectDepthKernel.h"
+#include "ofxKinectTileExecutor.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// yuy2 to rgba, bgra or gray
+//
+// the sensor's color camera delivers yuy2, two bytes a pixel with a chroma pair shared by every two
+// pixels. asking the sdk for rgba has it convert the whole frame on its own thread and hand over twice
+// the bytes; capturing yuy2 and converting here keeps the capture thread light and lets the conversion
+// run in row tiles on the worker threads. the arithmetic is the bt.601 studio range integer conversion
+// from the directshow yuv documentation, done in 32 bit lanes by pmaddwd, so scalar, sse2 and avx2 give
+// exactly the same bytes. gray is the luma alone, on the same scale as the rgb.
+//
+// convertRegion() crops and shrinks in the same pass: each output row is averaged down from the yuy2
+// rows under it into a row of yuy2 at the output size, which stays in cache and goes through the same
+// conversion, so the full size image is never written. chroma stays shared by pairs of output pixels.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectColorKernel
+{
+  public:
+	enum Output
+	{
+		OUTPUT_RGBA,
+		OUTPUT_BGRA,
+		OUTPUT_GRAY
+	};
+
+	/// how convertRegion() shrinks: the average of the block under an output pixel, or the pixel sampled
+	/// at the block's center, which for the whole numbered reductions is the average of the center 2x2
+	enum Filter
+	{
+		FILTER_BOX,
+		FILTER_BILINEAR
+	};
+
+	ofxKinectColorKernel();
+
+	/// use a slower instruction set than the cpu supports, e.g. to compare them
+	void setIsa(ofxKinectDepthKernel::Isa isa);
+	ofxKinectDepthKernel::Isa getIsa() const;
+
+	static int getNumChannels(Output output);
+	static string getOutputName(Output output);
+
+	/// converts count pixels, count is even
+	void convert(const unsigned char* yuy2, int count, unsigned char* dst, Output output) const;
+	/// a whole frame, in row tiles on the executor's threads when there is one
+	void convert(const unsigned char* yuy2, int width, int height, unsigned char* dst, Output output, ofxKinectTileExecutor* executor = NULL) const;
+	/// the part of a width x height frame under region, shrunk by reduction (1, 2 or 4), into dst at
+	/// snapRegion() / reduction. an empty region is the whole frame. reductions average into scratch rows
+	/// kept per executor thread, so one kernel converts one region at a time
+	void convertRegion(const unsigned char* yuy2, int width, int height, const ofRectangle& region, int reduction, Filter filter,
+		unsigned char* dst, Output output, ofxKinectTileExecutor* executor = NULL);
+	/// region clipped to the frame and shrunk to whole output pixels and whole chroma pairs
+	static ofRectangle snapRegion(const ofRectangle& region, int width, int height, int reduction);
+
+	/// times a per pixel reference loop against every supported instruction set on width x height frames for
+	/// every output and logs the results. checks every output against the reference byte for byte, on the
+	/// timed frame and on a frame holding every combination of y, u and v. then times every reduction
+	static void benchmark(int width = 1920, int height = 1080, int iterations = 50);
+
+	typedef void (*ConvertFunction)(const unsigned char* yuy2, int count, unsigned char* dst);
+
+  protected:
+	ofxKinectDepthKernel::Isa isa;
+
+	// convertRegion()'s reduced yuy2 row, one per executor thread
+	vector< vector<unsigned char> > regionRows;
+};
@@ -0,0 +1,387 @@
+#include "ofxKinectColorToDepthRegistrar.h"
+
+#include <emmintrin.h>
+
+//---------------------------------------------------------------------------
+ofxKinectColorToDepthRegistrar::ofxKinectColorToDepthRegistrar()
+	: depthWidth(0)
+	, depthHeight(0)
+	, colorWidth(0)
+	, colorHeight(0)
+	, bMapped(false)
+	, mappedTimeStamp(0)
+{
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectColorToDepthRegistrar::setup(int _depthWidth, int _depthHeight, int _colorWidth, int _colorHeight)
+{
+	depthWidth = _depthWidth;
+	depthHeight = _depthHeight;
+	colorWidth = _colorWidth;
+	colorHeight = _colorHeight;
+
+	depth.assign(depthWidth * depthHeight, 0);
+	// one entry per color pixel, that's what the sdk writes
+	depthCoordinates.resize(colorWidth * colorHeight);
+	depthIndices.assign(colorWidth * colorHeight, -1);
+	bMapped = false;
+}
+
+bool ofxKinectColorToDepthRegistrar::isSetup() const
+{
+	return depthWidth > 0 && colorWidth > 0;
+}
+
+const vector<DepthSpacePoint>& ofxKinectColorToDepthRegistrar::getDepthCoordinates() const
+{
+	return depthCoordinates;
+}
+
+const vector<int>& ofxKinectColorToDepthRegistrar::getDepthIndices() const
+{
+	return depthIndices;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectColorToDepthRegistrar::mapColorFrame(KCBHANDLE hKinect, const unsigned short* depthFrame, ofxKinectTileExecutor* executor, LONGLONG timeStamp)
+{
+#ifdef OFX_KINECT_NO_SDK
+	(void)hKinect;
+	(void)depthFrame;
+	(void)executor;
+	(void)timeStamp;
+	ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "Built without the sdk, map through a coordinate mapper";
+	return false;
+#else
+	if(!isSetup())
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "Call setup() first";
+		return false;
+	}
+
+	if(isMapped(depthFrame, timeStamp))
+	{
+		return true;
+	}
+	if(hKinect == NULL)
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "No sensor to map with";
+		return false;
+	}
+
+	memcpy(&depth[0], depthFrame, depth.size() * sizeof(UINT16));
+	bMapped = false;
+
+	HRESULT hr = KCBMapColorFrameToDepthSpace(hKinect,
+		depth.size(), &depth[0],
+		depthCoordinates.size(), &depthCoordinates[0]);
+	if(FAILED(hr))
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "Failed to map the color frame to depth space";
+		return false;
+	}
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(colorHeight, [&](int rowBegin, int rowEnd){
+			resolveRows(rowBegin, rowEnd);
+		});
+	}
+	else
+	{
+		resolveRows(0, colorHeight);
+	}
+	bMapped = true;
+	mappedTimeStamp = timeStamp;
+	return true;
+#endif
+}
+
+bool ofxKinectColorToDepthRegistrar::mapColorFrame(const ofxKinectCoordinateMapper& mapper, const unsigned short* depthFrame, ofxKinectTileExecutor* executor, LONGLONG timeStamp)
+{
+	if(!isSetup())
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "Call setup() first";
+		return false;
+	}
+	if(!mapper.isReady())
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "The coordinate mapper has no calibration";
+		return false;
+	}
+	if(mapper.getDepthWidth() != depthWidth || mapper.getDepthHeight() != depthHeight
+		|| mapper.getColorWidth() != colorWidth || mapper.getColorHeight() != colorHeight)
+	{
+		ofLogError("ofxKinectColorToDepthRegistrar::mapColorFrame") << "The calibration is for other frame sizes";
+		return false;
+	}
+	if(isMapped(depthFrame, timeStamp))
+	{
+		return true;
+	}
+
+	memcpy(&depth[0], depthFrame, depth.size() * sizeof(UINT16));
+	colorCoordinates.resize(depth.size());
+
+	float unmapped = -numeric_limits<float>::infinity();
+	ofxKinectTileExecutor::TileFunction mapRows = [&](int rowBegin, int rowEnd){
+		mapper.mapDepthFrameToColor(&depth[0], &colorCoordinates[0], rowBegin, rowEnd);
+	};
+	ofxKinectTileExecutor::TileFunction clearRows = [&](int rowBegin, int rowEnd){
+		for(int i = rowBegin * colorWidth; i < rowEnd * colorWidth; i++)
+		{
+			depthCoordinates[i].X = depthCoordinates[i].Y = unmapped;
+			depthIndices[i] = -1;
+		}
+	};
+
+	// the splat writes the indices itself, there is nothing left to resolve
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(depthHeight, mapRows);
+		executor->forEachRowTile(colorHeight, clearRows);
+	}
+	else
+	{
+		mapRows(0, depthHeight);
+		clearRows(0, colorHeight);
+	}
+	splatDepth(executor);
+	bMapped = true;
+	mappedTimeStamp = timeStamp;
+	return true;
+}
+
+// a timestamp settles it without reading the frame, a new one is a new frame
+bool ofxKinectColorToDepthRegistrar::isMapped(const unsigned short* depthFrame, LONGLONG timeStamp) const
+{
+	if(!bMapped)
+	{
+		return false;
+	}
+	if(timeStamp != 0 && mappedTimeStamp != 0)
+	{
+		return timeStamp == mappedTimeStamp;
+	}
+	return memcmp(&depth[0], depthFrame, depth.size() * sizeof(UINT16)) == 0;
+}
+
+// each depth pixel covers the color pixels from where it lands up to where its right and lower neighbours
+// land, or as far as its left and upper neighbours are from it at an edge, so a smooth surface is tiled
+// without overlap. neighbours on another surface don't count. false for pixels that cover nothing
+bool ofxKinectColorToDepthRegistrar::getSplat(int x, int y, int& x0, int& y0, int& x1, int& y1) const
+{
+	const int maxExtent = 8;
+	const int sameSurface = 100;
+
+	int i = y * depthWidth + x;
+	const ColorSpacePoint& p = colorCoordinates[i];
+	int d = depth[i];
+	if(d == 0 || !(p.X > -1 && p.X < colorWidth && p.Y > -1 && p.Y < colorHeight))
+	{
+		return false;
+	}
+
+	float extentX = 1, extentY = 1;
+	if(x + 1 < depthWidth && depth[i + 1] != 0 && abs(depth[i + 1] - d) < sameSurface)
+	{
+		extentX = colorCoordinates[i + 1].X - p.X;
+	}
+	else if(x > 0 && depth[i - 1] != 0 && abs(depth[i - 1] - d) < sameSurface)
+	{
+		extentX = p.X - colorCoordinates[i - 1].X;
+	}
+	if(y + 1 < depthHeight && depth[i + depthWidth] != 0 && abs(depth[i + depthWidth] - d) < sameSurface)
+	{
+		extentY = colorCoordinates[i + depthWidth].Y - p.Y;
+	}
+	else if(y > 0 && depth[i - depthWidth] != 0 && abs(depth[i - depthWidth] - d) < sameSurface)
+	{
+		extentY = p.Y - colorCoordinates[i - depthWidth].Y;
+	}
+
+	// the unmapped -infinity of a neighbour fails these too
+	extentX = extentX >= 1 ? MIN(extentX, (float)maxExtent) : 1;
+	extentY = extentY >= 1 ? MIN(extentY, (float)maxExtent) : 1;
+	x0 = MAX((int)ceilf(p.X), 0);
+	y0 = MAX((int)ceilf(p.Y), 0);
+	x1 = MIN((int)ceilf(p.X + extentX), colorWidth);
+	y1 = MIN((int)ceilf(p.Y + extentY), colorHeight);
+	return x0 < x1 && y0 < y1;
+}
+
+// overlapping splats keep the nearest depth, the first one on a tie. each tile owns a band of color rows and
+// walks the depth rows that reach it in order, clipping their splats to the band, so the table comes out the
+// same however it is tiled
+void ofxKinectColorToDepthRegistrar::splatDepth(ofxKinectTileExecutor* executor)
+{
+	splatTop.resize(depthHeight);
+	splatBottom.resize(depthHeight);
+	ofxKinectTileExecutor::TileFunction boundRows = [&](int rowBegin, int rowEnd){
+		for(int y = rowBegin; y < rowEnd; y++)
+		{
+			int top = colorHeight, bottom = 0;
+			for(int x = 0; x < depthWidth; x++)
+			{
+				int x0, y0, x1, y1;
+				if(getSplat(x, y, x0, y0, x1, y1))
+				{
+					top = MIN(top, y0);
+					bottom = MAX(bottom, y1);
+				}
+			}
+			splatTop[y] = top;
+			splatBottom[y] = bottom;
+		}
+	};
+
+	ofxKinectTileExecutor::TileFunction splatRows = [&](int rowBegin, int rowEnd){
+		for(int y = 0; y < depthHeight; y++)
+		{
+			if(splatTop[y] >= rowEnd || splatBottom[y] <= rowBegin)
+			{
+				continue;
+			}
+			for(int x = 0; x < depthWidth; x++)
+			{
+				int x0, y0, x1, y1;
+				if(!getSplat(x, y, x0, y0, x1, y1))
+				{
+					continue;
+				}
+
+				int i = y * depthWidth + x;
+				int d = depth[i];
+				for(int cy = MAX(y0, rowBegin); cy < MIN(y1, rowEnd); cy++)
+				{
+					for(int cx = x0; cx < x1; cx++)
+					{
+						int c = cy * colorWidth + cx;
+						if(depthIndices[c] < 0 || d < depth[depthIndices[c]])
+						{
+							depthIndices[c] = i;
+							depthCoordinates[c].X = x + 0.5f;
+							depthCoordinates[c].Y = y + 0.5f;
+						}
+					}
+				}
+			}
+		}
+	};
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(depthHeight, boundRows);
+		executor->forEachRowTile(colorHeight, splatRows);
+	}
+	else
+	{
+		boundRows(0, depthHeight);
+		splatRows(0, colorHeight);
+	}
+}
+
+void ofxKinectColorToDepthRegistrar::resolveRows(int rowBegin, int rowEnd)
+{
+	const float* coordinates = (const float*)&depthCoordinates[0];
+	int* indices = &depthIndices[0];
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 width = _mm_set1_ps((float)depthWidth);
+	const __m128 height = _mm_set1_ps((float)depthHeight);
+	const __m128i stride = _mm_set1_epi32(depthWidth);
+	const __m128i none = _mm_set1_epi32(-1);
+
+	int i = rowBegin * colorWidth;
+	int end = rowEnd * colorWidth;
+	for(; i + 4 <= end; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(coordinates + i * 2);
+		__m128 b = _mm_loadu_ps(coordinates + i * 2 + 4);
+		__m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+		// color pixels the depth camera doesn't see come back as -infinity
+		__m128i inside = _mm_castps_si128(_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, zero), _mm_cmplt_ps(x, width)),
+			_mm_and_ps(_mm_cmpge_ps(y, zero), _mm_cmplt_ps(y, height))));
+
+		// y * width + x with the depth width well inside 16 bits
+		__m128i ix = _mm_cvttps_epi32(_mm_and_ps(x, _mm_castsi128_ps(inside)));
+		__m128i iy = _mm_cvttps_epi32(_mm_and_ps(y, _mm_castsi128_ps(inside)));
+		__m128i index = _mm_add_epi32(_mm_madd_epi16(iy, stride), ix);
+
+		_mm_storeu_si128((__m128i*)(indices + i), _mm_or_si128(_mm_and_si128(inside, index), _mm_andnot_si128(inside, none)));
+	}
+
+	for(; i < end; i++)
+	{
+		const DepthSpacePoint& p = depthCoordinates[i];
+		bool bInside = p.X >= 0 && p.X < depthWidth && p.Y >= 0 && p.Y < depthHeight;
+		indices[i] = bInside ? (int)p.Y * depthWidth + (int)p.X : -1;
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectColorToDepthRegistrar::registerDepth(ofShortPixels& dst, ofxKinectTileExecutor* executor) const
+{
+	if(!isSetup())
+	{
+		return;
+	}
+
+	if(!dst.isAllocated() || dst.getWidth() != colorWidth || dst.getHeight() != colorHeight || dst.getNumChannels() != 1)
+	{
+		dst.allocate(colorWidth, colorHeight, 1);
+	}
+
+	unsigned short* out = dst.getPixels();
+	const int* indices = &depthIndices[0];
+	const unsigned short* src = &depth[0];
+	ofxKinectTileExecutor::TileFunction rows = [&](int rowBegin, int rowEnd){
+		for(int i = rowBegin * colorWidth; i < rowEnd * colorWidth; i++)
+		{
+			out[i] = indices[i] >= 0 ? src[indices[i]] : 0;
+		}
+	};
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(colorHeight, rows);
+	}
+	else
+	{
+		rows(0, colorHeight);
+	}
+}
+
+void ofxKinectColorToDepthRegistrar::registerBodyIndex(const unsigned char* bodyIndex, ofPixels& dst, ofxKinectTileExecutor* executor) const
+{
+	if(!isSetup())
+	{
+		return;
+	}
+
+	if(!dst.isAllocated() || dst.getWidth() != colorWidth || dst.getHeight() != colorHeight || dst.getNumChannels() != 1)
+	{
+		dst.allocate(colorWidth, colorHeight, 1);
+	}
+
+	unsigned char* out = dst.getPixels();
+	const int* indices = &depthIndices[0];
+	ofxKinectTileExecutor::TileFunction rows = [&](int rowBegin, int rowEnd){
+		for(int i = rowBegin * colorWidth; i < rowEnd * colorWidth; i++)
+		{
+			out[i] = indices[i] >= 0 ? bodyIndex[indices[i]] : 255;
+		}
+	};
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(colorHeight, rows);
+	}
+	else
+	{
+		rows(0, colorHeight);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+#include "ofxKinectTileExecutor.h"
+#include "ofxKinectCoordinateMapper.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// depth and body index for every color pixel
+//
+// the sdk maps a depth frame to one depth space position per color pixel. mapColorFrame() does that once per
+// depth frame and resolves every position to a depth pixel index right away, row parallel. the depth and
+// body index images at color resolution are then plain gathers through that table, so both come from one
+// mapping. color pixels the depth camera doesn't see get depth 0 and body index 255 (no body).
+//
+// without a sensor the table comes from a coordinate mapper's calibration, which only maps depth to color:
+// every depth pixel is splatted over the color pixels between it and its neighbours, nearest depth first,
+// in bands of color rows. a depth frame with the last mapped one's timestamp, or without a timestamp and
+// identical to it, keeps the table as it is.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectColorToDepthRegistrar
+{
+  public:
+	ofxKinectColorToDepthRegistrar();
+
+	void setup(int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+	bool isSetup() const;
+
+	/// map a depth frame to color space and build the lookup table, executor may be NULL. timeStamp is the
+	/// depth frame's, 0 compares the pixels instead. fails when built with OFX_KINECT_NO_SDK
+	bool mapColorFrame(KCBHANDLE hKinect, const unsigned short* depth, ofxKinectTileExecutor* executor = NULL, LONGLONG timeStamp = 0);
+	/// the same through a calibration, for recordings and backends without a sensor
+	bool mapColorFrame(const ofxKinectCoordinateMapper& mapper, const unsigned short* depth, ofxKinectTileExecutor* executor = NULL, LONGLONG timeStamp = 0);
+
+	/// depth of the mapped frame at color resolution, dst is allocated if needed
+	void registerDepth(ofShortPixels& dst, ofxKinectTileExecutor* executor = NULL) const;
+	/// body index at color resolution through the same table, bodyIndex must be from the same tick as the depth
+	void registerBodyIndex(const unsigned char* bodyIndex, ofPixels& dst, ofxKinectTileExecutor* executor = NULL) const;
+
+	/// depth space position of every color pixel of the last mapped frame
+	const vector<DepthSpacePoint>& getDepthCoordinates() const;
+	/// depth pixel index of every color pixel, -1 where there is none
+	const vector<int>& getDepthIndices() const;
+
+  protected:
+	bool isMapped(const unsigned short* depth, LONGLONG timeStamp) const;
+	void resolveRows(int rowBegin, int rowEnd);
+	bool getSplat(int x, int y, int& x0, int& y0, int& x1, int& y1) const;
+	void splatDepth(ofxKinectTileExecutor* executor);
+
+	int depthWidth, depthHeight;
+	int colorWidth, colorHeight;
+
+	vector<UINT16> depth;
+	vector<DepthSpacePoint> depthCoordinates;
+	vector<int> depthIndices;
+	bool bMapped;
+	LONGLONG mappedTimeStamp;
+
+	// the calibration's depth to color mapping of the depth frame
+	vector<ColorSpacePoint> colorCoordinates;
+	// the color rows each depth row's splats cover
+	vector<int> splatTop, splatBottom;
+};
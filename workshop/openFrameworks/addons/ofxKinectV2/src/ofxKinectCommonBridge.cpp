@@ -1,5 +1,12 @@
 #include "ofxKinectCommonBridge.h"
 
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+	#include <mmsystem.h>
+	#pragma comment (lib, "winmm.lib")
+#endif
+
 //================================================================================================================
 // common bridge
 //================================================================================================================
@@ -8,17 +15,46 @@
 ofxKinectCommonBridge::ofxKinectCommonBridge(){
 	hKinect = NULL;
 
-	pDepthFrame = NULL;
-	pColorFrame = NULL;
-
-	beginMappingColorToDepth = false;
-	bNeedsUpdateSkeleton = false;
+	bundleSequence = 0;
+	maxTimestampSkew = 0;
+	bWarnedPoolExhausted = false;
+	framePool.allocate(4);
+	// the getters always have a frame to hand out, even before the first one arrives
+	frameBundles.getFrontBuffer() = framePool.acquire();
+
+	lastArrivalMicros = 0;
+	lastFrameTimeStamp = 0;
+	numClockOffsets = 0;
+	nextClockOffset = 0;
+	capturedFrameCount = 0;
+	framePeriodMicros = 1000000.0f / 30.0f;
+	captureLatencyMicros = 0;
+	averageCaptureLatencyMicros = 0;
+
+	colorToDepthSequence = 0;
+	colorPixelsSequence = 0;
+	bWarnedNoColorToDepth = false;
+	colorFormat = ColorImageFormat_Rgba;
+	bConvertColor = true;
+	bConvertingColor = false;
+	colorOutput = ofxKinectColorKernel::OUTPUT_RGBA;
+	colorReduction = 1;
+	colorFilter = ofxKinectColorKernel::FILTER_BOX;
+	bResamplingColor = false;
+
+	bPlayback = false;
+	bPlaybackRealtime = true;
+	bPlaybackLoop = true;
+	playbackFrame = 0;
+	playbackSeek = -1;
+	bPlaybackDone = false;
+	playbackClockMicros = 0;
+	playbackClockTimeStamp = 0;
+	bIsSkeletonFrameNew = false;
 	bUsingBodyIndex = false;
-	bNeedsUpdateBodyIndex = false;
+	bIsFrameNewBodyIndex = false;
 	bIsFrameNewVideo = false;
-	bNeedsUpdateVideo = false;
 	bIsFrameNewDepth = false;
-	bNeedsUpdateDepth = false;
 	bVideoIsInfrared = false;
 	bVideoIsColor = false;
 	bInited = false;
@@ -28,10 +64,16 @@ ofxKinectCommonBridge::ofxKinectCommonBridge(){
 	mappingDepthToColor = false;
 
 	bUsingSkeletons = false;
+	skeletons.resize(BODY_COUNT);
+	skeletonsSequence = ~0ULL;
 	bUsingDepth = false;
   	bUseTexture = true;
 	bUseFloatTexture = false;
 	bProgrammableRenderer = false;
+	bUseTextureStreaming = true;
+	for(int i = 0; i < KV2_STREAM_COUNT; i++){
+		textureUploadMicros[i] = 0;
+	}
 	
 	setDepthClipping();
 
@@ -86,15 +128,7 @@ void ofxKinectCommonBridge::setDepthClipping(float nearClip, float farClip){
 //---------------------------------------------------------------------------
 void ofxKinectCommonBridge::updateDepthLookupTable()
 {
-	unsigned char nearColor = bNearWhite ? 255 : 0;
-	unsigned char farColor = bNearWhite ? 0 : 255;
-	unsigned int maxDepthLevels = 10001;
-	depthLookupTable.resize(maxDepthLevels);
-	depthLookupTable[0] = 0;
-	for(unsigned int i = 1; i < maxDepthLevels; i++)
-	{
-		depthLookupTable[i] = ofMap(i, nearClipping, farClipping, nearColor, farColor, true);
-	}
+	depthKernel.setClipping(nearClipping, farClipping, bNearWhite);
 }
 
 /// is the current frame new?
@@ -111,14 +145,56 @@ bool ofxKinectCommonBridge::isFrameNewDepth(){
 }
 
 bool ofxKinectCommonBridge::isNewSkeleton() {
-	return bNeedsUpdateSkeleton;
+	return bIsSkeletonFrameNew;
+}
+
+//---------------------------------------------------------------------------
+float ofxKinectCommonBridge::getCaptureLatencyMicros(){
+	lock();
+	float latency = captureLatencyMicros;
+	unlock();
+	return latency;
 }
 
-void ofxKinectCommonBridge::checkOpenGLError(string function){
+//---------------------------------------------------------------------------
+float ofxKinectCommonBridge::getAverageCaptureLatencyMicros(){
+	lock();
+	float latency = averageCaptureLatencyMicros;
+	unlock();
+	return latency;
+}
+
+//---------------------------------------------------------------------------
+float ofxKinectCommonBridge::getFramePeriodMicros(){
+	lock();
+	float period = framePeriodMicros;
+	unlock();
+	return period;
+}
+
+//---------------------------------------------------------------------------
+unsigned long long ofxKinectCommonBridge::getCapturedFrameCount(){
+	lock();
+	unsigned long long count = capturedFrameCount;
+	unlock();
+	return count;
+}
+
+// glGetError() waits for the driver to catch up with every call queued before it, so the checks
+// are only compiled in for debugging and never run without textures. the name is a literal so the
+// calls build nothing when they are compiled out
+void ofxKinectCommonBridge::checkOpenGLError(const char* function){
+#ifdef OFX_KINECT_CHECK_GL_ERRORS
+	if(!bUseTexture){
+		return;
+	}
     GLuint err = glGetError();
     if (err != GL_NO_ERROR){
-        //ofLogError( "CloudsVisualSystem::checkOpenGLErrors") << "OpenGL generated error " << ofToString(err) << " : " << gluErrorString(err) << " in " << function;
+        ofLogError("ofxKinectCommonBridge::checkOpenGLError") << "OpenGL generated error " << ofToString(err) << " : " << gluErrorString(err) << " in " << function;
     }
+#else
+	(void)function;
+#endif
 }
 
 /// updates the pixel buffers and textures
@@ -134,63 +210,102 @@ void ofxKinectCommonBridge::update()
 		return;
 	}
 
-	// update color or IR pixels and textures if necessary
-	if(bNeedsUpdateVideo)
+	// pick up the newest frames the capture thread has published, nothing is copied here
+	bool bNewBundle = frameBundles.swap();
+	if(bNewBundle && bPlayback){
+		wakePlayback();
+	}
+	bIsFrameNewVideo = bNewBundle && (bVideoIsInfrared || bVideoIsColor);
+	bIsFrameNewDepth = bNewBundle && bUsingDepth;
+	bIsFrameNewBodyIndex = bNewBundle && bUsingBodyIndex;
+	bIsSkeletonFrameNew = bNewBundle && bUsingSkeletons;
+
+	// the render thread's copy of the last two frames, so queries between updates need no lock
+	if(bIsSkeletonFrameNew)
 	{
-		bIsFrameNewVideo = true;
-		bNeedsUpdateVideo = false;
+		skeletonInterpolator.push(frameBundles.getFrontBuffer()->filteredBodies, frameBundles.getFrontBuffer()->arrivalMicros);
+	}
+	poseFrames.swap();
 
-		if(bUseTexture) {
-			if(bVideoIsInfrared) 
-			{
-				swap(pInfraredFrame, pInfraredFrameBack);
-				memcpy(irPixels.getPixels(), pInfraredFrame->Buffer, pInfraredFrame->Size*sizeof(short));
-				if(bProgrammableRenderer){
-					videoTex.loadData(pInfraredFrame->Buffer, irFrameDescription.width, irFrameDescription.height, GL_RED);
-				} else {
-					videoTex.loadData(pInfraredFrame->Buffer, irFrameDescription.width, irFrameDescription.height, GL_LUMINANCE16);
-				}
-			} 
-			else if(bVideoIsColor)
+	// update color or IR textures if necessary
+	if(bIsFrameNewVideo && bUseTexture)
+	{
+		unsigned long long uploadStart = ofGetElapsedTimeMicros();
+		if(bVideoIsInfrared && videoStreamer.isReady())
+		{
+			videoStreamer.upload(frameBundles.getFrontBuffer()->infrared.frame.Buffer, &tileExecutor);
+		}
+		else if(bVideoIsColor && videoStreamer.isReady() && bConvertingColor)
+		{
+			// captured yuy2 converted in row tiles on the workers straight into the mapped buffer
+			unsigned char* mapped = (unsigned char*)videoStreamer.beginUpload();
+			if(mapped != NULL)
 			{
-				swap(pColorFrame, pColorFrameBack);
-				if( bProgrammableRenderer ) {
-					// programmable renderer likes this
-					videoTex.loadData(pColorFrame->Buffer, colorFrameDescription.width, colorFrameDescription.height, GL_RG16);
-				} else {
-					videoTex.loadData(pColorFrame->Buffer, colorFrameDescription.width, colorFrameDescription.height, GL_RGBA);
-				}
+				convertColor(mapped);
+				videoStreamer.endUpload();
 			}
 		}
-	} else {
-		bIsFrameNewVideo = false;
+		else if(bVideoIsColor && videoStreamer.isReady())
+		{
+			videoStreamer.upload(frameBundles.getFrontBuffer()->color.frame.Buffer, &tileExecutor);
+		}
+		else if(bVideoIsInfrared) 
+		{
+			KCBInfraredFrame& irFrame = frameBundles.getFrontBuffer()->infrared.frame;
+			if(bProgrammableRenderer){
+				videoTex.loadData(irFrame.Buffer, irFrameDescription.width, irFrameDescription.height, GL_RED);
+			} else {
+				videoTex.loadData(irFrame.Buffer, irFrameDescription.width, irFrameDescription.height, GL_LUMINANCE16);
+			}
+		} 
+		else if(bVideoIsColor)
+		{
+			KCBColorFrame& colorFrame = frameBundles.getFrontBuffer()->color.frame;
+			if( bConvertingColor ) {
+				updateColorPixels();
+				int glFormat = colorOutput == ofxKinectColorKernel::OUTPUT_RGBA ? GL_RGBA : colorOutput == ofxKinectColorKernel::OUTPUT_BGRA ? GL_BGRA
+					: bProgrammableRenderer ? GL_RED : GL_LUMINANCE;
+				videoTex.loadData(colorPixels.getPixels(), colorPixels.getWidth(), colorPixels.getHeight(), glFormat);
+			} else if( colorFormat != ColorImageFormat_Rgba ) {
+				// yuy2 goes up as two channels, the programmable renderer's shaders unpack it
+				videoTex.loadData(colorFrame.Buffer, colorFrameDescription.width, colorFrameDescription.height, GL_RG16);
+			} else {
+				videoTex.loadData(colorFrame.Buffer, colorFrameDescription.width, colorFrameDescription.height, GL_RGBA);
+			}
+		}
+		recordTextureUpload(bVideoIsInfrared ? KV2_STREAM_INFRARED : KV2_STREAM_COLOR, uploadStart);
 	}
 
 	checkOpenGLError("KCB:: VIDEO");
 
 	// update depth pixels and texture if necessary
-	if(bNeedsUpdateDepth)
+	if(bIsFrameNewDepth)
 	{
-
-		//swap(depthPixelsRawBack, depthPixelsRaw);
-		swap(pDepthFrameBack, pDepthFrame);
-
-		if(mappingColorToDepth) {
-			beginMappingColorToDepth = true;
-		}
-
-		bIsFrameNewDepth = true;
-		bNeedsUpdateDepth = false;
-
-		for(int i = 0; i < depthPixels.getWidth()*depthPixels.getHeight(); i++) {
-			depthPixelsRaw.getPixels()[i] = pDepthFrame->Buffer[i];
-			depthPixels.getPixels()[i]    = depthLookupTable[ofClamp(depthPixelsRaw.getPixels()[i], 0, depthLookupTable.size() - 1)];
-			if(bUseFloatTexture){
-				depthPixelsNormalized.getPixels()[i] =  depthPixelsRaw.getPixels()[i] / 65535.0f;
+		KCBDepthFrame& depthFrame = frameBundles.getFrontBuffer()->depth.frame;
+
+		// raw depth is read in place from the sensor's buffer, only the derived images are written
+		int width = depthPixels.getWidth();
+		unsigned char* visual = depthPixels.getPixels();
+		float* normalized = bUseFloatTexture ? depthPixelsNormalized.getPixels() : NULL;
+		tileExecutor.forEachRowTile(depthPixels.getHeight(), [&](int rowBegin, int rowEnd){
+			int offset = rowBegin * width;
+			depthKernel.convert(depthFrame.Buffer + offset, (rowEnd - rowBegin) * width, visual + offset, NULL,
+				normalized != NULL ? normalized + offset : NULL);
+		});
+
+		if(bUseTexture && depthStreamer.isReady() && rawDepthStreamer.isReady()) {
+			unsigned long long uploadStart = ofGetElapsedTimeMicros();
+			depthStreamer.upload(depthPixels.getPixels(), &tileExecutor);
+			if(bProgrammableRenderer && bUseFloatTexture){
+				rawDepthStreamer.upload(depthPixelsNormalized.getPixels(), &tileExecutor);
 			}
+			else{
+				rawDepthStreamer.upload(depthFrame.Buffer, &tileExecutor);
+			}
+			recordTextureUpload(KV2_STREAM_DEPTH, uploadStart);
 		}
-
-		if(bUseTexture) {
+		else if(bUseTexture) {
+			unsigned long long uploadStart = ofGetElapsedTimeMicros();
 			if( bProgrammableRenderer ) {
 				depthTex.loadData(depthPixels.getPixels(), depthFrameDescription.width, depthFrameDescription.height, GL_RED);
 				checkOpenGLError("KCB:: BEFORE LOAD DEPTH");
@@ -198,7 +313,7 @@ void ofxKinectCommonBridge::update()
 					rawDepthTex.loadData(depthPixelsNormalized.getPixels(),depthFrameDescription.width, depthFrameDescription.height, GL_RED);
 				}
 				else{
-					rawDepthTex.loadData(depthPixelsRaw.getPixels(), depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE_INTEGER_EXT );
+					rawDepthTex.loadData(depthFrame.Buffer, depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE_INTEGER_EXT );
 				}
 				//FAILED ALTERNATIVES
 				//rawDepthTex.loadData(depthPixelsRaw.getPixels(), depthFrameDescription.width, depthFrameDescription.height, GL_RED);
@@ -206,53 +321,92 @@ void ofxKinectCommonBridge::update()
 				checkOpenGLError("KCB:: AFTER LOAD DEPTH");
 			} else {
 				depthTex.loadData(depthPixels.getPixels(), depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE);
-				rawDepthTex.loadData(pDepthFrame->Buffer, depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE16);
+				rawDepthTex.loadData(depthFrame.Buffer, depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE16);
 			}
+			recordTextureUpload(KV2_STREAM_DEPTH, uploadStart);
 		}
-	} else {
-		bIsFrameNewDepth = false;
 	}
 
 	checkOpenGLError("KCB:: DEPTH");
 
-	// update skeletons if necessary
-	if(bUsingSkeletons && bNeedsUpdateSkeleton)
-	{	
-		swap(backSkeletons, skeletons);
-		bNeedsUpdateSkeleton = false;
-	} 
+	// depth and body index at color resolution, asked for with initColorStream(true)
+	if(bIsFrameNewDepth && mappingColorToDepth)
+	{
+		mapColorToDepth(depthPixelsAlignedToColor, bodyIndexPixelsAlignedToColor);
+	}
 
-	if (bNeedsUpdateBodyIndex)
+	if (bIsFrameNewBodyIndex && bUseTexture)
 	{
-		
-		swap(pBodyIndexFrame, pBodyIndexFrame);
+		KCBBodyIndexFrame& bodyIndexFrame = frameBundles.getFrontBuffer()->bodyIndex.frame;
 
-		if (bProgrammableRenderer)
+		unsigned long long uploadStart = ofGetElapsedTimeMicros();
+		if (bodyIndexStreamer.isReady())
 		{
-			bodyIndexTex.loadData(pBodyIndexFrame->Buffer, bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_RED);
+			bodyIndexStreamer.upload(bodyIndexFrame.Buffer, &tileExecutor);
+		}
+		else if (bProgrammableRenderer)
+		{
+			bodyIndexTex.loadData(bodyIndexFrame.Buffer, bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_RED);
 		}
 		else
 		{
-			bodyIndexTex.loadData(pBodyIndexFrame->Buffer, bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_LUMINANCE);
+			bodyIndexTex.loadData(bodyIndexFrame.Buffer, bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_LUMINANCE);
 		}
-
-		bNeedsUpdateBodyIndex = false;
+		recordTextureUpload(KV2_STREAM_BODY_INDEX, uploadStart);
 	}
 
 	checkOpenGLError("KCB:: SKELETON");
 }
 
+//------------------------------------
+const Kv2FrameBundle& ofxKinectCommonBridge::getFrameBundle(){
+	return *frameBundles.getFrontBuffer();
+}
+
+//------------------------------------
+Kv2FrameRef ofxKinectCommonBridge::getFrameRef(){
+	return frameBundles.getFrontBuffer();
+}
+
+//------------------------------------
+LONGLONG ofxKinectCommonBridge::getMaxTimestampSkew(){
+	lock();
+	LONGLONG skew = maxTimestampSkew;
+	unlock();
+	return skew;
+}
+
 //------------------------------------
 ofPixels& ofxKinectCommonBridge::getColorPixelsRef(){
 	if(!bVideoIsColor){
 		ofLogWarning("ofxKinectCommonBridge::getColorPixelsRef") << "Getting Color Pixels when color stream unitialized";
 	}
-	return videoPixels;
+	if(bConvertingColor){
+		updateColorPixels();
+		return colorPixels;
+	}
+	return frameBundles.getFrontBuffer()->color.pixels;
+}
+
+//------------------------------------
+// captured yuy2 into the format asked for, in row tiles on the workers
+void ofxKinectCommonBridge::convertColor(unsigned char* dst){
+	colorKernel.convertRegion(frameBundles.getFrontBuffer()->color.pixels.getPixels(), colorFrameDescription.width, colorFrameDescription.height,
+		colorRegion, colorReduction, colorFilter, dst, colorOutput, &tileExecutor);
+}
+
+// converted once per frame, and only for frames the pixels are asked for
+void ofxKinectCommonBridge::updateColorPixels(){
+	const Kv2FrameBundle& bundle = *frameBundles.getFrontBuffer();
+	if(bundle.sequence != colorPixelsSequence){
+		convertColor(colorPixels.getPixels());
+		colorPixelsSequence = bundle.sequence;
+	}
 }
 
 //------------------------------------
 ofPixels & ofxKinectCommonBridge::getBodyIndexPixelsRef() {
-	return bodyIndexPixels;
+	return frameBundles.getFrontBuffer()->bodyIndex.pixels;
 }
 
 //------------------------------------
@@ -262,7 +416,7 @@ ofPixels & ofxKinectCommonBridge::getDepthPixelsRef(){       	///< grayscale val
 
 //------------------------------------
 ofShortPixels & ofxKinectCommonBridge::getRawDepthPixelsRef(){
-	return depthPixelsRaw;
+	return frameBundles.getFrontBuffer()->depth.pixels;
 }
 
 //------------------------------------
@@ -270,7 +424,7 @@ ofShortPixels& ofxKinectCommonBridge::getIRPixelsRef(){
 	if(!bVideoIsInfrared){
 		ofLogWarning("ofxKinectCommonBridge::getIRPixelsRef") << "Getting IR Pixels with IR stream unitialized";
 	}
-	return irPixels;
+	return frameBundles.getFrontBuffer()->infrared.pixels;
 }
 
 //------------------------------------
@@ -279,12 +433,55 @@ ofFloatPixels& ofxKinectCommonBridge::getFloatDepthPixelsRef(){
 }
 
 //------------------------------------
-vector<Kv2Skeleton> ofxKinectCommonBridge::getSkeletons(){
+const Kv2SkeletonFrame& ofxKinectCommonBridge::getSkeletonFrame(){
+	return frameBundles.getFrontBuffer()->filteredBodies;
+}
+
+const Kv2SkeletonFrame& ofxKinectCommonBridge::getRawSkeletonFrame(){
+	return frameBundles.getFrontBuffer()->bodies;
+}
+
+const vector<Kv2Skeleton>& ofxKinectCommonBridge::getSkeletons(){
+	const Kv2FrameBundle& bundle = *frameBundles.getFrontBuffer();
+	if(skeletonsSequence == bundle.sequence){
+		return skeletons;
+	}
+
+	const Kv2SkeletonFrame& frame = bundle.filteredBodies;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++){
+		Kv2Skeleton& skeleton = skeletons[body];
+		skeleton.tracked = frame.tracked[body];
+		skeleton.trackingId = frame.trackingIds[body];
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++){
+			skeleton.joints[j] = Kv2Joint((JointType)j, frame.positions[body][j], frame.orientations[body][j], frame.trackingStates[body][j]);
+		}
+	}
+	skeletonsSequence = bundle.sequence;
 	return skeletons;
 }
 
+const Kv2SkeletonFrame& ofxKinectCommonBridge::getSkeletonFrameAt(unsigned long long micros){
+	return skeletonInterpolator.getFrameAtMicros(micros);
+}
+
+ofxKinectSkeletonInterpolator& ofxKinectCommonBridge::getSkeletonInterpolator(){
+	return skeletonInterpolator;
+}
+
+const ofxKinectJointHistory& ofxKinectCommonBridge::getJointHistory(){
+	return jointHistory;
+}
+
+const Kv2PoseFrame& ofxKinectCommonBridge::getPoseFrame(){
+	return poseFrames.getFrontBuffer();
+}
+
 //------------------------------------
 void ofxKinectCommonBridge::setUseTexture(bool bUse){
+	if(bUse && !bUseTexture && bStarted){
+		ofLogError("ofxKinectCommonBridge::setUseTexture") << "Textures are allocated by the init calls, they can't be turned back on once started";
+		return;
+	}
 	bUseTexture = bUse;
 }
 
@@ -292,6 +489,61 @@ void ofxKinectCommonBridge::setRawTextureUsesFloats(bool bUseRawFloat){
 	bUseFloatTexture = true;
 }
 
+void ofxKinectCommonBridge::setColorConversion(bool bConvert, ofxKinectColorKernel::Output output){
+	if(bVideoIsColor){
+		ofLogError("ofxKinectCommonBridge::setColorConversion") << "Set the color conversion before initColorStream()";
+		return;
+	}
+	bConvertColor = bConvert;
+	colorOutput = output;
+}
+
+void ofxKinectCommonBridge::setColorResampling(int reduction, ofxKinectColorKernel::Filter filter, const ofRectangle& region){
+	if(bVideoIsColor){
+		ofLogError("ofxKinectCommonBridge::setColorResampling") << "Set the color resampling before initColorStream()";
+		return;
+	}
+	if(reduction != 1 && reduction != 2 && reduction != 4){
+		ofLogError("ofxKinectCommonBridge::setColorResampling") << "The color frame can be reduced by 1, 2 or 4, not " << reduction;
+		return;
+	}
+	colorReduction = reduction;
+	colorFilter = filter;
+	colorRegion = region;
+}
+
+ofRectangle ofxKinectCommonBridge::getColorRegion(){
+	return colorRegion;
+}
+
+ofxKinectColorKernel& ofxKinectCommonBridge::getColorKernel(){
+	return colorKernel;
+}
+
+ofxKinectJointFilter& ofxKinectCommonBridge::getJointFilter(){
+	return jointFilter;
+}
+
+ofxKinectPoseClassifier& ofxKinectCommonBridge::getPoseClassifier(){
+	return poseClassifier;
+}
+
+void ofxKinectCommonBridge::setUseTextureStreaming(bool bUse){
+	bUseTextureStreaming = bUse;
+}
+
+float ofxKinectCommonBridge::getTextureUploadMicros(Kv2RecordedStream stream){
+	if(stream < 0 || stream >= KV2_STREAM_COUNT){
+		return 0;
+	}
+	return textureUploadMicros[stream];
+}
+
+void ofxKinectCommonBridge::recordTextureUpload(Kv2RecordedStream stream, unsigned long long startMicros){
+	float micros = ofGetElapsedTimeMicros() - startMicros;
+	textureUploadMicros[stream] = textureUploadMicros[stream] == 0 ? micros : textureUploadMicros[stream] * 0.9f + micros * 0.1f;
+}
+
 //----------------------------------------------------------
 void ofxKinectCommonBridge::draw(float _x, float _y, float _w, float _h) {
 	if(bUseTexture) {
@@ -302,7 +554,7 @@ void ofxKinectCommonBridge::draw(float _x, float _y, float _w, float _h) {
 //----------------------------------------------------------
 void ofxKinectCommonBridge::draw(float _x, float _y) {
 	if (bVideoIsColor){
-		draw(_x, _y, colorFrameDescription.width, colorFrameDescription.height);
+		draw(_x, _y, bConvertingColor ? colorPixels.getWidth() : colorFrameDescription.width, bConvertingColor ? colorPixels.getHeight() : colorFrameDescription.height);
 	} else if (bVideoIsInfrared){
 		draw(_x, _y, irFrameDescription.width, irFrameDescription.height);
 	}
@@ -364,7 +616,9 @@ void ofxKinectCommonBridge::drawDepth(const ofRectangle & rect) {
 
 //----------------------------------------------------------
 void ofxKinectCommonBridge::drawBodyIndex(float x, float y) {
-	bodyIndexTex.draw(x, y);
+	if(bUseTexture) {
+		bodyIndexTex.draw(x, y);
+	}
 }
 
 void ofxKinectCommonBridge::drawAllSkeletons()
@@ -374,9 +628,10 @@ void ofxKinectCommonBridge::drawAllSkeletons()
 
 void ofxKinectCommonBridge::drawAllSkeletons(ofVec2f scale)
 {
-	for (int i = 0; i < skeletons.size(); i++)
+	const Kv2SkeletonFrame& frame = frameBundles.getFrontBuffer()->filteredBodies;
+	for (int i = 0; i < Kv2SkeletonFrame::MAX_BODIES; i++)
 	{
-		if (skeletons[i].tracked)
+		if (frame.tracked[i])
 		{
 			drawSkeleton(i, scale);
 		}
@@ -391,13 +646,14 @@ void ofxKinectCommonBridge::drawSkeleton( int index)
 
 void ofxKinectCommonBridge::drawSkeleton( int index, ofVec2f scale )
 {
-	if(index >= skeletons.size())
+	const Kv2SkeletonFrame& frame = frameBundles.getFrontBuffer()->filteredBodies;
+	if(index < 0 || index >= Kv2SkeletonFrame::MAX_BODIES)
 	{
 		ofLog() << " skeleton index too high " << endl;
 		return;
 	}
 
-	if (!skeletons[index].tracked)
+	if (!frame.tracked[index])
 	{
 		ofLog() << " skeleton index not being tracked " << endl;
 		return;
@@ -426,9 +682,9 @@ void ofxKinectCommonBridge::drawSkeleton( int index, ofVec2f scale )
 	{
 		ofSetLineWidth(2);
 
-		ofVec3f lineBegin = (skeletons[index].joints[skeletonDrawOrder[i].first].getPosition() + normalize) * scale3;
+		ofVec3f lineBegin = (frame.positions[index][skeletonDrawOrder[i].first] + normalize) * scale3;
 		lineBegin.y = scale3.y - lineBegin.y;
-		ofVec3f lineEnd = (skeletons[index].joints[skeletonDrawOrder[i].second].getPosition() + normalize) * scale3;
+		ofVec3f lineEnd = (frame.positions[index][skeletonDrawOrder[i].second] + normalize) * scale3;
 		lineEnd.y = scale3.y - lineEnd.y;
 
 		ofSetColor(0, 255, 0);
@@ -441,26 +697,128 @@ void ofxKinectCommonBridge::drawSkeleton( int index, ofVec2f scale )
 }
 
 
+void ofxKinectCommonBridge::setNumWorkerThreads(int numThreads)
+{
+	tileExecutor.setNumThreads(numThreads);
+}
+
+ofxKinectTileExecutor& ofxKinectCommonBridge::getTileExecutor()
+{
+	return tileExecutor;
+}
+
+ofxKinectDepthToColorRegistrar& ofxKinectCommonBridge::getDepthToColorRegistrar()
+{
+	return depthToColorRegistrar;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectCommonBridge::setFramePoolSize(int size)
+{
+	// the streams allocate their buffers in every pooled frame, and a frame still held through
+	// getFrameRef() would be deleted under its handle
+	if(backend || bPlayback || bUsingDepth || bVideoIsColor || bVideoIsInfrared || bUsingBodyIndex || bUsingSkeletons){
+		ofLogError("ofxKinectCommonBridge::setFramePoolSize") << "Cannot resize the frame pool once initSensor(), initPlayback() or a stream was initialized";
+		return;
+	}
+	if(framePool.getNumInUse() > 1 || frameBundles.getFrontBuffer().getUseCount() > 1){
+		ofLogError("ofxKinectCommonBridge::setFramePoolSize") << "Cannot resize the frame pool while frame refs are held, release them first";
+		return;
+	}
+
+	// the triple buffer alone keeps three frames in flight
+	frameBundles.getFrontBuffer().release();
+	framePool.allocate(MAX(size, 4));
+	frameBundles.getFrontBuffer() = framePool.acquire();
+}
+
 bool ofxKinectCommonBridge::initSensor()
+{
+#ifdef OFX_KINECT_NO_SDK
+	ofLogError("ofxKinectCommonBridge::initSensor") << "Built without the sdk, pass a backend such as ofxKinectSyntheticBackend";
+	return false;
+#else
+	return initSensor(ofPtr<ofxKinectSensorBackend>(new ofxKinectKCBBackend()));
+#endif
+}
+
+bool ofxKinectCommonBridge::initSensor(ofPtr<ofxKinectSensorBackend> sensorBackend)
 {
 	if(bStarted){
 		ofLogError("ofxKinectCommonBridge::initSensor") << "Cannot configure once the sensor has already started" << endl;
 		return false;
 	}
+	if(bPlayback || backend){
+		ofLogError("ofxKinectCommonBridge::initSensor") << "A sensor or a recording was already initialized";
+		return false;
+	}
 
-	if (ofGetCurrentRenderer()->getType() == ofGLProgrammableRenderer::TYPE){
+	// without textures there may be no renderer at all
+	if (bUseTexture && ofGetCurrentRenderer()->getType() == ofGLProgrammableRenderer::TYPE){
 		bProgrammableRenderer = true;
 	}
 
-	hKinect = KCBOpenDefaultSensor();
+	if(!sensorBackend || !sensorBackend->open()){
+		return false;
+	}
+	backend = sensorBackend;
+	hKinect = backend->getHandle();
+	if(backend->getFramePeriodMicros() > 0){
+		framePeriodMicros = backend->getFramePeriodMicros();
+	}
+
+	return true;
+}
+
+ofPtr<ofxKinectSensorBackend> ofxKinectCommonBridge::getBackend()
+{
+	return backend;
+}
+
+bool ofxKinectCommonBridge::initPlayback(const string& path, bool bRealtime, bool bLoop)
+{
+	if(bStarted || backend){
+		ofLogError("ofxKinectCommonBridge::initPlayback") << "Cannot play back once a sensor was initialized or started";
+		return false;
+	}
+
+	if(!player.open(path)){
+		return false;
+	}
+
+	if (bUseTexture && ofGetCurrentRenderer()->getType() == ofGLProgrammableRenderer::TYPE){
+		bProgrammableRenderer = true;
+	}
 
+	bPlayback = true;
+	bPlaybackRealtime = bRealtime;
+	bPlaybackLoop = bLoop;
+	playbackFrame = 0;
+	playbackSeek = -1;
+	bPlaybackDone = false;
+	playbackClockMicros = 0;
 	return true;
 }
 
+//---------------------------------------------------------------------------
+bool ofxKinectCommonBridge::getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description)
+{
+	if(bPlayback){
+		if(!player.hasStream(stream)){
+			ofLogError("ofxKinectCommonBridge::getStreamDescription") << "The recording doesn't have stream " << stream;
+			return false;
+		}
+		description = player.getHeader().streams[stream];
+		return true;
+	}
+
+	return backend && backend->getStreamDescription(stream, description);
+}
+
 bool ofxKinectCommonBridge::initDepthStream( bool mapDepthToColor )
 {
 
-	if(hKinect == NULL){
+	if(!backend && !bPlayback){
 		ofLogError("ofxKinectCommonBridge::initDepthStream") << "Cannot init depth stream until initSensor() is called";
 		return false;
 	}
@@ -473,31 +831,23 @@ bool ofxKinectCommonBridge::initDepthStream( bool mapDepthToColor )
 	mappingDepthToColor = mapDepthToColor;
 
 
-	HRESULT hr;
-	hr = KCBGetDepthFrameDescription(hKinect, &depthFrameDescription);
+	if(!getStreamDescription(KV2_STREAM_DEPTH, depthFrameDescription)){
+		return false;
+	}
 
 	//hr = KCBCreateDepthFrame(depthFrameDescription, &pDepthFrame);
 
 	if(bProgrammableRenderer) {
 		depthPixels.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_COLOR);
-		depthPixelsBack.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_COLOR);
 	} else {
 		depthPixels.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
-		depthPixelsBack.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
 	}
 
-	depthPixelsRawFront.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
-	depthPixelsRawBack.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
-	depthPixelsRaw.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
 	depthPixelsNormalized.allocate(depthFrameDescription.width, depthFrameDescription.height, OF_IMAGE_GRAYSCALE);
 
-	pDepthFrame = new KCBDepthFrame();
-	pDepthFrame->Buffer = depthPixelsRawFront.getPixels();
-	pDepthFrame->Size = depthFrameDescription.lengthInPixels;
-
-	pDepthFrameBack = new KCBDepthFrame();
-	pDepthFrameBack->Buffer = depthPixelsRawBack.getPixels();
-	pDepthFrameBack->Size = depthFrameDescription.lengthInPixels;
+	for(int i = 0; i < framePool.size(); i++){
+		framePool[i].depth.allocate(depthFrameDescription.width, depthFrameDescription.height, 1);
+	}
 
 	if(bUseTexture){
 
@@ -534,6 +884,21 @@ bool ofxKinectCommonBridge::initDepthStream( bool mapDepthToColor )
 			depthTex.allocate(depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE);
 			rawDepthTex.allocate(depthFrameDescription.width, depthFrameDescription.height, GL_LUMINANCE16);
 		}
+
+		if(bUseTextureStreaming){
+			int w = depthFrameDescription.width;
+			int h = depthFrameDescription.height;
+			depthStreamer.setup(depthTex, w, h, bProgrammableRenderer ? GL_RED : GL_LUMINANCE, GL_UNSIGNED_BYTE, 1);
+			if(!bProgrammableRenderer){
+				rawDepthStreamer.setup(rawDepthTex, w, h, GL_LUMINANCE, GL_UNSIGNED_SHORT, 2);
+			}
+			else if(bUseFloatTexture){
+				rawDepthStreamer.setup(rawDepthTex, w, h, GL_RED, GL_FLOAT, 4);
+			}
+			else{
+				rawDepthStreamer.setup(rawDepthTex, w, h, GL_LUMINANCE_INTEGER_EXT, GL_UNSIGNED_SHORT, 2);
+			}
+		}
 	}
 	
 	bUsingDepth = true;
@@ -543,14 +908,77 @@ bool ofxKinectCommonBridge::initDepthStream( bool mapDepthToColor )
 bool ofxKinectCommonBridge::initColorStream( bool mapColorToDepth, ColorImageFormat format)
 {
 
-	if(hKinect == NULL){
+	if(!backend && !bPlayback){
 		ofLogError("ofxKinectCommonBridge::initDepthStream") << "Cannot init depth stream until initSensor() is called";
 		return false;
 	}
 
-	KCBGetColorFrameDescription(hKinect, ColorImageFormat_Rgba, &colorFrameDescription);
+	if(bStarted){
+		ofLogError("ofxKinectCommonBridge::initColorStream") << "Cannot configure once the sensor has already started";
+		return false;
+	}
 
-	if(bUseTexture){
+	// rgba is converted here from the native yuy2 unless conversion is off
+	ColorImageFormat captureFormat = format;
+	if(bPlayback){
+		// the buffers have to match what was recorded
+		captureFormat = (ColorImageFormat)player.getHeader().colorFormat;
+	}
+	else if(bConvertColor && format == ColorImageFormat_Rgba){
+		captureFormat = ColorImageFormat_Yuy2;
+	}
+	bConvertingColor = bConvertColor && format == ColorImageFormat_Rgba && captureFormat == ColorImageFormat_Yuy2;
+	format = captureFormat;
+
+	if(!getStreamDescription(KV2_STREAM_COLOR, colorFrameDescription)){
+		return false;
+	}
+	colorFormat = format;
+
+	// cropping and shrinking happen in the conversion, without it the pixels are the whole frame
+	if(!bConvertingColor && (colorReduction != 1 || colorRegion.width > 0 || colorRegion.height > 0)){
+		ofLogWarning("ofxKinectCommonBridge::initColorStream") << "Color resampling needs the color conversion, the whole frame is used";
+		colorReduction = 1;
+		colorRegion = ofRectangle();
+	}
+	colorRegion = ofxKinectColorKernel::snapRegion(colorRegion, colorFrameDescription.width, colorFrameDescription.height, colorReduction);
+	bResamplingColor = colorReduction != 1 || colorRegion.width != colorFrameDescription.width || colorRegion.height != colorFrameDescription.height;
+
+	if(bConvertingColor){
+		colorPixels.allocate(colorRegion.width / colorReduction, colorRegion.height / colorReduction, ofxKinectColorKernel::getNumChannels(colorOutput));
+		// whatever frame is out now was captured for the old settings
+		colorPixelsSequence = frameBundles.getFrontBuffer()->sequence;
+	}
+	else{
+		colorPixels.clear();
+	}
+
+	if(bUseTexture && bConvertingColor){
+		int w = colorPixels.getWidth();
+		int h = colorPixels.getHeight();
+		videoStreamer.clear();
+		if (colorOutput == ofxKinectColorKernel::OUTPUT_GRAY)
+		{
+			videoTex.allocate(w, h, bProgrammableRenderer ? GL_R8 : GL_LUMINANCE);
+			if (bProgrammableRenderer)
+			{
+				videoTex.setRGToRGBASwizzles(true);
+			}
+			if (bUseTextureStreaming)
+			{
+				videoStreamer.setup(videoTex, w, h, bProgrammableRenderer ? GL_RED : GL_LUMINANCE, GL_UNSIGNED_BYTE, 1);
+			}
+		}
+		else
+		{
+			videoTex.allocate(w, h, GL_RGBA);
+			if (bUseTextureStreaming)
+			{
+				videoStreamer.setup(videoTex, w, h, colorOutput == ofxKinectColorKernel::OUTPUT_BGRA ? GL_BGRA : GL_RGBA, GL_UNSIGNED_BYTE, 4);
+			}
+		}
+	}
+	else if(bUseTexture){
 		if (format != ColorImageFormat_Rgba)
 		{
 			if (bProgrammableRenderer)
@@ -566,32 +994,27 @@ bool ofxKinectCommonBridge::initColorStream( bool mapColorToDepth, ColorImageFor
 		{ 
 			videoTex.allocate(colorFrameDescription.width, colorFrameDescription.height, GL_RGBA);
 		}
-	}
 
-	if (format != ColorImageFormat_Rgba)
-	{
-		videoPixels.allocate(colorFrameDescription.width, colorFrameDescription.height, 2);
-		videoPixelsBack.allocate(colorFrameDescription.width, colorFrameDescription.height, 2);
-	}
-	else
-	{
-		videoPixels.allocate(colorFrameDescription.width, colorFrameDescription.height, OF_IMAGE_COLOR_ALPHA);
-		videoPixelsBack.allocate(colorFrameDescription.width, colorFrameDescription.height, OF_IMAGE_COLOR_ALPHA);
+		videoStreamer.clear();
+		if (bUseTextureStreaming && format == ColorImageFormat_Rgba)
+		{
+			videoStreamer.setup(videoTex, colorFrameDescription.width, colorFrameDescription.height, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+		}
+		else if (bUseTextureStreaming && bProgrammableRenderer)
+		{
+			videoStreamer.setup(videoTex, colorFrameDescription.width, colorFrameDescription.height, GL_RG, GL_UNSIGNED_BYTE, 2);
+		}
 	}
 
-	pColorFrame = new KCBColorFrame();
-	pColorFrame->Buffer = videoPixels.getPixels();
-	pColorFrame->Size = colorFrameDescription.lengthInPixels * colorFrameDescription.bytesPerPixel;
-	pColorFrame->Format = format;
-
-
-	pColorFrameBack = new KCBColorFrame();
-	pColorFrameBack->Buffer = videoPixelsBack.getPixels();
-	pColorFrameBack->Size = colorFrameDescription.lengthInPixels * colorFrameDescription.bytesPerPixel;
-	pColorFrameBack->Format = format;
+	int channels = (format != ColorImageFormat_Rgba) ? 2 : 4;
+	for(int i = 0; i < framePool.size(); i++){
+		framePool[i].color.allocate(colorFrameDescription.width, colorFrameDescription.height, channels);
+		framePool[i].color.frame.Format = format;
+	}
 
 	bVideoIsColor = true;
 	bVideoIsInfrared = false;
+	mappingColorToDepth = mapColorToDepth;
 
 	//HRESULT hr = KCBCreateColorFrame(ColorImageFormat_Rgba, colorFrameDescription, &pColorFrame);
 	return true;
@@ -607,19 +1030,13 @@ bool ofxKinectCommonBridge::initIRStream()
 	bVideoIsInfrared = true;
 	bVideoIsColor = false;
 
-	KCBGetInfraredFrameDescription(hKinect, &irFrameDescription);
-
-	irPixelsFront.allocate(irFrameDescription.width, irFrameDescription.height, OF_IMAGE_GRAYSCALE);
-	irPixelsBack.allocate(irFrameDescription.width, irFrameDescription.height, OF_IMAGE_GRAYSCALE);
-	irPixels.allocate(irFrameDescription.width, irFrameDescription.height, OF_IMAGE_GRAYSCALE);
-
-	pInfraredFrameBack = new KCBInfraredFrame();
-	pInfraredFrameBack->Buffer = irPixelsBack.getPixels();
-	pInfraredFrameBack->Size = irFrameDescription.lengthInPixels;
+	if(!getStreamDescription(KV2_STREAM_INFRARED, irFrameDescription)){
+		return false;
+	}
 
-	pInfraredFrame = new KCBInfraredFrame();
-	pInfraredFrame->Buffer = irPixelsFront.getPixels();
-	pInfraredFrame->Size = irFrameDescription.lengthInPixels;
+	for(int i = 0; i < framePool.size(); i++){
+		framePool[i].infrared.allocate(irFrameDescription.width, irFrameDescription.height, 1);
+	}
 
 	if(bUseTexture)
 	{
@@ -630,6 +1047,10 @@ bool ofxKinectCommonBridge::initIRStream()
 		else{
 			videoTex.allocate(irFrameDescription.width, irFrameDescription.height, GL_LUMINANCE);
 		}
+
+		if(bUseTextureStreaming){
+			videoStreamer.setup(videoTex, irFrameDescription.width, irFrameDescription.height, bProgrammableRenderer ? GL_RED : GL_LUMINANCE, GL_UNSIGNED_SHORT, 2);
+		}
 	}
 
 	bInited = true;
@@ -642,32 +1063,31 @@ bool ofxKinectCommonBridge::initBodyIndexStream()
 		ofLogError("ofxKinectCommonBridge::initBodyIndexStream") << "Cannot configure once the sensor has already started";
 		return false;
 	}
-	HRESULT hr = KCBGetBodyIndexFrameDescription(hKinect, &bodyIndexFrameDescription);
-
-	if (!SUCCEEDED(hr))
+	if (!getStreamDescription(KV2_STREAM_BODY_INDEX, bodyIndexFrameDescription))
 	{
 		ofLogError("ofxKinectCommonBridge::initBodyIndexStream") << "cannot initialize stream";
 		return false;
 	}
 
-	bodyIndexPixels.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, OF_IMAGE_GRAYSCALE);
-	bodyIndexPixelsBack.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, OF_IMAGE_GRAYSCALE);
-
-	pBodyIndexFrameBack = new KCBBodyIndexFrame();
-	pBodyIndexFrameBack->Buffer = bodyIndexPixelsBack.getPixels();
-	pBodyIndexFrameBack->Size = bodyIndexFrameDescription.lengthInPixels;
-
-	pBodyIndexFrame = new KCBBodyIndexFrame();
-	pBodyIndexFrame->Buffer = bodyIndexPixels.getPixels();
-	pBodyIndexFrame->Size = bodyIndexFrameDescription.lengthInPixels;
-
-	if (bProgrammableRenderer)
-	{
-		bodyIndexTex.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_R8);
+	for(int i = 0; i < framePool.size(); i++){
+		framePool[i].bodyIndex.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, 1);
 	}
-	else
+
+	if (bUseTexture)
 	{
-		bodyIndexTex.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_LUMINANCE);
+		if (bProgrammableRenderer)
+		{
+			bodyIndexTex.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_R8);
+		}
+		else
+		{
+			bodyIndexTex.allocate(bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, GL_LUMINANCE);
+		}
+
+		if (bUseTextureStreaming)
+		{
+			bodyIndexStreamer.setup(bodyIndexTex, bodyIndexFrameDescription.width, bodyIndexFrameDescription.height, bProgrammableRenderer ? GL_RED : GL_LUMINANCE, GL_UNSIGNED_BYTE, 1);
+		}
 	}
 	bUsingBodyIndex = true;
 
@@ -681,16 +1101,33 @@ bool ofxKinectCommonBridge::initSkeletonStream( bool seated )
 		return false;
 	}
 
-	skeletons.resize(6);
-	backSkeletons.resize(6);
+	for(int i = 0; i < framePool.size(); i++){
+		framePool[i].bodies.clear();
+		framePool[i].filteredBodies.clear();
+	}
+	for(int i = 0; i < poseFrames.size(); i++){
+		poseFrames[i].clear();
+	}
+	jointFilter.reset();
+	skeletonInterpolator.reset();
+	jointHistory.reset();
+	poseClassifier.reset();
+
+	if(bPlayback){
+		if(!player.hasBodies()){
+			ofLogError("ofxKinectCommonBridge::initSkeletonStream") << "The recording doesn't have bodies";
+			return false;
+		}
+		bUsingSkeletons = true;
+		return true;
+	}
 
-	//HRESULT hr = KCBCreateBodyFrame(&pBodyFrame);
-	//if (hr >= 0){
+	if (backend && backend->openBodyStream()){
 		bUsingSkeletons = true;
 		return true;
-	//}
-	//ofLogError("ofxKinectCommonBridge::initSkeletonStream") << "cannot initialize stream";
-	//return false;
+	}
+	ofLogError("ofxKinectCommonBridge::initSkeletonStream") << "cannot initialize stream";
+	return false;
 }
 
 //----------------------------------------------------------
@@ -713,12 +1150,15 @@ vector<ofVec3f> ofxKinectCommonBridge::mapDepthToSkeleton(const ofShortPixels& d
 
 void ofxKinectCommonBridge::cacheAllDepthFramePoints(){
 	if(allDepthFramePoints.size() != depthFrameDescription.height*depthFrameDescription.width){
-		allDepthFramePoints.clear();
-		for(int y = 0; y < depthFrameDescription.height; y++){
-			for(int x = 0; x < depthFrameDescription.width; x++){
-				allDepthFramePoints.push_back(ofPoint(x,y));
+		int width = depthFrameDescription.width;
+		allDepthFramePoints.resize(depthFrameDescription.height*depthFrameDescription.width);
+		tileExecutor.forEachRowTile(depthFrameDescription.height, [&](int rowBegin, int rowEnd){
+			for(int y = rowBegin; y < rowEnd; y++){
+				for(int x = 0; x < width; x++){
+					allDepthFramePoints[y*width+x] = ofPoint(x,y);
+				}
 			}
-		}
+		});
 	}
 }
 
@@ -742,36 +1182,211 @@ vector<ofVec3f> ofxKinectCommonBridge::mapDepthToSkeleton(const vector<ofPoint>&
 
 //----------------------------------------------------------
 vector<ofVec3f> ofxKinectCommonBridge::mapDepthToSkeleton(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage){
-	vector<DepthSpacePoint> depthPixels;
-	vector<UINT16> depths;
-	vector<CameraSpacePoint> cameraPoints;
-	
-	int depthArraySize = depthFrameDescription.width * depthFrameDescription.height;
-	depthPixels.resize(depthArraySize);
-	depths.resize(depthArraySize);
-	cameraPoints.resize(depthArraySize);
-
-	for(int y = 0; y < depthFrameDescription.height; y++){
-		for(int x = 0; x < depthFrameDescription.width; x++) {
-			int i = y*depthFrameDescription.width+x;
-			depths[i] = (UINT16)depthImage.getPixels()[i];
-			depthPixels[i].X = x;
-			depthPixels[i].Y = y;
+	vector<ofVec3f> points;
+	mapDepthPointsToSkeleton(depthPoints, depthImage, points);
+	return points;
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapDepthPointsToSkeleton(const vector<ofPoint>& depthPoints, vector<ofVec3f>& cameraPoints, bool bBilinear){
+	mapDepthPointsToSkeleton(depthPoints, getRawDepthPixelsRef(), cameraPoints, bBilinear);
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapDepthPointsToSkeleton(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, vector<ofVec3f>& cameraPoints, bool bBilinear){
+	int width = depthFrameDescription.width;
+	int height = depthFrameDescription.height;
+	const unsigned short* depths = depthImage.getPixels();
+	cameraPoints.resize(depthPoints.size());
+	if(depthPoints.empty()){
+		return;
+	}
+
+	// with the ray table each point is a lookup and a multiply, no round trip through the sdk
+	if(updateDepthProjector()){
+		tileExecutor.forEachTile((int)depthPoints.size(), width * tileExecutor.getTileRows(), [&](int begin, int end){
+			for(int i = begin; i < end; i++){
+				float depth = ofxKinectDepthProjector::sampleDepth(depths, width, height, depthPoints[i].x, depthPoints[i].y, bBilinear);
+				if(bBilinear){
+					cameraPoints[i] = depthProjector.projectSubpixel(depthPoints[i].x, depthPoints[i].y, depth);
+				} else {
+					cameraPoints[i] = depthProjector.project((int)ofClamp(depthPoints[i].x, 0, width - 1), (int)ofClamp(depthPoints[i].y, 0, height - 1), (unsigned short)depth);
+				}
+			}
+		});
+		return;
+	}
+
+	// until then the sdk maps just these points
+	if(hKinect == NULL){
+		ofLogError("ofxKinectCommonBridge::mapDepthPointsToSkeleton") << "No sensor to map with, load a calibration with setupCoordinateMapper() first";
+		float unmapped = -numeric_limits<float>::infinity();
+		cameraPoints.assign(depthPoints.size(), ofVec3f(unmapped, unmapped, unmapped));
+		return;
+	}
+#ifndef OFX_KINECT_NO_SDK
+	fillSparseDepthPoints(depthPoints, depthImage, bBilinear);
+	sparseCameraPoints.resize(depthPoints.size());
+	HRESULT hr = KCBMapDepthPointsToCameraSpace(hKinect, 
+		sparseDepthPoints.size(), &sparseDepthPoints[0],
+		sparseDepths.size(), &sparseDepths[0],
+		sparseCameraPoints.size(), &sparseCameraPoints[0]);
+	if(FAILED(hr)){
+		ofLogError("ofxKinectCommonBridge::mapDepthPointsToSkeleton") << "Failed to map depth points to camera space";
+	}
+
+	for(size_t i = 0; i < sparseCameraPoints.size(); i++){
+		cameraPoints[i].set(sparseCameraPoints[i].X, sparseCameraPoints[i].Y, sparseCameraPoints[i].Z);
+	}
+#endif
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapDepthPointsToColor(const vector<ofPoint>& depthPoints, vector<ofVec2f>& colorPoints, bool bBilinear){
+	mapDepthPointsToColor(depthPoints, getRawDepthPixelsRef(), colorPoints, bBilinear);
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapDepthPointsToColor(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, vector<ofVec2f>& colorPoints, bool bBilinear){
+	colorPoints.resize(depthPoints.size());
+	if(depthPoints.empty()){
+		return;
+	}
+
+	fillSparseDepthPoints(depthPoints, depthImage, bBilinear);
+
+	// a calibration maps without the sdk, and is the only way to map a recording or a backend without a sensor
+	if(coordinateMapper.isReady() || hKinect == NULL){
+		if(!coordinateMapper.isReady()){
+			ofLogError("ofxKinectCommonBridge::mapDepthPointsToColor") << "No sensor to map with, load a calibration with setupCoordinateMapper() first";
+			float unmapped = -numeric_limits<float>::infinity();
+			colorPoints.assign(depthPoints.size(), ofVec2f(unmapped, unmapped));
+			return;
 		}
+		tileExecutor.forEachTile((int)depthPoints.size(), depthFrameDescription.width * tileExecutor.getTileRows(), [&](int begin, int end){
+			for(int i = begin; i < end; i++){
+				colorPoints[i] = coordinateMapper.mapDepthToColor(sparseDepthPoints[i].X, sparseDepthPoints[i].Y, sparseDepths[i]);
+			}
+		});
+		return;
 	}
 
-	HRESULT mapResult;
-	mapResult = KCBMapDepthPointsToCameraSpace(hKinect, 
-		depthArraySize, &depthPixels[0],
-		depthArraySize, &depths[0],
-		depthArraySize, &cameraPoints[0]);
-	
-	vector<ofVec3f> points;
-	for(int i = 0; i < depthPoints.size(); i++){
-		CameraSpacePoint& p = cameraPoints[int(depthPoints[i].y) * depthFrameDescription.width + int(depthPoints[i].x)]; 
-		points.push_back( ofVec3f(p.X,p.Y,p.Z) );
+#ifndef OFX_KINECT_NO_SDK
+	sparseColorPoints.resize(depthPoints.size());
+	HRESULT hr = KCBMapDepthPointsToColorSpace(hKinect, 
+		sparseDepthPoints.size(), &sparseDepthPoints[0],
+		sparseDepths.size(), &sparseDepths[0],
+		sparseColorPoints.size(), &sparseColorPoints[0]);
+	if(FAILED(hr)){
+		ofLogError("ofxKinectCommonBridge::mapDepthPointsToColor") << "Failed to map depth points to color space";
 	}
-	return points;
+
+	for(size_t i = 0; i < sparseColorPoints.size(); i++){
+		colorPoints[i].set(sparseColorPoints[i].X, sparseColorPoints[i].Y);
+	}
+#endif
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::fillSparseDepthPoints(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, bool bBilinear){
+	int width = depthFrameDescription.width;
+	int height = depthFrameDescription.height;
+	const unsigned short* depths = depthImage.getPixels();
+
+	sparseDepthPoints.resize(depthPoints.size());
+	sparseDepths.resize(depthPoints.size());
+	tileExecutor.forEachTile((int)depthPoints.size(), width * tileExecutor.getTileRows(), [&](int begin, int end){
+		for(int i = begin; i < end; i++){
+			float x = ofClamp(depthPoints[i].x, 0, width - 1);
+			float y = ofClamp(depthPoints[i].y, 0, height - 1);
+			// the sdk takes sub pixel positions as they are, only the depth has to be sampled
+			sparseDepthPoints[i].X = bBilinear ? x : (int)x;
+			sparseDepthPoints[i].Y = bBilinear ? y : (int)y;
+			sparseDepths[i] = (UINT16)(ofxKinectDepthProjector::sampleDepth(depths, width, height, x, y, bBilinear) + 0.5f);
+		}
+	});
+}
+
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::updateDepthProjector(){
+	if(!depthProjector.isReady() && coordinateMapper.isReady()){
+		// a loaded calibration has the same rays, and works without a sensor
+		depthProjector = coordinateMapper.getDepthProjector();
+	}
+	if(!depthProjector.isReady() && backend){
+		backend->setupDepthProjector(depthProjector, depthFrameDescription.width, depthFrameDescription.height);
+	}
+	return depthProjector.isReady();
+}
+
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::setupCoordinateMapper(const string& calibrationCachePath){
+	if(coordinateMapper.isReady()){
+		return true;
+	}
+	if(!calibrationCachePath.empty() && coordinateMapper.load(calibrationCachePath)){
+		return true;
+	}
+	if(hKinect == NULL){
+		ofLogError("ofxKinectCommonBridge::setupCoordinateMapper") << "No calibration file to load and no sensor to capture one from";
+		return false;
+	}
+
+	// the streams don't have to be open for the mapping, their sizes are fixed
+	KCBFrameDescription depthDescription = depthFrameDescription;
+	KCBFrameDescription colorDescription = colorFrameDescription;
+#ifndef OFX_KINECT_NO_SDK
+	if(depthDescription.width == 0){
+		KCBGetDepthFrameDescription(hKinect, &depthDescription);
+	}
+	if(colorDescription.width == 0){
+		KCBGetColorFrameDescription(hKinect, ColorImageFormat_Rgba, &colorDescription);
+	}
+#endif
+
+	if(!coordinateMapper.setup(hKinect, depthDescription.width, depthDescription.height, colorDescription.width, colorDescription.height)){
+		return false;
+	}
+	if(!calibrationCachePath.empty()){
+		coordinateMapper.save(calibrationCachePath);
+	}
+	return true;
+}
+
+//----------------------------------------------------------
+ofxKinectCoordinateMapper& ofxKinectCommonBridge::getCoordinateMapper(){
+	return coordinateMapper;
+}
+
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::mapDepthToCameraSpace(float* dst, ofxKinectDepthProjector::Layout layout){
+	return mapDepthToCameraSpace(getRawDepthPixelsRef(), dst, layout);
+}
+
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::mapDepthToCameraSpace(const ofShortPixels& depthImage, float* dst, ofxKinectDepthProjector::Layout layout){
+	if(!updateDepthProjector()){
+		return false;
+	}
+
+	const unsigned short* depths = depthImage.getPixels();
+	tileExecutor.forEachRowTile(depthProjector.getHeight(), [&](int rowBegin, int rowEnd){
+		depthProjector.project(depths, dst, layout, rowBegin, rowEnd);
+	});
+	return true;
+}
+
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::mapDepthToCameraSpace(const ofShortPixels& depthImage, float* dstX, float* dstY, float* dstZ){
+	if(!updateDepthProjector()){
+		return false;
+	}
+
+	const unsigned short* depths = depthImage.getPixels();
+	tileExecutor.forEachRowTile(depthProjector.getHeight(), [&](int rowBegin, int rowEnd){
+		depthProjector.project(depths, dstX, dstY, dstZ, rowBegin, rowEnd);
+	});
+	return true;
 }
 
 //----------------------------------------------------------
@@ -810,98 +1425,103 @@ void ofxKinectCommonBridge::mapDepthToColor(const ofShortPixels& depthImage, vec
 }
 
 
-// RICK
-void ofxKinectCommonBridge::altGetColorDepthLookupTable(int frameSize, DepthSpacePoint *depthSpacePoints)
-{
-
-	//vector<UINT16>* spoofDepth;
-	//memcpy(spoofDepth, pDepthFrame->Buffer, frameSize);
-
-	HRESULT hr = KCBMapColorFrameToDepthSpace(hKinect,
-		//frameSize, (UINT16*) depthPixelsRawFront.getPixels(),
-		// frameSize, pDepthFrame->Buffer,
-		frameSize, depthPixelsRawFront.getPixels(),
-		frameSize, depthSpacePoints);
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapColorToDepth(ofShortPixels& dstDepthPixels){
+	if(updateColorToDepthTable()){
+		colorToDepthRegistrar.registerDepth(dstDepthPixels, &tileExecutor);
+	}
+}
 
-	if (FAILED(hr))
-	{
-		int foo = 0;
-		// do some logging...
+//----------------------------------------------------------
+void ofxKinectCommonBridge::mapColorToDepth(ofShortPixels& dstDepthPixels, ofPixels& dstBodyIndexPixels){
+	if(updateColorToDepthTable()){
+		colorToDepthRegistrar.registerDepth(dstDepthPixels, &tileExecutor);
+		if(bUsingBodyIndex){
+			colorToDepthRegistrar.registerBodyIndex(getBodyIndexPixelsRef().getPixels(), dstBodyIndexPixels, &tileExecutor);
+		}
 	}
 }
 
-void ofxKinectCommonBridge::altMapColorToDepth(ofPixels &mappedColorFrame)
-{
-	int depthArraySize = depthFrameDescription.width * depthFrameDescription.height;
-	vector<DepthSpacePoint> depthMapTable;
-	depthMapTable.resize(depthArraySize);
+//----------------------------------------------------------
+ofShortPixels& ofxKinectCommonBridge::getDepthPixelsAlignedToColorRef(){
+	return depthPixelsAlignedToColor;
+}
 
-	altGetColorDepthLookupTable(depthArraySize, &depthMapTable[0]);
+//----------------------------------------------------------
+ofPixels& ofxKinectCommonBridge::getBodyIndexPixelsAlignedToColorRef(){
+	return bodyIndexPixelsAlignedToColor;
+}
 
-	for (int i = 0; i < depthMapTable.size(); ++i)
-	{
-		DepthSpacePoint point = depthMapTable[i];
-		if ((point.X < 0 && point.X >= 1920) 
-			||
-			(point.Y < 0 && point.Y >= 1080))
-		{
-			continue;
-		}
+//----------------------------------------------------------
+// the table only depends on the depth frame, so it is built once per tick however many images read from it
+bool ofxKinectCommonBridge::updateColorToDepthTable(){
+	if(!bUsingDepth || !bVideoIsColor){
+		ofLogError("ofxKinectCommonBridge::updateColorToDepthTable") << "Mapping color to depth needs both the depth and the color stream";
+		return false;
+	}
 
-		//mappedColorFrame.setColor(i, videoPixels.getColor(point.X, point.Y));
-		int index = point.X + (point.Y * 1920);
+	const Kv2FrameBundle& bundle = getFrameBundle();
+	if(colorToDepthRegistrar.isSetup() && bundle.sequence == colorToDepthSequence){
+		return true;
+	}
 
-		mappedColorFrame.getPixels()[i] = videoPixels.getPixels()[index]; // videoPixels.getPixelIndex(point.X, point.Y) ];
+	if(!colorToDepthRegistrar.isSetup()){
+		colorToDepthRegistrar.setup(depthFrameDescription.width, depthFrameDescription.height,
+			colorFrameDescription.width, colorFrameDescription.height);
+	}
 
+	// without a sensor the calibration stands in, update() asks every frame so that is only said once
+	if(hKinect == NULL && !coordinateMapper.isReady()){
+		if(!bWarnedNoColorToDepth){
+			ofLogError("ofxKinectCommonBridge::updateColorToDepthTable") << "No sensor to map with, load a calibration with setupCoordinateMapper() first";
+			bWarnedNoColorToDepth = true;
+		}
+		return false;
 	}
+	// a new bundle can carry the same depth frame, its timestamp tells without comparing the pixels
+	bool bMapped = hKinect == NULL
+		? colorToDepthRegistrar.mapColorFrame(coordinateMapper, bundle.depth.frame.Buffer, &tileExecutor, bundle.depth.frame.TimeStamp)
+		: colorToDepthRegistrar.mapColorFrame(hKinect, bundle.depth.frame.Buffer, &tileExecutor, bundle.depth.frame.TimeStamp);
+	if(!bMapped){
+		return false;
+	}
+	colorToDepthSequence = bundle.sequence;
+	return true;
 }
 
 
 //----------------------------------------------------------
 void ofxKinectCommonBridge::mapDepthToColor(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, vector<ofVec2f>& colorPointsOut){
-	vector<DepthSpacePoint> depthPixels;
-	vector<UINT16> depths;
-	vector<ColorSpacePoint> colorPoints;
-	
-	int depthArraySize = depthFrameDescription.width * depthFrameDescription.height;
-	depthPixels.resize(depthArraySize);
-	depths.resize(depthArraySize);
-	colorPoints.resize(depthArraySize);
-
-	for(int y = 0; y < depthFrameDescription.height; y++){
-		for(int x = 0; x < depthFrameDescription.width; x++) {
-			int i = y*depthFrameDescription.width+x;
-			depths[i] = (UINT16)depthImage.getPixels()[i];
-			depthPixels[i].X = x;
-			depthPixels[i].Y = y;
-		}
-	}
-
-	HRESULT mapResult;
-	mapResult = KCBMapDepthPointsToColorSpace(hKinect, 
-		depthArraySize, &depthPixels[0],
-		depthArraySize, &depths[0],
-		depthArraySize, &colorPoints[0]);
-
-	if(colorPointsOut.size() != colorPoints.size()){
-		colorPointsOut.resize(colorPoints.size());
-	}
+	mapDepthPointsToColor(depthPoints, depthImage, colorPointsOut);
 
-	for(int i = 0; i < colorPoints.size(); i++){
-		ColorSpacePoint& p = colorPoints[int(depthPoints[i].y) * depthFrameDescription.width + int(depthPoints[i].x)]; 
-		colorPointsOut[i].set(ofVec2f(ofClamp(p.X,0,colorFrameDescription.width-1),
-									  ofClamp(p.Y,0,colorFrameDescription.height-1)) );
+	for(int i = 0; i < colorPointsOut.size(); i++){
+		colorPointsOut[i].set(ofClamp(colorPointsOut[i].x,0,colorFrameDescription.width-1),
+							  ofClamp(colorPointsOut[i].y,0,colorFrameDescription.height-1));
 	}
 }
 
 void ofxKinectCommonBridge::mapDepthToColor(ofPixels& dstColorPixels){
-	cacheAllDepthFramePoints();
-	mapDepthToColor(allDepthFramePoints,dstColorPixels);
+	mapDepthToColor(getRawDepthPixelsRef(), dstColorPixels);
 }
 
 void ofxKinectCommonBridge::mapDepthToColor(const ofShortPixels& depthImage, ofPixels& dstColorPixels){
-	cacheAllDepthFramePoints();
-	return mapDepthToColor(allDepthFramePoints,depthImage,dstColorPixels);
+	if(bResamplingColor){
+		ofLogError("ofxKinectCommonBridge::mapDepthToColor") << "Color is cropped or shrunk, mapping needs the whole color frame";
+		return;
+	}
+	// whole frame, the registrar keeps its buffers between calls and gathers row parallel
+	if(!depthToColorRegistrar.isSetup()){
+		depthToColorRegistrar.setup(depthFrameDescription.width, depthFrameDescription.height,
+			colorFrameDescription.width, colorFrameDescription.height);
+	}
+
+	// through the calibration when there is one, the sdk needs a sensor
+	bool bMapped = coordinateMapper.isReady() || hKinect == NULL
+		? depthToColorRegistrar.mapDepthFrame(coordinateMapper, depthImage.getPixels(), &tileExecutor)
+		: depthToColorRegistrar.mapDepthFrame(hKinect, depthImage.getPixels());
+	if(bMapped){
+		depthToColorRegistrar.registerColor(getColorPixelsRef(), dstColorPixels, &tileExecutor);
+	}
 }
 
 void ofxKinectCommonBridge::mapDepthToColor(const vector<ofPoint>& depthPoints, ofPixels& dstColorPixels){
@@ -910,49 +1530,45 @@ void ofxKinectCommonBridge::mapDepthToColor(const vector<ofPoint>& depthPoints,
 }
 
 void ofxKinectCommonBridge::mapDepthToColor(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, ofPixels& dstColorPixels){
-	vector<DepthSpacePoint> depthPixels;
-	vector<UINT16> depths;
-	vector<ColorSpacePoint> colorPoints;
-	
-	int depthArraySize = depthFrameDescription.width * depthFrameDescription.height;
-	depthPixels.resize(depthArraySize);
-	depths.resize(depthArraySize);
-	colorPoints.resize(depthArraySize);
-
-	for(int y = 0; y < depthFrameDescription.height; y++){
-		for(int x = 0; x < depthFrameDescription.width; x++) {
-			int i = y*depthFrameDescription.width+x;
-			depths[i] = (UINT16)depthImage.getPixels()[i];
-			depthPixels[i].X = x;
-			depthPixels[i].Y = y;
-		}
+	// only the given points are mapped and written, everything else stays black
+	if(bResamplingColor){
+		ofLogError("ofxKinectCommonBridge::mapDepthToColor") << "Color is cropped or shrunk, mapping needs the whole color frame";
+		return;
 	}
-
-	HRESULT mapResult;
-	mapResult = KCBMapDepthPointsToColorSpace(hKinect, 
-		depthArraySize, &depthPixels[0],
-		depthArraySize, &depths[0],
-		depthArraySize, &colorPoints[0]);
+	mapDepthPointsToColor(depthPoints, depthImage, sparseMappedColorPoints);
 
 	if(!dstColorPixels.isAllocated() || 
 		dstColorPixels.getWidth() != depthFrameDescription.width ||
-		dstColorPixels.getWidth() != depthFrameDescription.height)
+		dstColorPixels.getHeight() != depthFrameDescription.height)
 	{
 		dstColorPixels.allocate(depthFrameDescription.width,depthFrameDescription.height, OF_IMAGE_COLOR);
 	}
 
-	memset(dstColorPixels.getPixels(), 0, dstColorPixels.getWidth()*dstColorPixels.getHeight()*dstColorPixels.getBytesPerPixel());
-
-	for(int i = 0; i < colorPoints.size(); i++){
-		int depthFrameIndex = int(depthPoints[i].y) * depthFrameDescription.width + int(depthPoints[i].x);
-		ColorSpacePoint& p = colorPoints[depthFrameIndex]; 
-		if(p.X >= 0 && p.X < colorFrameDescription.width &&
-		   p.Y >= 0 && p.Y < colorFrameDescription.height)
-		{
-			dstColorPixels.setColor(depthPoints[i].x,depthPoints[i].y, videoPixels.getColor(p.X,p.Y));
+	ofPixels& videoPixels = getColorPixelsRef();
+
+	int rowBytes = dstColorPixels.getWidth()*dstColorPixels.getBytesPerPixel();
+	tileExecutor.forEachRowTile(dstColorPixels.getHeight(), [&](int rowBegin, int rowEnd){
+		memset(dstColorPixels.getPixels() + rowBegin*rowBytes, 0, (rowEnd - rowBegin)*rowBytes);
+	});
+
+	int srcChannels = videoPixels.getNumChannels();
+	int dstChannels = dstColorPixels.getNumChannels();
+	int channels = MIN(srcChannels, dstChannels);
+	tileExecutor.forEachTile((int)depthPoints.size(), depthFrameDescription.width * tileExecutor.getTileRows(), [&](int begin, int end){
+		for(int i = begin; i < end; i++){
+			ofVec2f& p = sparseMappedColorPoints[i];
+			int x = depthPoints[i].x, y = depthPoints[i].y;
+			if(p.x >= 0 && p.x < colorFrameDescription.width &&
+			   p.y >= 0 && p.y < colorFrameDescription.height &&
+			   x >= 0 && x < depthFrameDescription.width &&
+			   y >= 0 && y < depthFrameDescription.height)
+			{
+				const unsigned char* src = videoPixels.getPixels() + (int(p.y) * colorFrameDescription.width + int(p.x)) * srcChannels;
+				unsigned char* dst = dstColorPixels.getPixels() + (y * depthFrameDescription.width + x) * dstChannels;
+				memcpy(dst, src, channels);
+			}
 		}
-	}
-
+	});
 }
 
 
@@ -1014,128 +1630,339 @@ vector<ofVec3f> ofxKinectCommonBridge::mapColorToSkeleton(vector<ofPoint>& color
 void ofxKinectCommonBridge::stop() {
 	if(bStarted){
 		
+		stopThread();
+		wakePlayback();
 		waitForThread(true);
 
 		bStarted = false;
 
-		KCBCloseSensor(&hKinect);
+		// nothing reaches the recorder once the capture thread is gone
+		recorder.close();
 
-		//delete pBodies; //KCBReleaseBodyFrame(&pBodyFrame);
-		KCBReleaseBodyIndexFrame(&pBodyIndexFrame);
+		depthProjector.clear();
 
-		KCBReleaseColorFrame(&pColorFrame);
-		KCBReleaseColorFrame(&pColorFrameBack);
+		//KCBReleaseLongExposureInfraredFrame(_Inout_ KCBLongExposureInfraredFrame** pLongExposureInfraredFrame);
 
-		KCBReleaseDepthFrame(&pDepthFrame);
-		KCBReleaseDepthFrame(&pDepthFrameBack);
+	}
+	if(backend){
+		backend->close();
+		backend.reset();
+	}
+	hKinect = NULL;
+	player.close();
+	bPlayback = false;
+}	
 
-		KCBReleaseInfraredFrame(&pInfraredFrame);
-		KCBReleaseInfraredFrame(&pInfraredFrameBack);
+//----------------------------------------------------------
+void ofxKinectCommonBridge::seekPlayback(int frame){
+	playbackSeek = MAX(frame, 0);
+	wakePlayback();
+}
 
-		//KCBReleaseLongExposureInfraredFrame(_Inout_ KCBLongExposureInfraredFrame** pLongExposureInfraredFrame);
+bool ofxKinectCommonBridge::isPlaybackDone(){
+	return bPlaybackDone;
+}
+
+ofxKinectPlayer& ofxKinectCommonBridge::getPlayer(){
+	return player;
+}
 
+//----------------------------------------------------------
+bool ofxKinectCommonBridge::startRecording(const string& path){
+	if(!(bUsingDepth || bVideoIsColor || bVideoIsInfrared || bUsingBodyIndex || bUsingSkeletons)){
+		ofLogError("ofxKinectCommonBridge::startRecording") << "Init the streams to record first";
+		return false;
 	}
-}	
+
+	Kv2RecordingHeader header;
+	if(bUsingDepth){
+		header.streamMask |= 1 << KV2_STREAM_DEPTH;
+		header.streams[KV2_STREAM_DEPTH] = depthFrameDescription;
+		header.streams[KV2_STREAM_DEPTH].bytesPerPixel = sizeof(unsigned short);
+	}
+	if(bVideoIsInfrared){
+		header.streamMask |= 1 << KV2_STREAM_INFRARED;
+		header.streams[KV2_STREAM_INFRARED] = irFrameDescription;
+		header.streams[KV2_STREAM_INFRARED].bytesPerPixel = sizeof(unsigned short);
+	}
+	if(bVideoIsColor){
+		header.streamMask |= 1 << KV2_STREAM_COLOR;
+		header.streams[KV2_STREAM_COLOR] = colorFrameDescription;
+		header.streams[KV2_STREAM_COLOR].bytesPerPixel = colorFormat != ColorImageFormat_Rgba ? 2 : 4;
+		header.colorFormat = colorFormat;
+	}
+	if(bUsingBodyIndex){
+		header.streamMask |= 1 << KV2_STREAM_BODY_INDEX;
+		header.streams[KV2_STREAM_BODY_INDEX] = bodyIndexFrameDescription;
+		header.streams[KV2_STREAM_BODY_INDEX].bytesPerPixel = 1;
+	}
+	if(bUsingSkeletons){
+		header.bodyCount = BODY_COUNT;
+	}
+
+	return recorder.open(path, header);
+}
+
+void ofxKinectCommonBridge::stopRecording(){
+	recorder.close();
+}
+
+ofxKinectRecorder& ofxKinectCommonBridge::getRecorder(){
+	return recorder;
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::wakePlayback(){
+	// taking the lock orders this after the capture thread's check of what it waits for, so the wake can't
+	// fall between that check and its wait
+	{
+		std::lock_guard<std::mutex> guard(playbackMutex);
+	}
+	playbackWake.notify_all();
+}
+
+// stands in for waitForFrame() and KCBGetAllFrameData() when playing a recording
+bool ofxKinectCommonBridge::playFrame(Kv2FrameBundle& bundle){
+	int seek = playbackSeek.exchange(-1);
+	if(seek >= 0){
+		playbackFrame = MIN(seek, player.getNumFrames() - 1);
+		playbackClockMicros = 0;
+		bPlaybackDone = false;
+	}
+
+	if(playbackFrame >= player.getNumFrames()){
+		if(!bPlaybackLoop || player.getNumFrames() == 0){
+			bPlaybackDone = true;
+			ofSleepMillis(10);
+			return false;
+		}
+		playbackFrame = 0;
+		playbackClockMicros = 0;
+	}
+
+	if(!player.readFrame(playbackFrame, bundle)){
+		playbackFrame++;
+		return false;
+	}
+	// the os reads the next frames while this one waits for its time
+	player.prefetch(playbackFrame + 1, 2);
+
+	if(bPlaybackRealtime){
+		LONGLONG timeStamp = player.getTimeStamp(playbackFrame);
+		if(playbackClockMicros == 0){
+			playbackClockMicros = ofGetElapsedTimeMicros();
+			playbackClockTimeStamp = timeStamp;
+		}
+		// timestamps are 100ns ticks
+		unsigned long long due = playbackClockMicros + (unsigned long long)MAX(timeStamp - playbackClockTimeStamp, 0) / 10;
+		unsigned long long now = ofGetElapsedTimeMicros();
+		if(due > now){
+			// a timed wait at the 1ms timer resolution the capture thread asks for, cut short by a seek or stop()
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(due - now);
+			std::unique_lock<std::mutex> guard(playbackMutex);
+			while(isThreadRunning() && playbackSeek < 0 && playbackWake.wait_until(guard, deadline) != std::cv_status::timeout){
+			}
+		}
+	}
+	else{
+		// as fast as update() takes them, but never skipping one
+		std::unique_lock<std::mutex> guard(playbackMutex);
+		while(frameBundles.isPending() && isThreadRunning() && playbackSeek < 0){
+			playbackWake.wait(guard);
+		}
+	}
+
+	playbackFrame++;
+	return true;
+}
+
+//----------------------------------------------------------
+// KCB doesn't hand out a waitable handle for frame arrival, only KCBMultiFrameReady.
+// Rather than polling on a fixed sleep we sleep through the part of the frame period
+// in which nothing can arrive and only poll from shortly before the expected tick. The
+// polls sleep too, at the 1ms timer resolution the capture thread asks for, so a frame
+// is seen within about a millisecond without spinning a core.
+bool ofxKinectCommonBridge::waitForFrame(){
+	const unsigned long long guardMicros = 2000;
+	const unsigned long long pollMicros = 500;
+
+	// a backend without a frame rate has a frame whenever it is asked
+	if(backend->getFramePeriodMicros() == 0){
+		return backend->isFrameReady();
+	}
+
+	unsigned long long now = ofGetElapsedTimeMicros();
+	unsigned long long expected = lastArrivalMicros + (unsigned long long)framePeriodMicros;
+	if(lastArrivalMicros != 0 && expected > now + guardMicros){
+		std::this_thread::sleep_for(std::chrono::microseconds(expected - now - guardMicros));
+	}
+
+	// the sensor drops to 15fps in low light, so give up after two periods and let
+	// the caller check whether the thread should still be running
+	unsigned long long timeout = ofGetElapsedTimeMicros() + (unsigned long long)(framePeriodMicros * 2);
+	while(!backend->isFrameReady()){
+		if(!isThreadRunning() || ofGetElapsedTimeMicros() > timeout){
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(pollMicros));
+	}
+	return true;
+}
+
+//----------------------------------------------------------
+// when the frame was there to be picked up, rather than when a poll noticed it: the sensor's
+// timestamp in ofGetElapsedTimeMicros(). a frame that was noticed late only makes the offset
+// between the clocks larger, so the smallest of the last frames is the closest to the truth
+unsigned long long ofxKinectCommonBridge::getArrivalMicros(LONGLONG timeStamp, unsigned long long detectedMicros){
+	if(timeStamp <= 0){
+		return detectedMicros;
+	}
+	// a new backend or a restarted sensor starts its clock over
+	if(timeStamp < lastFrameTimeStamp){
+		numClockOffsets = 0;
+	}
+
+	clockOffsets[nextClockOffset] = (long long)detectedMicros - timeStamp / 10;
+	nextClockOffset = (nextClockOffset + 1) % NUM_CLOCK_OFFSETS;
+	numClockOffsets = MIN(numClockOffsets + 1, (int)NUM_CLOCK_OFFSETS);
+	long long offset = clockOffsets[(nextClockOffset + NUM_CLOCK_OFFSETS - 1) % NUM_CLOCK_OFFSETS];
+	for(int i = 0; i < numClockOffsets; i++){
+		offset = MIN(offset, clockOffsets[i]);
+	}
+	return (unsigned long long)MAX(timeStamp / 10 + offset, 0LL);
+}
+
+//----------------------------------------------------------
+void ofxKinectCommonBridge::stampFrameBundle(Kv2FrameBundle& bundle){
+	LONGLONG stamps[5];
+	int count = 0;
+
+	// a stream left at 0 wasn't in the frame, e.g. one a recording lacks
+	if(bUsingDepth && bundle.depth.frame.TimeStamp != 0) stamps[count++] = bundle.depth.frame.TimeStamp;
+	if(bUsingBodyIndex && bundle.bodyIndex.frame.TimeStamp != 0) stamps[count++] = bundle.bodyIndex.frame.TimeStamp;
+	if(bVideoIsColor && bundle.color.frame.TimeStamp != 0) stamps[count++] = bundle.color.frame.TimeStamp;
+	if(bVideoIsInfrared && bundle.infrared.frame.TimeStamp != 0) stamps[count++] = bundle.infrared.frame.TimeStamp;
+	if(bUsingSkeletons && bundle.bodies.timeStamp != 0) stamps[count++] = bundle.bodies.timeStamp;
+
+	LONGLONG earliest = count > 0 ? stamps[0] : 0;
+	LONGLONG latest = earliest;
+	for(int i = 1; i < count; i++){
+		earliest = MIN(earliest, stamps[i]);
+		latest = MAX(latest, stamps[i]);
+	}
+
+	bundle.timeStamp = earliest;
+	bundle.timeStampSkew = latest - earliest;
+	bundle.sequence = ++bundleSequence;
+}
 
 //----------------------------------------------------------
 void ofxKinectCommonBridge::threadedFunction(){
 
-	LONGLONG timestamp;
-	
-	//how can we tell?
+#ifdef _WIN32
+	// windows sleeps in 15.6ms steps by default, too coarse to wait on a 33ms frame with
+	timeBeginPeriod(1);
+#endif
+
+	unsigned int streamMask = 0;
+	if(bUsingDepth) streamMask |= 1 << KV2_STREAM_DEPTH;
+	if(bVideoIsInfrared) streamMask |= 1 << KV2_STREAM_INFRARED;
+	if(bVideoIsColor) streamMask |= 1 << KV2_STREAM_COLOR;
+	if(bUsingBodyIndex) streamMask |= 1 << KV2_STREAM_BODY_INDEX;
+
 	while(isThreadRunning()) {
 
-		// KCBAllFramesReady
-		if (bUsingDepth && KCBIsFrameReady(hKinect, FrameSourceTypes_Depth) && SUCCEEDED(KCBGetDepthFrame(hKinect, pDepthFrame)))
-		{
-			bNeedsUpdateDepth = true;
+		if(!bPlayback && !waitForFrame()){
+			continue;
 		}
 
-		if (bUsingBodyIndex)
-		{
-			
-			if (SUCCEEDED(KCBGetBodyIndexFrame(hKinect, pBodyIndexFrame)))
-			{
-				bNeedsUpdateBodyIndex = true;
+		unsigned long long detected = ofGetElapsedTimeMicros();
+
+		// one call fetches every enabled stream from the backend
+		// whatever the back slot held has been passed over by update(), give it back and
+		// take a free frame from the pool for the sensor to write into
+		Kv2FrameRef& back = frameBundles.getBackBuffer();
+		back.release();
+		back = framePool.acquire();
+		if(!back.isValid()){
+			if(!bWarnedPoolExhausted){
+				ofLogWarning("ofxKinectCommonBridge::threadedFunction") << "every pooled frame is held, dropping frames. Release frame refs sooner or raise setFramePoolSize()";
+				bWarnedPoolExhausted = true;
 			}
+			ofSleepMillis(1);
+			continue;
 		}
 
-		if (bVideoIsInfrared)
+		// straight into the back bundle, update() can't see it until it is published
+		Kv2FrameBundle& bundle = *back;
+		if(bPlayback)
 		{
-			if (SUCCEEDED(KCBGetInfraredFrame(hKinect, pInfraredFrame)))
+			if(!playFrame(bundle))
 			{
-				bNeedsUpdateVideo = true;
+				continue;
 			}
+			detected = ofGetElapsedTimeMicros();
 		}
-		else if(bVideoIsColor)
+		else
 		{
-			if (SUCCEEDED(KCBGetColorFrame(hKinect, pColorFrame)))
+			if(!backend->readFrame(bundle, streamMask, bUsingSkeletons))
 			{
-				bNeedsUpdateVideo = true;
+				continue;
 			}
 		}
 
-		if(bUsingSkeletons) 
+		// a frame the backend had no new bodies for keeps the last result
+		if(bUsingSkeletons)
 		{
-			LONGLONG timestamp;
-			IBodyFrame* pBodyFrame = NULL;
-			IBody* ppBodies[BODY_COUNT] = { 0 };
-			if (SUCCEEDED(KCBGetIBodyFrame(hKinect, &pBodyFrame)))
-			{
-				HRESULT hr = pBodyFrame->GetAndRefreshBodyData(BODY_COUNT, ppBodies);
-
-				// buffer for later
-				for (int i = 0; i < BODY_COUNT; ++i)
-				{
-					backSkeletons[i].joints.clear();
-					backSkeletons[i].tracked = false;
-
-					IBody *pBody = ppBodies[i];
-					BOOLEAN isTracked = false;
-
-					if (pBody == NULL)
-					{
-						continue;
-					}
-
-					HRESULT hr = pBody->get_IsTracked(&isTracked);
-					if (isTracked)
-					{
-						HRESULT hrJoints = ppBodies[i]->GetJoints(JointType_Count, joints);
-						HRESULT hrOrient = ppBodies[i]->GetJointOrientations(JointType_Count, jointOrients);
-						if (FAILED(hrJoints))
-						{
-							ofLogError("ofxKinectCommonBridge::threadedFunction") << "Failed to get joints";
-						}
-
-						if (FAILED(hrOrient))
-						{
-							ofLogError("ofxKinectCommonBridge::threadedFunction") << "Failed to get orientations";
-						}
-
-						if (SUCCEEDED(hrJoints) && SUCCEEDED(hrOrient))
-						{
-							for (int j = 0; j < JointType_Count; ++j)
-							{
-								backSkeletons[i].joints[joints[j].JointType] = Kv2Joint(joints[j], jointOrients[j]);
-							}
-						}
-						backSkeletons[i].tracked = true;
-					}
-
-					pBody->Release();
-				}
+			bundle.filteredBodies = jointFilter.apply(bundle.bodies);
+			jointHistory.push(bundle.filteredBodies);
+		}
 
-				// all done clean up
-				pBodyFrame->Release();
-				bNeedsUpdateSkeleton = true;
+		// all streams of this tick go out together. a recording's timestamps only say when it was
+		// recorded, its frames arrive when they are read
+		stampFrameBundle(bundle);
+		unsigned long long arrival = bPlayback ? detected : getArrivalMicros(bundle.timeStamp, detected);
+		bundle.arrivalMicros = arrival;
+		if(recorder.isRecording())
+		{
+			// the recorder holds its own reference, the bundle goes back to the pool once it is written
+			recorder.write(back);
+		}
+		frameBundles.publish();
 
-			}
+		unsigned long long published = ofGetElapsedTimeMicros();
+
+		// labelled once the frame is out, so the library never holds it up. every body frame is classified
+		// however often update() runs, and the labels go out on their own
+		if(bUsingSkeletons)
+		{
+			poseClassifier.classify(bundle.filteredBodies, poseFrames.getBackBuffer());
+			poseFrames.publish();
 		}
+
+		lock();
+		// from the sensor's timestamps where there are any, they don't jitter with the polls. ignore
+		// gaps from dropped frames so a stall doesn't stretch the next sleep
+		bool bTimeStamped = lastFrameTimeStamp > 0 && bundle.timeStamp > lastFrameTimeStamp;
+		float interval = bTimeStamped ? (bundle.timeStamp - lastFrameTimeStamp) / 10.0f : (float)(arrival - lastArrivalMicros);
+		if(lastArrivalMicros != 0 && interval < framePeriodMicros * 1.5f){
+			framePeriodMicros = ofLerp(framePeriodMicros, interval, 0.1f);
+		}
+		lastArrivalMicros = arrival;
+		lastFrameTimeStamp = bundle.timeStamp;
+		maxTimestampSkew = MAX(maxTimestampSkew, bundle.timeStampSkew);
+		captureLatencyMicros = (float)(published - arrival);
+		averageCaptureLatencyMicros = ofLerp(averageCaptureLatencyMicros, captureLatencyMicros, 0.1f);
+		capturedFrameCount++;
+		unlock();
+
 		//TODO: TILT
 		//TODO: ACCEL
 		//TODO: FACE
 		//TODO: AUDIO
-		ofSleepMillis(10);
 	}
+
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
 }
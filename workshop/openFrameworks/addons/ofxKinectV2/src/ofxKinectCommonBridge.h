@@ -2,52 +2,37 @@
 
 #include "ofMain.h"
 
-#include "KCBv2LIB.h"
-#pragma comment (lib, "KCBv2.lib") // add path to lib additional dependency dir $(TargetDir)
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// not sure this is right
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-class Kv2Joint
-{
-  public:
-	Kv2Joint(){}
-	Kv2Joint(const _Joint& kcbPosition, const _JointOrientation& kcbOrientation)
-	{
-		jointOrientation.set(kcbOrientation.Orientation.x, kcbOrientation.Orientation.y, kcbOrientation.Orientation.z, kcbOrientation.Orientation.w);
-		jointPosition.set(kcbPosition.Position.X, kcbPosition.Position.Y, kcbPosition.Position.Z);
-		type = kcbPosition.JointType;
-	}
-
-	ofVec3f getPosition()
-	{
-		return jointPosition;
-	}
-
-	ofQuaternion getOrientation()
-	{
-		return jointOrientation;
-	}
-
-	TrackingState getTrackingState()
-	{
-		return trackingState;
-	}
-
-  protected:
-	ofVec3f jointPosition;
-	ofQuaternion jointOrientation;
-	JointType type;
-	TrackingState trackingState;
-};
+#include <mutex>
+#include <condition_variable>
 
-class Kv2Skeleton
-{
-  public:
-	bool tracked;
-	map<JointType, Kv2Joint> joints;
-};
+#include "ofxKinectTypes.h"
+#ifndef OFX_KINECT_NO_SDK
+#pragma comment (lib, "KCBv2.lib") // add path to lib additional dependency dir $(TargetDir)
+#endif
+
+#include "ofxKinectTripleBuffer.h"
+#include "ofxKinectFramePool.h"
+#include "ofxKinectDepthKernel.h"
+#include "ofxKinectColorKernel.h"
+#include "ofxKinectTileExecutor.h"
+#include "ofxKinectTextureStreamer.h"
+#include "ofxKinectDepthProjector.h"
+#include "ofxKinectDepthToColorRegistrar.h"
+#include "ofxKinectColorToDepthRegistrar.h"
+#include "ofxKinectCoordinateMapper.h"
+#include "ofxKinectRecorder.h"
+#include "ofxKinectPlayer.h"
+#include "ofxKinectSensorBackend.h"
+#ifndef OFX_KINECT_NO_SDK
+#include "ofxKinectKCBBackend.h"
+#endif
+#include "ofxKinectSyntheticBackend.h"
+#include "ofxKinectSkeletonFrame.h"
+#include "ofxKinectJointFilter.h"
+#include "ofxKinectSkeletonInterpolator.h"
+#include "ofxKinectJointHistory.h"
+#include "ofxKinectPoseClassifier.h"
+#include "ofxKinectFrameBundle.h"
 
 class ofxKinectCommonBridge : protected ofThread {
   public:
@@ -56,15 +41,68 @@ class ofxKinectCommonBridge : protected ofThread {
 	~ofxKinectCommonBridge();
 
 	// new API
+	/// number of frames the sensor can write into, call before initSensor() or initPlayback() and
+	/// while no getFrameRef() handle is held. three are always in flight between the capture thread
+	/// and update(), the rest can be held through getFrameRef()
+	void setFramePoolSize(int size = 4);
+
+	/// threads the pixel loops are split across, 0 uses every hardware thread, 1 keeps them on the calling thread
+	void setNumWorkerThreads(int numThreads = 0);
+	/// tile size and per tile timing of the pixel loops
+	ofxKinectTileExecutor& getTileExecutor();
+	/// settings of the whole frame mapDepthToColor(ofPixels&)
+	ofxKinectDepthToColorRegistrar& getDepthToColorRegistrar();
+
+	/// opens the sensor through ofxKinectKCBBackend, fails when built with OFX_KINECT_NO_SDK
 	bool initSensor( );
+	/// take frames from a backend instead of the sensor, e.g. an ofxKinectSyntheticBackend for running
+	/// without hardware. the bridge keeps the backend until stop()
+	bool initSensor(ofPtr<ofxKinectSensorBackend> backend);
+	/// what initSensor() opened, empty before and after stop()
+	ofPtr<ofxKinectSensorBackend> getBackend();
+	/// replay a recording instead of opening the sensor, the init*Stream() calls then pick streams from it.
+	/// realtime keeps the recorded frame timing; otherwise every frame is handed to update() as soon as it
+	/// picked up the last one, so a run sees the same frames every time
+	bool initPlayback(const string& path, bool bRealtime = true, bool bLoop = true);
 	bool initDepthStream( bool mapDepthToColor = false );
+	/// with mapColorToDepth update() also fills getDepthPixelsAlignedToColorRef() and getBodyIndexPixelsAlignedToColorRef()
 	bool initColorStream(bool mapColorToDepth = false, ColorImageFormat format = ColorImageFormat_Rgba);
+	/// with rgba asked of initColorStream(), capture the sensor's native yuy2 and convert it on the worker
+	/// threads into output, which is what getColorPixelsRef() and the color texture then hold, instead of
+	/// having the sdk convert to rgba. on with rgba by default, set before initColorStream()
+	void setColorConversion(bool bConvert, ofxKinectColorKernel::Output output = ofxKinectColorKernel::OUTPUT_RGBA);
+	/// have the conversion keep only region of the color frame, shrunk by reduction (1, 2 or 4), so
+	/// getColorPixelsRef() and the color texture are getColorRegion() / reduction. the mapping between
+	/// depth and color needs the whole frame. set before initColorStream()
+	void setColorResampling(int reduction, ofxKinectColorKernel::Filter filter = ofxKinectColorKernel::FILTER_BOX, const ofRectangle& region = ofRectangle());
+	/// the part of the color frame the color pixels cover, in color frame pixels
+	ofRectangle getColorRegion();
+	ofxKinectColorKernel& getColorKernel();
+	/// smooths every body on the capture thread, holt with the sdk's defaults unless set up otherwise
+	/// before start(). METHOD_NONE hands the sensor's joints through
+	ofxKinectJointFilter& getJointFilter();
+	/// labels the filtered bodies of every frame on the capture thread, after the frame has gone out to
+	/// update(). its library can be changed from any thread at any time
+	ofxKinectPoseClassifier& getPoseClassifier();
 	bool initIRStream();
 	bool initSkeletonStream( bool seated );
 	bool start();
 
 	void stop();
 
+	/// jump to a frame of the recording being played
+	void seekPlayback(int frame);
+	/// the last frame of a recording that doesn't loop has been handed out
+	bool isPlaybackDone();
+	/// header and index of the recording being played, only read frames from it while stopped
+	ofxKinectPlayer& getPlayer();
+
+	/// write every frame of the enabled streams to a recording until stopRecording(). the frames wait for
+	/// the disk in the frame pool, so raise setFramePoolSize() by the recorder's queue length
+	bool startRecording(const string& path);
+	void stopRecording();
+	ofxKinectRecorder& getRecorder();
+
   	/// is the current frame new?
 	bool isFrameNew();
 	bool isFrameNewVideo();
@@ -72,6 +110,21 @@ class ofxKinectCommonBridge : protected ofThread {
 	bool isNewSkeleton();
 	bool initBodyIndexStream();
 
+	/// all streams from the newest sensor tick picked up by update(), valid until the next update()
+	const Kv2FrameBundle& getFrameBundle();
+	/// the same bundle, kept alive without copying for as long as the handle is held
+	Kv2FrameRef getFrameRef();
+	/// the largest timestamp skew between streams seen in any bundle so far, in 100ns ticks
+	LONGLONG getMaxTimestampSkew();
+
+	/// time from a sensor frame arriving to it being published to update(), in microseconds. arrival is
+	/// taken from the sensor's timestamp, so time the capture thread took to notice the frame counts
+	float getCaptureLatencyMicros();
+	float getAverageCaptureLatencyMicros();
+	/// measured time between sensor frames, in microseconds
+	float getFramePeriodMicros();
+	unsigned long long getCapturedFrameCount();
+
 	void setDepthClipping(float nearClip=500, float farClip=4000);
 	
 	/// updates the pixel buffers and textures
@@ -81,17 +134,41 @@ class ofxKinectCommonBridge : protected ofThread {
 
 	ofPixels& getColorPixelsRef();
 	ofPixels& getDepthPixelsRef();       	///< grayscale values
-	ofShortPixels& getRawDepthPixelsRef();	///< raw 11 bit values
+	ofShortPixels& getRawDepthPixelsRef();	///< raw 11 bit values, a view of the sensor's buffer
 	ofFloatPixels& getFloatDepthPixelsRef();	///normalized 0 - 1, only works if setRawTextureUsesFloats is true
 	ofShortPixels& getIRPixelsRef();
 	ofPixels& getBodyIndexPixelsRef();
-	vector<Kv2Skeleton> getSkeletons();
-
-	/// enable/disable frame loading into textures on update()
+	/// every body of the latest frame through the joint filter, valid until the next update(). allocates nothing
+	const Kv2SkeletonFrame& getSkeletonFrame();
+	/// the same bodies as the sensor sent them, which is what recordings keep
+	const Kv2SkeletonFrame& getRawSkeletonFrame();
+	/// the filtered bodies copied out joint by joint, only when the frame changed
+	const vector<Kv2Skeleton>& getSkeletons();
+	/// the filtered bodies at a time of ofGetElapsedTimeMicros(), between the last two frames or up to the
+	/// interpolator's horizon past the newest. ask for when the frame being drawn will be shown to hide the
+	/// sensor's 30hz, valid until the next call. allocates nothing
+	const Kv2SkeletonFrame& getSkeletonFrameAt(unsigned long long micros);
+	/// fed by update(), for the horizon and queries by sensor timestamp
+	ofxKinectSkeletonInterpolator& getSkeletonInterpolator();
+	/// the last seconds of every filtered body by tracking id, written by the capture thread as frames come
+	/// in and safe to query from any thread
+	const ofxKinectJointHistory& getJointHistory();
+	/// the label of every body of the latest classified frame, see getPoseClassifier(). the labels go out
+	/// just after their frame, so they can be an update() behind getSkeletonFrame(); timeStamp says which
+	const Kv2PoseFrame& getPoseFrame();
+
+	/// enable/disable frame loading into textures on update(). false before initSensor() or initPlayback()
+	/// makes the bridge headless: no texture is allocated and no gl call is made, so it runs without a gl
+	/// context while pixels, skeletons and mappings stay available
 	void setUseTexture(bool bUse);
 	/// In the programmable renderer, this will switch the raw texture over to using GL_R32F as opposed to GL_LUMINANCE16UI_EXT
 	/// This was because I was experiencing issues on some cards and the unsigned int extensions
 	void setRawTextureUsesFloats(bool bUseRawFloat);
+	/// frames reach the textures through pixel buffer objects, so update() only queues the copies instead
+	/// of waiting for them. on where the gl supports it, set before the init calls
+	void setUseTextureStreaming(bool bUse);
+	/// time update() spends handing a stream's frames to its textures, streamed or loaded, in microseconds
+	float getTextureUploadMicros(Kv2RecordedStream stream);
 
 	/// draw the video texture
 	void draw(float x, float y, float w, float h);
@@ -126,9 +203,33 @@ class ofxKinectCommonBridge : protected ofThread {
 	vector<ofVec3f> mapDepthToSkeleton(const ofShortPixels& depthImage);
 	vector<ofVec3f> mapDepthToSkeleton(const vector<ofPoint>& depthPoints);
 	vector<ofVec3f> mapDepthToSkeleton(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage);
+
+	//only the given depth pixels are mapped, so the cost follows the number of points rather than the frame.
+	//bBilinear samples depth between the neighbouring pixels for sub pixel positions
+	void mapDepthPointsToSkeleton(const vector<ofPoint>& depthPoints, vector<ofVec3f>& cameraPoints, bool bBilinear = false);
+	void mapDepthPointsToSkeleton(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, vector<ofVec3f>& cameraPoints, bool bBilinear = false);
+	void mapDepthPointsToColor(const vector<ofPoint>& depthPoints, vector<ofVec2f>& colorPoints, bool bBilinear = false);
+	void mapDepthPointsToColor(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, vector<ofVec2f>& colorPoints, bool bBilinear = false);
+
+	//camera space of every depth pixel in meters, written into a buffer you own. interleaved needs
+	//3 floats per depth pixel, planar writes all x, then all y, then all z. false until the sensor has
+	//reported its calibration
+	bool mapDepthToCameraSpace(float* dst, ofxKinectDepthProjector::Layout layout = ofxKinectDepthProjector::LAYOUT_INTERLEAVED);
+	bool mapDepthToCameraSpace(const ofShortPixels& depthImage, float* dst, ofxKinectDepthProjector::Layout layout = ofxKinectDepthProjector::LAYOUT_INTERLEAVED);
+	bool mapDepthToCameraSpace(const ofShortPixels& depthImage, float* dstX, float* dstY, float* dstZ);
+
+	//mapping without the sdk from a calibration captured once, see ofxKinectCoordinateMapper. with a cache path
+	//the calibration is read from that file if it exists, otherwise it is captured from the sensor and written
+	//there. false until the sensor has reported its calibration. once set up mapDepthToCameraSpace, the depth to color
+	//mappings and mapColorToDepth go through it, so they work on recordings and backends without a sensor
+	bool setupCoordinateMapper(const string& calibrationCachePath = "");
+	ofxKinectCoordinateMapper& getCoordinateMapper();
 	
-	void altGetColorDepthLookupTable(int frameSize, DepthSpacePoint *depthSpacePoints);
-	void altMapColorToDepth(ofPixels &mappedColorFrame); // RICK
+	//depth (and body index) of the current frame at color resolution, unseen color pixels get depth 0 and body index 255
+	void mapColorToDepth(ofShortPixels& dstDepthPixels);
+	void mapColorToDepth(ofShortPixels& dstDepthPixels, ofPixels& dstBodyIndexPixels);
+	ofShortPixels& getDepthPixelsAlignedToColorRef();
+	ofPixels& getBodyIndexPixelsAlignedToColorRef();
 	 
 	//get a coordinate in the color image back from a point in the depthImage
 	ofVec2f mapDepthToColor(ofPoint depthPoint);
@@ -142,6 +243,7 @@ class ofxKinectCommonBridge : protected ofThread {
 
 	//these mappings copy color pixels into the destination provided
 	//if dstColorPixels isn't allocated it will be forced to the same size as depthImage
+	//the whole frame versions go through the registrar, see getDepthToColorRegistrar() for bilinear and occlusion
 	void mapDepthToColor(ofPixels& dstColorPixels);
 	void mapDepthToColor(const ofShortPixels& depthImage, ofPixels& dstColorPixels);
 	void mapDepthToColor(const vector<ofPoint>& depthPoint, ofPixels& dstColorPixels);
@@ -167,16 +269,25 @@ class ofxKinectCommonBridge : protected ofThread {
 
   protected:
 
+	// where live frames come from, hKinect is its sdk handle for the mappings and NULL without a sensor
+	ofPtr<ofxKinectSensorBackend> backend;
     KCBHANDLE hKinect;
 	ColorImageFormat colorFormat;
 
   	bool bInited;
 	bool bStarted;
-	vector<Kv2Skeleton> skeletons;
-	vector<Kv2Skeleton> backSkeletons;
 
-	//quantize depth buffer to 8 bit range
-	vector<unsigned char> depthLookupTable;
+	// the sensor writes into bundles from the pool, one per tick, and the capture thread hands
+	// references to them to update() through a lock free triple buffer
+	ofxKinectFramePool<Kv2FrameBundle> framePool;
+	ofxKinectTripleBuffer<Kv2FrameRef> frameBundles;
+	bool bWarnedPoolExhausted;
+	void stampFrameBundle(Kv2FrameBundle& bundle);
+	unsigned long long bundleSequence;
+	LONGLONG maxTimestampSkew;
+
+	//quantize depth buffer to 8 bit range, the normalized float image comes out of the same pass
+	ofxKinectDepthKernel depthKernel;
 	void updateDepthLookupTable();
 	void updateDepthPixels();
 	void updateIRPixels();
@@ -191,58 +302,125 @@ class ofxKinectCommonBridge : protected ofThread {
 	ofTexture videoTex; ///< the RGB texture
 	ofTexture bodyIndexTex;
 
-	ofPixels videoPixels;
-	ofPixels videoPixelsBack;			///< rgb back
+	// set up by the init calls next to the textures, loadData() is used while they aren't ready
+	bool bUseTextureStreaming;
+	ofxKinectTextureStreamer videoStreamer;
+	ofxKinectTextureStreamer depthStreamer;
+	ofxKinectTextureStreamer rawDepthStreamer;
+	ofxKinectTextureStreamer bodyIndexStreamer;
+	float textureUploadMicros[KV2_STREAM_COUNT];
+	void recordTextureUpload(Kv2RecordedStream stream, unsigned long long startMicros);
+
 	ofPixels depthPixels;
-	ofPixels depthPixelsBack;
-	ofShortPixels depthPixelsRaw;
-	ofShortPixels depthPixelsRawBack;	///< depth back
-	ofShortPixels depthPixelsRawFront;
 	ofFloatPixels depthPixelsNormalized;
-	
-	ofShortPixels irPixelsFront;
-	ofShortPixels irPixelsBack;
-	ofShortPixels irPixels;
 
-	ofPixels bodyIndexPixelsBack;
-	ofPixels bodyIndexPixels;
+	// the captured yuy2 converted in update(), bundles keep what the sensor sent. a streamed texture
+	// gets it converted straight into the mapped buffer, colorPixels only when the cpu asks for them
+	ofxKinectColorKernel colorKernel;
+	bool bConvertColor;
+	bool bConvertingColor;
+	ofxKinectColorKernel::Output colorOutput;
+	int colorReduction;
+	ofxKinectColorKernel::Filter colorFilter;
+	ofRectangle colorRegion;
+	bool bResamplingColor;
+	ofPixels colorPixels;
+	unsigned long long colorPixelsSequence;
+	void convertColor(unsigned char* dst);
+	void updateColorPixels();
 
 	bool bIsFrameNewVideo;
-	bool bNeedsUpdateVideo;
 	bool bIsFrameNewDepth;
-	bool bNeedsUpdateDepth;
-	bool bNeedsUpdateSkeleton;
 	bool bIsSkeletonFrameNew;
+	bool bIsFrameNewBodyIndex;
 	bool bProgrammableRenderer;
 
-	bool bNeedsUpdateBodyIndex;
-
 	bool bVideoIsColor;
 	bool bVideoIsInfrared;
 	bool bUsingSkeletons;
+	ofxKinectJointFilter jointFilter;
+	ofxKinectSkeletonInterpolator skeletonInterpolator;
+	ofxKinectJointHistory jointHistory;
+	ofxKinectPoseClassifier poseClassifier;
+	ofxKinectTripleBuffer<Kv2PoseFrame> poseFrames;
+	vector<Kv2Skeleton> skeletons;
+	unsigned long long skeletonsSequence;
 	bool bUsingDepth;
 	bool bUsingBodyIndex;
 
 	BYTE *irPixelByteArray;
 
 	void threadedFunction();
+	bool waitForFrame();
+	unsigned long long getArrivalMicros(LONGLONG timeStamp, unsigned long long detectedMicros);
+
+	// the sensor's clock less ofGetElapsedTimeMicros() of the last frames, capture thread only
+	enum { NUM_CLOCK_OFFSETS = 32 };
+	long long clockOffsets[NUM_CLOCK_OFFSETS];
+	int numClockOffsets;
+	int nextClockOffset;
+	LONGLONG lastFrameTimeStamp;
+
+	// capture timing, written by the capture thread under the thread lock
+	unsigned long long lastArrivalMicros;
+	unsigned long long capturedFrameCount;
+	float framePeriodMicros;
+	float captureLatencyMicros;
+	float averageCaptureLatencyMicros;
 
 	bool mappingColorToDepth;
 	bool mappingDepthToColor;
-	bool beginMappingColorToDepth;
-
-	KCBDepthFrame *pDepthFrame, *pDepthFrameBack;
-	KCBColorFrame *pColorFrame, *pColorFrameBack;
-	KCBInfraredFrame *pInfraredFrame, *pInfraredFrameBack;
-	//KCBBodyFrame* pBodyFrame; // not using this yet
 
-	JointOrientation jointOrients[JointType_Count];
-	Joint joints[JointType_Count];
+	// color to depth table, rebuilt once per depth frame that differs from the last
+	ofxKinectColorToDepthRegistrar colorToDepthRegistrar;
+	unsigned long long colorToDepthSequence;
+	bool bWarnedNoColorToDepth;
+	bool updateColorToDepthTable();
+	ofShortPixels depthPixelsAlignedToColor;
+	ofPixels bodyIndexPixelsAlignedToColor;
 
 	vector<ofPoint> allDepthFramePoints;
 	void cacheAllDepthFramePoints();
 
-	KCBBodyIndexFrame *pBodyIndexFrame, *pBodyIndexFrameBack;
+	// scratch for the sparse mappings, kept so repeated queries don't allocate
+	void fillSparseDepthPoints(const vector<ofPoint>& depthPoints, const ofShortPixels& depthImage, bool bBilinear);
+	vector<DepthSpacePoint> sparseDepthPoints;
+	vector<UINT16> sparseDepths;
+	vector<CameraSpacePoint> sparseCameraPoints;
+	vector<ColorSpacePoint> sparseColorPoints;
+	vector<ofVec2f> sparseMappedColorPoints;
+
+	// full frame depth to color, buffers kept between frames
+	ofxKinectDepthToColorRegistrar depthToColorRegistrar;
+
+	// runs every per pixel loop above in row tiles
+	ofxKinectTileExecutor tileExecutor;
+
+	// the sensor's per pixel rays, fetched on first use
+	ofxKinectDepthProjector depthProjector;
+	bool updateDepthProjector();
+
+	// calibration for mapping without the sdk, kept across stop() since it belongs to the device
+	ofxKinectCoordinateMapper coordinateMapper;
+
+	// a recording standing in for the sensor, read by the capture thread
+	ofxKinectPlayer player;
+	bool bPlayback;
+	bool bPlaybackRealtime;
+	bool bPlaybackLoop;
+	int playbackFrame;
+	std::atomic<int> playbackSeek;
+	std::atomic<bool> bPlaybackDone;
+	unsigned long long playbackClockMicros;
+	LONGLONG playbackClockTimeStamp;
+	// the capture thread sleeps on this until update() takes a frame, a seek or stop()
+	std::mutex playbackMutex;
+	std::condition_variable playbackWake;
+	void wakePlayback();
+	bool playFrame(Kv2FrameBundle& bundle);
+	bool getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description);
+
+	ofxKinectRecorder recorder;
 
 	KCBFrameDescription colorFrameDescription;
 	KCBFrameDescription depthFrameDescription;
@@ -251,6 +429,6 @@ class ofxKinectCommonBridge : protected ofThread {
 
 	pair<JointType, JointType> skeletonDrawOrder[JointType_Count];
 
-	void checkOpenGLError(string function);
+	void checkOpenGLError(const char* function);
 
 };
@@ -0,0 +1,749 @@
+#include "ofxKinectCoordinateMapper.h"
+
+#include <emmintrin.h>
+#include <limits>
+
+static const char calibrationMagic[4] = { 'K', 'V', '2', 'M' };
+static const int calibrationVersion = 1;
+
+// inverse grid nodes outside the depth image, far enough out that any blend with them stays outside too
+static const float inverseOutside = -1e6f;
+
+static const float unmapped = -numeric_limits<float>::infinity();
+
+template<typename T>
+static void writeVector(ofstream& file, const vector<T>& v)
+{
+	unsigned int size = v.size();
+	file.write((const char*)&size, sizeof(size));
+	if(size > 0)
+	{
+		file.write((const char*)&v[0], size * sizeof(T));
+	}
+}
+
+template<typename T>
+static bool readVector(ifstream& file, vector<T>& v, unsigned int maxSize)
+{
+	unsigned int size = 0;
+	file.read((char*)&size, sizeof(size));
+	if(!file || size > maxSize)
+	{
+		return false;
+	}
+	v.resize(size);
+	if(size > 0)
+	{
+		file.read((char*)&v[0], size * sizeof(T));
+	}
+	return !file.fail();
+}
+
+//---------------------------------------------------------------------------
+ofxKinectCoordinateMapper::ofxKinectCoordinateMapper()
+	: depthWidth(0)
+	, depthHeight(0)
+	, colorWidth(0)
+	, colorHeight(0)
+	, inverseWidth(0)
+	, inverseHeight(0)
+	, inverseMinX(0)
+	, inverseMinY(0)
+	, inverseStepX(1)
+	, inverseStepY(1)
+	, sdkDepthFrameToColorMicros(0)
+{
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectCoordinateMapper::setup(KCBHANDLE hKinect, int _depthWidth, int _depthHeight, int _colorWidth, int _colorHeight)
+{
+#ifdef OFX_KINECT_NO_SDK
+	(void)hKinect;
+	(void)_depthWidth;
+	(void)_depthHeight;
+	(void)_colorWidth;
+	(void)_colorHeight;
+	ofLogError("ofxKinectCoordinateMapper::setup") << "Built without the sdk, load() a calibration instead";
+	return false;
+#else
+	clear();
+	if(!depthProjector.setup(hKinect, _depthWidth, _depthHeight))
+	{
+		return false;
+	}
+
+	int count = _depthWidth * _depthHeight;
+
+	// flat frames at depths spread evenly in 1/z, which is what the fit is in
+	float fitDepths[] = { 500, 600, 750, 950, 1250, 1700, 2400, 3500, 5200, 8000 };
+	int fitCount = sizeof(fitDepths) / sizeof(fitDepths[0]);
+
+	vector<float> depths(fitDepths, fitDepths + fitCount);
+	vector<vector<ColorSpacePoint> > samples(fitCount, vector<ColorSpacePoint>(count));
+	vector<UINT16> frame(count);
+	unsigned long long sdkMicros = 0;
+	for(int k = 0; k < fitCount; k++)
+	{
+		frame.assign(count, (UINT16)fitDepths[k]);
+
+		unsigned long long start = ofGetElapsedTimeMicros();
+		HRESULT hr = KCBMapDepthFrameToColorSpace(hKinect, count, &frame[0], count, &samples[k][0]);
+		sdkMicros += ofGetElapsedTimeMicros() - start;
+
+		if(FAILED(hr))
+		{
+			ofLogError("ofxKinectCoordinateMapper::setup") << "Failed to map depth to color space";
+			depthProjector.clear();
+			return false;
+		}
+	}
+
+	ColorSpacePoint center = samples[0][count / 2 + _depthWidth / 2];
+	if(!(center.X > unmapped) || (center.X == 0 && center.Y == 0))
+	{
+		ofLogVerbose("ofxKinectCoordinateMapper::setup") << "Depth to color mapping not available yet";
+		depthProjector.clear();
+		return false;
+	}
+
+	depthWidth = _depthWidth;
+	depthHeight = _depthHeight;
+	colorWidth = _colorWidth;
+	colorHeight = _colorHeight;
+	sdkDepthFrameToColorMicros = sdkMicros / (float)fitCount;
+
+	fitColorModel(depths, samples);
+	buildInverseRays();
+
+	// sdk references on a sparse grid, half a pixel off so the sub pixel paths get checked too, at
+	// depths between the fitted ones
+	float checkDepths[] = { 550, 1100, 2000, 4300, 7000 };
+	for(unsigned int k = 0; k < sizeof(checkDepths) / sizeof(checkDepths[0]); k++)
+	{
+		for(int y = 2; y < depthHeight; y += 8)
+		{
+			for(int x = 2; x < depthWidth; x += 8)
+			{
+				DepthSpacePoint p = { x + 0.5f, y + 0.5f };
+				referenceDepthPoints.push_back(p);
+				referenceDepths.push_back((UINT16)checkDepths[k]);
+			}
+		}
+	}
+
+	int referenceCount = referenceDepthPoints.size();
+	referenceDepthToColor.resize(referenceCount);
+	referenceCameraPoints.resize(referenceCount);
+	referenceCameraToDepth.resize(referenceCount);
+	referenceCameraToColor.resize(referenceCount);
+
+	HRESULT hr = KCBMapDepthPointsToColorSpace(hKinect, referenceCount, &referenceDepthPoints[0],
+		referenceCount, &referenceDepths[0], referenceCount, &referenceDepthToColor[0]);
+	if(SUCCEEDED(hr))
+	{
+		hr = KCBMapDepthPointsToCameraSpace(hKinect, referenceCount, &referenceDepthPoints[0],
+			referenceCount, &referenceDepths[0], referenceCount, &referenceCameraPoints[0]);
+	}
+	if(SUCCEEDED(hr))
+	{
+		hr = KCBMapCameraPointsToDepthSpace(hKinect, referenceCount, &referenceCameraPoints[0], referenceCount, &referenceCameraToDepth[0]);
+	}
+	if(SUCCEEDED(hr))
+	{
+		hr = KCBMapCameraPointsToColorSpace(hKinect, referenceCount, &referenceCameraPoints[0], referenceCount, &referenceCameraToColor[0]);
+	}
+	if(FAILED(hr))
+	{
+		// the calibration itself is fine, there is just nothing to benchmark against
+		ofLogWarning("ofxKinectCoordinateMapper::setup") << "Failed to get the reference mappings";
+		referenceDepthPoints.clear();
+		referenceDepths.clear();
+		referenceDepthToColor.clear();
+		referenceCameraPoints.clear();
+		referenceCameraToDepth.clear();
+		referenceCameraToColor.clear();
+	}
+
+	return true;
+#endif
+}
+
+void ofxKinectCoordinateMapper::fitColorModel(const vector<float>& depths, const vector<vector<ColorSpacePoint> >& samples)
+{
+	// every pixel sees the same depths, so the least squares solution is the same linear combination
+	// of the samples everywhere: (A^T A)^-1 A^T with rows 1, w, w^2 of A
+	int n = depths.size();
+	double m[3][3] = { { 0 } };
+	for(int k = 0; k < n; k++)
+	{
+		double w = 1000.0 / depths[k];
+		double row[3] = { 1, w, w * w };
+		for(int i = 0; i < 3; i++)
+		{
+			for(int j = 0; j < 3; j++)
+			{
+				m[i][j] += row[i] * row[j];
+			}
+		}
+	}
+
+	double inv[3][3];
+	inv[0][0] = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	inv[0][1] = m[0][2] * m[2][1] - m[0][1] * m[2][2];
+	inv[0][2] = m[0][1] * m[1][2] - m[0][2] * m[1][1];
+	inv[1][0] = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	inv[1][1] = m[0][0] * m[2][2] - m[0][2] * m[2][0];
+	inv[1][2] = m[0][2] * m[1][0] - m[0][0] * m[1][2];
+	inv[2][0] = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	inv[2][1] = m[0][1] * m[2][0] - m[0][0] * m[2][1];
+	inv[2][2] = m[0][0] * m[1][1] - m[0][1] * m[1][0];
+	double det = m[0][0] * inv[0][0] + m[0][1] * inv[1][0] + m[0][2] * inv[2][0];
+
+	vector<float> weights(3 * n);
+	for(int k = 0; k < n; k++)
+	{
+		double w = 1000.0 / depths[k];
+		double row[3] = { 1, w, w * w };
+		for(int i = 0; i < 3; i++)
+		{
+			weights[i * n + k] = (float)((inv[i][0] * row[0] + inv[i][1] * row[1] + inv[i][2] * row[2]) / det);
+		}
+	}
+
+	int count = depthWidth * depthHeight;
+	for(int c = 0; c < COLOR_COEFFICIENTS; c++)
+	{
+		colorModel[c].assign(count, 0);
+	}
+
+	for(int p = 0; p < count; p++)
+	{
+		bool bValid = true;
+		double x[3] = { 0 }, y[3] = { 0 };
+		for(int k = 0; k < n; k++)
+		{
+			const ColorSpacePoint& s = samples[k][p];
+			bValid = bValid && s.X > unmapped && s.Y > unmapped;
+			for(int i = 0; i < 3; i++)
+			{
+				x[i] += weights[i * n + k] * s.X;
+				y[i] += weights[i * n + k] * s.Y;
+			}
+		}
+
+		// a pixel the sdk doesn't map stays unmapped at any depth
+		colorModel[COLOR_AX][p] = bValid ? (float)x[0] : unmapped;
+		colorModel[COLOR_BX][p] = bValid ? (float)x[1] : 0;
+		colorModel[COLOR_CX][p] = bValid ? (float)x[2] : 0;
+		colorModel[COLOR_AY][p] = bValid ? (float)y[0] : unmapped;
+		colorModel[COLOR_BY][p] = bValid ? (float)y[1] : 0;
+		colorModel[COLOR_CY][p] = bValid ? (float)y[2] : 0;
+	}
+}
+
+void ofxKinectCoordinateMapper::buildInverseRays()
+{
+	const vector<float>& raysX = depthProjector.getRaysX();
+	const vector<float>& raysY = depthProjector.getRaysY();
+	int width = depthWidth;
+	int height = depthHeight;
+
+	float minX = raysX[0], maxX = raysX[0], minY = raysY[0], maxY = raysY[0];
+	for(unsigned int i = 1; i < raysX.size(); i++)
+	{
+		minX = MIN(minX, raysX[i]);
+		maxX = MAX(maxX, raysX[i]);
+		minY = MIN(minY, raysY[i]);
+		maxY = MAX(maxY, raysY[i]);
+	}
+
+	inverseWidth = width;
+	inverseHeight = height;
+	inverseMinX = minX;
+	inverseMinY = minY;
+	inverseStepX = (maxX - minX) / (inverseWidth - 1);
+	inverseStepY = (maxY - minY) / (inverseHeight - 1);
+	inverseX.assign(inverseWidth * inverseHeight, inverseOutside);
+	inverseY.assign(inverseWidth * inverseHeight, inverseOutside);
+
+	// start from where the middle row and column put the ray, then newton on the bilinear ray table
+	int middleRow = (height / 2) * width;
+	int middleColumn = width / 2;
+	float spanX = raysX[middleRow + width - 1] - raysX[middleRow];
+	float spanY = raysY[(height - 1) * width + middleColumn] - raysY[middleColumn];
+
+	for(int j = 0; j < inverseHeight; j++)
+	{
+		float ny = inverseMinY + j * inverseStepY;
+		for(int i = 0; i < inverseWidth; i++)
+		{
+			float nx = inverseMinX + i * inverseStepX;
+			float px = (nx - raysX[middleRow]) / spanX * (width - 1);
+			float py = (ny - raysY[middleColumn]) / spanY * (height - 1);
+
+			bool bConverged = false;
+			for(int iteration = 0; iteration < 10 && !bConverged; iteration++)
+			{
+				// far off the table where the distortion folds over, give up
+				if(!(fabsf(px) < width * 4 && fabsf(py) < height * 4))
+				{
+					break;
+				}
+
+				int x0 = (int)ofClamp(floorf(px), 0, width - 2);
+				int y0 = (int)ofClamp(floorf(py), 0, height - 2);
+				float fx = px - x0;
+				float fy = py - y0;
+
+				// outside the table the edge cells are extended linearly
+				int p = y0 * width + x0;
+				float x00 = raysX[p], x10 = raysX[p + 1], x01 = raysX[p + width], x11 = raysX[p + width + 1];
+				float y00 = raysY[p], y10 = raysY[p + 1], y01 = raysY[p + width], y11 = raysY[p + width + 1];
+				float rx = (1 - fy) * ((1 - fx) * x00 + fx * x10) + fy * ((1 - fx) * x01 + fx * x11);
+				float ry = (1 - fy) * ((1 - fx) * y00 + fx * y10) + fy * ((1 - fx) * y01 + fx * y11);
+				float dxdx = (1 - fy) * (x10 - x00) + fy * (x11 - x01);
+				float dxdy = (1 - fx) * (x01 - x00) + fx * (x11 - x10);
+				float dydx = (1 - fy) * (y10 - y00) + fy * (y11 - y01);
+				float dydy = (1 - fx) * (y01 - y00) + fx * (y11 - y10);
+
+				float det = dxdx * dydy - dxdy * dydx;
+				if(det == 0)
+				{
+					break;
+				}
+				float ex = nx - rx;
+				float ey = ny - ry;
+				float stepX = (ex * dydy - ey * dxdy) / det;
+				float stepY = (ey * dxdx - ex * dydx) / det;
+				px += stepX;
+				py += stepY;
+				bConverged = fabsf(stepX) < 1e-4f && fabsf(stepY) < 1e-4f;
+			}
+
+			if(bConverged && px >= -0.5f && px <= width - 0.5f && py >= -0.5f && py <= height - 0.5f)
+			{
+				inverseX[j * inverseWidth + i] = px;
+				inverseY[j * inverseWidth + i] = py;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectCoordinateMapper::save(const string& path) const
+{
+	if(!isReady())
+	{
+		ofLogError("ofxKinectCoordinateMapper::save") << "Nothing to save, call setup() first";
+		return false;
+	}
+
+	ofstream file(ofToDataPath(path).c_str(), ios::binary);
+	if(!file)
+	{
+		ofLogError("ofxKinectCoordinateMapper::save") << "Cannot open " << path;
+		return false;
+	}
+
+	int header[] = { calibrationVersion, depthWidth, depthHeight, colorWidth, colorHeight };
+	file.write(calibrationMagic, sizeof(calibrationMagic));
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)&sdkDepthFrameToColorMicros, sizeof(sdkDepthFrameToColorMicros));
+
+	writeVector(file, depthProjector.getRaysX());
+	writeVector(file, depthProjector.getRaysY());
+	for(int c = 0; c < COLOR_COEFFICIENTS; c++)
+	{
+		writeVector(file, colorModel[c]);
+	}
+
+	writeVector(file, referenceDepthPoints);
+	writeVector(file, referenceDepths);
+	writeVector(file, referenceDepthToColor);
+	writeVector(file, referenceCameraPoints);
+	writeVector(file, referenceCameraToDepth);
+	writeVector(file, referenceCameraToColor);
+
+	if(!file)
+	{
+		ofLogError("ofxKinectCoordinateMapper::save") << "Failed to write " << path;
+		return false;
+	}
+	return true;
+}
+
+bool ofxKinectCoordinateMapper::load(const string& path)
+{
+	clear();
+
+	ifstream file(ofToDataPath(path).c_str(), ios::binary);
+	if(!file)
+	{
+		ofLogVerbose("ofxKinectCoordinateMapper::load") << "No calibration at " << path;
+		return false;
+	}
+
+	char magic[4];
+	int header[5];
+	file.read(magic, sizeof(magic));
+	file.read((char*)header, sizeof(header));
+	file.read((char*)&sdkDepthFrameToColorMicros, sizeof(sdkDepthFrameToColorMicros));
+	if(!file || memcmp(magic, calibrationMagic, sizeof(magic)) != 0 || header[0] != calibrationVersion)
+	{
+		ofLogError("ofxKinectCoordinateMapper::load") << path << " is not a calibration file of this version";
+		return false;
+	}
+
+	int width = header[1], height = header[2];
+	if(width < 2 || height < 2 || width > 4096 || height > 4096)
+	{
+		ofLogError("ofxKinectCoordinateMapper::load") << path << " has a bad depth size";
+		return false;
+	}
+
+	unsigned int count = width * height;
+	vector<float> raysX, raysY;
+	bool bRead = readVector(file, raysX, count) && readVector(file, raysY, count) && raysX.size() == count && raysY.size() == count;
+	for(int c = 0; c < COLOR_COEFFICIENTS && bRead; c++)
+	{
+		bRead = readVector(file, colorModel[c], count) && colorModel[c].size() == count;
+	}
+
+	unsigned int maxReferences = 1 << 20;
+	bRead = bRead && readVector(file, referenceDepthPoints, maxReferences) && readVector(file, referenceDepths, maxReferences)
+		&& readVector(file, referenceDepthToColor, maxReferences) && readVector(file, referenceCameraPoints, maxReferences)
+		&& readVector(file, referenceCameraToDepth, maxReferences) && readVector(file, referenceCameraToColor, maxReferences);
+	if(!bRead)
+	{
+		ofLogError("ofxKinectCoordinateMapper::load") << path << " is truncated";
+		clear();
+		return false;
+	}
+
+	vector<PointF> rays(count);
+	for(unsigned int i = 0; i < count; i++)
+	{
+		rays[i].X = raysX[i];
+		rays[i].Y = raysY[i];
+	}
+	depthProjector.setRayTable(&rays[0], width, height);
+
+	depthWidth = width;
+	depthHeight = height;
+	colorWidth = header[3];
+	colorHeight = header[4];
+	buildInverseRays();
+	return true;
+}
+
+bool ofxKinectCoordinateMapper::isReady() const
+{
+	return depthProjector.isReady() && !colorModel[0].empty();
+}
+
+void ofxKinectCoordinateMapper::clear()
+{
+	depthWidth = depthHeight = 0;
+	colorWidth = colorHeight = 0;
+	depthProjector.clear();
+	for(int c = 0; c < COLOR_COEFFICIENTS; c++)
+	{
+		colorModel[c].clear();
+	}
+	inverseWidth = inverseHeight = 0;
+	inverseX.clear();
+	inverseY.clear();
+	referenceDepthPoints.clear();
+	referenceDepths.clear();
+	referenceDepthToColor.clear();
+	referenceCameraPoints.clear();
+	referenceCameraToDepth.clear();
+	referenceCameraToColor.clear();
+	sdkDepthFrameToColorMicros = 0;
+}
+
+int ofxKinectCoordinateMapper::getDepthWidth() const
+{
+	return depthWidth;
+}
+
+int ofxKinectCoordinateMapper::getDepthHeight() const
+{
+	return depthHeight;
+}
+
+int ofxKinectCoordinateMapper::getColorWidth() const
+{
+	return colorWidth;
+}
+
+int ofxKinectCoordinateMapper::getColorHeight() const
+{
+	return colorHeight;
+}
+
+const ofxKinectDepthProjector& ofxKinectCoordinateMapper::getDepthProjector() const
+{
+	return depthProjector;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectCoordinateMapper::mapDepthFrameToColor(const unsigned short* depth, ColorSpacePoint* dst, int rowBegin, int rowEnd) const
+{
+	const float* ax = &colorModel[COLOR_AX][0];
+	const float* bx = &colorModel[COLOR_BX][0];
+	const float* cx = &colorModel[COLOR_CX][0];
+	const float* ay = &colorModel[COLOR_AY][0];
+	const float* by = &colorModel[COLOR_BY][0];
+	const float* cy = &colorModel[COLOR_CY][0];
+	float* out = (float*)dst;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 millimeters = _mm_set1_ps(1000.0f);
+	const __m128 none = _mm_set1_ps(unmapped);
+
+	int i = rowBegin * depthWidth;
+	int end = rowEnd * depthWidth;
+	for(; i + 4 <= end; i += 4)
+	{
+		__m128 d = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(depth + i)), zero));
+		__m128 valid = _mm_cmpneq_ps(d, _mm_setzero_ps());
+		__m128 w = _mm_div_ps(millimeters, d);
+
+		__m128 x = _mm_add_ps(_mm_loadu_ps(ax + i), _mm_mul_ps(w, _mm_add_ps(_mm_loadu_ps(bx + i), _mm_mul_ps(w, _mm_loadu_ps(cx + i)))));
+		__m128 y = _mm_add_ps(_mm_loadu_ps(ay + i), _mm_mul_ps(w, _mm_add_ps(_mm_loadu_ps(by + i), _mm_mul_ps(w, _mm_loadu_ps(cy + i)))));
+		x = _mm_or_ps(_mm_and_ps(valid, x), _mm_andnot_ps(valid, none));
+		y = _mm_or_ps(_mm_and_ps(valid, y), _mm_andnot_ps(valid, none));
+
+		_mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(x, y));
+		_mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(x, y));
+	}
+
+	mapDepthRowsToColorScalar(depth, dst, i, end);
+}
+
+void ofxKinectCoordinateMapper::mapDepthRowsToColorScalar(const unsigned short* depth, ColorSpacePoint* dst, int begin, int end) const
+{
+	for(int i = begin; i < end; i++)
+	{
+		if(depth[i] == 0)
+		{
+			dst[i].X = dst[i].Y = unmapped;
+			continue;
+		}
+		float w = 1000.0f / depth[i];
+		dst[i].X = colorModel[COLOR_AX][i] + w * (colorModel[COLOR_BX][i] + w * colorModel[COLOR_CX][i]);
+		dst[i].Y = colorModel[COLOR_AY][i] + w * (colorModel[COLOR_BY][i] + w * colorModel[COLOR_CY][i]);
+	}
+}
+
+ofVec2f ofxKinectCoordinateMapper::depthToColor(float x, float y, float w) const
+{
+	x = ofClamp(x, 0, depthWidth - 1);
+	y = ofClamp(y, 0, depthHeight - 1);
+	int x0 = MIN((int)x, depthWidth - 2);
+	int y0 = MIN((int)y, depthHeight - 2);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int i = y0 * depthWidth + x0;
+	float c[COLOR_COEFFICIENTS];
+	for(int k = 0; k < COLOR_COEFFICIENTS; k++)
+	{
+		const vector<float>& plane = colorModel[k];
+		c[k] = ofLerp(ofLerp(plane[i], plane[i + 1], fx), ofLerp(plane[i + depthWidth], plane[i + depthWidth + 1], fx), fy);
+	}
+
+	// an unmapped neighbour turns the blend into -infinity or nan
+	if(!(c[COLOR_AX] > unmapped) || !(c[COLOR_AY] > unmapped))
+	{
+		return ofVec2f(unmapped, unmapped);
+	}
+	return ofVec2f(c[COLOR_AX] + w * (c[COLOR_BX] + w * c[COLOR_CX]), c[COLOR_AY] + w * (c[COLOR_BY] + w * c[COLOR_CY]));
+}
+
+ofVec2f ofxKinectCoordinateMapper::mapDepthToColor(float x, float y, float depth) const
+{
+	if(depth <= 0)
+	{
+		return ofVec2f(unmapped, unmapped);
+	}
+	return depthToColor(x, y, 1000.0f / depth);
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectCoordinateMapper::cameraToDepth(float x, float y, float z, float& depthX, float& depthY) const
+{
+	if(!(z > 0))
+	{
+		return false;
+	}
+
+	float gx = (x / z - inverseMinX) / inverseStepX;
+	float gy = (y / z - inverseMinY) / inverseStepY;
+	if(!(gx >= 0 && gx <= inverseWidth - 1 && gy >= 0 && gy <= inverseHeight - 1))
+	{
+		return false;
+	}
+
+	int x0 = MIN((int)gx, inverseWidth - 2);
+	int y0 = MIN((int)gy, inverseHeight - 2);
+	float fx = gx - x0;
+	float fy = gy - y0;
+	int i = y0 * inverseWidth + x0;
+	depthX = ofLerp(ofLerp(inverseX[i], inverseX[i + 1], fx), ofLerp(inverseX[i + inverseWidth], inverseX[i + inverseWidth + 1], fx), fy);
+	depthY = ofLerp(ofLerp(inverseY[i], inverseY[i + 1], fx), ofLerp(inverseY[i + inverseWidth], inverseY[i + inverseWidth + 1], fx), fy);
+	return depthX >= -0.5f && depthY >= -0.5f;
+}
+
+void ofxKinectCoordinateMapper::mapCameraToDepth(const CameraSpacePoint* points, DepthSpacePoint* dst, int count) const
+{
+	for(int i = 0; i < count; i++)
+	{
+		if(!cameraToDepth(points[i].X, points[i].Y, points[i].Z, dst[i].X, dst[i].Y))
+		{
+			dst[i].X = dst[i].Y = unmapped;
+		}
+	}
+}
+
+void ofxKinectCoordinateMapper::mapCameraToColor(const CameraSpacePoint* points, ColorSpacePoint* dst, int count) const
+{
+	for(int i = 0; i < count; i++)
+	{
+		float x, y;
+		ofVec2f color(unmapped, unmapped);
+		if(cameraToDepth(points[i].X, points[i].Y, points[i].Z, x, y))
+		{
+			color = depthToColor(x, y, 1.0f / points[i].Z);
+		}
+		dst[i].X = color.x;
+		dst[i].Y = color.y;
+	}
+}
+
+ofVec2f ofxKinectCoordinateMapper::mapCameraToDepth(const ofVec3f& point) const
+{
+	float x, y;
+	if(!cameraToDepth(point.x, point.y, point.z, x, y))
+	{
+		return ofVec2f(unmapped, unmapped);
+	}
+	return ofVec2f(x, y);
+}
+
+ofVec2f ofxKinectCoordinateMapper::mapCameraToColor(const ofVec3f& point) const
+{
+	float x, y;
+	if(!cameraToDepth(point.x, point.y, point.z, x, y))
+	{
+		return ofVec2f(unmapped, unmapped);
+	}
+	return depthToColor(x, y, 1.0f / point.z);
+}
+
+//---------------------------------------------------------------------------
+// max and mean distance between mapped and reference points, skipping points either side left unmapped
+template<typename Point>
+static void measureError(const vector<Point>& mapped, const vector<Point>& reference, float& maxError, float& meanError, int& skipped)
+{
+	maxError = meanError = 0;
+	skipped = 0;
+	int compared = 0;
+	for(unsigned int i = 0; i < reference.size(); i++)
+	{
+		if(!(mapped[i].X > unmapped) || !(reference[i].X > unmapped))
+		{
+			skipped++;
+			continue;
+		}
+		float error = ofVec2f(mapped[i].X - reference[i].X, mapped[i].Y - reference[i].Y).length();
+		maxError = MAX(maxError, error);
+		meanError += error;
+		compared++;
+	}
+	meanError = compared > 0 ? meanError / compared : 0;
+}
+
+void ofxKinectCoordinateMapper::benchmark(int iterations) const
+{
+	if(!isReady())
+	{
+		ofLogError("ofxKinectCoordinateMapper::benchmark") << "Call setup() or load() first";
+		return;
+	}
+
+	int referenceCount = referenceDepthPoints.size();
+	if(referenceCount > 0)
+	{
+		float maxError, meanError;
+		int skipped;
+
+		vector<ColorSpacePoint> depthToColor(referenceCount);
+		for(int i = 0; i < referenceCount; i++)
+		{
+			ofVec2f p = mapDepthToColor(referenceDepthPoints[i].X, referenceDepthPoints[i].Y, referenceDepths[i]);
+			depthToColor[i].X = p.x;
+			depthToColor[i].Y = p.y;
+		}
+		measureError(depthToColor, referenceDepthToColor, maxError, meanError, skipped);
+		ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "depth to color: max error " << maxError << " px, mean " << meanError
+			<< " px over " << referenceCount - skipped << " points";
+
+		vector<DepthSpacePoint> cameraToDepth(referenceCount);
+		mapCameraToDepth(&referenceCameraPoints[0], &cameraToDepth[0], referenceCount);
+		measureError(cameraToDepth, referenceCameraToDepth, maxError, meanError, skipped);
+		ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "camera to depth: max error " << maxError << " px, mean " << meanError
+			<< " px over " << referenceCount - skipped << " points";
+
+		vector<ColorSpacePoint> cameraToColor(referenceCount);
+		mapCameraToColor(&referenceCameraPoints[0], &cameraToColor[0], referenceCount);
+		measureError(cameraToColor, referenceCameraToColor, maxError, meanError, skipped);
+		ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "camera to color: max error " << maxError << " px, mean " << meanError
+			<< " px over " << referenceCount - skipped << " points";
+	}
+	else
+	{
+		ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "no reference mappings stored, timing only";
+	}
+
+	// a frame with some holes, like a real one
+	int count = depthWidth * depthHeight;
+	vector<unsigned short> depth(count);
+	for(int i = 0; i < count; i++)
+	{
+		depth[i] = ofRandom(100) < 5 ? 0 : (unsigned short)ofRandom(500, 4500);
+	}
+	vector<ColorSpacePoint> colorPoints(count);
+
+	unsigned long long start = ofGetElapsedTimeMicros();
+	for(int n = 0; n < iterations; n++)
+	{
+		mapDepthRowsToColorScalar(&depth[0], &colorPoints[0], 0, count);
+	}
+	float scalarMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+	start = ofGetElapsedTimeMicros();
+	for(int n = 0; n < iterations; n++)
+	{
+		mapDepthFrameToColor(&depth[0], &colorPoints[0], 0, depthHeight);
+	}
+	float simdMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+	ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "depth frame to color: scalar " << scalarMicros << " us/frame, sse2 "
+		<< simdMicros << " us/frame, sdk at capture " << sdkDepthFrameToColorMicros << " us/frame";
+
+	vector<CameraSpacePoint> cameraPoints(count);
+	vector<float> xyz(count * 3);
+	depthProjector.project(&depth[0], &xyz[0], ofxKinectDepthProjector::LAYOUT_INTERLEAVED, 0, depthHeight);
+	memcpy(&cameraPoints[0], &xyz[0], xyz.size() * sizeof(float));
+
+	start = ofGetElapsedTimeMicros();
+	for(int n = 0; n < iterations; n++)
+	{
+		mapCameraToColor(&cameraPoints[0], &colorPoints[0], count);
+	}
+	float cameraMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+	ofLogNotice("ofxKinectCoordinateMapper::benchmark") << "camera to color: " << cameraMicros * 1000 / count << " ns/point";
+}
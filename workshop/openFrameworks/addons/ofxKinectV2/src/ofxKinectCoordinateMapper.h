@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+#include "ofxKinectDepthProjector.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// coordinate mapping without the sdk
+//
+// setup() asks the sensor once for what it knows about itself: the ray of every depth pixel, and where
+// every depth pixel lands in the color image at a handful of depths. from there on mapping is plain math
+// that runs anywhere, including on recorded data with no sensor attached, and save()/load() keep it in a
+// small binary file.
+//
+// for a fixed depth pixel the color position is a smooth function of 1/z (the baseline between the two
+// cameras turns into a parallax that shrinks with distance), so each depth pixel stores a quadratic in 1/z
+// for x and y, fitted by least squares. camera space to depth goes through the inverse of the ray table,
+// resampled on a regular grid over the normalized image plane; camera space to color goes to depth and
+// then through the same quadratic, so it only covers what the depth camera sees.
+//
+// unmapped points come out as -infinity like they do from the sdk. setup() also stores sdk mappings at
+// depths the fit never saw plus the sdk's own timing, and benchmark() checks accuracy and speed against those.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectCoordinateMapper
+{
+  public:
+	ofxKinectCoordinateMapper();
+
+	/// capture the calibration from the sensor, fails until the sensor has reported it. needs the sdk,
+	/// built with OFX_KINECT_NO_SDK only load() gives a calibration
+	bool setup(KCBHANDLE hKinect, int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+	/// read a calibration written by save(), no sensor needed
+	bool load(const string& path);
+	bool save(const string& path) const;
+	bool isReady() const;
+	void clear();
+
+	int getDepthWidth() const;
+	int getDepthHeight() const;
+	int getColorWidth() const;
+	int getColorHeight() const;
+
+	/// depth to camera space, see ofxKinectDepthProjector
+	const ofxKinectDepthProjector& getDepthProjector() const;
+
+	/// color position of rows [rowBegin, rowEnd) of a full depth frame, dst holds one point per depth pixel
+	void mapDepthFrameToColor(const unsigned short* depth, ColorSpacePoint* dst, int rowBegin, int rowEnd) const;
+	/// sub pixel depth position, depth in millimeters
+	ofVec2f mapDepthToColor(float x, float y, float depth) const;
+
+	/// camera space points in meters, within the depth camera's field of view
+	void mapCameraToDepth(const CameraSpacePoint* points, DepthSpacePoint* dst, int count) const;
+	void mapCameraToColor(const CameraSpacePoint* points, ColorSpacePoint* dst, int count) const;
+	ofVec2f mapCameraToDepth(const ofVec3f& point) const;
+	ofVec2f mapCameraToColor(const ofVec3f& point) const;
+
+	/// error against the sdk mappings stored by setup() and time per frame against the sdk's, results go to the log
+	void benchmark(int iterations = 20) const;
+
+  protected:
+	void mapDepthRowsToColorScalar(const unsigned short* depth, ColorSpacePoint* dst, int begin, int end) const;
+	void fitColorModel(const vector<float>& depths, const vector<vector<ColorSpacePoint> >& samples);
+	void buildInverseRays();
+	bool cameraToDepth(float x, float y, float z, float& depthX, float& depthY) const;
+	ofVec2f depthToColor(float x, float y, float w) const;
+
+	int depthWidth, depthHeight;
+	int colorWidth, colorHeight;
+
+	ofxKinectDepthProjector depthProjector;
+
+	// x = a + b * w + c * w * w with w = 1 / z in 1/meters, one plane per coefficient
+	enum { COLOR_AX, COLOR_BX, COLOR_CX, COLOR_AY, COLOR_BY, COLOR_CY, COLOR_COEFFICIENTS };
+	vector<float> colorModel[COLOR_COEFFICIENTS];
+
+	// depth pixel position over a regular grid of x / z, y / z
+	int inverseWidth, inverseHeight;
+	float inverseMinX, inverseMinY;
+	float inverseStepX, inverseStepY;
+	vector<float> inverseX, inverseY;
+
+	// sdk results at depths the fit didn't use, for benchmark()
+	vector<DepthSpacePoint> referenceDepthPoints;
+	vector<UINT16> referenceDepths;
+	vector<ColorSpacePoint> referenceDepthToColor;
+	vector<CameraSpacePoint> referenceCameraPoints;
+	vector<DepthSpacePoint> referenceCameraToDepth;
+	vector<ColorSpacePoint> referenceCameraToColor;
+	float sdkDepthFrameToColorMicros;
+};
@@ -0,0 +1,831 @@
+#include "ofxKinectDepthCodec.h"
+
+#include <stddef.h>
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace
+{
+	// a frame starts with this, then the bits
+	struct Header
+	{
+		char magic[4];
+		unsigned short width;
+		unsigned short height;
+		unsigned int mode;
+		unsigned int payloadSize;
+	};
+
+	enum
+	{
+		MODE_RAW,		///< the frame didn't get smaller, the pixels follow as they are
+		MODE_PREDICTED
+	};
+
+	// unary codes this long switch to the raw 16 bit value, so no symbol is longer than 41 bits
+	const int ESCAPE = 24;
+	// error statistics are halved every this many samples so they follow the scene
+	const int RESET = 64;
+	// bit length of |b - c| + |d - b|, saturated to 16 bits
+	const int CONTEXT_COUNT = 17;
+
+	inline int countTrailingZeros(unsigned int value)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	/// bits needed for value, 0 for 0. value has to be below 2^31
+	inline int getBitLength(unsigned int value)
+	{
+		// the highest set bit of 2 * value + 1 is the bit length of value, without a branch for 0
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse(&index, value * 2 + 1);
+		return index;
+#else
+		return 31 - __builtin_clz(value * 2 + 1);
+#endif
+	}
+
+	// running mean of the mapped errors seen in one context, picks the rice parameter
+	struct Context
+	{
+		Context() : sum(4), count(1) {}
+
+		/// the smallest k with count << k >= sum, as in jpeg-ls. count << k has the bit length of sum for
+		/// the difference of their bit lengths, at most one more step is needed, so there's no loop to
+		/// mispredict when the noise moves k up and down
+		inline int getK() const
+		{
+			int k = MAX(getBitLength(sum) - getBitLength(count), 0);
+			k += (count << k) < sum;
+			return MIN(k, 16);
+		}
+
+		/// an error counts for at most about 8 to 16 times the current mean, so a lone hole in a wall doesn't
+		/// blow up the code length of the next few dozen pixels. taken from sum rather than k, which would
+		/// put getK() on the path from one update to the next
+		inline void update(unsigned int value)
+		{
+			sum += MIN(value, (sum >> 2) + 16);
+			if(++count == RESET)
+			{
+				sum = (sum + 1) >> 1;
+				count >>= 1;
+			}
+		}
+
+		unsigned int sum;
+		unsigned int count;
+	};
+
+	// lsb first, so a unary prefix is read back with one trailing zero count. every put stores the low
+	// word whether it is complete or not and only moves on once it is, which keeps the branch on the
+	// number of pending bits out of the loop
+	struct BitWriter
+	{
+		BitWriter(unsigned char* output, unsigned char* end) : bits(0), count(0), p(output), end(end) {}
+
+		inline void put(unsigned int value, int length)
+		{
+			bits |= (unsigned long long)value << count;
+			count += length;
+			if(p + 4 <= end)
+			{
+				unsigned int word = (unsigned int)bits;
+				memcpy(p, &word, 4);
+			}
+			int full = count >> 5;
+			p += full * 4;
+			bits >>= full * 32;
+			count -= full * 32;
+		}
+
+		/// length is at most 32
+		inline void putRice(unsigned int value, int k)
+		{
+			unsigned int q = value >> k;
+			if(q < ESCAPE - 16)
+			{
+				// prefix and remainder together fit one put
+				put((1u << q) | ((value & ((1u << k) - 1)) << (q + 1)), q + 1 + k);
+			}
+			else if(q < ESCAPE)
+			{
+				put(1u << q, q + 1);
+				put(value & ((1u << k) - 1), k);
+			}
+			else
+			{
+				put(1u << ESCAPE, ESCAPE + 1);
+				put(value, 16);
+			}
+		}
+
+		/// where the data ends, NULL if it ran past the end of the output
+		unsigned char* flush()
+		{
+			while(count > 0)
+			{
+				if(p >= end)
+				{
+					return NULL;
+				}
+				*p++ = (unsigned char)bits;
+				bits >>= 8;
+				count -= 8;
+			}
+			return p <= end ? p : NULL;
+		}
+
+		bool isOverflowing() const
+		{
+			return p > end;
+		}
+
+		unsigned long long bits;
+		int count;
+		unsigned char* p;
+		unsigned char* end;
+	};
+
+	// keeps 56 to 63 bits buffered. a refill reads 8 bytes and moves on by the whole bytes that fit, so it
+	// doesn't branch on how many bits are left; the longest symbol is 41 bits, one refill per symbol does
+	struct BitReader
+	{
+		BitReader(const unsigned char* data, unsigned int size) : bits(0), count(0), p(data), start(data), end(data + size) {}
+
+		inline void refill()
+		{
+			unsigned long long word = 0;
+			if(end - p >= 8)
+			{
+				memcpy(&word, p, 8);
+			}
+			else
+			{
+				// the tail of the stream, reading past it gives zeros
+				for(int i = 0; i < end - p; i++)
+				{
+					word |= (unsigned long long)p[i] << (8 * i);
+				}
+			}
+			bits |= word << count;
+			p += (63 - count) >> 3;
+			count |= 56;
+		}
+
+		inline unsigned int getRice(int k)
+		{
+			refill();
+			int q = countTrailingZeros((unsigned int)bits | (1u << ESCAPE));
+			unsigned int rest = (unsigned int)(bits >> (q + 1));
+			if(q < ESCAPE)
+			{
+				skip(q + 1 + k);
+				return (q << k) | (rest & ((1u << k) - 1));
+			}
+			skip(ESCAPE + 1 + 16);
+			return rest & 0xffff;
+		}
+
+		inline void skip(int length)
+		{
+			bits >>= length;
+			count -= length;
+		}
+
+		/// false if more bits were read than the stream has
+		bool isValid() const
+		{
+			return (p - start) * 8 - count <= (end - start) * 8;
+		}
+
+		unsigned long long bits;
+		int count;
+		const unsigned char* p;
+		const unsigned char* start;
+		const unsigned char* end;
+	};
+
+	// median edge detector: the smaller neighbour above an edge, the larger below, else the plane through
+	// them. that is the median of a, b and a + b - c, written so it compiles to conditional moves. 0 is no
+	// reading, so a missing neighbour is replaced by another one rather than taken for an edge down to zero
+	inline int predict(int a, int b, int c)
+	{
+		a = a != 0 ? a : b;
+		b = b != 0 ? b : a;
+		c = c != 0 ? c : b;
+		int high = MAX(a, b);
+		int low = MIN(a, b);
+		return MAX(low, MIN(high, a + b - c));
+	}
+
+	// how busy the row above is around the pixel, from b, c and d above right. leaving the left neighbour
+	// out means the decoder knows the code length before the previous pixel is done
+	inline int getContext(int b, int c, int d)
+	{
+		b = b != 0 ? b : MAX(c, d);
+		c = c != 0 ? c : b;
+		d = d != 0 ? d : b;
+		return getBitLength(MIN(abs(b - c) + abs(d - b), 0xffff));
+	}
+
+	// the error modulo 2^16 folded onto 0, 1, 2... for -0, -1, +1...
+	inline unsigned int mapError(int value, int prediction)
+	{
+		int error = (short)(value - prediction);
+		return ((unsigned int)error << 1) ^ (unsigned int)(error >> 31);
+	}
+
+	inline unsigned short unmapError(unsigned int mapped, int prediction)
+	{
+		int error = (int)(mapped >> 1) ^ -(int)(mapped & 1);
+		return (unsigned short)(prediction + error);
+	}
+
+	// sse2 only compares and takes the min and max of signed 16 bit values, flipping the top bit makes
+	// them work for unsigned ones
+	inline __m128i flipSign(__m128i value)
+	{
+		return _mm_xor_si128(value, _mm_set1_epi16((short)0x8000));
+	}
+
+	inline __m128i minU16(__m128i x, __m128i y)
+	{
+		return flipSign(_mm_min_epi16(flipSign(x), flipSign(y)));
+	}
+
+	inline __m128i maxU16(__m128i x, __m128i y)
+	{
+		return flipSign(_mm_max_epi16(flipSign(x), flipSign(y)));
+	}
+
+	inline __m128i greaterU16(__m128i x, __m128i y)
+	{
+		return _mm_cmpgt_epi16(flipSign(x), flipSign(y));
+	}
+
+	inline __m128i select(__m128i mask, __m128i x, __m128i y)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, x), _mm_andnot_si128(mask, y));
+	}
+
+	inline __m128i replaceZeros(__m128i value, __m128i replacement)
+	{
+		return select(_mm_cmpeq_epi16(value, _mm_setzero_si128()), replacement, value);
+	}
+
+	inline __m128i absDiffU16(__m128i x, __m128i y)
+	{
+		return _mm_or_si128(_mm_subs_epu16(x, y), _mm_subs_epu16(y, x));
+	}
+
+	// getBitLength(g) is the exponent of 2g + 1 as a float, exact for the 17 bits that takes
+	inline __m128i getBitLength32(__m128i value)
+	{
+		__m128i odd = _mm_add_epi32(_mm_slli_epi32(value, 1), _mm_set1_epi32(1));
+		__m128i exponent = _mm_srli_epi32(_mm_castps_si128(_mm_cvtepi32_ps(odd)), 23);
+		return _mm_sub_epi32(exponent, _mm_set1_epi32(127));
+	}
+
+	// getContext() for 8 pixels, written as 8 bytes
+	inline void getContexts(__m128i b, __m128i c, __m128i d, unsigned char* rowContexts)
+	{
+		b = select(_mm_cmpeq_epi16(b, _mm_setzero_si128()), maxU16(c, d), b);
+		c = replaceZeros(c, b);
+		d = replaceZeros(d, b);
+		__m128i gradient = _mm_adds_epu16(absDiffU16(b, c), absDiffU16(d, b));
+		__m128i low = getBitLength32(_mm_unpacklo_epi16(gradient, _mm_setzero_si128()));
+		__m128i high = getBitLength32(_mm_unpackhi_epi16(gradient, _mm_setzero_si128()));
+		__m128i contexts = _mm_packs_epi32(low, high);
+		_mm_storel_epi64((__m128i*)rowContexts, _mm_packus_epi16(contexts, contexts));
+	}
+
+	// predict() for 8 pixels. a + b - c only wraps around when it isn't picked
+	inline __m128i predict(__m128i a, __m128i b, __m128i c)
+	{
+		a = replaceZeros(a, b);
+		b = replaceZeros(b, a);
+		c = replaceZeros(c, b);
+		__m128i high = maxU16(a, b);
+		__m128i low = minU16(a, b);
+		__m128i plane = _mm_sub_epi16(_mm_add_epi16(a, b), c);
+		__m128i bAboveHigh = _mm_andnot_si128(greaterU16(high, c), _mm_set1_epi16(-1));
+		__m128i bBelowLow = _mm_andnot_si128(greaterU16(c, low), _mm_set1_epi16(-1));
+		return select(bAboveHigh, low, select(bBelowLow, high, plane));
+	}
+
+	// a is the left neighbour, b the one above, c above left and d above right. outside the frame a and c
+	// are 0 and d is b, the row above the first one is all 0
+
+	// the contexts of a row only need the row above, so the decoder gets them 8 at a time as well
+	void getRowContexts(const unsigned short* up, int width, unsigned char* rowContexts)
+	{
+		int x = 0;
+		for(; x < MIN(width, 1); x++)
+		{
+			rowContexts[x] = getContext(up[x], 0, x + 1 < width ? up[x + 1] : up[x]);
+		}
+		for(; x + 8 < width; x += 8)
+		{
+			__m128i b = _mm_loadu_si128((const __m128i*)(up + x));
+			__m128i c = _mm_loadu_si128((const __m128i*)(up + x - 1));
+			__m128i d = _mm_loadu_si128((const __m128i*)(up + x + 1));
+			getContexts(b, c, d, rowContexts + x);
+		}
+		for(; x < width; x++)
+		{
+			rowContexts[x] = getContext(up[x], up[x - 1], x + 1 < width ? up[x + 1] : up[x]);
+		}
+	}
+
+	// the encoder knows every neighbour up front, so the prediction errors of a row are found 8 at a time
+	// and only the bit writing is left to go pixel by pixel
+	void getRowErrors(const unsigned short* row, const unsigned short* up, int width, unsigned short* mapped)
+	{
+		int x = 0;
+		for(; x < MIN(width, 1); x++)
+		{
+			mapped[x] = mapError(row[x], predict(0, up[x], 0));
+		}
+		for(; x + 8 <= width; x += 8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row + x - 1));
+			__m128i b = _mm_loadu_si128((const __m128i*)(up + x));
+			__m128i c = _mm_loadu_si128((const __m128i*)(up + x - 1));
+			__m128i error = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)(row + x)), predict(a, b, c));
+			_mm_storeu_si128((__m128i*)(mapped + x), _mm_xor_si128(_mm_slli_epi16(error, 1), _mm_srai_epi16(error, 15)));
+		}
+		for(; x < width; x++)
+		{
+			mapped[x] = mapError(row[x], predict(row[x - 1], up[x], up[x - 1]));
+		}
+	}
+
+	void encodeRow(const unsigned short* row, const unsigned short* up, int width, const unsigned short* mapped, const unsigned char* rowContexts,
+		BitWriter& writer, Context* contexts, Context& runContext)
+	{
+		bool bRunEnded = false;
+		int x = 0;
+		while(x < width)
+		{
+			int a = x > 0 ? row[x - 1] : 0;
+			int b = up[x];
+			int c = x > 0 ? up[x - 1] : 0;
+			if(a == b && b == c && !bRunEnded)
+			{
+				// flat neighbourhood, count the pixels repeating the left one
+				int run = 0;
+				while(x + run < width && row[x + run] == a)
+				{
+					run++;
+				}
+				int k = runContext.getK();
+				writer.putRice(run, k);
+				runContext.update(run);
+				x += run;
+				// the pixel that ended the run is coded on its own
+				bRunEnded = true;
+				continue;
+			}
+			bRunEnded = false;
+
+			Context& context = contexts[rowContexts[x]];
+			int k = context.getK();
+			writer.putRice(mapped[x], k);
+			context.update(mapped[x]);
+			x++;
+		}
+	}
+
+	bool decodeRow(unsigned short* row, const unsigned short* up, int width, const unsigned char* rowContexts,
+		BitReader& reader, Context* contexts, Context& runContext)
+	{
+		int a = 0;
+		int c = 0;
+		bool bRunEnded = false;
+		int x = 0;
+		while(x < width)
+		{
+			int b = up[x];
+			if(a == b && b == c && !bRunEnded)
+			{
+				int k = runContext.getK();
+				unsigned int run = reader.getRice(k);
+				runContext.update(run);
+				if(run > (unsigned int)(width - x))
+				{
+					return false;
+				}
+				if(run > 0)
+				{
+					for(unsigned int i = 0; i < run; i++)
+					{
+						row[x + i] = a;
+					}
+					x += run;
+					c = up[x - 1];
+				}
+				bRunEnded = true;
+				continue;
+			}
+			bRunEnded = false;
+
+			Context& context = contexts[rowContexts[x]];
+			int k = context.getK();
+			unsigned int mapped = reader.getRice(k);
+			context.update(mapped);
+			row[x] = unmapError(mapped, predict(a, b, c));
+
+			a = row[x];
+			c = b;
+			x++;
+		}
+		return true;
+	}
+
+	void benchmarkFrame(const string& name, const unsigned short* frame, int width, int height, int iterations)
+	{
+		vector<unsigned char> encoded;
+		vector<unsigned short> decoded(width * height);
+
+		unsigned long long start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			ofxKinectDepthCodec::encode(frame, width, height, encoded);
+		}
+		float encodeMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		bool bDecoded = true;
+		start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			bDecoded = ofxKinectDepthCodec::decode(&encoded[0], encoded.size(), &decoded[0], width, height) && bDecoded;
+		}
+		float decodeMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		int mismatches = 0;
+		for(int i = 0; i < width * height; i++)
+		{
+			if(decoded[i] != frame[i])
+			{
+				mismatches++;
+			}
+		}
+
+		float ratio = width * height * sizeof(unsigned short) / (float)encoded.size();
+		ofLogNotice("ofxKinectDepthCodec::benchmark") << name << " " << width << "x" << height << ": " << encoded.size() << " bytes, "
+			<< ratio << ":1, encode " << encodeMicros << " us, decode " << decodeMicros << " us, "
+			<< (bDecoded ? "" : "decode failed, ") << mismatches << " mismatched pixels";
+	}
+}
+
+//---------------------------------------------------------------------------
+unsigned int ofxKinectDepthCodec::getMaxEncodedSize(int width, int height)
+{
+	return sizeof(Header) + width * height * sizeof(unsigned short);
+}
+
+unsigned int ofxKinectDepthCodec::encode(const unsigned short* pixels, int width, int height, unsigned char* output, unsigned int capacity)
+{
+	if(width <= 0 || height <= 0 || width > 0xffff || height > 0xffff || capacity < sizeof(Header))
+	{
+		return 0;
+	}
+
+	Header header;
+	memcpy(header.magic, "KV2D", 4);
+	header.width = width;
+	header.height = height;
+	header.mode = MODE_PREDICTED;
+
+	// anything bigger than the raw pixels is stored raw instead
+	unsigned int rawSize = width * height * sizeof(unsigned short);
+	unsigned char* payload = output + sizeof(Header);
+	BitWriter writer(payload, payload + MIN(capacity - sizeof(Header), rawSize));
+	Context contexts[CONTEXT_COUNT];
+	Context runContext;
+
+	vector<unsigned short> zeros(width, 0), mapped(width);
+	vector<unsigned char> rowContexts(width);
+	for(int y = 0; y < height && !writer.isOverflowing(); y++)
+	{
+		const unsigned short* row = pixels + y * width;
+		const unsigned short* up = y > 0 ? row - width : &zeros[0];
+		getRowContexts(up, width, &rowContexts[0]);
+		getRowErrors(row, up, width, &mapped[0]);
+		encodeRow(row, up, width, &mapped[0], &rowContexts[0], writer, contexts, runContext);
+	}
+
+	unsigned char* end = writer.isOverflowing() ? NULL : writer.flush();
+	if(end != NULL)
+	{
+		header.payloadSize = end - payload;
+	}
+	else
+	{
+		if(capacity < sizeof(Header) + rawSize)
+		{
+			return 0;
+		}
+		header.mode = MODE_RAW;
+		header.payloadSize = rawSize;
+		memcpy(payload, pixels, rawSize);
+	}
+
+	memcpy(output, &header, sizeof(Header));
+	return sizeof(Header) + header.payloadSize;
+}
+
+bool ofxKinectDepthCodec::encode(const unsigned short* pixels, int width, int height, vector<unsigned char>& output)
+{
+	output.resize(getMaxEncodedSize(width, height));
+	unsigned int size = encode(pixels, width, height, &output[0], output.size());
+	output.resize(size);
+	return size > 0;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectDepthCodec::getDimensions(const unsigned char* data, unsigned int size, int& width, int& height)
+{
+	Header header;
+	if(data == NULL || size < sizeof(Header))
+	{
+		return false;
+	}
+	memcpy(&header, data, sizeof(Header));
+	if(memcmp(header.magic, "KV2D", 4) != 0 || header.payloadSize > size - sizeof(Header))
+	{
+		return false;
+	}
+	width = header.width;
+	height = header.height;
+	return true;
+}
+
+bool ofxKinectDepthCodec::decode(const unsigned char* data, unsigned int size, unsigned short* pixels, int width, int height)
+{
+	int encodedWidth, encodedHeight;
+	if(!getDimensions(data, size, encodedWidth, encodedHeight) || encodedWidth != width || encodedHeight != height)
+	{
+		ofLogError("ofxKinectDepthCodec::decode") << "Not an encoded " << width << "x" << height << " frame";
+		return false;
+	}
+
+	Header header;
+	memcpy(&header, data, sizeof(Header));
+	const unsigned char* payload = data + sizeof(Header);
+
+	if(header.mode == MODE_RAW)
+	{
+		if(header.payloadSize != width * height * sizeof(unsigned short))
+		{
+			return false;
+		}
+		memcpy(pixels, payload, header.payloadSize);
+		return true;
+	}
+
+	BitReader reader(payload, header.payloadSize);
+	Context contexts[CONTEXT_COUNT];
+	Context runContext;
+
+	vector<unsigned short> zeros(width, 0);
+	vector<unsigned char> rowContexts(width);
+	bool bDecoded = true;
+	for(int y = 0; y < height && bDecoded; y++)
+	{
+		unsigned short* row = pixels + y * width;
+		const unsigned short* up = y > 0 ? row - width : &zeros[0];
+		getRowContexts(up, width, &rowContexts[0]);
+		bDecoded = decodeRow(row, up, width, &rowContexts[0], reader, contexts, runContext);
+	}
+
+	if(!bDecoded || !reader.isValid())
+	{
+		ofLogError("ofxKinectDepthCodec::decode") << "The frame is damaged or cut short";
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthCodec::benchmark(const unsigned short* frame, int width, int height, int iterations)
+{
+	if(frame != NULL)
+	{
+		benchmarkFrame("frame", frame, width, height, iterations);
+		return;
+	}
+
+	vector<unsigned short> depth, infrared;
+	makeTestFrames(width, height, depth, infrared);
+	benchmarkFrame("synthetic depth", &depth[0], width, height, iterations);
+	benchmarkFrame("synthetic infrared", &infrared[0], width, height, iterations);
+
+	// the raw fallback and the run mode at their extremes
+	vector<unsigned short> noise(width * height), flat(width * height, 0);
+	for(int i = 0; i < width * height; i++)
+	{
+		noise[i] = (unsigned short)ofRandom(65536);
+	}
+	benchmarkFrame("white noise", &noise[0], width, height, iterations / 10 + 1);
+	benchmarkFrame("empty", &flat[0], width, height, iterations);
+}
+
+//---------------------------------------------------------------------------
+namespace
+{
+	bool testRoundTrip(const string& name, const unsigned short* frame, int width, int height)
+	{
+		vector<unsigned char> encoded;
+		vector<unsigned short> decoded(width * height, 0);
+		bool bPassed = ofxKinectDepthCodec::encode(frame, width, height, encoded)
+			&& ofxKinectDepthCodec::decode(&encoded[0], encoded.size(), &decoded[0], width, height)
+			&& memcmp(&decoded[0], frame, width * height * sizeof(unsigned short)) == 0;
+		if(!bPassed)
+		{
+			ofLogError("ofxKinectDepthCodec::test") << name << " " << width << "x" << height << " didn't come back unchanged";
+		}
+		return bPassed;
+	}
+
+	// the decoder gets exactly size bytes of their own, so reading past them is an overrun a checked build
+	// catches rather than a read into the rest of the frame
+	bool decodeCopy(const unsigned char* data, unsigned int size, int width, int height)
+	{
+		vector<unsigned char> copy(data, data + size);
+		vector<unsigned short> decoded(width * height);
+		return ofxKinectDepthCodec::decode(copy.empty() ? NULL : &copy[0], size, &decoded[0], width, height);
+	}
+}
+
+bool ofxKinectDepthCodec::test()
+{
+	int failures = 0;
+	const int width = 512, height = 424;
+
+	vector<unsigned short> depth, infrared;
+	makeTestFrames(width, height, depth, infrared);
+	failures += !testRoundTrip("synthetic depth", &depth[0], width, height);
+	failures += !testRoundTrip("synthetic infrared", &infrared[0], width, height);
+
+	// the raw fallback, run mode over a whole frame, and escapes on every pixel
+	vector<unsigned short> noise(width * height), flat(width * height, 0), extremes(width * height);
+	for(int i = 0; i < width * height; i++)
+	{
+		noise[i] = (unsigned short)ofRandom(65536);
+		extremes[i] = (i + i / width) % 2 == 0 ? 0 : 0xffff;
+	}
+	failures += !testRoundTrip("white noise", &noise[0], width, height);
+	failures += !testRoundTrip("empty", &flat[0], width, height);
+	failures += !testRoundTrip("checkerboard of 0 and 65535", &extremes[0], width, height);
+
+	// odd and tiny sizes, where rows end inside a vector and runs hit the end of a row
+	for(int n = 0; n < 200; n++)
+	{
+		int w = 1 + (int)ofRandom(40), h = 1 + (int)ofRandom(12);
+		vector<unsigned short> frame(w * h);
+		int base = (int)ofRandom(8000), spread = 1 << (int)ofRandom(17);
+		for(int i = 0; i < w * h; i++)
+		{
+			frame[i] = ofRandom(1) < 0.2f ? 0 : (unsigned short)ofClamp(base + ofRandom(spread) - spread / 2, 0, 65535);
+		}
+		failures += !testRoundTrip("random", &frame[0], w, h);
+	}
+
+	// damaged data, each one logs an error from decode() that is expected here
+	vector<unsigned char> encoded;
+	encode(&depth[0], width, height, encoded);
+	ofLogLevel logLevel = ofGetLogLevel();
+	ofSetLogLevel(OF_LOG_FATAL_ERROR);
+
+	// cut short anywhere, with the header's size as written or patched to match what is left
+	int accepted = 0;
+	unsigned int cuts[] = { 0, 1, sizeof(Header) - 1, sizeof(Header), sizeof(Header) + 1, (unsigned int)encoded.size() / 2, (unsigned int)encoded.size() - 8, (unsigned int)encoded.size() - 1 };
+	for(size_t c = 0; c < sizeof(cuts) / sizeof(cuts[0]); c++)
+	{
+		accepted += decodeCopy(&encoded[0], cuts[c], width, height);
+		if(cuts[c] >= sizeof(Header))
+		{
+			vector<unsigned char> cut(encoded.begin(), encoded.begin() + cuts[c]);
+			unsigned int payloadSize = cuts[c] - sizeof(Header);
+			memcpy(&cut[offsetof(Header, payloadSize)], &payloadSize, sizeof(payloadSize));
+			accepted += decodeCopy(&cut[0], cut.size(), width, height);
+		}
+	}
+	if(accepted > 0)
+	{
+		ofLogError("ofxKinectDepthCodec::test") << accepted << " truncated frames were decoded";
+		failures++;
+	}
+
+	// a header that doesn't fit the frame
+	accepted = 0;
+	vector<unsigned char> damaged = encoded;
+	damaged[0] = 'X';
+	accepted += decodeCopy(&damaged[0], damaged.size(), width, height);
+	accepted += decodeCopy(&encoded[0], encoded.size(), width + 1, height);
+	damaged = encoded;
+	unsigned int mode = MODE_RAW;
+	memcpy(&damaged[offsetof(Header, mode)], &mode, sizeof(mode));
+	accepted += decodeCopy(&damaged[0], damaged.size(), width, height);
+	if(accepted > 0)
+	{
+		ofLogError("ofxKinectDepthCodec::test") << accepted << " frames with a damaged header were decoded";
+		failures++;
+	}
+
+	// flipped bits in the payload can decode to other pixels, there is no checksum, but must stay within
+	// the data and the frame
+	int rejected = 0;
+	const int corruptions = 200;
+	for(int n = 0; n < corruptions; n++)
+	{
+		damaged = encoded;
+		int flips = 1 + (int)ofRandom(8);
+		for(int f = 0; f < flips; f++)
+		{
+			damaged[sizeof(Header) + (int)ofRandom(damaged.size() - sizeof(Header))] ^= 1 << (int)ofRandom(8);
+		}
+		rejected += !decodeCopy(&damaged[0], damaged.size(), width, height);
+	}
+
+	ofSetLogLevel(logLevel);
+
+	ofLogNotice("ofxKinectDepthCodec::test") << (failures == 0 ? "passed" : "FAILED") << ": round trips of synthetic depth and infrared, noise, "
+		<< "extremes and 200 random sizes, truncated and damaged headers rejected, " << rejected << " of " << corruptions
+		<< " corrupted payloads rejected and the rest decoded within bounds";
+	return failures == 0;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthCodec::makeTestFrames(int width, int height, vector<unsigned short>& depth, vector<unsigned short>& infrared)
+{
+	depth.assign(width * height, 0);
+	infrared.assign(width * height, 0);
+	float focal = width * 0.713f;
+	float cameraHeight = 1.0f, wallDistance = 4.2f;
+	ofVec3f sphereCenter(0.2f, -0.1f, 2.0f);
+	float sphereRadius = 0.45f;
+
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			ofVec3f ray((x - width * 0.5f) / focal, (height * 0.5f - y) / focal, 1);
+
+			float z = wallDistance;
+			float albedo = 0.6f;
+			if(ray.y < 0)
+			{
+				float floorZ = cameraHeight / -ray.y;
+				if(floorZ < z)
+				{
+					z = floorZ;
+					albedo = 0.4f;
+				}
+			}
+
+			// ray against the sphere, z = t since the ray's z is 1
+			float rayLength = ray.length();
+			ofVec3f direction = ray / rayLength;
+			float along = direction.dot(sphereCenter);
+			float miss = (sphereCenter - direction * along).length();
+			bool bEdge = false;
+			if(miss < sphereRadius)
+			{
+				float t = (along - sqrtf(sphereRadius * sphereRadius - miss * miss)) / rayLength;
+				if(t < z)
+				{
+					z = t;
+					albedo = 0.8f;
+					bEdge = miss > sphereRadius * 0.97f;
+				}
+			}
+
+			float cornerX = (x - width * 0.5f) / (width * 0.5f);
+			float cornerY = (y - height * 0.5f) / (height * 0.5f);
+			bool bOutside = cornerX * cornerX + cornerY * cornerY > 1.7f;
+
+			// a millimeter at a meter, three and a half at four
+			float sigma = 1.0f + 0.15f * z * z;
+			float gaussian = sqrtf(-2 * logf(ofRandom(1e-6f, 1))) * cosf(ofRandom(TWO_PI));
+			int i = y * width + x;
+			depth[i] = bEdge || bOutside || ofRandom(1) < 0.01f ? 0 : (unsigned short)ofClamp(z * 1000 + gaussian * sigma, 0, 8000);
+
+			float intensity = 3000 * albedo / (z * z);
+			float shot = sqrtf(-2 * logf(ofRandom(1e-6f, 1))) * cosf(ofRandom(TWO_PI));
+			infrared[i] = (unsigned short)ofClamp(intensity + shot * sqrtf(intensity) * 2, 0, 65535);
+		}
+	}
+}
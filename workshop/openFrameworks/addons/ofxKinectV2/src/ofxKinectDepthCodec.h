@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ofMain.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lossless codec for 16 bit depth and infrared frames
+//
+// every pixel is predicted from its left, upper and upper left neighbours with the median edge detector
+// of jpeg-ls, and the prediction error is written with an adaptive rice code. the rice parameter comes
+// from running error statistics kept per context, the context being how busy the neighbourhood is, so
+// flat walls get short codes and depth edges long ones without a second pass over the frame. where the
+// three neighbours are equal (holes, saturated ir) the codec switches to run mode and writes only how
+// many pixels repeat the left one. the contexts only look at the row above and the encoder knows every
+// neighbour, so both are worked out 8 pixels at a time with sse2 and only the bits go pixel by pixel.
+// a frame that wouldn't get smaller is stored raw. a frame decodes exactly to what was encoded. infrared
+// compresses about 2:1 against depth's 3:1: its shot noise alone is worth about 6.7 bits a pixel on the
+// test frames, which keeps any lossless coder under 2.4:1.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectDepthCodec
+{
+  public:
+	/// upper bound of encode()'s output for a frame of this size, whatever the pixels are
+	static unsigned int getMaxEncodedSize(int width, int height);
+
+	/// writes at most capacity bytes to output and returns how many, 0 if it didn't fit
+	static unsigned int encode(const unsigned short* pixels, int width, int height, unsigned char* output, unsigned int capacity);
+	/// output is resized to the encoded size, its capacity is kept for the next frame
+	static bool encode(const unsigned short* pixels, int width, int height, vector<unsigned char>& output);
+
+	/// false if the data isn't a width x height frame or is cut short
+	static bool decode(const unsigned char* data, unsigned int size, unsigned short* pixels, int width, int height);
+	/// dimensions of an encoded frame, false if data isn't one
+	static bool getDimensions(const unsigned char* data, unsigned int size, int& width, int& height);
+
+	/// encodes and decodes a frame iterations times and logs ratio and timing, and whether it came back
+	/// unchanged. without a frame a synthetic room with sensor noise and holes is used
+	static void benchmark(const unsigned short* frame = NULL, int width = 512, int height = 424, int iterations = 200);
+	/// round trips synthetic depth and infrared, noise, extremes and random odd sized frames, and checks that
+	/// truncated data and damaged headers are rejected and corrupted payloads decode without overrunning.
+	/// logs the outcome and returns whether everything passed
+	static bool test();
+
+	/// the synthetic room the benchmarks use: floor, back wall and a sphere, with time of flight noise
+	/// growing with distance, dropouts and no readings in the corners, in millimeters and ir intensity
+	static void makeTestFrames(int width, int height, vector<unsigned short>& depth, vector<unsigned short>& infrared);
+};
@@ -0,0 +1,336 @@
+#include "ofxKinectDepthKernel.h"
+
+#include <float.h>
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#endif
+
+//---------------------------------------------------------------------------
+// scalar, also finishes the last few pixels of the simd versions. a divide per pixel is too slow without
+// simd, so this reads the same mapping from a table built in setClipping()
+template<bool bVisual, bool bRaw, bool bNormalized>
+static void convertScalar(const ofxKinectDepthKernel::Params& p, const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized)
+{
+	for(int i = 0; i < count; i++)
+	{
+		unsigned short d = depth[i];
+		if(bVisual)
+		{
+			visual[i] = p.lookupTable[MIN(d, p.maxDepthIndex)];
+		}
+		if(bRaw)
+		{
+			raw[i] = d;
+		}
+		if(bNormalized)
+		{
+			normalized[i] = d / 65535.0f;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+static inline __m128 mapDepthSSE2(__m128 d, const ofxKinectDepthKernel::Params& p)
+{
+	__m128 out = _mm_sub_ps(_mm_min_ps(d, _mm_set1_ps(p.maxDepth)), _mm_set1_ps(p.nearClip));
+	out = _mm_add_ps(_mm_mul_ps(_mm_div_ps(out, _mm_set1_ps(p.range)), _mm_set1_ps(p.colorRange)), _mm_set1_ps(p.colorMin));
+	out = _mm_min_ps(_mm_max_ps(out, _mm_set1_ps(p.colorLow)), _mm_set1_ps(p.colorHigh));
+	// no reading stays black
+	return _mm_andnot_ps(_mm_cmpeq_ps(d, _mm_setzero_ps()), out);
+}
+
+template<bool bVisual, bool bRaw, bool bNormalized>
+static void convertSSE2(const ofxKinectDepthKernel::Params& p, const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 toNormalized = _mm_set1_ps(65535.0f);
+
+	int i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m128i d16 = _mm_loadu_si128((const __m128i*)(depth + i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero));
+		__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(d16, zero));
+
+		if(bVisual)
+		{
+			__m128i v32lo = _mm_cvttps_epi32(mapDepthSSE2(lo, p));
+			__m128i v32hi = _mm_cvttps_epi32(mapDepthSSE2(hi, p));
+			__m128i v16 = _mm_packs_epi32(v32lo, v32hi);
+			_mm_storel_epi64((__m128i*)(visual + i), _mm_packus_epi16(v16, v16));
+		}
+		if(bRaw)
+		{
+			_mm_storeu_si128((__m128i*)(raw + i), d16);
+		}
+		if(bNormalized)
+		{
+			_mm_storeu_ps(normalized + i, _mm_div_ps(lo, toNormalized));
+			_mm_storeu_ps(normalized + i + 4, _mm_div_ps(hi, toNormalized));
+		}
+	}
+
+	convertScalar<bVisual, bRaw, bNormalized>(p, depth + i, count - i, visual + i, raw + i, normalized + i);
+}
+
+#ifdef OFX_KINECT_HAS_AVX2
+//---------------------------------------------------------------------------
+static inline __m256 mapDepthAVX2(__m256 d, const ofxKinectDepthKernel::Params& p)
+{
+	__m256 out = _mm256_sub_ps(_mm256_min_ps(d, _mm256_set1_ps(p.maxDepth)), _mm256_set1_ps(p.nearClip));
+	out = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(out, _mm256_set1_ps(p.range)), _mm256_set1_ps(p.colorRange)), _mm256_set1_ps(p.colorMin));
+	out = _mm256_min_ps(_mm256_max_ps(out, _mm256_set1_ps(p.colorLow)), _mm256_set1_ps(p.colorHigh));
+	return _mm256_andnot_ps(_mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_EQ_OQ), out);
+}
+
+template<bool bVisual, bool bRaw, bool bNormalized>
+static void convertAVX2(const ofxKinectDepthKernel::Params& p, const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized)
+{
+	const __m256 toNormalized = _mm256_set1_ps(65535.0f);
+
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i d16lo = _mm_loadu_si128((const __m128i*)(depth + i));
+		__m128i d16hi = _mm_loadu_si128((const __m128i*)(depth + i + 8));
+		__m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(d16lo));
+		__m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(d16hi));
+
+		if(bVisual)
+		{
+			__m256i v32lo = _mm256_cvttps_epi32(mapDepthAVX2(lo, p));
+			__m256i v32hi = _mm256_cvttps_epi32(mapDepthAVX2(hi, p));
+			// packs works per 128 bit lane, put the four quarters back in pixel order
+			__m256i v16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(v32lo, v32hi), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i v8 = _mm_packus_epi16(_mm256_castsi256_si128(v16), _mm256_extracti128_si256(v16, 1));
+			_mm_storeu_si128((__m128i*)(visual + i), v8);
+		}
+		if(bRaw)
+		{
+			_mm_storeu_si128((__m128i*)(raw + i), d16lo);
+			_mm_storeu_si128((__m128i*)(raw + i + 8), d16hi);
+		}
+		if(bNormalized)
+		{
+			_mm256_storeu_ps(normalized + i, _mm256_div_ps(lo, toNormalized));
+			_mm256_storeu_ps(normalized + i + 8, _mm256_div_ps(hi, toNormalized));
+		}
+	}
+
+	// keep the upper halves of the ymm registers from slowing down the sse code that follows
+	_mm256_zeroupper();
+	convertScalar<bVisual, bRaw, bNormalized>(p, depth + i, count - i, visual + i, raw + i, normalized + i);
+}
+#endif
+
+//---------------------------------------------------------------------------
+// one instance per combination of outputs, indexed by visual | raw << 1 | normalized << 2
+#define OFX_KINECT_DEPTH_KERNELS(fn) \
+	{ fn<false, false, false>, fn<true, false, false>, fn<false, true, false>, fn<true, true, false>, \
+	  fn<false, false, true>, fn<true, false, true>, fn<false, true, true>, fn<true, true, true> }
+
+static const ofxKinectDepthKernel::ConvertFunction scalarKernels[8] = OFX_KINECT_DEPTH_KERNELS(convertScalar);
+static const ofxKinectDepthKernel::ConvertFunction sse2Kernels[8] = OFX_KINECT_DEPTH_KERNELS(convertSSE2);
+#ifdef OFX_KINECT_HAS_AVX2
+static const ofxKinectDepthKernel::ConvertFunction avx2Kernels[8] = OFX_KINECT_DEPTH_KERNELS(convertAVX2);
+#endif
+
+//---------------------------------------------------------------------------
+ofxKinectDepthKernel::ofxKinectDepthKernel()
+{
+	isa = getBestSupportedIsa();
+	setClipping(500, 4000, true);
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthKernel::setClipping(float nearClip, float farClip, bool nearWhite, unsigned short maxDepth)
+{
+	float nearColor = nearWhite ? 255 : 0;
+	float farColor = nearWhite ? 0 : 255;
+
+	params.nearClip = nearClip;
+	params.range = farClip - nearClip;
+	params.colorMin = nearColor;
+	params.colorRange = farColor - nearColor;
+	params.colorLow = MIN(nearColor, farColor);
+	params.colorHigh = MAX(nearColor, farColor);
+	params.maxDepth = maxDepth;
+	params.maxDepthIndex = maxDepth;
+
+	// ofMap hands back the near color when the input range is empty
+	if(fabs(params.range) < FLT_EPSILON)
+	{
+		params.range = 1;
+		params.colorRange = 0;
+	}
+
+	// same arithmetic as the simd versions so every instruction set gives the same image
+	lookupTable.resize(maxDepth + 1);
+	lookupTable[0] = 0;
+	for(int i = 1; i <= maxDepth; i++)
+	{
+		float out = ((float)i - params.nearClip) / params.range * params.colorRange + params.colorMin;
+		lookupTable[i] = (unsigned char)MIN(MAX(out, params.colorLow), params.colorHigh);
+	}
+	params.lookupTable = NULL;
+}
+
+const ofxKinectDepthKernel::Params& ofxKinectDepthKernel::getParams() const
+{
+	return params;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthKernel::setIsa(Isa requested)
+{
+	isa = (Isa)MIN((int)requested, (int)getBestSupportedIsa());
+}
+
+ofxKinectDepthKernel::Isa ofxKinectDepthKernel::getIsa() const
+{
+	return isa;
+}
+
+ofxKinectDepthKernel::Isa ofxKinectDepthKernel::getBestSupportedIsa()
+{
+	static int best = -1;
+	if(best < 0)
+	{
+		// every x64 cpu has sse2
+		best = ISA_SSE2;
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] >= 7)
+		{
+			__cpuid(info, 1);
+			bool bOsSavesYmm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+			__cpuidex(info, 7, 0);
+			if(bOsSavesYmm && (info[1] & (1 << 5)))
+			{
+				best = ISA_AVX2;
+			}
+		}
+#elif defined(OFX_KINECT_HAS_AVX2)
+		best = ISA_AVX2;
+#endif
+	}
+	return (Isa)best;
+}
+
+string ofxKinectDepthKernel::getIsaName(Isa isa)
+{
+	switch(isa)
+	{
+	case ISA_AVX2: return "AVX2";
+	case ISA_SSE2: return "SSE2";
+	default: return "scalar";
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthKernel::convert(const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized) const
+{
+	int outputs = (visual != NULL ? 1 : 0) | (raw != NULL ? 2 : 0) | (normalized != NULL ? 4 : 0);
+	if(outputs == 0)
+	{
+		return;
+	}
+
+	// the table pointer is only filled in here so copies of the kernel never point at each other's table
+	Params p = params;
+	p.lookupTable = &lookupTable[0];
+
+	switch(isa)
+	{
+#ifdef OFX_KINECT_HAS_AVX2
+	case ISA_AVX2:
+		avx2Kernels[outputs](p, depth, count, visual, raw, normalized);
+		break;
+#endif
+	case ISA_SSE2:
+		sse2Kernels[outputs](p, depth, count, visual, raw, normalized);
+		break;
+	default:
+		scalarKernels[outputs](p, depth, count, visual, raw, normalized);
+		break;
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthKernel::benchmark(int width, int height, int iterations)
+{
+	int count = width * height;
+	float nearClip = 500, farClip = 4000;
+
+	// the loop update() used to run, lookup table included
+	vector<unsigned char> lookupTable(10001);
+	lookupTable[0] = 0;
+	for(unsigned int i = 1; i < lookupTable.size(); i++)
+	{
+		lookupTable[i] = ofMap(i, nearClip, farClip, 255, 0, true);
+	}
+
+	// mostly valid readings with some holes and a few out of range values, like a real frame
+	vector<unsigned short> depth(count);
+	for(int i = 0; i < count; i++)
+	{
+		int r = (int)ofRandom(100);
+		depth[i] = r < 5 ? 0 : r < 7 ? (unsigned short)ofRandom(10000, 65535) : (unsigned short)ofRandom(1, 8000);
+	}
+
+	vector<unsigned char> expectedVisual(count), visual(count);
+	vector<unsigned short> raw(count);
+	vector<float> expectedNormalized(count), normalized(count);
+
+	unsigned long long start = ofGetElapsedTimeMicros();
+	for(int n = 0; n < iterations; n++)
+	{
+		for(int i = 0; i < count; i++)
+		{
+			expectedVisual[i] = lookupTable[ofClamp(depth[i], 0, lookupTable.size() - 1)];
+			expectedNormalized[i] = depth[i] / 65535.0f;
+		}
+	}
+	float legacyMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+	ofLogNotice("ofxKinectDepthKernel::benchmark") << width << "x" << height << " lookup table loop: " << legacyMicros << " us/frame";
+
+	ofxKinectDepthKernel kernel;
+	kernel.setClipping(nearClip, farClip, true);
+	for(int isa = ISA_SCALAR; isa <= getBestSupportedIsa(); isa++)
+	{
+		kernel.setIsa((Isa)isa);
+
+		start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			kernel.convert(&depth[0], count, &visual[0], NULL, NULL);
+		}
+		float visualMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			kernel.convert(&depth[0], count, &visual[0], &raw[0], &normalized[0]);
+		}
+		float allMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		int mismatches = 0;
+		for(int i = 0; i < count; i++)
+		{
+			if(visual[i] != expectedVisual[i] || raw[i] != depth[i] || normalized[i] != expectedNormalized[i])
+			{
+				mismatches++;
+			}
+		}
+
+		ofLogNotice("ofxKinectDepthKernel::benchmark") << getIsaName((Isa)isa) << ": visual " << visualMicros << " us/frame, all outputs "
+			<< allMicros << " us/frame (" << legacyMicros / allMicros << "x), " << mismatches << " mismatched pixels";
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ofMain.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// fused depth conversion
+//
+// turns raw sensor depth into the 8 bit visual image, a raw 16 bit copy and the normalized float image
+// in a single pass. each combination of outputs is its own template instance, so an output that is
+// switched off (NULL destination) costs nothing. runs on AVX2 or SSE2 when the cpu has it and falls back
+// to scalar code otherwise; all three produce exactly the same values as the old lookup table.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectDepthKernel
+{
+  public:
+	enum Isa
+	{
+		ISA_SCALAR,
+		ISA_SSE2,
+		ISA_AVX2
+	};
+
+	// everything the kernel needs to reproduce ofMap(depth, near, far, nearColor, farColor, true)
+	struct Params
+	{
+		float nearClip;
+		float range;
+		float colorMin;
+		float colorRange;
+		float colorLow;
+		float colorHigh;
+		float maxDepth;
+		unsigned short maxDepthIndex;
+		const unsigned char* lookupTable;
+	};
+
+	ofxKinectDepthKernel();
+
+	/// depth values are clamped to maxDepth before mapping, 0 (no reading) always maps to black
+	void setClipping(float nearClip, float farClip, bool nearWhite, unsigned short maxDepth = 10000);
+	const Params& getParams() const;
+
+	/// use a slower instruction set than the cpu supports, e.g. to compare them
+	void setIsa(Isa isa);
+	Isa getIsa() const;
+	static Isa getBestSupportedIsa();
+	static string getIsaName(Isa isa);
+
+	/// converts count pixels. any destination may be NULL to skip that output
+	void convert(const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized) const;
+
+	/// times the old per pixel loop against every supported instruction set on width x height frames
+	/// and logs the results, also checks every output matches the old loop
+	static void benchmark(int width = 512, int height = 424, int iterations = 500);
+
+	typedef void (*ConvertFunction)(const Params& params, const unsigned short* depth, int count, unsigned char* visual, unsigned short* raw, float* normalized);
+
+  protected:
+	Params params;
+	vector<unsigned char> lookupTable;
+	Isa isa;
+};
@@ -0,0 +1,227 @@
+#include "ofxKinectDepthProjector.h"
+
+#include <emmintrin.h>
+
+//---------------------------------------------------------------------------
+ofxKinectDepthProjector::ofxKinectDepthProjector()
+	: width(0)
+	, height(0)
+{
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectDepthProjector::setup(KCBHANDLE hKinect, int _width, int _height)
+{
+#ifdef OFX_KINECT_NO_SDK
+	(void)hKinect;
+	(void)_width;
+	(void)_height;
+	ofLogError("ofxKinectDepthProjector::setup") << "Built without the sdk, use setRayTable()";
+	return false;
+#else
+	UINT32 entryCount = 0;
+	PointF* entries = NULL;
+
+	HRESULT hr = GetDepthFrameToCameraSpaceTable(hKinect, &entryCount, &entries);
+	if(FAILED(hr) || entries == NULL)
+	{
+		ofLogError("ofxKinectDepthProjector::setup") << "Failed to get the depth to camera space table";
+		return false;
+	}
+
+	bool bValid = entryCount == (UINT32)(_width * _height);
+	if(bValid)
+	{
+		// the sensor hands out a table of zeros until it has sent its calibration
+		PointF corner = entries[0];
+		bValid = corner.X != 0 || corner.Y != 0;
+	}
+
+	if(bValid)
+	{
+		setRayTable(entries, _width, _height);
+	}
+	else
+	{
+		ofLogVerbose("ofxKinectDepthProjector::setup") << "Depth to camera space table not available yet";
+	}
+
+	CoTaskMemFree(entries);
+	return bValid;
+#endif
+}
+
+void ofxKinectDepthProjector::setRayTable(const PointF* rays, int _width, int _height)
+{
+	width = _width;
+	height = _height;
+	raysX.resize(width * height);
+	raysY.resize(width * height);
+	for(int i = 0; i < width * height; i++)
+	{
+		raysX[i] = rays[i].X;
+		raysY[i] = rays[i].Y;
+	}
+}
+
+bool ofxKinectDepthProjector::isReady() const
+{
+	return width > 0 && height > 0;
+}
+
+void ofxKinectDepthProjector::clear()
+{
+	width = height = 0;
+	raysX.clear();
+	raysY.clear();
+}
+
+int ofxKinectDepthProjector::getWidth() const
+{
+	return width;
+}
+
+int ofxKinectDepthProjector::getHeight() const
+{
+	return height;
+}
+
+const vector<float>& ofxKinectDepthProjector::getRaysX() const
+{
+	return raysX;
+}
+
+const vector<float>& ofxKinectDepthProjector::getRaysY() const
+{
+	return raysY;
+}
+
+//---------------------------------------------------------------------------
+ofVec3f ofxKinectDepthProjector::projectSubpixel(float x, float y, float depth) const
+{
+	x = ofClamp(x, 0, width - 1);
+	y = ofClamp(y, 0, height - 1);
+	int x0 = MIN((int)x, width - 2);
+	int y0 = MIN((int)y, height - 2);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	int i = y0 * width + x0;
+	float rayX = ofLerp(ofLerp(raysX[i], raysX[i + 1], fx), ofLerp(raysX[i + width], raysX[i + width + 1], fx), fy);
+	float rayY = ofLerp(ofLerp(raysY[i], raysY[i + 1], fx), ofLerp(raysY[i + width], raysY[i + width + 1], fx), fy);
+
+	float z = depth * 0.001f;
+	return ofVec3f(rayX * z, rayY * z, z);
+}
+
+float ofxKinectDepthProjector::sampleDepth(const unsigned short* depth, int width, int height, float x, float y, bool bBilinear)
+{
+	x = ofClamp(x, 0, width - 1);
+	y = ofClamp(y, 0, height - 1);
+	if(!bBilinear)
+	{
+		return depth[(int)y * width + (int)x];
+	}
+
+	int x0 = MIN((int)x, width - 2);
+	int y0 = MIN((int)y, height - 2);
+	float fx = x - x0;
+	float fy = y - y0;
+
+	// holes have no depth to blend with, leave them out and renormalize over the rest
+	const unsigned short* p = depth + y0 * width + x0;
+	unsigned short samples[4] = { p[0], p[1], p[width], p[width + 1] };
+	float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+	float sum = 0;
+	float weightSum = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		if(samples[i] != 0)
+		{
+			sum += samples[i] * weights[i];
+			weightSum += weights[i];
+		}
+	}
+	return weightSum > 0 ? sum / weightSum : 0;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthProjector::project(const unsigned short* depth, float* dst, Layout layout, int rowBegin, int rowEnd) const
+{
+	if(layout == LAYOUT_PLANAR)
+	{
+		int planeSize = width * height;
+		project(depth, dst, dst + planeSize, dst + planeSize * 2, rowBegin, rowEnd);
+		return;
+	}
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 toMeters = _mm_set1_ps(0.001f);
+
+	int i = rowBegin * width;
+	int end = rowEnd * width;
+	for(; i + 8 <= end; i += 8)
+	{
+		__m128i d16 = _mm_loadu_si128((const __m128i*)(depth + i));
+		__m128 z[2];
+		z[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero)), toMeters);
+		z[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d16, zero)), toMeters);
+
+		for(int half = 0; half < 2; half++)
+		{
+			int j = i + half * 4;
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(&raysX[j]), z[half]);
+			__m128 y = _mm_mul_ps(_mm_loadu_ps(&raysY[j]), z[half]);
+
+			// 4 x, 4 y, 4 z -> x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+			__m128 xy0 = _mm_unpacklo_ps(x, y);
+			__m128 xy1 = _mm_unpackhi_ps(x, y);
+			__m128 t0 = _mm_shuffle_ps(z[half], xy0, _MM_SHUFFLE(2, 2, 0, 0));
+			__m128 t1 = _mm_shuffle_ps(xy0, z[half], _MM_SHUFFLE(1, 1, 3, 3));
+			__m128 t2 = _mm_shuffle_ps(z[half], xy1, _MM_SHUFFLE(3, 2, 3, 2));
+
+			float* out = dst + j * 3;
+			_mm_storeu_ps(out, _mm_shuffle_ps(xy0, t0, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(out + 4, _mm_shuffle_ps(t1, xy1, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(out + 8, _mm_shuffle_ps(t2, t2, _MM_SHUFFLE(1, 3, 2, 0)));
+		}
+	}
+
+	for(; i < end; i++)
+	{
+		float z = depth[i] * 0.001f;
+		dst[i * 3] = raysX[i] * z;
+		dst[i * 3 + 1] = raysY[i] * z;
+		dst[i * 3 + 2] = z;
+	}
+}
+
+void ofxKinectDepthProjector::project(const unsigned short* depth, float* dstX, float* dstY, float* dstZ, int rowBegin, int rowEnd) const
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 toMeters = _mm_set1_ps(0.001f);
+
+	int i = rowBegin * width;
+	int end = rowEnd * width;
+	for(; i + 8 <= end; i += 8)
+	{
+		__m128i d16 = _mm_loadu_si128((const __m128i*)(depth + i));
+		__m128 zLo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero)), toMeters);
+		__m128 zHi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(d16, zero)), toMeters);
+
+		_mm_storeu_ps(dstX + i, _mm_mul_ps(_mm_loadu_ps(&raysX[i]), zLo));
+		_mm_storeu_ps(dstX + i + 4, _mm_mul_ps(_mm_loadu_ps(&raysX[i + 4]), zHi));
+		_mm_storeu_ps(dstY + i, _mm_mul_ps(_mm_loadu_ps(&raysY[i]), zLo));
+		_mm_storeu_ps(dstY + i + 4, _mm_mul_ps(_mm_loadu_ps(&raysY[i + 4]), zHi));
+		_mm_storeu_ps(dstZ + i, zLo);
+		_mm_storeu_ps(dstZ + i + 4, zHi);
+	}
+
+	for(; i < end; i++)
+	{
+		float z = depth[i] * 0.001f;
+		dstX[i] = raysX[i] * z;
+		dstY[i] = raysY[i] * z;
+		dstZ[i] = z;
+	}
+}
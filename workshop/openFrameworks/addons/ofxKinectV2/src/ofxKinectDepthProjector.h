@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// depth to camera space through the sensor's ray table
+//
+// every depth pixel has a fixed ray through it, so camera space is just ray * depth. the table is fetched
+// once from the sensor and kept in planar form; projecting a frame is then a couple of multiplies per pixel
+// with no calls into the sdk. pixels without depth come out as (0, 0, 0).
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectDepthProjector
+{
+  public:
+	enum Layout
+	{
+		LAYOUT_INTERLEAVED,	///< x y z x y z ...
+		LAYOUT_PLANAR		///< all x, then all y, then all z
+	};
+
+	ofxKinectDepthProjector();
+
+	/// fetch the ray table from the sensor, fails until the sensor has reported its calibration
+	bool setup(KCBHANDLE hKinect, int width, int height);
+	/// use a ray table from elsewhere, one (x, y) per depth pixel with z = 1
+	void setRayTable(const PointF* rays, int width, int height);
+	bool isReady() const;
+	void clear();
+
+	int getWidth() const;
+	int getHeight() const;
+	const vector<float>& getRaysX() const;
+	const vector<float>& getRaysY() const;
+
+	/// camera space of rows [rowBegin, rowEnd) of a full depth frame, in meters. dst is the start of
+	/// the whole frame's buffer: 3 floats per pixel for interleaved, 3 planes of width * height for planar
+	void project(const unsigned short* depth, float* dst, Layout layout, int rowBegin, int rowEnd) const;
+	/// same with the three planes in separate buffers
+	void project(const unsigned short* depth, float* dstX, float* dstY, float* dstZ, int rowBegin, int rowEnd) const;
+
+	/// single pixel, no bounds checks
+	ofVec3f project(int x, int y, unsigned short depth) const
+	{
+		int i = y * width + x;
+		float z = depth * 0.001f;
+		return ofVec3f(raysX[i] * z, raysY[i] * z, z);
+	}
+
+	/// sub pixel position with the ray interpolated between the four pixels around it, depth in millimeters
+	ofVec3f projectSubpixel(float x, float y, float depth) const;
+
+	/// depth in millimeters at a position in a width x height depth image, clamped to the image. nearest
+	/// takes the pixel the position falls in, bilinear blends the neighbours that have depth and gives
+	/// 0 only when none of them do
+	static float sampleDepth(const unsigned short* depth, int width, int height, float x, float y, bool bBilinear);
+
+  protected:
+	int width;
+	int height;
+	vector<float> raysX;
+	vector<float> raysY;
+};
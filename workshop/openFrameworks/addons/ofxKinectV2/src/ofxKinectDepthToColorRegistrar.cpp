@@ -0,0 +1,373 @@
+#include "ofxKinectDepthToColorRegistrar.h"
+#include "ofxKinectDepthKernel.h"
+
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#endif
+
+//---------------------------------------------------------------------------
+ofxKinectDepthToColorRegistrar::ofxKinectDepthToColorRegistrar()
+	: depthWidth(0)
+	, depthHeight(0)
+	, colorWidth(0)
+	, colorHeight(0)
+	, bBilinear(false)
+	, bOcclusionTest(true)
+	, occlusionTolerance(50)
+	, cellShift(2)
+	, zBufferWidth(0)
+	, zBufferHeight(0)
+{
+	bUseAVX2 = ofxKinectDepthKernel::getBestSupportedIsa() >= ofxKinectDepthKernel::ISA_AVX2;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthToColorRegistrar::setup(int _depthWidth, int _depthHeight, int _colorWidth, int _colorHeight)
+{
+	depthWidth = _depthWidth;
+	depthHeight = _depthHeight;
+	colorWidth = _colorWidth;
+	colorHeight = _colorHeight;
+
+	depth.assign(depthWidth * depthHeight, 0);
+	colorCoordinates.resize(depthWidth * depthHeight);
+	// nothing is mapped until the first frame
+	for(size_t i = 0; i < colorCoordinates.size(); i++)
+	{
+		colorCoordinates[i].X = colorCoordinates[i].Y = -1;
+	}
+	setOcclusionTest(bOcclusionTest, occlusionTolerance, cellShift);
+}
+
+bool ofxKinectDepthToColorRegistrar::isSetup() const
+{
+	return depthWidth > 0 && colorWidth > 0;
+}
+
+void ofxKinectDepthToColorRegistrar::setBilinear(bool _bBilinear)
+{
+	bBilinear = _bBilinear;
+}
+
+bool ofxKinectDepthToColorRegistrar::getBilinear() const
+{
+	return bBilinear;
+}
+
+void ofxKinectDepthToColorRegistrar::setOcclusionTest(bool bEnabled, int toleranceMillimeters, int _cellShift)
+{
+	bOcclusionTest = bEnabled;
+	occlusionTolerance = toleranceMillimeters;
+	cellShift = ofClamp(_cellShift, 0, 4);
+	zBufferWidth = (colorWidth >> cellShift) + 1;
+	zBufferHeight = (colorHeight >> cellShift) + 1;
+	zBuffer.resize(zBufferWidth * zBufferHeight);
+	if(!depth.empty())
+	{
+		updateZBuffer();
+	}
+}
+
+bool ofxKinectDepthToColorRegistrar::getOcclusionTest() const
+{
+	return bOcclusionTest;
+}
+
+const vector<ColorSpacePoint>& ofxKinectDepthToColorRegistrar::getColorCoordinates() const
+{
+	return colorCoordinates;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectDepthToColorRegistrar::mapDepthFrame(KCBHANDLE hKinect, const unsigned short* depthFrame)
+{
+#ifdef OFX_KINECT_NO_SDK
+	(void)hKinect;
+	(void)depthFrame;
+	ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "Built without the sdk, map through a coordinate mapper";
+	return false;
+#else
+	if(!isSetup())
+	{
+		ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "Call setup() first";
+		return false;
+	}
+
+	memcpy(&depth[0], depthFrame, depth.size() * sizeof(UINT16));
+
+	HRESULT hr = KCBMapDepthFrameToColorSpace(hKinect,
+		depth.size(), &depth[0],
+		colorCoordinates.size(), &colorCoordinates[0]);
+	if(FAILED(hr))
+	{
+		ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "Failed to map the depth frame to color space";
+		return false;
+	}
+
+	updateZBuffer();
+	return true;
+#endif
+}
+
+bool ofxKinectDepthToColorRegistrar::mapDepthFrame(const ofxKinectCoordinateMapper& mapper, const unsigned short* depthFrame, ofxKinectTileExecutor* executor)
+{
+	if(!isSetup())
+	{
+		ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "Call setup() first";
+		return false;
+	}
+	if(!mapper.isReady())
+	{
+		ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "The coordinate mapper has no calibration";
+		return false;
+	}
+	if(mapper.getDepthWidth() != depthWidth || mapper.getDepthHeight() != depthHeight
+		|| mapper.getColorWidth() != colorWidth || mapper.getColorHeight() != colorHeight)
+	{
+		ofLogError("ofxKinectDepthToColorRegistrar::mapDepthFrame") << "The calibration is for other frame sizes";
+		return false;
+	}
+
+	memcpy(&depth[0], depthFrame, depth.size() * sizeof(UINT16));
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(depthHeight, [&](int rowBegin, int rowEnd){
+			mapper.mapDepthFrameToColor(&depth[0], &colorCoordinates[0], rowBegin, rowEnd);
+		});
+	}
+	else
+	{
+		mapper.mapDepthFrameToColor(&depth[0], &colorCoordinates[0], 0, depthHeight);
+	}
+
+	updateZBuffer();
+	return true;
+}
+
+// nearest depth landing in each cell. every cell is written by many depth pixels in no particular
+// order, so this stays on one thread; it is a single cheap pass next to the gather
+void ofxKinectDepthToColorRegistrar::updateZBuffer()
+{
+	if(!bOcclusionTest)
+	{
+		return;
+	}
+
+	std::fill(zBuffer.begin(), zBuffer.end(), 0xFFFF);
+	for(size_t i = 0; i < depth.size(); i++)
+	{
+		const ColorSpacePoint& p = colorCoordinates[i];
+		if(depth[i] != 0 && p.X >= 0 && p.X < colorWidth && p.Y >= 0 && p.Y < colorHeight)
+		{
+			int& cell = zBuffer[((int)p.Y >> cellShift) * zBufferWidth + ((int)p.X >> cellShift)];
+			cell = MIN(cell, (int)depth[i]);
+		}
+	}
+}
+
+inline bool ofxKinectDepthToColorRegistrar::isVisible(int colorX, int colorY, int d) const
+{
+	return !bOcclusionTest || d <= zBuffer[(colorY >> cellShift) * zBufferWidth + (colorX >> cellShift)] + occlusionTolerance;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthToColorRegistrar::registerColor(const ofPixels& color, ofPixels& dst, ofxKinectTileExecutor* executor)
+{
+	if(!isSetup() || !color.isAllocated())
+	{
+		return;
+	}
+
+	if(!dst.isAllocated() || dst.getWidth() != depthWidth || dst.getHeight() != depthHeight)
+	{
+		dst.allocate(depthWidth, depthHeight, color.getNumChannels());
+	}
+
+	if(executor != NULL)
+	{
+		executor->forEachRowTile(depthHeight, [&](int rowBegin, int rowEnd){
+			registerRows(color, dst, rowBegin, rowEnd);
+		});
+	}
+	else
+	{
+		registerRows(color, dst, 0, depthHeight);
+	}
+}
+
+void ofxKinectDepthToColorRegistrar::registerRows(const ofPixels& color, ofPixels& dst, int rowBegin, int rowEnd) const
+{
+	int begin = rowBegin * depthWidth;
+	int end = rowEnd * depthWidth;
+
+	// the simd versions move whole 32 bit pixels
+	if(bBilinear || color.getNumChannels() != 4 || dst.getNumChannels() != 4)
+	{
+		registerRowsScalar(color, dst, begin, end);
+	}
+#ifdef OFX_KINECT_HAS_AVX2
+	else if(bUseAVX2)
+	{
+		registerRowsAVX2(color, dst, begin, end);
+	}
+#endif
+	else
+	{
+		registerRowsSSE2(color, dst, begin, end);
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthToColorRegistrar::registerRowsScalar(const ofPixels& color, ofPixels& dst, int begin, int end) const
+{
+	int srcChannels = color.getNumChannels();
+	int dstChannels = dst.getNumChannels();
+	int channels = MIN(srcChannels, dstChannels);
+	const unsigned char* src = color.getPixels();
+	unsigned char* out = dst.getPixels();
+
+	for(int i = begin; i < end; i++)
+	{
+		unsigned char* o = out + i * dstChannels;
+		memset(o, 0, dstChannels);
+
+		const ColorSpacePoint& p = colorCoordinates[i];
+		if(!(p.X >= 0 && p.X < colorWidth && p.Y >= 0 && p.Y < colorHeight) || !isVisible((int)p.X, (int)p.Y, depth[i]))
+		{
+			continue;
+		}
+
+		if(!bBilinear)
+		{
+			const unsigned char* s = src + ((int)p.Y * colorWidth + (int)p.X) * srcChannels;
+			for(int c = 0; c < channels; c++)
+			{
+				o[c] = s[c];
+			}
+			continue;
+		}
+
+		// pixel centers sit at +0.5, blend the four around the point in 8 bit fixed point
+		float fx = ofClamp(p.X - 0.5f, 0, colorWidth - 1);
+		float fy = ofClamp(p.Y - 0.5f, 0, colorHeight - 1);
+		int x0 = MIN((int)fx, colorWidth - 2);
+		int y0 = MIN((int)fy, colorHeight - 2);
+		int wx = (int)((fx - x0) * 256);
+		int wy = (int)((fy - y0) * 256);
+		const unsigned char* s00 = src + (y0 * colorWidth + x0) * srcChannels;
+		const unsigned char* s10 = s00 + srcChannels;
+		const unsigned char* s01 = s00 + colorWidth * srcChannels;
+		const unsigned char* s11 = s01 + srcChannels;
+		for(int c = 0; c < channels; c++)
+		{
+			int top = s00[c] * (256 - wx) + s10[c] * wx;
+			int bottom = s01[c] * (256 - wx) + s11[c] * wx;
+			o[c] = (top * (256 - wy) + bottom * wy + (1 << 15)) >> 16;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectDepthToColorRegistrar::registerRowsSSE2(const ofPixels& color, ofPixels& dst, int begin, int end) const
+{
+	const unsigned int* src = (const unsigned int*)color.getPixels();
+	unsigned int* out = (unsigned int*)dst.getPixels();
+	const float* coordinates = (const float*)&colorCoordinates[0];
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 width = _mm_set1_ps((float)colorWidth);
+	const __m128 height = _mm_set1_ps((float)colorHeight);
+	const __m128i stride = _mm_set1_epi32(colorWidth);
+
+	int i = begin;
+	for(; i + 4 <= end; i += 4)
+	{
+		// x0 y0 x1 y1 | x2 y2 x3 y3 -> x0 x1 x2 x3, y0 y1 y2 y3
+		__m128 a = _mm_loadu_ps(coordinates + i * 2);
+		__m128 b = _mm_loadu_ps(coordinates + i * 2 + 4);
+		__m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+		// unmapped pixels come back as -infinity, which fails these too
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, zero), _mm_cmplt_ps(x, width)),
+			_mm_and_ps(_mm_cmpge_ps(y, zero), _mm_cmplt_ps(y, height)));
+		int mask = _mm_movemask_ps(inside);
+
+		// 32 bit multiply of y * width, sse2 only has the unsigned 32 x 32 -> 64 form
+		__m128i ix = _mm_cvttps_epi32(_mm_and_ps(x, inside));
+		__m128i iy = _mm_cvttps_epi32(_mm_and_ps(y, inside));
+		__m128i evens = _mm_mul_epu32(iy, stride);
+		__m128i odds = _mm_mul_epu32(_mm_srli_si128(iy, 4), stride);
+		__m128i rows = _mm_unpacklo_epi32(_mm_shuffle_epi32(evens, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odds, _MM_SHUFFLE(0, 0, 2, 0)));
+
+		int index[4], px[4], py[4];
+		_mm_storeu_si128((__m128i*)index, _mm_add_epi32(rows, ix));
+		_mm_storeu_si128((__m128i*)px, ix);
+		_mm_storeu_si128((__m128i*)py, iy);
+
+		for(int k = 0; k < 4; k++)
+		{
+			bool bVisible = (mask & (1 << k)) && isVisible(px[k], py[k], depth[i + k]);
+			out[i + k] = bVisible ? src[index[k]] : 0;
+		}
+	}
+
+	registerRowsScalar(color, dst, i, end);
+}
+
+#ifdef OFX_KINECT_HAS_AVX2
+//---------------------------------------------------------------------------
+void ofxKinectDepthToColorRegistrar::registerRowsAVX2(const ofPixels& color, ofPixels& dst, int begin, int end) const
+{
+	const int* src = (const int*)color.getPixels();
+	unsigned int* out = (unsigned int*)dst.getPixels();
+	const float* coordinates = (const float*)&colorCoordinates[0];
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 width = _mm256_set1_ps((float)colorWidth);
+	const __m256 height = _mm256_set1_ps((float)colorHeight);
+	const __m256i stride = _mm256_set1_epi32(colorWidth);
+	const __m256i zStride = _mm256_set1_epi32(zBufferWidth);
+	const __m256i tolerance = _mm256_set1_epi32(occlusionTolerance);
+	const __m128i shift = _mm_cvtsi32_si128(cellShift);
+
+	int i = begin;
+	for(; i + 8 <= end; i += 8)
+	{
+		// shuffle works per 128 bit lane, the permute puts the quarters back in pixel order
+		__m256 a = _mm256_loadu_ps(coordinates + i * 2);
+		__m256 b = _mm256_loadu_ps(coordinates + i * 2 + 8);
+		__m256 x = _mm256_castsi256_ps(_mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+		__m256 y = _mm256_castsi256_ps(_mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+
+		__m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GE_OQ), _mm256_cmp_ps(x, width, _CMP_LT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_GE_OQ), _mm256_cmp_ps(y, height, _CMP_LT_OQ)));
+		__m256i visible = _mm256_castps_si256(inside);
+
+		__m256i ix = _mm256_cvttps_epi32(_mm256_and_ps(x, inside));
+		__m256i iy = _mm256_cvttps_epi32(_mm256_and_ps(y, inside));
+
+		if(bOcclusionTest)
+		{
+			__m256i d = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&depth[i]));
+			__m256i cell = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srl_epi32(iy, shift), zStride), _mm256_srl_epi32(ix, shift));
+			__m256i nearest = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), &zBuffer[0], cell, visible, 4);
+			__m256i behind = _mm256_cmpgt_epi32(d, _mm256_add_epi32(nearest, tolerance));
+			visible = _mm256_andnot_si256(behind, visible);
+		}
+
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(iy, stride), ix);
+		__m256i pixels = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), src, index, visible, 4);
+		_mm256_storeu_si256((__m256i*)(out + i), pixels);
+	}
+
+	_mm256_zeroupper();
+	registerRowsScalar(color, dst, i, end);
+}
+#endif
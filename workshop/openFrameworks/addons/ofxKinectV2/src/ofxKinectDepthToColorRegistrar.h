@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+#include "ofxKinectTileExecutor.h"
+#include "ofxKinectCoordinateMapper.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// color for every depth pixel
+//
+// keeps its buffers between frames, so registering a frame allocates nothing. the depth frame is mapped to
+// color space in one sdk call, or through a coordinate mapper's calibration without a sensor, then the
+// color is gathered row parallel: 8 pixels at a time with avx2 gathers, or simd addressing with scalar
+// loads on sse2. with the occlusion test a coarse z-buffer in color space keeps background pixels from
+// picking up the color of the foreground that hides them from the color camera; those come out black like
+// unmapped pixels.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectDepthToColorRegistrar
+{
+  public:
+	ofxKinectDepthToColorRegistrar();
+
+	void setup(int depthWidth, int depthHeight, int colorWidth, int colorHeight);
+	bool isSetup() const;
+
+	/// blend the four color pixels around each mapped point instead of taking the one it falls in
+	void setBilinear(bool bBilinear);
+	bool getBilinear() const;
+
+	/// a depth pixel is hidden when it is more than toleranceMillimeters behind the nearest depth
+	/// landing in the same cell of the z-buffer. the z-buffer is the color image shrunk by 2^cellShift
+	void setOcclusionTest(bool bEnabled, int toleranceMillimeters = 50, int cellShift = 2);
+	bool getOcclusionTest() const;
+
+	/// map a depth frame into color space, this is the only part that goes through the sdk and it fails
+	/// when built with OFX_KINECT_NO_SDK
+	bool mapDepthFrame(KCBHANDLE hKinect, const unsigned short* depth);
+	/// the same through a calibration, for recordings and backends without a sensor. executor may be NULL
+	bool mapDepthFrame(const ofxKinectCoordinateMapper& mapper, const unsigned short* depth, ofxKinectTileExecutor* executor = NULL);
+
+	/// color of every depth pixel of the last mapped frame. color can have any number of channels, dst
+	/// keeps its channels if it is already depth sized and gets the color's channels otherwise.
+	/// executor may be NULL to stay on the calling thread
+	void registerColor(const ofPixels& color, ofPixels& dst, ofxKinectTileExecutor* executor = NULL);
+
+	/// color space position of every depth pixel of the last mapped frame
+	const vector<ColorSpacePoint>& getColorCoordinates() const;
+
+  protected:
+	void updateZBuffer();
+	void registerRows(const ofPixels& color, ofPixels& dst, int rowBegin, int rowEnd) const;
+	void registerRowsScalar(const ofPixels& color, ofPixels& dst, int begin, int end) const;
+	void registerRowsSSE2(const ofPixels& color, ofPixels& dst, int begin, int end) const;
+	void registerRowsAVX2(const ofPixels& color, ofPixels& dst, int begin, int end) const;
+	bool isVisible(int colorX, int colorY, int depth) const;
+
+	int depthWidth, depthHeight;
+	int colorWidth, colorHeight;
+
+	bool bBilinear;
+	bool bOcclusionTest;
+	int occlusionTolerance;
+	int cellShift;
+	int zBufferWidth, zBufferHeight;
+
+	vector<UINT16> depth;
+	vector<ColorSpacePoint> colorCoordinates;
+	vector<int> zBuffer;
+	bool bUseAVX2;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+#include "ofxKinectFramePool.h"
+#include "ofxKinectSkeletonFrame.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// what one sensor tick hands out
+//
+// the bundle the capture thread fills and update() publishes, with the joints and skeletons copied out of
+// it. kept apart from ofxKinectCommonBridge so backends can fill bundles with only ofxKinectTypes.h behind
+// them.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// not sure this is right
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Kv2Joint
+{
+  public:
+	Kv2Joint() : type(JointType_SpineBase), trackingState(TrackingState_NotTracked) {}
+	Kv2Joint(const _Joint& kcbPosition, const _JointOrientation& kcbOrientation)
+	{
+		jointOrientation.set(kcbOrientation.Orientation.x, kcbOrientation.Orientation.y, kcbOrientation.Orientation.z, kcbOrientation.Orientation.w);
+		jointPosition.set(kcbPosition.Position.X, kcbPosition.Position.Y, kcbPosition.Position.Z);
+		type = kcbPosition.JointType;
+		trackingState = kcbPosition.TrackingState;
+	}
+	Kv2Joint(JointType _type, const ofVec3f& position, const ofQuaternion& orientation, TrackingState state)
+		: jointPosition(position), jointOrientation(orientation), type(_type), trackingState(state) {}
+
+	ofVec3f getPosition() const
+	{
+		return jointPosition;
+	}
+
+	ofQuaternion getOrientation() const
+	{
+		return jointOrientation;
+	}
+
+	JointType getType() const
+	{
+		return type;
+	}
+
+	TrackingState getTrackingState() const
+	{
+		return trackingState;
+	}
+
+  protected:
+	ofVec3f jointPosition;
+	ofQuaternion jointOrientation;
+	JointType type;
+	TrackingState trackingState;
+};
+
+// one body copied out of a Kv2SkeletonFrame, joints indexed by JointType
+class Kv2Skeleton
+{
+  public:
+	Kv2Skeleton() : tracked(false), trackingId(0) {}
+
+	bool tracked;
+	UINT64 trackingId;
+	Kv2Joint joints[JointType_Count];
+};
+
+// a KCB frame struct together with the pixels it writes into. the sensor writes
+// straight into pixels, so the slot must not be copied once allocate() was called
+template<typename KCBFrame, typename PixelType>
+class Kv2FrameSlot
+{
+  public:
+	Kv2FrameSlot()
+	{
+		memset(&frame, 0, sizeof(frame));
+	}
+
+	void allocate(int width, int height, int channels)
+	{
+		pixels.allocate(width, height, channels);
+		frame.Buffer = pixels.getPixels();
+		frame.Size = width * height * channels;
+	}
+
+	KCBFrame frame;
+	ofPixels_<PixelType> pixels;
+};
+
+typedef Kv2FrameSlot<KCBDepthFrame, unsigned short> Kv2DepthSlot;
+typedef Kv2FrameSlot<KCBInfraredFrame, unsigned short> Kv2InfraredSlot;
+typedef Kv2FrameSlot<KCBColorFrame, unsigned char> Kv2ColorSlot;
+typedef Kv2FrameSlot<KCBBodyIndexFrame, unsigned char> Kv2BodyIndexSlot;
+
+// every enabled stream from one sensor tick, published to update() as a unit so depth,
+// color, body index and bodies always belong together. timestamps are in 100ns ticks
+class Kv2FrameBundle
+{
+  public:
+	Kv2FrameBundle() : timeStamp(0), timeStampSkew(0), arrivalMicros(0), sequence(0) {}
+
+	Kv2DepthSlot depth;
+	Kv2ColorSlot color;
+	Kv2InfraredSlot infrared;
+	Kv2BodyIndexSlot bodyIndex;
+	Kv2SkeletonFrame bodies;	///< as the sensor sent them, with their own timestamp
+	Kv2SkeletonFrame filteredBodies;	///< through the bridge's joint filter
+
+	LONGLONG timeStamp;		///< earliest timestamp of the streams in the bundle
+	LONGLONG timeStampSkew;	///< latest minus earliest timestamp of the streams in the bundle
+	unsigned long long arrivalMicros;	///< ofGetElapsedTimeMicros() when the frame was ready to be picked up, from its timestamp
+	unsigned long long sequence;
+};
+
+/// keeps a bundle out of the frame pool for as long as the handle (or a copy of it) is alive
+typedef ofxKinectFrameRef<Kv2FrameBundle> Kv2FrameRef;
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// fixed size pool of frames with reference counted handles
+//
+// the capture thread acquires a free frame, has the sensor write straight into it and hands out
+// ofxKinectFrameRef handles to it. a frame only goes back to the pool once the last handle is released,
+// so consumers can keep a frame around as long as they like without copying it. acquire() never blocks,
+// it returns an empty handle when every frame is still held.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+class ofxKinectPooledFrame
+{
+  public:
+	ofxKinectPooledFrame() : refCount(0) {}
+
+	T value;
+	std::atomic<int> refCount;
+
+  private:
+	ofxKinectPooledFrame(const ofxKinectPooledFrame&);
+	ofxKinectPooledFrame& operator=(const ofxKinectPooledFrame&);
+};
+
+template<typename T>
+class ofxKinectFrameRef
+{
+  public:
+	ofxKinectFrameRef() : frame(NULL) {}
+
+	explicit ofxKinectFrameRef(ofxKinectPooledFrame<T>* adopted) : frame(adopted) {}
+
+	ofxKinectFrameRef(const ofxKinectFrameRef& other) : frame(other.frame)
+	{
+		retain();
+	}
+
+	~ofxKinectFrameRef()
+	{
+		release();
+	}
+
+	ofxKinectFrameRef& operator=(const ofxKinectFrameRef& other)
+	{
+		if(frame != other.frame)
+		{
+			release();
+			frame = other.frame;
+			retain();
+		}
+		return *this;
+	}
+
+	/// drop this handle's hold on the frame, the frame goes back to the pool with the last handle
+	void release()
+	{
+		if(frame != NULL)
+		{
+			frame->refCount.fetch_sub(1, std::memory_order_acq_rel);
+			frame = NULL;
+		}
+	}
+
+	bool isValid() const
+	{
+		return frame != NULL;
+	}
+
+	int getUseCount() const
+	{
+		return frame != NULL ? frame->refCount.load(std::memory_order_acquire) : 0;
+	}
+
+	T* get() const
+	{
+		return frame != NULL ? &frame->value : NULL;
+	}
+
+	T& operator*() const
+	{
+		return frame->value;
+	}
+
+	T* operator->() const
+	{
+		return &frame->value;
+	}
+
+  protected:
+	void retain()
+	{
+		if(frame != NULL)
+		{
+			frame->refCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	ofxKinectPooledFrame<T>* frame;
+};
+
+template<typename T>
+class ofxKinectFramePool
+{
+  public:
+	ofxKinectFramePool() {}
+
+	~ofxKinectFramePool()
+	{
+		clear();
+	}
+
+	/// not thread safe, only call while no handles are held
+	void allocate(int count)
+	{
+		clear();
+		for(int i = 0; i < count; i++)
+		{
+			frames.push_back(new ofxKinectPooledFrame<T>());
+		}
+	}
+
+	void clear()
+	{
+		for(size_t i = 0; i < frames.size(); i++)
+		{
+			delete frames[i];
+		}
+		frames.clear();
+	}
+
+	int size() const
+	{
+		return (int)frames.size();
+	}
+
+	/// direct access to every frame for allocating buffers before capture starts
+	T& operator[](int index)
+	{
+		return frames[index]->value;
+	}
+
+	/// claim a frame nobody holds, returns an empty handle if all of them are in use
+	ofxKinectFrameRef<T> acquire()
+	{
+		for(size_t i = 0; i < frames.size(); i++)
+		{
+			int expected = 0;
+			if(frames[i]->refCount.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+			{
+				return ofxKinectFrameRef<T>(frames[i]);
+			}
+		}
+		return ofxKinectFrameRef<T>();
+	}
+
+	/// number of frames currently held by at least one handle
+	int getNumInUse() const
+	{
+		int inUse = 0;
+		for(size_t i = 0; i < frames.size(); i++)
+		{
+			if(frames[i]->refCount.load(std::memory_order_relaxed) > 0)
+			{
+				inUse++;
+			}
+		}
+		return inUse;
+	}
+
+  protected:
+	std::vector<ofxKinectPooledFrame<T>*> frames;
+
+  private:
+	ofxKinectFramePool(const ofxKinectFramePool&);
+	ofxKinectFramePool& operator=(const ofxKinectFramePool&);
+};
@@ -0,0 +1,556 @@
+#include "ofxKinectGestureRecognizer.h"
+
+#include "ofxKinectPlayer.h"
+
+// a path that can't be taken, small enough that adding to it stays finite
+static const float UNREACHABLE = 1e30f;
+
+//---------------------------------------------------------------------------
+ofxKinectGestureRecognizer::Template::Template()
+	: threshold(0.15f)
+	, duration(0)
+{
+}
+
+bool ofxKinectGestureRecognizer::Template::setFromFrames(const Kv2SkeletonFrame* frames, int numFrames, UINT64 trackingId)
+{
+	features.clear();
+	duration = 0;
+	if(joints.empty())
+	{
+		ofLogError("ofxKinectGestureRecognizer::Template::setFromFrames") << "Set the joints of " << name << " first";
+		return false;
+	}
+
+	// frame by frame first, then turned around so a joint's axis is one run over the frames
+	vector<float> byFrame;
+	LONGLONG first = 0, last = 0;
+	ofVec3f bodyFeatures[Kv2SkeletonFrame::NUM_JOINTS];
+	for(int i = 0; i < numFrames; i++)
+	{
+		int body = frames[i].findBody(trackingId);
+		if(body < 0 || !getBodyFeatures(frames[i], body, bodyFeatures))
+		{
+			continue;
+		}
+		if(byFrame.empty())
+		{
+			first = frames[i].timeStamp;
+		}
+		last = frames[i].timeStamp;
+		for(size_t k = 0; k < joints.size(); k++)
+		{
+			const ofVec3f& p = bodyFeatures[joints[k]];
+			byFrame.push_back(p.x);
+			byFrame.push_back(p.y);
+			byFrame.push_back(p.z);
+		}
+	}
+
+	int width = (int)joints.size() * 3;
+	int length = (int)byFrame.size() / width;
+	if(length < 2 || last <= first)
+	{
+		ofLogError("ofxKinectGestureRecognizer::Template::setFromFrames") << "The body is tracked in " << length << " frames, " << name << " needs at least two";
+		return false;
+	}
+	features.resize(byFrame.size());
+	for(int i = 0; i < length; i++)
+	{
+		for(int k = 0; k < width; k++)
+		{
+			features[k * length + i] = byFrame[i * width + k];
+		}
+	}
+	duration = last - first;
+	return true;
+}
+
+int ofxKinectGestureRecognizer::Template::getNumFrames() const
+{
+	return joints.empty() ? 0 : (int)features.size() / ((int)joints.size() * 3);
+}
+
+//---------------------------------------------------------------------------
+ofxKinectGestureRecognizer::ofxKinectGestureRecognizer()
+	: columnSize(0)
+	, lastTimeStamp(-1)
+	, updateMicros(0)
+{
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		trackingIds[body] = 0;
+	}
+}
+
+int ofxKinectGestureRecognizer::addTemplate(const Template& gesture)
+{
+	if(gesture.getNumFrames() < 2 || gesture.duration <= 0)
+	{
+		ofLogError("ofxKinectGestureRecognizer::addTemplate") << "The template " << gesture.name << " has no frames, set it up with setFromFrames()";
+		return -1;
+	}
+	templates.push_back(gesture);
+
+	// every body's columns move with the new template, so everything in progress starts over
+	columnOffsets.resize(templates.size());
+	columnSize = 0;
+	int longest = 0;
+	for(size_t g = 0; g < templates.size(); g++)
+	{
+		columnOffsets[g] = columnSize;
+		columnSize += templates[g].getNumFrames() + 1;
+		longest = MAX(longest, templates[g].getNumFrames());
+	}
+	costs.resize(columnSize * Kv2SkeletonFrame::MAX_BODIES);
+	steps.resize(columnSize * Kv2SkeletonFrame::MAX_BODIES);
+	starts.resize(columnSize * Kv2SkeletonFrame::MAX_BODIES);
+	distances.resize(longest);
+	matches.reserve(templates.size() * Kv2SkeletonFrame::MAX_BODIES);
+	reset();
+	return (int)templates.size() - 1;
+}
+
+int ofxKinectGestureRecognizer::loadTemplate(const string& path, const string& name, const vector<JointType>& joints, int firstFrame, int lastFrame, float threshold)
+{
+	ofxKinectPlayer player;
+	if(!player.open(path))
+	{
+		ofLogError("ofxKinectGestureRecognizer::loadTemplate") << "Couldn't open " << path;
+		return -1;
+	}
+	if(!player.hasBodies())
+	{
+		ofLogError("ofxKinectGestureRecognizer::loadTemplate") << path << " doesn't have bodies";
+		return -1;
+	}
+	lastFrame = lastFrame < 0 ? player.getNumFrames() - 1 : MIN(lastFrame, player.getNumFrames() - 1);
+	if(firstFrame < 0 || firstFrame > lastFrame)
+	{
+		ofLogError("ofxKinectGestureRecognizer::loadTemplate") << "Frames " << firstFrame << " to " << lastFrame << " aren't in " << path;
+		return -1;
+	}
+
+	// the bodies of each frame the way the player hands them to the bridge
+	vector<Kv2SkeletonFrame> frames(lastFrame - firstFrame + 1);
+	unsigned int bodyCount = MIN(player.getHeader().bodyCount, (unsigned int)Kv2SkeletonFrame::MAX_BODIES);
+	for(int i = 0; i < (int)frames.size(); i++)
+	{
+		const Kv2RecordedBody* bodies = player.getBodies(firstFrame + i);
+		for(unsigned int b = 0; bodies != NULL && b < bodyCount; b++)
+		{
+			if(bodies[b].tracked != 0)
+			{
+				frames[i].setBody(b, bodies[b].trackingId != 0 ? bodies[b].trackingId : b + 1, bodies[b].joints, bodies[b].orientations);
+			}
+		}
+		frames[i].timeStamp = player.getFrameHeader(firstFrame + i).bodyTimeStamp;
+	}
+
+	UINT64 trackingId = 0;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES && trackingId == 0; body++)
+	{
+		trackingId = frames[0].tracked[body] ? frames[0].trackingIds[body] : 0;
+	}
+	if(trackingId == 0)
+	{
+		ofLogError("ofxKinectGestureRecognizer::loadTemplate") << "No body is tracked in frame " << firstFrame << " of " << path;
+		return -1;
+	}
+
+	Template gesture;
+	gesture.name = name;
+	gesture.joints = joints;
+	gesture.threshold = threshold;
+	if(!gesture.setFromFrames(&frames[0], (int)frames.size(), trackingId))
+	{
+		return -1;
+	}
+	return addTemplate(gesture);
+}
+
+void ofxKinectGestureRecognizer::clearTemplates()
+{
+	templates.clear();
+	columnOffsets.clear();
+	columnSize = 0;
+	costs.clear();
+	steps.clear();
+	starts.clear();
+	matches.clear();
+	reset();
+}
+
+int ofxKinectGestureRecognizer::getNumTemplates() const
+{
+	return (int)templates.size();
+}
+
+const ofxKinectGestureRecognizer::Template& ofxKinectGestureRecognizer::getTemplate(int gesture) const
+{
+	return templates[gesture];
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectGestureRecognizer::reset()
+{
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		trackingIds[body] = 0;
+		resetBody(body);
+	}
+	lastTimeStamp = -1;
+}
+
+void ofxKinectGestureRecognizer::resetBody(int body)
+{
+	for(size_t g = 0; g < templates.size(); g++)
+	{
+		int offset = body * columnSize + columnOffsets[g];
+		costs[offset] = 0;
+		steps[offset] = 0;
+		starts[offset] = 0;
+		for(int i = 1; i <= templates[g].getNumFrames(); i++)
+		{
+			costs[offset + i] = UNREACHABLE;
+			steps[offset + i] = 0;
+			starts[offset + i] = 0;
+		}
+	}
+}
+
+bool ofxKinectGestureRecognizer::getBodyFeatures(const Kv2SkeletonFrame& frame, int body, ofVec3f* features)
+{
+	if(!frame.tracked[body])
+	{
+		return false;
+	}
+	const ofVec3f& root = frame.positions[body][JointType_SpineShoulder];
+	float length = root.distance(frame.positions[body][JointType_SpineBase]);
+	// a spine of a few centimeters is a body the sensor lost, not a small person
+	if(length < 0.05f)
+	{
+		return false;
+	}
+	for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+	{
+		features[j] = (frame.positions[body][j] - root) / length;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+int ofxKinectGestureRecognizer::update(const Kv2SkeletonFrame& frame)
+{
+	matches.clear();
+	if(frame.timeStamp == lastTimeStamp)
+	{
+		return 0;
+	}
+	lastTimeStamp = frame.timeStamp;
+	unsigned long long start = ofGetElapsedTimeMicros();
+
+	ofVec3f features[Kv2SkeletonFrame::NUM_JOINTS];
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		UINT64 trackingId = frame.tracked[body] ? frame.trackingIds[body] : 0;
+		if(trackingId != trackingIds[body])
+		{
+			trackingIds[body] = trackingId;
+			resetBody(body);
+		}
+		if(trackingId == 0 || !getBodyFeatures(frame, body, features))
+		{
+			continue;
+		}
+
+		for(size_t g = 0; g < templates.size(); g++)
+		{
+			const Template& gesture = templates[g];
+			int length = gesture.getNumFrames();
+			int offset = body * columnSize + columnOffsets[g];
+			float* cost = &costs[offset];
+			float* step = &steps[offset];
+			LONGLONG* from = &starts[offset];
+
+			// the frame's distance to every template frame, one joint axis at a time so the loops vectorize
+			float* distance = &distances[0];
+			for(int i = 0; i < length; i++)
+			{
+				distance[i] = 0;
+			}
+			for(size_t k = 0; k < gesture.joints.size(); k++)
+			{
+				const ofVec3f& p = features[gesture.joints[k]];
+				const float* x = &gesture.features[(k * 3 + 0) * length];
+				const float* y = &gesture.features[(k * 3 + 1) * length];
+				const float* z = &gesture.features[(k * 3 + 2) * length];
+				for(int i = 0; i < length; i++)
+				{
+					float dx = p.x - x[i], dy = p.y - y[i], dz = p.z - z[i];
+					distance[i] += dx * dx + dy * dy + dz * dz;
+				}
+			}
+			// root mean square over the joints, so thresholds don't depend on how many there are
+			float inverseJoints = 1.0f / gesture.joints.size();
+			for(int i = 0; i < length; i++)
+			{
+				distance[i] = sqrtf(distance[i] * inverseJoints);
+			}
+
+			// row 0 is a path starting on this frame. each row takes the cheapest of the row below on this
+			// frame, itself on the last frame and the row below on the last frame. which one wins is random,
+			// so it is picked with selects rather than branches
+			from[0] = frame.timeStamp;
+			float diagonalCost = 0, diagonalStep = 0;
+			LONGLONG diagonalFrom = frame.timeStamp;
+			float belowCost = 0, belowStep = 0;
+			LONGLONG belowFrom = frame.timeStamp;
+			for(int i = 1; i <= length; i++)
+			{
+				float lastCost = cost[i], lastStep = step[i];
+				LONGLONG lastFrom = from[i];
+
+				bool bBelow = belowCost < diagonalCost;
+				float bestCost = bBelow ? belowCost : diagonalCost;
+				float bestStep = bBelow ? belowStep : diagonalStep;
+				LONGLONG bestFrom = bBelow ? belowFrom : diagonalFrom;
+				bool bLast = lastCost < bestCost;
+				bestCost = bLast ? lastCost : bestCost;
+				bestStep = bLast ? lastStep : bestStep;
+				bestFrom = bLast ? lastFrom : bestFrom;
+
+				belowCost = cost[i] = MIN(bestCost + distance[i - 1], UNREACHABLE);
+				belowStep = step[i] = bestStep + 1;
+				belowFrom = from[i] = bestFrom;
+
+				diagonalCost = lastCost;
+				diagonalStep = lastStep;
+				diagonalFrom = lastFrom;
+			}
+
+			// the whole template matched up to this frame, and the body is where it ends. without the last
+			// check a slow performance is reported early, warping the rest of the template onto one frame
+			if(cost[length] >= UNREACHABLE || distance[length - 1] >= gesture.threshold)
+			{
+				continue;
+			}
+			float meanCost = cost[length] / step[length];
+			LONGLONG took = frame.timeStamp - from[length];
+			if(meanCost < gesture.threshold && took * 2 >= gesture.duration && took <= gesture.duration * 2)
+			{
+				Match match;
+				match.gesture = (int)g;
+				match.body = body;
+				match.trackingId = trackingId;
+				match.cost = meanCost;
+				match.startTimeStamp = from[length];
+				match.endTimeStamp = frame.timeStamp;
+				matches.push_back(match);
+
+				for(int i = 1; i <= length; i++)
+				{
+					cost[i] = UNREACHABLE;
+				}
+			}
+		}
+	}
+
+	float micros = (float)(ofGetElapsedTimeMicros() - start);
+	updateMicros = updateMicros == 0 ? micros : updateMicros * 0.9f + micros * 0.1f;
+	return (int)matches.size();
+}
+
+const vector<ofxKinectGestureRecognizer::Match>& ofxKinectGestureRecognizer::getMatches() const
+{
+	return matches;
+}
+
+float ofxKinectGestureRecognizer::getUpdateMicros() const
+{
+	return updateMicros;
+}
+
+//---------------------------------------------------------------------------
+static float uniform(unsigned int& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / 16777216.0f;
+}
+
+static float noise(unsigned int& seed)
+{
+	// the sum of four uniform numbers is close enough to normal, unit variance
+	float sum = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		sum += uniform(seed);
+	}
+	return (sum - 2.0f) * 1.7320508f;
+}
+
+// a benchmark gesture moves both hands and the right elbow from rest along sines, in spine lengths
+class ofxKinectBenchmarkGesture
+{
+  public:
+	void setRandom(unsigned int& seed)
+	{
+		numFrames = 20 + (int)(uniform(seed) * 25);
+		for(int k = 0; k < 9; k++)
+		{
+			amplitude[k] = 0.2f + uniform(seed) * 0.5f;
+			frequency[k] = 0.5f + uniform(seed);
+			phase[k] = uniform(seed) * TWO_PI;
+		}
+	}
+
+	ofVec3f getOffset(int joint, float progress) const
+	{
+		float offset[3];
+		for(int axis = 0; axis < 3; axis++)
+		{
+			int k = joint * 3 + axis;
+			offset[axis] = amplitude[k] * (sinf(TWO_PI * frequency[k] * progress + phase[k]) - sinf(phase[k]));
+		}
+		return ofVec3f(offset[0], offset[1], offset[2]);
+	}
+
+	int numFrames;
+	float amplitude[9], frequency[9], phase[9];
+};
+
+static const JointType benchmarkJoints[3] = { JointType_HandLeft, JointType_HandRight, JointType_ElbowRight };
+
+static void setBenchmarkBody(Kv2SkeletonFrame& frame, int body, const ofxKinectBenchmarkGesture* gesture, float progress, float sigma, unsigned int& seed)
+{
+	// a spine half a meter long, every other joint somewhere around the shoulders
+	ofVec3f root(body * 0.6f - 1.5f, 0.2f, 2.5f);
+	frame.tracked[body] = true;
+	frame.trackingIds[body] = body + 1;
+	for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+	{
+		frame.positions[body][j] = root + ofVec3f((j % 5) * 0.1f - 0.2f, (j / 5) * -0.1f, 0);
+		frame.trackingStates[body][j] = TrackingState_Tracked;
+	}
+	frame.positions[body][JointType_SpineShoulder] = root;
+	frame.positions[body][JointType_SpineBase] = root - ofVec3f(0, 0.5f, 0);
+	for(int k = 0; k < 3 && gesture != NULL; k++)
+	{
+		frame.positions[body][benchmarkJoints[k]] += gesture->getOffset(k, progress) * 0.5f;
+	}
+	for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+	{
+		frame.positions[body][j] += ofVec3f(noise(seed), noise(seed), noise(seed)) * sigma;
+	}
+}
+
+void ofxKinectGestureRecognizer::benchmark(int numTemplates, int numFrames)
+{
+	const float sigma = 0.01f;
+	unsigned int seed = 7;
+
+	// the templates recorded clean, at 30hz
+	vector<ofxKinectBenchmarkGesture> gestures(numTemplates);
+	ofxKinectGestureRecognizer recognizer;
+	for(int g = 0; g < numTemplates; g++)
+	{
+		gestures[g].setRandom(seed);
+		vector<Kv2SkeletonFrame> frames(gestures[g].numFrames);
+		for(int i = 0; i < gestures[g].numFrames; i++)
+		{
+			frames[i].timeStamp = (LONGLONG)i * 333333;
+			setBenchmarkBody(frames[i], 0, &gestures[g], i / (float)(gestures[g].numFrames - 1), 0, seed);
+		}
+		Template gesture;
+		gesture.name = "gesture " + ofToString(g);
+		gesture.joints.assign(benchmarkJoints, benchmarkJoints + 3);
+		gesture.setFromFrames(&frames[0], (int)frames.size(), 1);
+		recognizer.addTemplate(gesture);
+	}
+
+	// every body rests a while, then performs a random gesture at three quarters to four thirds of its speed
+	struct Performance
+	{
+		int gesture;
+		int frame;
+		int numFrames;
+		bool bRecognized;
+	};
+	Performance current[Kv2SkeletonFrame::MAX_BODIES], last[Kv2SkeletonFrame::MAX_BODIES];
+	int resting[Kv2SkeletonFrame::MAX_BODIES], lastEnd[Kv2SkeletonFrame::MAX_BODIES];
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		current[body].gesture = last[body].gesture = -1;
+		resting[body] = 10 + body * 7;
+		lastEnd[body] = -1000;
+	}
+
+	Kv2SkeletonFrame frame;
+	int performances = 0, hits = 0, mistakes = 0;
+	unsigned long long micros = 0, worst = 0;
+	for(int n = 0; n < numFrames; n++)
+	{
+		frame.timeStamp = (LONGLONG)n * 333333;
+		for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+		{
+			Performance& performance = current[body];
+			if(performance.gesture < 0 && --resting[body] <= 0)
+			{
+				performance.gesture = (int)(uniform(seed) * numTemplates) % numTemplates;
+				float speed = 0.75f + uniform(seed) * 0.58f;
+				performance.numFrames = MAX(2, (int)(gestures[performance.gesture].numFrames / speed + 0.5f));
+				performance.frame = 0;
+				performance.bRecognized = false;
+				performances++;
+			}
+			if(performance.gesture < 0)
+			{
+				setBenchmarkBody(frame, body, NULL, 0, sigma, seed);
+				continue;
+			}
+			setBenchmarkBody(frame, body, &gestures[performance.gesture], performance.frame / (float)(performance.numFrames - 1), sigma, seed);
+			if(++performance.frame == performance.numFrames)
+			{
+				last[body] = performance;
+				lastEnd[body] = n;
+				performance.gesture = -1;
+				resting[body] = 20 + (int)(uniform(seed) * 40);
+			}
+		}
+
+		unsigned long long start = ofGetElapsedTimeMicros();
+		recognizer.update(frame);
+		unsigned long long took = ofGetElapsedTimeMicros() - start;
+		micros += took;
+		worst = MAX(worst, took);
+
+		// right once per performance, while its last quarter is being performed or just after
+		const vector<Match>& found = recognizer.getMatches();
+		for(size_t m = 0; m < found.size(); m++)
+		{
+			int body = found[m].body;
+			Performance* performance = NULL;
+			if(current[body].gesture == found[m].gesture && current[body].frame * 4 >= current[body].numFrames * 3)
+			{
+				performance = &current[body];
+			}
+			else if(last[body].gesture == found[m].gesture && n - lastEnd[body] <= 5)
+			{
+				performance = &last[body];
+			}
+			if(performance != NULL && !performance->bRecognized)
+			{
+				performance->bRecognized = true;
+				hits++;
+			}
+			else
+			{
+				mistakes++;
+			}
+		}
+	}
+
+	ofLogNotice("ofxKinectGestureRecognizer::benchmark") << micros / (float)numFrames << " us/frame (worst " << worst << " us) for "
+		<< numTemplates << " templates x " << (int)Kv2SkeletonFrame::MAX_BODIES << " bodies, " << hits << " of " << performances
+		<< " performances recognized, " << mistakes << " mistaken";
+}
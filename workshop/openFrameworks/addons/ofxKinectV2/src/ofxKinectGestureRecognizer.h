@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectSkeletonFrame.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// dynamic gestures by streaming dynamic time warping
+//
+// a gesture is a recorded sequence of a few joints, taken relative to the spine shoulder and divided by
+// the length of the spine so people of any size and place in the room match the same template. every
+// body keeps one column of warping costs per template, which each frame moves on by one in place: the
+// cost of a template frame is its distance to the new body frame plus the cheapest of the three ways
+// there, and the first row costs nothing, so a gesture can start on any frame (subsequence dtw, as in
+// sakurai's spring). a frame is O(templates x template length) and nothing is recomputed or buffered, a
+// gesture is reported on the frame its end matches: when the frame is within the template's threshold
+// of its last frame, the cost per step of the whole path is below it too and the path took between half
+// and twice the recorded time. that template's column then starts over, so one performance is reported
+// once.
+//
+// feed it from the render thread, e.g. if(kinect.isNewSkeleton()) gestures.update(kinect.getSkeletonFrame());
+// frames update() never saw are simply warped over. templates are added before update() is called, the
+// columns are allocated then and a frame allocates nothing.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectGestureRecognizer
+{
+  public:
+	class Template
+	{
+	  public:
+		Template();
+
+		/// the joints of a tracked body over a run of frames, frames without it are skipped. false if it isn't
+		/// in at least two
+		bool setFromFrames(const Kv2SkeletonFrame* frames, int numFrames, UINT64 trackingId);
+		int getNumFrames() const;
+
+		string name;
+		vector<JointType> joints;	///< the joints the gesture is made with, set before setFromFrames()
+		float threshold;			///< spine lengths per joint per step, the mean cost to report a match below
+		LONGLONG duration;			///< 100ns ticks from the first frame to the last
+		vector<float> features;		///< joint x axis major, getNumFrames() long each
+	};
+
+	class Match
+	{
+	  public:
+		int gesture;
+		int body;
+		UINT64 trackingId;
+		float cost;				///< per joint per step, in spine lengths
+		LONGLONG startTimeStamp;
+		LONGLONG endTimeStamp;
+	};
+
+	ofxKinectGestureRecognizer();
+
+	/// returns the new gesture's index, -1 if the template has no frames or joints
+	int addTemplate(const Template& gesture);
+	/// a gesture recorded with ofxKinectRecorder, the body that is tracked in firstFrame and the frames up to
+	/// lastFrame, -1 for the end of the recording
+	int loadTemplate(const string& path, const string& name, const vector<JointType>& joints, int firstFrame = 0, int lastFrame = -1, float threshold = 0.15f);
+	void clearTemplates();
+	int getNumTemplates() const;
+	const Template& getTemplate(int gesture) const;
+
+	/// forget every performance in progress
+	void reset();
+	/// moves every body's costs on by the frame, returns the number of gestures that ended on it
+	int update(const Kv2SkeletonFrame& frame);
+	/// the gestures that ended on the last frame update() was given
+	const vector<Match>& getMatches() const;
+	/// time update() took, smoothed over frames
+	float getUpdateMicros() const;
+
+	/// times update() with a hundred templates of three joints over six bodies that perform them faster and
+	/// slower than recorded with sensor noise, and logs how many were recognized and how many were mistaken
+	static void benchmark(int numTemplates = 100, int numFrames = 3000);
+
+  protected:
+	/// the features of every joint of a body, relative to the spine shoulder and in spine lengths
+	static bool getBodyFeatures(const Kv2SkeletonFrame& frame, int body, ofVec3f* features);
+	void resetBody(int body);
+
+	vector<Template> templates;
+	vector<int> columnOffsets;		///< where each template's columns start, numFrames + 1 per body
+	int columnSize;					///< all templates' columns of one body
+
+	// per body, columnSize long
+	vector<float> costs;			///< the cheapest path to each template frame
+	vector<float> steps;			///< the length of that path
+	vector<LONGLONG> starts;		///< the timestamp it started on
+	UINT64 trackingIds[Kv2SkeletonFrame::MAX_BODIES];
+
+	vector<float> distances;		///< one template's distances to the frame
+	vector<Match> matches;
+	LONGLONG lastTimeStamp;
+	float updateMicros;
+};
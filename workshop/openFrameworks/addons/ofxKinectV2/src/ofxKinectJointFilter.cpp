@@ -0,0 +1,571 @@
+#include "ofxKinectJointFilter.h"
+
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#endif
+
+//---------------------------------------------------------------------------
+// the lane kernels are written once against these, masks are all ones or all zeros per lane
+struct ScalarLanes
+{
+	enum { WIDTH = 1 };
+	typedef float V;
+	typedef bool M;
+
+	static V load(const float* p) { return *p; }
+	static void store(float* p, V v) { *p = v; }
+	static V set(float f) { return f; }
+	static V add(V a, V b) { return a + b; }
+	static V sub(V a, V b) { return a - b; }
+	static V mul(V a, V b) { return a * b; }
+	static V div(V a, V b) { return a / b; }
+	static V sqrt(V a) { return sqrtf(a); }
+	static V min(V a, V b) { return a < b ? a : b; }
+	static V max(V a, V b) { return a > b ? a : b; }
+	static M less(V a, V b) { return a < b; }
+	static M lessEqual(V a, V b) { return a <= b; }
+	static M greater(V a, V b) { return a > b; }
+	static M equal(V a, V b) { return a == b; }
+	static V select(M m, V a, V b) { return m ? a : b; }
+};
+
+struct SSE2Lanes
+{
+	enum { WIDTH = 4 };
+	typedef __m128 V;
+	typedef __m128 M;
+
+	static V load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+	static V set(float f) { return _mm_set1_ps(f); }
+	static V add(V a, V b) { return _mm_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm_div_ps(a, b); }
+	static V sqrt(V a) { return _mm_sqrt_ps(a); }
+	static V min(V a, V b) { return _mm_min_ps(a, b); }
+	static V max(V a, V b) { return _mm_max_ps(a, b); }
+	static M less(V a, V b) { return _mm_cmplt_ps(a, b); }
+	static M lessEqual(V a, V b) { return _mm_cmple_ps(a, b); }
+	static M greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+	static M equal(V a, V b) { return _mm_cmpeq_ps(a, b); }
+	static V select(M m, V a, V b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+
+#ifdef OFX_KINECT_HAS_AVX2
+struct AVX2Lanes
+{
+	enum { WIDTH = 8 };
+	typedef __m256 V;
+	typedef __m256 M;
+
+	static V load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+	static V set(float f) { return _mm256_set1_ps(f); }
+	static V add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V div(V a, V b) { return _mm256_div_ps(a, b); }
+	static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static V min(V a, V b) { return _mm256_min_ps(a, b); }
+	static V max(V a, V b) { return _mm256_max_ps(a, b); }
+	static M less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static M lessEqual(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static M greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static M equal(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	static V select(M m, V a, V b) { return _mm256_blendv_ps(b, a, m); }
+};
+#endif
+
+//---------------------------------------------------------------------------
+// a + (b - a) * t
+template<typename L>
+static inline typename L::V lerpLanes(typename L::V a, typename L::V b, typename L::V t)
+{
+	return L::add(a, L::mul(L::sub(b, a), t));
+}
+
+template<typename L>
+static inline typename L::V lengthLanes(const typename L::V* v)
+{
+	return L::sqrt(L::add(L::add(L::mul(v[0], v[0]), L::mul(v[1], v[1])), L::mul(v[2], v[2])));
+}
+
+// one frame of the frames counter, back to 0 where the lane has no joint
+template<typename L>
+static inline void countFrame(ofxKinectJointFilter::Bank& bank, int i, typename L::V frames)
+{
+	typename L::M valid = L::greater(L::load(bank.valid + i), L::set(0.5f));
+	L::store(bank.frames + i, L::select(valid, L::min(L::add(frames, L::set(1)), L::set(2)), L::set(0)));
+}
+
+//---------------------------------------------------------------------------
+// slerp from the last orientation towards the new one, the shorter way round. the weights are eberly's
+// polynomials in the cosine of the angle ("a fast and accurate algorithm for computing slerp"), within a
+// few float ulps of sin((1 - t) a) / sin(a) and sin(t a) / sin(a)
+template<typename L>
+static void orientationLanes(ofxKinectJointFilter::Bank& bank, const ofxKinectJointFilter::Constants& constants)
+{
+	typedef typename L::V V;
+	typedef typename L::M M;
+
+	static const float mu = 1.85298109240830f;
+	static const float u[8] = { 1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9), 1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), mu / (8 * 17) };
+	static const float v[8] = { 1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9, 5.0f / 11, 6.0f / 13, 7.0f / 15, mu * 8 / 17 };
+
+	const float t = constants.orientationWeight;
+	const float d = 1 - t;
+	const V zero = L::set(0), one = L::set(1);
+
+	for(int i = 0; i < ofxKinectJointFilter::NUM_PADDED_LANES; i += L::WIDTH)
+	{
+		V from[4], to[4];
+		for(int c = 0; c < 4; c++)
+		{
+			from[c] = L::load(bank.orientation[c] + i);
+			to[c] = L::load(bank.orientationInput[c] + i);
+		}
+		V cosine = L::add(L::add(L::mul(from[0], to[0]), L::mul(from[1], to[1])), L::add(L::mul(from[2], to[2]), L::mul(from[3], to[3])));
+		M flip = L::less(cosine, zero);
+		cosine = L::select(flip, L::sub(zero, cosine), cosine);
+		V xm1 = L::sub(cosine, one);
+
+		V toWeight = one, fromWeight = one;
+		for(int k = 7; k >= 0; k--)
+		{
+			toWeight = L::add(one, L::mul(L::mul(L::set(u[k] * t * t - v[k]), xm1), toWeight));
+			fromWeight = L::add(one, L::mul(L::mul(L::set(u[k] * d * d - v[k]), xm1), fromWeight));
+		}
+		toWeight = L::mul(L::set(t), toWeight);
+		fromWeight = L::mul(L::set(d), fromWeight);
+		toWeight = L::select(flip, L::sub(zero, toWeight), toWeight);
+
+		// a lane starting over takes the new orientation as it is
+		M first = L::equal(L::load(bank.frames + i), zero);
+		for(int c = 0; c < 4; c++)
+		{
+			V q = L::add(L::mul(from[c], fromWeight), L::mul(to[c], toWeight));
+			L::store(bank.orientation[c] + i, L::select(first, to[c], q));
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+// holt double exponential smoothing, as in the sdk samples' joint filter
+template<typename L>
+static void holtLanes(ofxKinectJointFilter::Bank& bank, const ofxKinectJointFilter::Constants& constants)
+{
+	typedef typename L::V V;
+	typedef typename L::M M;
+
+	const ofxKinectJointFilter::HoltParameters& p = constants.holt;
+	const V zero = L::set(0), one = L::set(1), half = L::set(0.5f), tiny = L::set(1e-6f);
+	const V smoothing = L::set(p.smoothing);
+	const V correction = L::set(p.correction);
+	const V prediction = L::set(p.prediction);
+
+	for(int i = 0; i < ofxKinectJointFilter::NUM_PADDED_LANES; i += L::WIDTH)
+	{
+		V frames = L::load(bank.frames + i);
+		M first = L::equal(frames, zero);
+		M second = L::equal(frames, one);
+		V scale = L::load(bank.radiusScale + i);
+		V jitterRadius = L::mul(L::set(p.jitterRadius), scale);
+		V maxDeviation = L::mul(L::set(p.maxDeviationRadius), scale);
+
+		V input[3], previous[3], lastFiltered[3], lastTrend[3], difference[3];
+		for(int c = 0; c < 3; c++)
+		{
+			input[c] = L::load(bank.input[c] + i);
+			previous[c] = L::load(bank.previous[c] + i);
+			lastFiltered[c] = L::load(bank.filtered[c] + i);
+			lastTrend[c] = L::load(bank.trend[c] + i);
+			difference[c] = L::sub(input[c], lastFiltered[c]);
+		}
+
+		// moves inside the jitter radius only count as far as they reach out of it
+		V distance = lengthLanes<L>(difference);
+		M jitter = L::lessEqual(distance, jitterRadius);
+		V jitterWeight = L::div(distance, jitterRadius);
+
+		V filtered[3], trend[3], predicted[3];
+		for(int c = 0; c < 3; c++)
+		{
+			// the second frame starts from the mean of the first two
+			V secondFiltered = L::mul(L::add(input[c], previous[c]), half);
+			V secondTrend = lerpLanes<L>(lastTrend[c], L::sub(secondFiltered, lastFiltered[c]), correction);
+
+			V dejittered = L::select(jitter, lerpLanes<L>(lastFiltered[c], input[c], jitterWeight), input[c]);
+			V smoothed = lerpLanes<L>(dejittered, L::add(lastFiltered[c], lastTrend[c]), smoothing);
+			V smoothedTrend = lerpLanes<L>(lastTrend[c], L::sub(smoothed, lastFiltered[c]), correction);
+
+			filtered[c] = L::select(first, input[c], L::select(second, secondFiltered, smoothed));
+			trend[c] = L::select(first, zero, L::select(second, secondTrend, smoothedTrend));
+			predicted[c] = L::add(filtered[c], L::mul(trend[c], prediction));
+			difference[c] = L::sub(predicted[c], input[c]);
+		}
+
+		// predictions too far from the raw joint are pulled back towards it
+		distance = lengthLanes<L>(difference);
+		M deviating = L::greater(distance, maxDeviation);
+		V deviationWeight = L::div(maxDeviation, L::max(distance, tiny));
+		for(int c = 0; c < 3; c++)
+		{
+			V output = L::select(deviating, lerpLanes<L>(input[c], predicted[c], deviationWeight), predicted[c]);
+			L::store(bank.output[c] + i, output);
+			L::store(bank.previous[c] + i, input[c]);
+			L::store(bank.filtered[c] + i, filtered[c]);
+			L::store(bank.trend[c] + i, trend[c]);
+		}
+		countFrame<L>(bank, i, frames);
+	}
+}
+
+//---------------------------------------------------------------------------
+// the one euro filter, per joint on the length of its velocity
+template<typename L>
+static void oneEuroLanes(ofxKinectJointFilter::Bank& bank, const ofxKinectJointFilter::Constants& constants)
+{
+	typedef typename L::V V;
+	typedef typename L::M M;
+
+	const ofxKinectJointFilter::OneEuroParameters& p = constants.oneEuro;
+	const float seconds = constants.seconds;
+	// a low pass at cutoff over one frame weighs the new value by 1 / (1 + 1 / (2 pi cutoff seconds))
+	const float speedWeight = 1.0f / (1.0f + 1.0f / (float)(TWO_PI * p.derivativeCutoff * seconds));
+	const V zero = L::set(0), one = L::set(1);
+	const V rate = L::set(1.0f / seconds);
+	const V speedAlpha = L::set(speedWeight);
+	const V minCutoff = L::set((float)(TWO_PI * p.minCutoff * seconds));
+	const V beta = L::set((float)(TWO_PI * p.beta * seconds));
+
+	for(int i = 0; i < ofxKinectJointFilter::NUM_PADDED_LANES; i += L::WIDTH)
+	{
+		V frames = L::load(bank.frames + i);
+		M first = L::equal(frames, zero);
+
+		V input[3], lastFiltered[3], velocity[3];
+		for(int c = 0; c < 3; c++)
+		{
+			input[c] = L::load(bank.input[c] + i);
+			lastFiltered[c] = L::load(bank.filtered[c] + i);
+			V lastVelocity = L::load(bank.trend[c] + i);
+			velocity[c] = L::select(first, zero, lerpLanes<L>(lastVelocity, L::mul(L::sub(input[c], lastFiltered[c]), rate), speedAlpha));
+		}
+
+		// the cutoff, already times 2 pi seconds, rises with the smoothed speed
+		V cutoff = L::add(minCutoff, L::mul(beta, lengthLanes<L>(velocity)));
+		V alpha = L::div(cutoff, L::add(cutoff, one));
+		for(int c = 0; c < 3; c++)
+		{
+			V filtered = L::select(first, input[c], lerpLanes<L>(lastFiltered[c], input[c], alpha));
+			L::store(bank.output[c] + i, filtered);
+			L::store(bank.previous[c] + i, input[c]);
+			L::store(bank.filtered[c] + i, filtered);
+			L::store(bank.trend[c] + i, velocity[c]);
+		}
+		countFrame<L>(bank, i, frames);
+	}
+}
+
+//---------------------------------------------------------------------------
+// indexed by Isa, then orientations followed by the positions of each Method - 1
+static const ofxKinectJointFilter::LaneFunction laneKernels[3][3] = {
+	{ orientationLanes<ScalarLanes>, holtLanes<ScalarLanes>, oneEuroLanes<ScalarLanes> },
+	{ orientationLanes<SSE2Lanes>, holtLanes<SSE2Lanes>, oneEuroLanes<SSE2Lanes> },
+#ifdef OFX_KINECT_HAS_AVX2
+	{ orientationLanes<AVX2Lanes>, holtLanes<AVX2Lanes>, oneEuroLanes<AVX2Lanes> }
+#else
+	{ orientationLanes<SSE2Lanes>, holtLanes<SSE2Lanes>, oneEuroLanes<SSE2Lanes> }
+#endif
+};
+
+//---------------------------------------------------------------------------
+// the defaults of the sdk samples' joint filter
+ofxKinectJointFilter::HoltParameters::HoltParameters()
+	: smoothing(0.25f)
+	, correction(0.25f)
+	, prediction(0.25f)
+	, jitterRadius(0.03f)
+	, maxDeviationRadius(0.05f)
+{
+}
+
+ofxKinectJointFilter::OneEuroParameters::OneEuroParameters()
+	: minCutoff(1.0f)
+	, beta(20.0f)
+	, derivativeCutoff(1.0f)
+{
+}
+
+//---------------------------------------------------------------------------
+ofxKinectJointFilter::ofxKinectJointFilter()
+	: method(METHOD_HOLT)
+	, orientationSmoothing(0.5f)
+	, isa(ofxKinectDepthKernel::getBestSupportedIsa())
+	, applyMicros(0)
+{
+	memset(&bank, 0, sizeof(bank));
+	reset();
+}
+
+void ofxKinectJointFilter::setMethod(Method _method)
+{
+	method = _method;
+	reset();
+}
+
+ofxKinectJointFilter::Method ofxKinectJointFilter::getMethod() const
+{
+	return method;
+}
+
+void ofxKinectJointFilter::setHoltParameters(const HoltParameters& parameters)
+{
+	holt = parameters;
+	// the jitter weight divides by the radius, a tenth of a millimeter is as good as none
+	holt.jitterRadius = MAX(holt.jitterRadius, 0.0001f);
+}
+
+const ofxKinectJointFilter::HoltParameters& ofxKinectJointFilter::getHoltParameters() const
+{
+	return holt;
+}
+
+void ofxKinectJointFilter::setOneEuroParameters(const OneEuroParameters& parameters)
+{
+	oneEuro = parameters;
+}
+
+const ofxKinectJointFilter::OneEuroParameters& ofxKinectJointFilter::getOneEuroParameters() const
+{
+	return oneEuro;
+}
+
+void ofxKinectJointFilter::setOrientationSmoothing(float smoothing)
+{
+	orientationSmoothing = ofClamp(smoothing, 0, 0.99f);
+}
+
+float ofxKinectJointFilter::getOrientationSmoothing() const
+{
+	return orientationSmoothing;
+}
+
+void ofxKinectJointFilter::setIsa(ofxKinectDepthKernel::Isa requested)
+{
+	isa = (ofxKinectDepthKernel::Isa)MIN((int)requested, (int)ofxKinectDepthKernel::getBestSupportedIsa());
+}
+
+ofxKinectDepthKernel::Isa ofxKinectJointFilter::getIsa() const
+{
+	return isa;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectJointFilter::reset()
+{
+	for(int i = 0; i < NUM_PADDED_LANES; i++)
+	{
+		bank.frames[i] = 0;
+	}
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		trackingIds[body] = 0;
+	}
+	lastTimeStamp = 0;
+	bStarted = false;
+	filtered.clear();
+}
+
+//---------------------------------------------------------------------------
+const Kv2SkeletonFrame& ofxKinectJointFilter::apply(const Kv2SkeletonFrame& frame)
+{
+	if(bStarted && frame.timeStamp == lastTimeStamp)
+	{
+		return filtered;
+	}
+	unsigned long long start = ofGetElapsedTimeMicros();
+
+	// a recording that looped or a gap of seconds, nothing carries over
+	float seconds = (frame.timeStamp - lastTimeStamp) / 10000000.0f;
+	if(bStarted && (seconds <= 0 || seconds > 1.0f))
+	{
+		reset();
+	}
+	if(!bStarted)
+	{
+		seconds = 1.0f / 30.0f;
+	}
+	bStarted = true;
+	lastTimeStamp = frame.timeStamp;
+
+	filtered = frame;
+	if(method == METHOD_NONE)
+	{
+		return filtered;
+	}
+
+	// into the lanes
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		bool bNewBody = frame.trackingIds[body] != trackingIds[body];
+		trackingIds[body] = frame.tracked[body] ? frame.trackingIds[body] : 0;
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			int lane = body * Kv2SkeletonFrame::NUM_JOINTS + j;
+			TrackingState state = frame.trackingStates[body][j];
+			bool bValid = frame.tracked[body] && state != TrackingState_NotTracked;
+			const ofVec3f& position = frame.positions[body][j];
+			bank.input[0][lane] = position.x;
+			bank.input[1][lane] = position.y;
+			bank.input[2][lane] = position.z;
+			const ofQuaternion& orientation = frame.orientations[body][j];
+			bank.orientationInput[0][lane] = orientation.x();
+			bank.orientationInput[1][lane] = orientation.y();
+			bank.orientationInput[2][lane] = orientation.z();
+			bank.orientationInput[3][lane] = orientation.w();
+			bank.valid[lane] = bValid ? 1.0f : 0.0f;
+			bank.radiusScale[lane] = state == TrackingState_Inferred ? 2.0f : 1.0f;
+			if(bNewBody || !bValid)
+			{
+				bank.frames[lane] = 0;
+			}
+		}
+	}
+	for(int lane = NUM_LANES; lane < NUM_PADDED_LANES; lane++)
+	{
+		bank.radiusScale[lane] = 1.0f;
+	}
+
+	// the orientations go first, the positions count the frames they start over by
+	Constants constants;
+	constants.holt = holt;
+	constants.oneEuro = oneEuro;
+	constants.seconds = seconds;
+	constants.orientationWeight = 1.0f - orientationSmoothing;
+	laneKernels[isa][0](bank, constants);
+	laneKernels[isa][method](bank, constants);
+
+	// out of the lanes, joints without a reading keep the sensor's
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			int lane = body * Kv2SkeletonFrame::NUM_JOINTS + j;
+			if(bank.valid[lane] != 0)
+			{
+				filtered.positions[body][j].set(bank.output[0][lane], bank.output[1][lane], bank.output[2][lane]);
+				filtered.orientations[body][j].set(bank.orientation[0][lane], bank.orientation[1][lane], bank.orientation[2][lane], bank.orientation[3][lane]);
+			}
+		}
+	}
+
+	float micros = ofGetElapsedTimeMicros() - start;
+	applyMicros = applyMicros == 0 ? micros : applyMicros * 0.9f + micros * 0.1f;
+	return filtered;
+}
+
+const Kv2SkeletonFrame& ofxKinectJointFilter::getFiltered() const
+{
+	return filtered;
+}
+
+float ofxKinectJointFilter::getApplyMicros() const
+{
+	return applyMicros;
+}
+
+//---------------------------------------------------------------------------
+// the same noise on every run
+static float noise(unsigned int& seed)
+{
+	// the sum of four uniform numbers is close enough to normal, unit variance
+	float sum = 0;
+	for(int i = 0; i < 4; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		sum += (seed >> 8) / 16777216.0f;
+	}
+	return (sum - 2.0f) * 1.7320508f;
+}
+
+void ofxKinectJointFilter::benchmark(int iterations)
+{
+	const float sigma = 0.005f;
+	const int warmup = 30;
+	const int numIsas = (int)ofxKinectDepthKernel::getBestSupportedIsa() + 1;
+
+	for(int m = METHOD_HOLT; m <= METHOD_ONE_EURO; m++)
+	{
+		vector<float> reference;
+		for(int i = 0; i < numIsas; i++)
+		{
+			ofxKinectJointFilter filter;
+			filter.setIsa((ofxKinectDepthKernel::Isa)i);
+			filter.setMethod((Method)m);
+
+			Kv2SkeletonFrame frame;
+			unsigned int seed = 1;
+			double rawError[2] = { 0, 0 }, filteredError[2] = { 0, 0 };
+			unsigned long long micros = 0;
+			vector<float> result;
+			for(int n = 0; n < iterations; n++)
+			{
+				// six people, every other one standing still, the rest swaying 15cm at half a hertz
+				frame.timeStamp = (LONGLONG)n * 333333;
+				float seconds = n / 30.0f;
+				ofVec3f truth[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];
+				for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+				{
+					frame.tracked[body] = true;
+					frame.trackingIds[body] = body + 1;
+					float sway = (body % 2) * 0.15f;
+					for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+					{
+						float phase = seconds * TWO_PI * 0.5f + j * 0.2f;
+						truth[body][j].set(body * 0.3f - 0.75f + sinf(phase) * sway, j * 0.07f - 0.8f, 2.5f + cosf(phase) * sway);
+						frame.positions[body][j] = truth[body][j] + ofVec3f(noise(seed), noise(seed), noise(seed)) * sigma;
+						frame.orientations[body][j].makeRotate(phase * RAD_TO_DEG + noise(seed) * 3, ofVec3f(0.3f, 1, 0.1f));
+						frame.trackingStates[body][j] = (j % 7 == 6) ? TrackingState_Inferred : TrackingState_Tracked;
+					}
+				}
+
+				unsigned long long start = ofGetElapsedTimeMicros();
+				const Kv2SkeletonFrame& out = filter.apply(frame);
+				micros += ofGetElapsedTimeMicros() - start;
+
+				for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES && n >= warmup; body++)
+				{
+					for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+					{
+						rawError[body % 2] += frame.positions[body][j].squareDistance(truth[body][j]);
+						filteredError[body % 2] += out.positions[body][j].squareDistance(truth[body][j]);
+						const ofVec4f& q = out.orientations[body][j].asVec4();
+						float values[7] = { out.positions[body][j].x, out.positions[body][j].y, out.positions[body][j].z, q.x, q.y, q.z, q.w };
+						result.insert(result.end(), values, values + 7);
+					}
+				}
+			}
+
+			float difference = 0;
+			if(i == 0)
+			{
+				reference = result;
+			}
+			for(size_t k = 0; k < result.size() && k < reference.size(); k++)
+			{
+				difference = MAX(difference, fabsf(result[k] - reference[k]));
+			}
+			ofLogNotice("ofxKinectJointFilter::benchmark") << (m == METHOD_HOLT ? "holt" : "one euro") << " " << ofxKinectDepthKernel::getIsaName((ofxKinectDepthKernel::Isa)i)
+				<< ": " << micros / (float)iterations << " us/frame for " << NUM_LANES << " joints, noise left standing "
+				<< sqrt(filteredError[0] / rawError[0]) * 100 << "%, swaying " << sqrt(filteredError[1] / rawError[1]) * 100
+				<< "% (lag included), " << difference << " from scalar at most";
+		}
+	}
+}
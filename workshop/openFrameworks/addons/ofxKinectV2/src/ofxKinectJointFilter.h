@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectDepthKernel.h"
+#include "ofxKinectSkeletonFrame.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// joint smoothing for every body at once
+//
+// the positions of all BODY_COUNT x JointType_Count joints are one bank of lanes, kept as separate x, y
+// and z arrays, so a frame is filtered a vector of lanes at a time on scalar, sse2 or avx2 code built from
+// the same template. a lane's branches become masks, which keeps every lane on the same instructions.
+//
+// holt is the double exponential filter of the sdk samples: jitter below a radius is damped, the trend
+// predicts ahead and the prediction is pulled back within a radius of the raw joint; inferred joints get
+// twice the radii. one euro is a low pass whose cutoff rises with the joint's speed, so slow motion is
+// smooth and fast motion keeps up, run off the frame timestamps. orientations are slerped a fixed part of
+// the way towards the sensor's every frame, in the lanes as well, with eberly's polynomial slerp, which
+// needs no trigonometry. a body's lanes start over when its slot gets a new tracking id, a joint's when
+// it isn't tracked.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectJointFilter
+{
+  public:
+	enum Method
+	{
+		METHOD_NONE,
+		METHOD_HOLT,
+		METHOD_ONE_EURO
+	};
+
+	class HoltParameters
+	{
+	  public:
+		HoltParameters();
+
+		float smoothing;			///< [0..1], lower follows the raw joints closer
+		float correction;			///< [0..1], lower corrects the trend towards the raw joints slower
+		float prediction;			///< frames to predict ahead
+		float jitterRadius;			///< meters, moves below it are damped
+		float maxDeviationRadius;	///< meters, the furthest a prediction may stray from the raw joint
+	};
+
+	class OneEuroParameters
+	{
+	  public:
+		OneEuroParameters();
+
+		float minCutoff;			///< hz, the cutoff of a joint at rest, lower is smoother
+		float beta;					///< hz per meter per second the cutoff rises with speed, higher lags less
+		float derivativeCutoff;		///< hz, of the low pass on the speed estimate
+	};
+
+	ofxKinectJointFilter();
+
+	/// starts over from the next frame
+	void setMethod(Method method);
+	Method getMethod() const;
+	void setHoltParameters(const HoltParameters& parameters);
+	const HoltParameters& getHoltParameters() const;
+	void setOneEuroParameters(const OneEuroParameters& parameters);
+	const OneEuroParameters& getOneEuroParameters() const;
+	/// 0 hands the sensor's orientations through, towards 1 each frame only slerps a little way to them
+	void setOrientationSmoothing(float smoothing);
+	float getOrientationSmoothing() const;
+
+	/// use a slower instruction set than the cpu supports, e.g. to compare them
+	void setIsa(ofxKinectDepthKernel::Isa isa);
+	ofxKinectDepthKernel::Isa getIsa() const;
+
+	/// forget every body
+	void reset();
+	/// filters a frame newer than the last one and returns the result, an older frame starts over and the
+	/// same frame again returns the last result
+	const Kv2SkeletonFrame& apply(const Kv2SkeletonFrame& frame);
+	const Kv2SkeletonFrame& getFiltered() const;
+	/// time apply() took, smoothed over frames
+	float getApplyMicros() const;
+
+	/// times both methods on every supported instruction set over six bodies with sensor noise, half of
+	/// them swaying, logs the time per frame and how much of the noise is left, and checks the instruction
+	/// sets agree
+	static void benchmark(int iterations = 2000);
+
+	enum
+	{
+		NUM_LANES = Kv2SkeletonFrame::MAX_BODIES * Kv2SkeletonFrame::NUM_JOINTS,
+		NUM_PADDED_LANES = (NUM_LANES + 7) & ~7	///< whole avx2 vectors
+	};
+
+	// one x, y, z array each, NUM_PADDED_LANES long
+	struct Bank
+	{
+		float input[3][NUM_PADDED_LANES];	///< this frame's joints
+		float previous[3][NUM_PADDED_LANES];	///< the last frame's
+		float filtered[3][NUM_PADDED_LANES];
+		float trend[3][NUM_PADDED_LANES];	///< the holt trend, the one euro speed
+		float output[3][NUM_PADDED_LANES];
+		float orientationInput[4][NUM_PADDED_LANES];	///< x, y, z, w
+		float orientation[4][NUM_PADDED_LANES];
+		float frames[NUM_PADDED_LANES];		///< frames since the lane started over, 0 to 2
+		float valid[NUM_PADDED_LANES];		///< 1 for a lane with a joint this frame
+		float radiusScale[NUM_PADDED_LANES];	///< 2 for inferred joints
+	};
+
+	// per frame constants of the lane kernels
+	struct Constants
+	{
+		HoltParameters holt;
+		OneEuroParameters oneEuro;
+		float seconds;
+		float orientationWeight;	///< how far to slerp towards the sensor's orientations
+	};
+
+	typedef void (*LaneFunction)(Bank& bank, const Constants& constants);
+
+  protected:
+	Method method;
+	HoltParameters holt;
+	OneEuroParameters oneEuro;
+	float orientationSmoothing;
+	ofxKinectDepthKernel::Isa isa;
+
+	Bank bank;
+	UINT64 trackingIds[Kv2SkeletonFrame::MAX_BODIES];
+	LONGLONG lastTimeStamp;
+	bool bStarted;
+	Kv2SkeletonFrame filtered;
+	float applyMicros;
+};
@@ -0,0 +1,383 @@
+#include "ofxKinectJointHistory.h"
+
+//---------------------------------------------------------------------------
+ofxKinectJointHistory::ofxKinectJointHistory()
+{
+	reset();
+}
+
+void ofxKinectJointHistory::reset()
+{
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		tracks[body].sequence.store(0);
+		tracks[body].trackingId.store(0);
+		tracks[body].first.store(0);
+		tracks[body].count.store(0);
+	}
+	lastTimeStamp = -1;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectJointHistory::push(const Kv2SkeletonFrame& frame)
+{
+	if(frame.timeStamp == lastTimeStamp)
+	{
+		return;
+	}
+	lastTimeStamp = frame.timeStamp;
+
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		Track& track = tracks[body];
+		unsigned int count = track.count.load(std::memory_order_relaxed);
+		UINT64 trackingId = frame.tracked[body] ? frame.trackingIds[body] : 0;
+		bool bNewBody = trackingId != track.trackingId.load(std::memory_order_relaxed);
+		if(!bNewBody && trackingId == 0)
+		{
+			continue;
+		}
+
+		// the fence keeps the writes below from being seen before the odd sequence
+		unsigned int sequence = track.sequence.load(std::memory_order_relaxed);
+		track.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		// a new body starts from the next sample
+		if(bNewBody)
+		{
+			track.first.store(count, std::memory_order_relaxed);
+			track.trackingId.store(trackingId, std::memory_order_relaxed);
+		}
+		if(trackingId != 0)
+		{
+			Sample& sample = track.samples[count % CAPACITY];
+			sample.timeStamp = frame.timeStamp;
+			for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+			{
+				sample.positions[j] = frame.positions[body][j];
+				sample.trackingStates[j] = frame.trackingStates[body][j];
+			}
+			track.count.store(count + 1, std::memory_order_relaxed);
+		}
+
+		track.sequence.store(sequence + 2, std::memory_order_release);
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectJointHistory::hasBody(UINT64 trackingId) const
+{
+	return getNumSamples(trackingId) > 0;
+}
+
+int ofxKinectJointHistory::getNumSamples(UINT64 trackingId) const
+{
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES && trackingId != 0; body++)
+	{
+		const Track& track = tracks[body];
+		if(track.trackingId.load(std::memory_order_relaxed) != trackingId)
+		{
+			continue;
+		}
+
+		// the same seqlock as read(), so the count and first are of one body
+		for(int attempt = 0; attempt < 16; attempt++)
+		{
+			unsigned int sequence = track.sequence.load(std::memory_order_acquire);
+			if(sequence & 1)
+			{
+				continue;
+			}
+			bool bSameBody = track.trackingId.load(std::memory_order_relaxed) == trackingId;
+			unsigned int count = track.count.load(std::memory_order_relaxed);
+			unsigned int first = track.first.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(track.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				return bSameBody ? (int)MIN(count - first, (unsigned int)CAPACITY) : 0;
+			}
+		}
+		return 0;
+	}
+	return 0;
+}
+
+int ofxKinectJointHistory::read(UINT64 trackingId, int joint, float millis, ofVec3f* positions, LONGLONG* timeStamps, int maxSamples) const
+{
+	if(trackingId == 0 || joint < 0 || joint >= Kv2SkeletonFrame::NUM_JOINTS || maxSamples <= 0)
+	{
+		return 0;
+	}
+
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		const Track& track = tracks[body];
+		if(track.trackingId.load(std::memory_order_relaxed) != trackingId)
+		{
+			continue;
+		}
+
+		// a push to the slot while copying only costs another try
+		for(int attempt = 0; attempt < 16; attempt++)
+		{
+			unsigned int sequence = track.sequence.load(std::memory_order_acquire);
+			if(sequence & 1)
+			{
+				continue;
+			}
+			if(track.trackingId.load(std::memory_order_relaxed) != trackingId)
+			{
+				return 0;
+			}
+			unsigned int count = track.count.load(std::memory_order_relaxed);
+			unsigned int available = MIN(count - track.first.load(std::memory_order_relaxed), (unsigned int)CAPACITY);
+			if(available == 0)
+			{
+				return 0;
+			}
+
+			// walk back over the window, then copy it oldest first
+			LONGLONG newest = track.samples[(count - 1) % CAPACITY].timeStamp;
+			LONGLONG oldest = millis > 0 ? newest - (LONGLONG)(millis * 10000) : newest - 1;
+			unsigned int start = count;
+			int numTracked = 0;
+			while(start > count - available && numTracked < maxSamples)
+			{
+				const Sample& sample = track.samples[(start - 1) % CAPACITY];
+				if(millis > 0 && sample.timeStamp < oldest)
+				{
+					break;
+				}
+				start--;
+				numTracked += sample.trackingStates[joint] != TrackingState_NotTracked ? 1 : 0;
+			}
+
+			int numCopied = 0;
+			for(unsigned int i = start; i != count && numCopied < maxSamples; i++)
+			{
+				const Sample& sample = track.samples[i % CAPACITY];
+				if(sample.trackingStates[joint] == TrackingState_NotTracked)
+				{
+					continue;
+				}
+				positions[numCopied] = sample.positions[joint];
+				if(timeStamps != NULL)
+				{
+					timeStamps[numCopied] = sample.timeStamp;
+				}
+				numCopied++;
+			}
+
+			// the fence keeps the copies above from being read after the sequence
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(track.sequence.load(std::memory_order_relaxed) == sequence)
+			{
+				return numCopied;
+			}
+		}
+		return 0;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+int ofxKinectJointHistory::getPositions(UINT64 trackingId, JointType joint, float millis, ofVec3f* positions, int maxSamples, LONGLONG* timeStamps) const
+{
+	return read(trackingId, joint, millis, positions, timeStamps, maxSamples);
+}
+
+bool ofxKinectJointHistory::getVelocity(UINT64 trackingId, JointType joint, ofVec3f& velocity, float millis) const
+{
+	ofVec3f positions[CAPACITY];
+	LONGLONG timeStamps[CAPACITY];
+	int n = read(trackingId, joint, millis, positions, timeStamps, CAPACITY);
+	if(n < 2)
+	{
+		return false;
+	}
+
+	// the slope of the line through the samples, times about their middle keep the sums small
+	double meanTime = 0;
+	ofVec3f meanPosition;
+	for(int i = 0; i < n; i++)
+	{
+		meanTime += (timeStamps[i] - timeStamps[n - 1]) / 10000000.0;
+		meanPosition += positions[i];
+	}
+	meanTime /= n;
+	meanPosition /= (float)n;
+
+	double times = 0, x = 0, y = 0, z = 0;
+	for(int i = 0; i < n; i++)
+	{
+		double t = (timeStamps[i] - timeStamps[n - 1]) / 10000000.0 - meanTime;
+		ofVec3f p = positions[i] - meanPosition;
+		times += t * t;
+		x += t * p.x;
+		y += t * p.y;
+		z += t * p.z;
+	}
+	if(times <= 0)
+	{
+		return false;
+	}
+	velocity.set((float)(x / times), (float)(y / times), (float)(z / times));
+	return true;
+}
+
+bool ofxKinectJointHistory::getAcceleration(UINT64 trackingId, JointType joint, ofVec3f& acceleration, float millis) const
+{
+	ofVec3f positions[CAPACITY];
+	LONGLONG timeStamps[CAPACITY];
+	int n = read(trackingId, joint, millis, positions, timeStamps, CAPACITY);
+	if(n < 3)
+	{
+		return false;
+	}
+
+	// p = a + b t + c t^2 by the normal equations, the acceleration is 2c
+	double middle = (timeStamps[0] + timeStamps[n - 1]) / 2.0;
+	double s[5] = { 0, 0, 0, 0, 0 };
+	double r[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	for(int i = 0; i < n; i++)
+	{
+		double t = (timeStamps[i] - middle) / 10000000.0;
+		double powers[5] = { 1, t, t * t, t * t * t, t * t * t * t };
+		for(int k = 0; k < 5; k++)
+		{
+			s[k] += powers[k];
+		}
+		for(int k = 0; k < 3; k++)
+		{
+			r[k][0] += powers[k] * positions[i].x;
+			r[k][1] += powers[k] * positions[i].y;
+			r[k][2] += powers[k] * positions[i].z;
+		}
+	}
+
+	// cramer's rule for the t^2 coefficient of [s0 s1 s2; s1 s2 s3; s2 s3 s4]
+	double determinant = s[0] * (s[2] * s[4] - s[3] * s[3]) - s[1] * (s[1] * s[4] - s[2] * s[3]) + s[2] * (s[1] * s[3] - s[2] * s[2]);
+	if(fabs(determinant) < 1e-18)
+	{
+		return false;
+	}
+	double c[3];
+	for(int axis = 0; axis < 3; axis++)
+	{
+		c[axis] = (s[0] * (s[2] * r[2][axis] - r[1][axis] * s[3]) - s[1] * (s[1] * r[2][axis] - r[1][axis] * s[2])
+			+ r[0][axis] * (s[1] * s[3] - s[2] * s[2])) / determinant;
+	}
+	acceleration.set((float)(2 * c[0]), (float)(2 * c[1]), (float)(2 * c[2]));
+	return true;
+}
+
+float ofxKinectJointHistory::getPathLength(UINT64 trackingId, JointType joint, float millis) const
+{
+	ofVec3f positions[CAPACITY];
+	int n = read(trackingId, joint, millis, positions, NULL, CAPACITY);
+	float length = 0;
+	for(int i = 1; i < n; i++)
+	{
+		length += positions[i].distance(positions[i - 1]);
+	}
+	return length;
+}
+
+//---------------------------------------------------------------------------
+// frame n of the benchmark has every joint at x = n % 4096, so a reader can tell a torn sample
+class ofxKinectJointHistoryWriter : public ofThread
+{
+  public:
+	ofxKinectJointHistoryWriter(ofxKinectJointHistory& _history) : history(_history), pushes(0), micros(0) {}
+
+	void threadedFunction()
+	{
+		Kv2SkeletonFrame frame;
+		for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+		{
+			frame.tracked[body] = true;
+			frame.trackingIds[body] = body + 1;
+			for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+			{
+				frame.trackingStates[body][j] = TrackingState_Tracked;
+			}
+		}
+		for(int n = 1; isThreadRunning(); n++)
+		{
+			frame.timeStamp = (LONGLONG)n * 333333;
+			for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+			{
+				for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+				{
+					frame.positions[body][j].set((float)(n % 4096), (float)j, (float)body);
+				}
+			}
+			unsigned long long start = ofGetElapsedTimeMicros();
+			history.push(frame);
+			micros += ofGetElapsedTimeMicros() - start;
+			pushes++;
+		}
+	}
+
+	ofxKinectJointHistory& history;
+	unsigned long long pushes;
+	unsigned long long micros;
+};
+
+void ofxKinectJointHistory::benchmark(int iterations)
+{
+	ofxKinectJointHistory* history = new ofxKinectJointHistory();
+	ofxKinectJointHistoryWriter writer(*history);
+	writer.startThread(false, false);
+	while(history->getNumSamples(Kv2SkeletonFrame::MAX_BODIES) < CAPACITY)
+	{
+		ofSleepMillis(1);
+	}
+
+	ofVec3f positions[CAPACITY];
+	LONGLONG timeStamps[CAPACITY];
+	int torn = 0, empty = 0;
+	unsigned long long micros = 0;
+	for(int n = 0; n < iterations; n++)
+	{
+		UINT64 trackingId = n % Kv2SkeletonFrame::MAX_BODIES + 1;
+		unsigned long long start = ofGetElapsedTimeMicros();
+		int count = history->getPositions(trackingId, JointType_HandRight, 1000, positions, CAPACITY, timeStamps);
+		micros += ofGetElapsedTimeMicros() - start;
+
+		empty += count == 0 ? 1 : 0;
+		for(int i = 0; i < count; i++)
+		{
+			LONGLONG frame = timeStamps[i] / 333333;
+			if(positions[i].x != (float)(frame % 4096) || positions[i].y != (float)JointType_HandRight || positions[i].z != (float)(trackingId - 1))
+			{
+				torn++;
+			}
+		}
+	}
+	writer.waitForThread(true);
+	ofLogNotice("ofxKinectJointHistory::benchmark") << "push " << writer.micros / (float)MAX(writer.pushes, 1ULL) << " us over "
+		<< writer.pushes << " frames, a second of one joint " << micros / (float)iterations << " us, " << torn << " torn and "
+		<< empty << " empty of " << iterations << " reads";
+
+	// x at 0.5 m/s, y falling at 9.81 m/s^2, 30 frames
+	history->reset();
+	Kv2SkeletonFrame frame;
+	frame.tracked[0] = true;
+	frame.trackingIds[0] = 7;
+	frame.trackingStates[0][JointType_Head] = TrackingState_Tracked;
+	for(int n = 0; n < 30; n++)
+	{
+		float t = n / 30.0f;
+		frame.timeStamp = (LONGLONG)n * 333333;
+		frame.positions[0][JointType_Head].set(0.5f * t, 1.5f - 0.5f * 9.81f * t * t, 2);
+		history->push(frame);
+	}
+	ofVec3f velocity, acceleration;
+	history->getVelocity(7, JointType_Head, velocity, 100);
+	history->getAcceleration(7, JointType_Head, acceleration, 1000);
+	ofLogNotice("ofxKinectJointHistory::benchmark") << "velocity x " << velocity.x << " m/s (0.5), acceleration y " << acceleration.y
+		<< " m/s^2 (-9.81), path over 500ms " << history->getPathLength(7, JointType_Head, 500) << " m";
+	delete history;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+
+#include "ofMain.h"
+
+#include "ofxKinectSkeletonFrame.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the last few seconds of every tracked body, for trails, velocities and gestures
+//
+// each body slot has a ring of CAPACITY samples, a timestamp and all joints of one frame each, which the
+// capture thread writes and any thread reads without a lock. the slot is a seqlock: the writer makes its
+// sequence odd before it touches the slot and even again after, a reader copies what it asks for and
+// tries again if the sequence changed meanwhile, and a body that was replaced reads as gone. nothing is
+// allocated, queries copy into the caller's arrays or answer from a copy on the stack.
+//
+// bodies are looked up by tracking id, a slot starts a new history when it gets a new one. a joint's
+// queries skip the samples it wasn't tracked in. times are in milliseconds back from a body's newest
+// sample, 0 or less asks for everything kept.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectJointHistory
+{
+  public:
+	enum
+	{
+		CAPACITY = 128	///< samples per body, about four seconds at 30hz
+	};
+
+	ofxKinectJointHistory();
+
+	/// forget every body, only while nothing is pushing
+	void reset();
+	/// writer side, from one thread only: the bodies of a frame, the same frame again is ignored
+	void push(const Kv2SkeletonFrame& frame);
+
+	bool hasBody(UINT64 trackingId) const;
+	/// samples kept of the body, 0 if it isn't tracked
+	int getNumSamples(UINT64 trackingId) const;
+
+	/// the joint's positions over the last millis, oldest first, with their timestamps if asked for. returns
+	/// how many were copied, at most maxSamples
+	int getPositions(UINT64 trackingId, JointType joint, float millis, ofVec3f* positions, int maxSamples, LONGLONG* timeStamps = NULL) const;
+	/// meters per second, a least squares line through the last millis. false with fewer than two samples
+	bool getVelocity(UINT64 trackingId, JointType joint, ofVec3f& velocity, float millis = 100) const;
+	/// meters per second squared, a least squares parabola through the last millis. false with fewer than
+	/// three samples
+	bool getAcceleration(UINT64 trackingId, JointType joint, ofVec3f& acceleration, float millis = 250) const;
+	/// meters the joint moved over the last millis
+	float getPathLength(UINT64 trackingId, JointType joint, float millis) const;
+
+	/// has a thread push frames at full speed while this one queries, logs the time of each and checks no
+	/// query ever sees a sample half written, then checks velocity and acceleration on a known path
+	static void benchmark(int iterations = 100000);
+
+  protected:
+	struct Sample
+	{
+		LONGLONG timeStamp;
+		ofVec3f positions[Kv2SkeletonFrame::NUM_JOINTS];
+		TrackingState trackingStates[Kv2SkeletonFrame::NUM_JOINTS];
+	};
+
+	// a body slot's ring, count and first only grow
+	struct Track
+	{
+		std::atomic<unsigned int> sequence;	///< odd while push() writes the slot
+		std::atomic<UINT64> trackingId;	///< 0 while the slot has no body
+		std::atomic<unsigned int> first;	///< the count when the body took the slot
+		std::atomic<unsigned int> count;	///< samples written since the start
+		Sample samples[CAPACITY];
+	};
+
+	/// copies the joint's samples over the last millis into the arrays, oldest first
+	int read(UINT64 trackingId, int joint, float millis, ofVec3f* positions, LONGLONG* timeStamps, int maxSamples) const;
+
+	Track tracks[Kv2SkeletonFrame::MAX_BODIES];
+	LONGLONG lastTimeStamp;
+};
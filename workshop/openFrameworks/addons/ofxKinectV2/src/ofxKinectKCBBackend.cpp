@@ -0,0 +1,169 @@
+#include "ofxKinectKCBBackend.h"
+#include "ofxKinectCommonBridge.h"
+
+#ifndef OFX_KINECT_NO_SDK
+
+//---------------------------------------------------------------------------
+ofxKinectKCBBackend::ofxKinectKCBBackend()
+{
+	hKinect = NULL;
+	pBodyFrame = NULL;
+}
+
+ofxKinectKCBBackend::~ofxKinectKCBBackend()
+{
+	close();
+}
+
+bool ofxKinectKCBBackend::open()
+{
+	if(hKinect == NULL)
+	{
+		hKinect = KCBOpenDefaultSensor();
+	}
+	if(hKinect == NULL)
+	{
+		ofLogError("ofxKinectKCBBackend::open") << "No sensor";
+		return false;
+	}
+	return true;
+}
+
+void ofxKinectKCBBackend::close()
+{
+	if(hKinect != NULL)
+	{
+		KCBCloseSensor(&hKinect);
+		hKinect = NULL;
+	}
+
+	// image frames live in the bundles, only the body frame belongs to KCB
+	if(pBodyFrame != NULL)
+	{
+		KCBReleaseBodyFrame(&pBodyFrame);
+		pBodyFrame = NULL;
+	}
+}
+
+bool ofxKinectKCBBackend::isOpen() const
+{
+	return hKinect != NULL;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectKCBBackend::getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description)
+{
+	HRESULT hr = E_FAIL;
+	switch(stream)
+	{
+		case KV2_STREAM_DEPTH: hr = KCBGetDepthFrameDescription(hKinect, &description); break;
+		case KV2_STREAM_INFRARED: hr = KCBGetInfraredFrameDescription(hKinect, &description); break;
+		case KV2_STREAM_COLOR: hr = KCBGetColorFrameDescription(hKinect, ColorImageFormat_Rgba, &description); break;
+		case KV2_STREAM_BODY_INDEX: hr = KCBGetBodyIndexFrameDescription(hKinect, &description); break;
+		default: break;
+	}
+	return SUCCEEDED(hr);
+}
+
+bool ofxKinectKCBBackend::openBodyStream()
+{
+	if(pBodyFrame != NULL)
+	{
+		return true;
+	}
+	HRESULT hr = KCBCreateBodyFrame(&pBodyFrame);
+	if(FAILED(hr))
+	{
+		ofLogError("ofxKinectKCBBackend::openBodyStream") << "Cannot create the body frame";
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+float ofxKinectKCBBackend::getFramePeriodMicros() const
+{
+	return 1000000.0f / 30.0f;
+}
+
+bool ofxKinectKCBBackend::isFrameReady()
+{
+	return KCBMultiFrameReady(hKinect);
+}
+
+bool ofxKinectKCBBackend::readFrame(Kv2FrameBundle& bundle, unsigned int streamMask, bool bBodies)
+{
+	// one call fetches every enabled stream from the multi source reader
+	HRESULT hr = KCBGetAllFrameData(hKinect,
+		bBodies ? pBodyFrame : NULL,
+		(streamMask & (1 << KV2_STREAM_BODY_INDEX)) != 0 ? &bundle.bodyIndex.frame : NULL,
+		(streamMask & (1 << KV2_STREAM_COLOR)) != 0 ? &bundle.color.frame : NULL,
+		(streamMask & (1 << KV2_STREAM_DEPTH)) != 0 ? &bundle.depth.frame : NULL,
+		(streamMask & (1 << KV2_STREAM_INFRARED)) != 0 ? &bundle.infrared.frame : NULL,
+		NULL);
+
+	if(FAILED(hr))
+	{
+		return false;
+	}
+
+	if(bBodies && pBodyFrame != NULL)
+	{
+		updateSkeletons(pBodyFrame->Bodies, bundle.bodies);
+		bundle.bodies.timeStamp = pBodyFrame->TimeStamp;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectKCBBackend::setupDepthProjector(ofxKinectDepthProjector& projector, int width, int height)
+{
+	return hKinect != NULL && projector.setup(hKinect, width, height);
+}
+
+KCBHANDLE ofxKinectKCBBackend::getHandle() const
+{
+	return hKinect;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectKCBBackend::updateSkeletons(IBody** ppBodies, Kv2SkeletonFrame& bodies)
+{
+	for (int i = 0; i < BODY_COUNT; ++i)
+	{
+		bodies.setUntracked(i);
+
+		IBody *pBody = ppBodies[i];
+		BOOLEAN isTracked = false;
+
+		if (pBody == NULL)
+		{
+			continue;
+		}
+
+		HRESULT hr = pBody->get_IsTracked(&isTracked);
+		if (SUCCEEDED(hr) && isTracked)
+		{
+			HRESULT hrJoints = pBody->GetJoints(JointType_Count, joints);
+			HRESULT hrOrient = pBody->GetJointOrientations(JointType_Count, jointOrients);
+			if (FAILED(hrJoints))
+			{
+				ofLogError("ofxKinectKCBBackend::updateSkeletons") << "Failed to get joints";
+			}
+
+			if (FAILED(hrOrient))
+			{
+				ofLogError("ofxKinectKCBBackend::updateSkeletons") << "Failed to get orientations";
+			}
+
+			// a body without joints stays untracked rather than publishing the previous frame's joints
+			UINT64 trackingId = 0;
+			if (SUCCEEDED(hrJoints) && SUCCEEDED(hrOrient) && SUCCEEDED(pBody->get_TrackingId(&trackingId)))
+			{
+				bodies.setBody(i, trackingId, joints, jointOrients);
+			}
+		}
+	}
+}
+
+#endif
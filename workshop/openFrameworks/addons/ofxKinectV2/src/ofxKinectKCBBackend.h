@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ofxKinectSensorBackend.h"
+
+#ifndef OFX_KINECT_NO_SDK
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the default sensor through the common bridge library
+//
+// every enabled stream comes out of one KCBGetAllFrameData() call on the multi source reader, written
+// straight into the bundle's slots. the body frame keeps its IBody objects alive between frames so the
+// reader can refresh them in place, and the bodies are copied into the bundle's skeleton frame. left out
+// of builds with OFX_KINECT_NO_SDK.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectKCBBackend : public ofxKinectSensorBackend
+{
+  public:
+	ofxKinectKCBBackend();
+	~ofxKinectKCBBackend();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	bool getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description);
+	bool openBodyStream();
+
+	float getFramePeriodMicros() const;
+	bool isFrameReady();
+	bool readFrame(Kv2FrameBundle& bundle, unsigned int streamMask, bool bBodies);
+
+	bool setupDepthProjector(ofxKinectDepthProjector& projector, int width, int height);
+	KCBHANDLE getHandle() const;
+
+  protected:
+	void updateSkeletons(IBody** ppBodies, Kv2SkeletonFrame& bodies);
+
+	KCBHANDLE hKinect;
+	KCBBodyFrame* pBodyFrame;
+
+	JointOrientation jointOrients[JointType_Count];
+	Joint joints[JointType_Count];
+};
+
+#endif
@@ -0,0 +1,575 @@
+#include "ofxKinectLossyDepthCodec.h"
+#include "ofxKinectDepthCodec.h"
+
+#include <emmintrin.h>
+
+namespace
+{
+	// a frame starts with this and the curve it was quantized with, then a 4 bit mode per block, then
+	// the blocks: a 32 bit mask of the pixels without a reading if the mode has HOLES, then the residuals
+	struct Header
+	{
+		char magic[4];
+		unsigned short width;
+		unsigned short height;
+		float minError;
+		float relativeError;
+		float quadraticError;
+		unsigned short maxDepth;
+		unsigned short reserved;
+		unsigned int dataSize;
+	};
+
+	const int BLOCK_SIZE = 32;
+	const int MODE_COUNT = 6;
+	// bits per value of each block mode
+	const int MODE_BITS[MODE_COUNT] = { 0, 1, 2, 4, 8, 16 };
+	// or'ed into the mode of a block with holes in it
+	const int HOLES = 8;
+
+	const float MAX_BOUND = 2047;
+
+	inline int getBlocksPerRow(int width)
+	{
+		return (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	}
+
+	inline unsigned int getModesSize(int width, int height)
+	{
+		return (getBlocksPerRow(width) * height + 1) / 2;
+	}
+
+	// the difference to the row above modulo 2^16 folded onto 0, 1, 2... for -0, -1, +1...
+	inline unsigned short mapResidual(int level, int up)
+	{
+		int residual = (short)(level - up);
+		return (unsigned short)(((unsigned int)residual << 1) ^ (unsigned int)(residual >> 31));
+	}
+
+	inline unsigned int getBlockSize(int mode)
+	{
+		return MODE_BITS[mode & 7] * BLOCK_SIZE / 8 + ((mode & HOLES) != 0 ? sizeof(unsigned int) : 0);
+	}
+
+	inline int getMode(unsigned short largest)
+	{
+		return largest == 0 ? 0 : largest < 2 ? 1 : largest < 4 ? 2 : largest < 16 ? 3 : largest < 256 ? 4 : 5;
+	}
+
+	// the layouts keep the values a vector unpacks together in the same bit positions of neighbouring
+	// bytes: at 2 bits byte j holds values j, j + 8, j + 16 and j + 24, at 4 bits values j and j + 16.
+	// at 1 bit byte k holds values 8k to 8k + 7, which are unpacked like the hole mask
+	unsigned char* packBlock(const unsigned short* residuals, int mode, unsigned char* p)
+	{
+		switch(mode)
+		{
+			case 1:
+			{
+				unsigned int bits = 0;
+				for(int j = 0; j < BLOCK_SIZE; j++)
+				{
+					bits |= (unsigned int)residuals[j] << j;
+				}
+				memcpy(p, &bits, sizeof(unsigned int));
+				break;
+			}
+			case 2:
+				for(int j = 0; j < 8; j++)
+				{
+					p[j] = (unsigned char)(residuals[j] | residuals[j + 8] << 2 | residuals[j + 16] << 4 | residuals[j + 24] << 6);
+				}
+				break;
+			case 3:
+				for(int j = 0; j < 16; j++)
+				{
+					p[j] = (unsigned char)(residuals[j] | residuals[j + 16] << 4);
+				}
+				break;
+			case 4:
+				for(int j = 0; j < BLOCK_SIZE; j++)
+				{
+					p[j] = (unsigned char)residuals[j];
+				}
+				break;
+			case 5:
+				memcpy(p, residuals, BLOCK_SIZE * sizeof(unsigned short));
+				break;
+		}
+		return p + MODE_BITS[mode] * BLOCK_SIZE / 8;
+	}
+
+	// 32 bits as 0xffff for every bit that is set and 0 for the others, 8 at a time
+	void unpackBits(unsigned int value, unsigned short* out)
+	{
+		__m128i bits = _mm_set_epi16(128, 64, 32, 16, 8, 4, 2, 1);
+		for(int k = 0; k < 4; k++)
+		{
+			__m128i mask = _mm_set1_epi16((short)((value >> (8 * k)) & 0xff));
+			_mm_storeu_si128((__m128i*)out + k, _mm_cmpeq_epi16(_mm_and_si128(mask, bits), bits));
+		}
+	}
+
+	const unsigned char* unpackBlock(const unsigned char* p, int mode, unsigned short* residuals, unsigned short* keep)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i* out = (__m128i*)residuals;
+		if((mode & HOLES) != 0)
+		{
+			// keep is 0 where there is no reading
+			unsigned int holes;
+			memcpy(&holes, p, sizeof(unsigned int));
+			unpackBits(~holes, keep);
+			p += sizeof(unsigned int);
+			mode &= ~HOLES;
+		}
+		else
+		{
+			for(int k = 0; k < 4; k++)
+			{
+				_mm_storeu_si128((__m128i*)keep + k, _mm_set1_epi16(-1));
+			}
+		}
+
+		switch(mode)
+		{
+			case 0:
+				for(int k = 0; k < 4; k++)
+				{
+					_mm_storeu_si128(out + k, zero);
+				}
+				break;
+			case 1:
+			{
+				unsigned int bits;
+				memcpy(&bits, p, sizeof(unsigned int));
+				unpackBits(bits, residuals);
+				for(int k = 0; k < 4; k++)
+				{
+					_mm_storeu_si128(out + k, _mm_srli_epi16(_mm_loadu_si128(out + k), 15));
+				}
+				break;
+			}
+			case 2:
+			{
+				__m128i packed = _mm_loadl_epi64((const __m128i*)p);
+				__m128i mask = _mm_set1_epi8(3);
+				for(int k = 0; k < 4; k++)
+				{
+					__m128i values = _mm_and_si128(_mm_srli_epi16(packed, 2 * k), mask);
+					_mm_storeu_si128(out + k, _mm_unpacklo_epi8(values, zero));
+				}
+				break;
+			}
+			case 3:
+			{
+				__m128i packed = _mm_loadu_si128((const __m128i*)p);
+				__m128i mask = _mm_set1_epi8(15);
+				__m128i low = _mm_and_si128(packed, mask);
+				__m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+				_mm_storeu_si128(out, _mm_unpacklo_epi8(low, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(low, zero));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi8(high, zero));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi8(high, zero));
+				break;
+			}
+			case 4:
+			{
+				__m128i first = _mm_loadu_si128((const __m128i*)p);
+				__m128i second = _mm_loadu_si128((const __m128i*)p + 1);
+				_mm_storeu_si128(out, _mm_unpacklo_epi8(first, zero));
+				_mm_storeu_si128(out + 1, _mm_unpackhi_epi8(first, zero));
+				_mm_storeu_si128(out + 2, _mm_unpacklo_epi8(second, zero));
+				_mm_storeu_si128(out + 3, _mm_unpackhi_epi8(second, zero));
+				break;
+			}
+			case 5:
+				for(int k = 0; k < 4; k++)
+				{
+					_mm_storeu_si128(out + k, _mm_loadu_si128((const __m128i*)p + k));
+				}
+				break;
+		}
+		return p + MODE_BITS[mode] * BLOCK_SIZE / 8;
+	}
+
+	// levels of a row from the residuals and the row above, 8 at a time
+	void addRowAbove(const unsigned short* residuals, const unsigned short* up, unsigned short* levels, int paddedWidth)
+	{
+		__m128i one = _mm_set1_epi16(1);
+		for(int x = 0; x < paddedWidth; x += 8)
+		{
+			__m128i mapped = _mm_loadu_si128((const __m128i*)(residuals + x));
+			__m128i sign = _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(mapped, one));
+			__m128i residual = _mm_xor_si128(_mm_srli_epi16(mapped, 1), sign);
+			__m128i above = _mm_loadu_si128((const __m128i*)(up + x));
+			_mm_storeu_si128((__m128i*)(levels + x), _mm_add_epi16(above, residual));
+		}
+	}
+
+	void benchmarkCurve(const string& name, ofxKinectLossyDepthCodec& codec, const unsigned short* frame, int width, int height, int iterations)
+	{
+		vector<unsigned char> encoded;
+		vector<unsigned short> decoded(width * height);
+		ofxKinectLossyDepthCodec::Stats stats;
+
+		unsigned long long start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			codec.encode(frame, width, height, encoded, &stats);
+		}
+		float encodeMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		bool bDecoded = true;
+		start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			bDecoded = codec.decode(&encoded[0], encoded.size(), &decoded[0], width, height) && bDecoded;
+		}
+		float decodeMicros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		// checked against the frame rather than trusting the stats
+		int outside = 0;
+		for(int i = 0; i < width * height; i++)
+		{
+			if(frame[i] != 0 && abs(decoded[i] - frame[i]) > codec.getErrorBound(frame[i]))
+			{
+				outside++;
+			}
+			else if(frame[i] == 0 && decoded[i] != 0)
+			{
+				outside++;
+			}
+		}
+
+		ofLogNotice("ofxKinectLossyDepthCodec::benchmark") << name << " " << width << "x" << height << ", " << codec.getNumLevels()
+			<< " levels: " << encoded.size() << " bytes, " << stats.compressionRatio << ":1, error max " << stats.maxError
+			<< " mean " << stats.meanError << " mm, " << stats.maxErrorToBound * 100 << "% of the bound at most, encode "
+			<< encodeMicros << " us, decode " << decodeMicros << " us, " << (bDecoded ? "" : "decode failed, ")
+			<< outside << " pixels outside the bound";
+	}
+}
+
+//---------------------------------------------------------------------------
+ofxKinectLossyDepthCodec::ofxKinectLossyDepthCodec()
+{
+	setErrorCurve();
+}
+
+void ofxKinectLossyDepthCodec::setErrorCurve(float minError, float relativeError, float quadraticError, unsigned short maxDepth)
+{
+	this->minError = MAX(minError, 0.0f);
+	this->relativeError = MAX(relativeError, 0.0f);
+	this->quadraticError = MAX(quadraticError, 0.0f);
+	// the last bin's center has to stay below 2^16
+	this->maxDepth = MIN(maxDepth, 65535 - (int)MAX_BOUND - 1);
+	buildLevels();
+}
+
+float ofxKinectLossyDepthCodec::getErrorBound(unsigned short depth) const
+{
+	float meters = depth * 0.001f;
+	return MIN(minError + relativeError * depth + quadraticError * meters * meters, MAX_BOUND);
+}
+
+int ofxKinectLossyDepthCodec::getNumLevels() const
+{
+	return depthOfLevel.size() - 1;
+}
+
+void ofxKinectLossyDepthCodec::buildLevels()
+{
+	runs.clear();
+	levelOfDepth.assign(maxDepth + 1, 0);
+	depthOfLevel.assign(1, 0);
+
+	// the bound only grows, so a bin that is right at its near edge is right all the way through
+	int depth = 1;
+	while(depth <= maxDepth)
+	{
+		int allowedWidth = 2 * (int)getErrorBound(depth) + 1;
+		if(runs.empty() || allowedWidth * 2 >= runs.back().binWidth * 3)
+		{
+			Run run = { (int)depthOfLevel.size(), depth, allowedWidth };
+			runs.push_back(run);
+		}
+
+		int binWidth = runs.back().binWidth;
+		int level = depthOfLevel.size();
+		for(int d = depth; d < depth + binWidth && d <= maxDepth; d++)
+		{
+			levelOfDepth[d] = level;
+		}
+		depthOfLevel.push_back(depth + binWidth / 2);
+		depth += binWidth;
+	}
+
+	// the center of bin q is the sum over the runs started by q of binWidth * (q - firstLevel) less what
+	// the previous run's slope already adds, and a step where the center jumps from one run to the next
+	runLanes.resize(runs.size() * 3 * 8);
+	int previousWidth = 0;
+	int previousCenter = 0;
+	for(size_t i = 0; i < runs.size(); i++)
+	{
+		const Run& run = runs[i];
+		int center = depthOfLevel[run.firstLevel];
+		int lanes[3] = { run.firstLevel - 1, run.binWidth - previousWidth, center - previousCenter };
+		for(int k = 0; k < 3; k++)
+		{
+			std::fill(runLanes.begin() + (i * 3 + k) * 8, runLanes.begin() + (i * 3 + k + 1) * 8, (unsigned short)lanes[k]);
+		}
+		// where this run's line is at the next run's first level
+		if(i + 1 < runs.size())
+		{
+			previousCenter = center + (runs[i + 1].firstLevel - run.firstLevel) * run.binWidth;
+		}
+		previousWidth = run.binWidth;
+	}
+}
+
+void ofxKinectLossyDepthCodec::dequantizeRow(const unsigned short* levels, const unsigned short* keep, unsigned short* depth, int width) const
+{
+	const __m128i* lanes = (const __m128i*)&runLanes[0];
+	int runCount = runs.size();
+	__m128i flip = _mm_set1_epi16((short)0x8000);
+
+	for(int x = 0; x < width; x += 8)
+	{
+		__m128i level = _mm_loadu_si128((const __m128i*)(levels + x));
+		__m128i flippedLevel = _mm_xor_si128(level, flip);
+		__m128i result = _mm_setzero_si128();
+		for(int i = 0; i < runCount; i++)
+		{
+			__m128i before = _mm_loadu_si128(lanes + i * 3);
+			__m128i slope = _mm_loadu_si128(lanes + i * 3 + 1);
+			__m128i step = _mm_loadu_si128(lanes + i * 3 + 2);
+			// levels past the run's first one, 0 below it
+			__m128i past = _mm_subs_epu16(level, before);
+			__m128i bInRun = _mm_cmpgt_epi16(flippedLevel, _mm_xor_si128(before, flip));
+			result = _mm_add_epi16(result, _mm_mullo_epi16(_mm_subs_epu16(past, _mm_set1_epi16(1)), slope));
+			result = _mm_add_epi16(result, _mm_and_si128(bInRun, step));
+		}
+		result = _mm_and_si128(result, _mm_loadu_si128((const __m128i*)(keep + x)));
+
+		if(x + 8 <= width)
+		{
+			_mm_storeu_si128((__m128i*)(depth + x), result);
+		}
+		else
+		{
+			unsigned short tail[8];
+			_mm_storeu_si128((__m128i*)tail, result);
+			memcpy(depth + x, tail, (width - x) * sizeof(unsigned short));
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectLossyDepthCodec::encode(const unsigned short* depth, int width, int height, vector<unsigned char>& output, Stats* stats)
+{
+	if(depth == NULL || width <= 0 || height <= 0 || width > 65535 || height > 65535)
+	{
+		ofLogError("ofxKinectLossyDepthCodec::encode") << "Can't encode a " << width << "x" << height << " frame";
+		return false;
+	}
+
+	int blocksPerRow = getBlocksPerRow(width);
+	int paddedWidth = blocksPerRow * BLOCK_SIZE;
+	unsigned int modesSize = getModesSize(width, height);
+	output.resize(sizeof(Header) + modesSize + getBlockSize(5 | HOLES) * blocksPerRow * height);
+
+	unsigned char* modes = &output[sizeof(Header)];
+	memset(modes, 0, modesSize);
+	unsigned char* data = modes + modesSize;
+	unsigned char* p = data;
+
+	vector<unsigned short> levels(paddedWidth * 2, 0);
+	vector<unsigned short> residuals(paddedWidth);
+	vector<bool> holes(paddedWidth);
+
+	double errorSum = 0;
+	int validPixels = 0;
+	int maxError = 0;
+	float maxErrorToBound = 0;
+	int clampedPixels = 0;
+
+	for(int y = 0; y < height; y++)
+	{
+		unsigned short* row = &levels[(y & 1) * paddedWidth];
+		const unsigned short* up = &levels[((y + 1) & 1) * paddedWidth];
+		const unsigned short* pixels = depth + y * width;
+		if(y == 0)
+		{
+			std::fill(levels.begin() + paddedWidth, levels.end(), 0);
+		}
+
+		for(int x = 0; x < width; x++)
+		{
+			// a hole carries the level above down, so the row below predicts across it as well
+			int value = pixels[x];
+			if(value == 0)
+			{
+				row[x] = up[x];
+				residuals[x] = 0;
+				holes[x] = true;
+				continue;
+			}
+			if(value > maxDepth)
+			{
+				value = maxDepth;
+				clampedPixels++;
+			}
+			int level = levelOfDepth[value];
+			row[x] = level;
+			residuals[x] = mapResidual(level, up[x]);
+			holes[x] = false;
+
+			int error = abs(depthOfLevel[level] - pixels[x]);
+			errorSum += error;
+			validPixels++;
+			maxError = MAX(maxError, error);
+			maxErrorToBound = MAX(maxErrorToBound, error / MAX(getErrorBound(pixels[x]), 0.5f));
+		}
+		for(int x = width; x < paddedWidth; x++)
+		{
+			row[x] = 0;
+			residuals[x] = 0;
+			holes[x] = false;
+		}
+
+		for(int block = 0; block < blocksPerRow; block++)
+		{
+			const unsigned short* blockResiduals = &residuals[block * BLOCK_SIZE];
+			unsigned short largest = 0;
+			unsigned int blockHoles = 0;
+			for(int j = 0; j < BLOCK_SIZE; j++)
+			{
+				largest = MAX(largest, blockResiduals[j]);
+				blockHoles |= (unsigned int)holes[block * BLOCK_SIZE + j] << j;
+			}
+			int mode = getMode(largest);
+			int index = y * blocksPerRow + block;
+			modes[index >> 1] |= (mode | (blockHoles != 0 ? HOLES : 0)) << ((index & 1) * 4);
+			if(blockHoles != 0)
+			{
+				memcpy(p, &blockHoles, sizeof(unsigned int));
+				p += sizeof(unsigned int);
+			}
+			p = packBlock(blockResiduals, mode, p);
+		}
+	}
+
+	Header header;
+	memcpy(header.magic, "KV2Q", 4);
+	header.width = width;
+	header.height = height;
+	header.minError = minError;
+	header.relativeError = relativeError;
+	header.quadraticError = quadraticError;
+	header.maxDepth = maxDepth;
+	header.reserved = 0;
+	header.dataSize = p - data;
+	memcpy(&output[0], &header, sizeof(Header));
+	output.resize(sizeof(Header) + modesSize + header.dataSize);
+
+	if(stats != NULL)
+	{
+		stats->compressionRatio = width * height * sizeof(unsigned short) / (float)output.size();
+		stats->maxError = maxError;
+		stats->meanError = validPixels > 0 ? (float)(errorSum / validPixels) : 0;
+		stats->maxErrorToBound = maxErrorToBound;
+		stats->clampedPixels = clampedPixels;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectLossyDepthCodec::decode(const unsigned char* data, unsigned int size, unsigned short* depth, int width, int height)
+{
+	Header header;
+	if(data == NULL || size < sizeof(Header))
+	{
+		ofLogError("ofxKinectLossyDepthCodec::decode") << "Not an encoded frame";
+		return false;
+	}
+	memcpy(&header, data, sizeof(Header));
+	if(memcmp(header.magic, "KV2Q", 4) != 0 || header.width != width || header.height != height)
+	{
+		ofLogError("ofxKinectLossyDepthCodec::decode") << "Not an encoded " << width << "x" << height << " frame";
+		return false;
+	}
+
+	int blocksPerRow = getBlocksPerRow(width);
+	int paddedWidth = blocksPerRow * BLOCK_SIZE;
+	unsigned int modesSize = getModesSize(width, height);
+	const unsigned char* modes = data + sizeof(Header);
+	const unsigned char* p = modes + modesSize;
+	if(size - sizeof(Header) < modesSize || size - sizeof(Header) - modesSize < header.dataSize)
+	{
+		ofLogError("ofxKinectLossyDepthCodec::decode") << "The frame is cut short";
+		return false;
+	}
+
+	// the block sizes are checked up front, so unpacking doesn't have to
+	unsigned int dataSize = 0;
+	for(int i = 0; i < blocksPerRow * height; i++)
+	{
+		int mode = (modes[i >> 1] >> ((i & 1) * 4)) & 15;
+		if((mode & 7) >= MODE_COUNT)
+		{
+			dataSize = header.dataSize + 1;
+			break;
+		}
+		dataSize += getBlockSize(mode);
+	}
+	if(dataSize != header.dataSize)
+	{
+		ofLogError("ofxKinectLossyDepthCodec::decode") << "The frame is damaged";
+		return false;
+	}
+
+	if(header.minError != minError || header.relativeError != relativeError || header.quadraticError != quadraticError || header.maxDepth != maxDepth)
+	{
+		setErrorCurve(header.minError, header.relativeError, header.quadraticError, header.maxDepth);
+	}
+
+	vector<unsigned short> levels(paddedWidth * 2, 0);
+	vector<unsigned short> residuals(paddedWidth);
+	vector<unsigned short> keep(paddedWidth);
+	for(int y = 0; y < height; y++)
+	{
+		unsigned short* row = &levels[(y & 1) * paddedWidth];
+		const unsigned short* up = &levels[((y + 1) & 1) * paddedWidth];
+		for(int block = 0; block < blocksPerRow; block++)
+		{
+			int index = y * blocksPerRow + block;
+			int mode = (modes[index >> 1] >> ((index & 1) * 4)) & 15;
+			p = unpackBlock(p, mode, &residuals[block * BLOCK_SIZE], &keep[block * BLOCK_SIZE]);
+		}
+		addRowAbove(&residuals[0], up, row, paddedWidth);
+		dequantizeRow(row, &keep[0], depth + y * width, width);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectLossyDepthCodec::benchmark(const unsigned short* frame, int width, int height, int iterations)
+{
+	vector<unsigned short> depth, infrared;
+	if(frame == NULL)
+	{
+		ofxKinectDepthCodec::makeTestFrames(width, height, depth, infrared);
+		frame = &depth[0];
+	}
+
+	ofxKinectLossyDepthCodec codec;
+	codec.setErrorCurve(0, 0, 0);
+	benchmarkCurve("exact", codec, frame, width, height, iterations);
+	codec.setErrorCurve(1, 0.002f, 0);
+	benchmarkCurve("1mm + 0.2%", codec, frame, width, height, iterations);
+	codec.setErrorCurve();
+	benchmarkCurve("1mm + 0.5%", codec, frame, width, height, iterations);
+	codec.setErrorCurve(1, 0, 1.5f);
+	benchmarkCurve("1mm + 1.5mm/m^2", codec, frame, width, height, iterations);
+	codec.setErrorCurve(2, 0.01f, 0);
+	benchmarkCurve("2mm + 1%", codec, frame, width, height, iterations);
+}
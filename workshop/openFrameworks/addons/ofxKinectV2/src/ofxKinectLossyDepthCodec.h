@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ofMain.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// lossy depth codec whose error never exceeds a bound that grows with distance
+//
+// time of flight noise grows with depth, so keeping millimeters at four meters spends most of the bits on
+// noise. the error curve says how far off a pixel may come back at each depth, and depths are quantized
+// into bins as wide as the curve allows: bins stay at the width the curve allows where a run of them
+// starts, and a new run starts once the curve allows half as much again, which keeps the bins within
+// two thirds of the widest they could be. a bin decodes to its center, so the error is at most the bound
+// at its near edge. 0 (no reading) has a bin of its own and stays 0.
+//
+// the bin indices are predicted from the row above and the prediction errors are bit packed in blocks
+// of 32 at 0, 1, 2, 4, 8 or 16 bits each, so decoding a row is a few sse2 instructions per 8 pixels: unpack,
+// add the row above, and turn the indices back into depths with the piecewise linear sum of the runs,
+// without a table lookup per pixel.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectLossyDepthCodec
+{
+  public:
+	/// what encode() did to a frame
+	struct Stats
+	{
+		Stats() : compressionRatio(0), maxError(0), meanError(0), maxErrorToBound(0), clampedPixels(0) {}
+
+		float compressionRatio;
+		/// in millimeters, over the pixels with a reading
+		float maxError;
+		float meanError;
+		/// the largest error as a fraction of the bound at that depth, at most 1 unless pixels were clamped
+		float maxErrorToBound;
+		/// readings beyond the max depth, which come back as the max depth
+		int clampedPixels;
+	};
+
+	ofxKinectLossyDepthCodec();
+
+	/// a pixel at depth mm comes back within minError + relativeError * mm + quadraticError * (mm / 1000)^2
+	/// millimeters, the bound is capped at 2047. the default keeps half a percent of the distance
+	void setErrorCurve(float minError = 1, float relativeError = 0.005f, float quadraticError = 0, unsigned short maxDepth = 8000);
+	float getErrorBound(unsigned short depth) const;
+	/// number of bins the depths from 1 to the max depth fall into
+	int getNumLevels() const;
+
+	/// output is resized to the encoded size, its capacity is kept for the next frame
+	bool encode(const unsigned short* depth, int width, int height, vector<unsigned char>& output, Stats* stats = NULL);
+	/// false if the data isn't a width x height frame or is cut short. a frame encoded with another error
+	/// curve switches this codec to that curve
+	bool decode(const unsigned char* data, unsigned int size, unsigned short* depth, int width, int height);
+
+	/// encodes and decodes a frame iterations times and logs ratio, error and timing, and how many pixels
+	/// came back outside the bound. without a frame the synthetic room of ofxKinectDepthCodec is used
+	static void benchmark(const unsigned short* frame = NULL, int width = 512, int height = 424, int iterations = 200);
+
+  protected:
+	/// a run of bins of the same width, starting at a bin index and a depth
+	struct Run
+	{
+		int firstLevel;
+		int firstDepth;
+		int binWidth;
+	};
+
+	void buildLevels();
+	/// turns a row of bin indices back into depths 8 at a time, and zeroes where keep is 0
+	void dequantizeRow(const unsigned short* levels, const unsigned short* keep, unsigned short* depth, int width) const;
+
+	float minError;
+	float relativeError;
+	float quadraticError;
+	unsigned short maxDepth;
+
+	vector<Run> runs;
+	/// bin index of every depth up to maxDepth
+	vector<unsigned short> levelOfDepth;
+	/// the depth every bin decodes to
+	vector<unsigned short> depthOfLevel;
+	/// per run the level it starts at minus one, the change in slope and the step in the bin center
+	/// there, each repeated 8 times to be loaded as a vector
+	vector<unsigned short> runLanes;
+};
@@ -0,0 +1,424 @@
+#include "ofxKinectPlayer.h"
+#include "ofxKinectFrameBundle.h"
+#include "ofxKinectDepthCodec.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// a stream the frame doesn't hold, or that can't be read into the slot. the pooled slot still has an older
+// frame's pixels, so they are zeroed and the timestamp left at 0 for the bundle's stamping to skip
+template<typename Slot>
+static void clearStream(Slot& slot)
+{
+	if(slot.pixels.isAllocated())
+	{
+		memset(slot.pixels.getPixels(), 0, slot.pixels.getWidth() * slot.pixels.getHeight() * slot.pixels.getNumChannels() * sizeof(*slot.pixels.getPixels()));
+	}
+	slot.frame.TimeStamp = 0;
+}
+
+template<typename Slot>
+static void readStream(const unsigned char* data, unsigned int size, LONGLONG timeStamp, Slot& slot)
+{
+	unsigned int slotSize = slot.pixels.getWidth() * slot.pixels.getHeight() * slot.pixels.getNumChannels() * sizeof(*slot.pixels.getPixels());
+	if(data != NULL && size > 0 && size == slotSize)
+	{
+		memcpy(slot.pixels.getPixels(), data, size);
+		slot.frame.TimeStamp = timeStamp;
+	}
+	else
+	{
+		clearStream(slot);
+	}
+}
+
+// depth and infrared written with setCompression(true), cleared like readStream() when they don't fit the slot
+template<typename Slot>
+static void readCompressedStream(const unsigned char* data, unsigned int size, LONGLONG timeStamp, Slot& slot)
+{
+	if(data != NULL && slot.pixels.getWidth() > 0 && slot.pixels.getNumChannels() == 1
+		&& ofxKinectDepthCodec::decode(data, size, slot.pixels.getPixels(), slot.pixels.getWidth(), slot.pixels.getHeight()))
+	{
+		slot.frame.TimeStamp = timeStamp;
+	}
+	else
+	{
+		clearStream(slot);
+	}
+}
+
+//---------------------------------------------------------------------------
+ofxKinectPlayer::ofxKinectPlayer()
+	: fileSize(0)
+	, windowSize(0)
+	, granularity(1 << 16)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE)
+	, mappingHandle(NULL)
+#else
+	, fileDescriptor(-1)
+#endif
+	, view(NULL)
+	, viewOffset(0)
+	, viewSize(0)
+{
+}
+
+ofxKinectPlayer::~ofxKinectPlayer()
+{
+	close();
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectPlayer::open(const string& path)
+{
+	close();
+
+	string fullPath = ofToDataPath(path);
+#ifdef _WIN32
+	fileHandle = CreateFileA(fullPath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER length;
+	if(fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &length))
+	{
+		ofLogError("ofxKinectPlayer::open") << "Cannot open " << path;
+		close();
+		return false;
+	}
+	fileSize = length.QuadPart;
+	mappingHandle = fileSize > 0 ? CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	granularity = info.dwAllocationGranularity;
+#else
+	fileDescriptor = ::open(fullPath.c_str(), O_RDONLY);
+	struct stat status;
+	if(fileDescriptor < 0 || fstat(fileDescriptor, &status) != 0)
+	{
+		ofLogError("ofxKinectPlayer::open") << "Cannot open " << path;
+		close();
+		return false;
+	}
+	fileSize = status.st_size;
+	granularity = sysconf(_SC_PAGESIZE);
+#endif
+
+	// a 32 bit address space has no room for a long recording
+	windowSize = sizeof(void*) >= 8 ? fileSize : MIN(fileSize, 256ULL << 20);
+
+	const unsigned char* headerData = getRange(0, sizeof(header));
+	if(headerData == NULL || memcmp(headerData, "KV2R", 4) != 0 || ((const Kv2RecordingHeader*)headerData)->version != header.version)
+	{
+		ofLogError("ofxKinectPlayer::open") << path << " is not a recording of this version";
+		close();
+		return false;
+	}
+	memcpy(&header, headerData, sizeof(header));
+
+	unsigned long long indexSize = header.frameCount * (unsigned long long)sizeof(Kv2RecordingIndexEntry);
+	const unsigned char* indexData = header.frameCount > 0 ? getRange(header.indexOffset, indexSize) : NULL;
+	if(indexData != NULL)
+	{
+		index.resize(header.frameCount);
+		memcpy(&index[0], indexData, indexSize);
+	}
+	else if(buildIndex())
+	{
+		ofLogNotice("ofxKinectPlayer::open") << path << " was not closed properly, found " << index.size() << " frames";
+	}
+
+	if(index.empty())
+	{
+		ofLogWarning("ofxKinectPlayer::open") << path << " has no frames";
+	}
+	return true;
+}
+
+void ofxKinectPlayer::close()
+{
+	unmapView();
+#ifdef _WIN32
+	if(mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+	if(fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+	fileSize = 0;
+	header = Kv2RecordingHeader();
+	index.clear();
+}
+
+bool ofxKinectPlayer::isOpen() const
+{
+	return fileSize > 0;
+}
+
+bool ofxKinectPlayer::buildIndex()
+{
+	index.clear();
+
+	// a recorder that never closed leaves the file grown ahead, the zeros after the last record end the walk
+	unsigned long long offset = Kv2RecordingLayout::align(sizeof(Kv2RecordingHeader));
+	while(offset + sizeof(Kv2RecordedFrameHeader) <= fileSize)
+	{
+		const Kv2RecordedFrameHeader* frame = (const Kv2RecordedFrameHeader*)getRange(offset, sizeof(Kv2RecordedFrameHeader));
+		if(frame == NULL || memcmp(frame->magic, "KV2F", 4) != 0 || frame->size == 0 || offset + frame->size > fileSize)
+		{
+			break;
+		}
+
+		Kv2RecordingIndexEntry entry;
+		entry.offset = offset;
+		entry.timeStamp = frame->timeStamp;
+		index.push_back(entry);
+		offset += frame->size;
+	}
+	return !index.empty();
+}
+
+//---------------------------------------------------------------------------
+const unsigned char* ofxKinectPlayer::getRange(unsigned long long offset, unsigned long long length) const
+{
+	if(offset > fileSize || length > fileSize - offset)
+	{
+		return NULL;
+	}
+
+	if(view == NULL || offset < viewOffset || offset + length > viewOffset + viewSize)
+	{
+		unmapView();
+
+		unsigned long long begin = offset - offset % granularity;
+		unsigned long long end = MIN(fileSize, MAX(offset + length, begin + windowSize));
+#ifdef _WIN32
+		view = (unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, (DWORD)(begin >> 32), (DWORD)begin, (SIZE_T)(end - begin));
+#else
+		void* mapped = mmap(NULL, end - begin, PROT_READ, MAP_SHARED, fileDescriptor, begin);
+		view = mapped != MAP_FAILED ? (unsigned char*)mapped : NULL;
+#endif
+		if(view == NULL)
+		{
+			ofLogError("ofxKinectPlayer::getRange") << "Cannot map " << end - begin << " bytes of the recording";
+			return NULL;
+		}
+		viewOffset = begin;
+		viewSize = end - begin;
+	}
+
+	return view + (offset - viewOffset);
+}
+
+void ofxKinectPlayer::unmapView() const
+{
+	if(view != NULL)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(view, viewSize);
+#endif
+		view = NULL;
+		viewOffset = viewSize = 0;
+	}
+}
+
+//---------------------------------------------------------------------------
+const Kv2RecordingHeader& ofxKinectPlayer::getHeader() const
+{
+	return header;
+}
+
+bool ofxKinectPlayer::hasStream(Kv2RecordedStream stream) const
+{
+	return header.hasStream(stream);
+}
+
+bool ofxKinectPlayer::hasBodies() const
+{
+	return header.bodyCount > 0;
+}
+
+int ofxKinectPlayer::getNumFrames() const
+{
+	return index.size();
+}
+
+LONGLONG ofxKinectPlayer::getTimeStamp(int frame) const
+{
+	return index[frame].timeStamp;
+}
+
+int ofxKinectPlayer::getFrameAt(LONGLONG timeStamp) const
+{
+	int low = 0, high = index.size();
+	while(low < high)
+	{
+		int middle = (low + high) / 2;
+		if(index[middle].timeStamp <= timeStamp)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return MAX(low - 1, 0);
+}
+
+Kv2RecordedFrameHeader ofxKinectPlayer::getFrameHeader(int frame) const
+{
+	Kv2RecordedFrameHeader frameHeader;
+	memset(&frameHeader, 0, sizeof(frameHeader));
+	const unsigned char* record = getRange(index[frame].offset, sizeof(frameHeader));
+	if(record != NULL)
+	{
+		memcpy(&frameHeader, record, sizeof(frameHeader));
+	}
+	return frameHeader;
+}
+
+const unsigned char* ofxKinectPlayer::getRecord(int frame, Kv2RecordedFrameHeader& frameHeader) const
+{
+	if(frame < 0 || frame >= (int)index.size())
+	{
+		return NULL;
+	}
+
+	// the readers index bodies up to the file header's count, a record must hold that many
+	frameHeader = getFrameHeader(frame);
+	if(frameHeader.size < sizeof(frameHeader) || !Kv2RecordingLayout::fits(frameHeader)
+		|| (frameHeader.bodiesSize > 0 && frameHeader.bodiesSize < header.bodyCount * sizeof(Kv2RecordedBody)))
+	{
+		ofLogError("ofxKinectPlayer::getRecord") << "Frame " << frame << " is damaged, its streams don't fit in its record";
+		return NULL;
+	}
+	return getRange(index[frame].offset, frameHeader.size);
+}
+
+const unsigned char* ofxKinectPlayer::getStreamData(int frame, Kv2RecordedStream stream) const
+{
+	Kv2RecordedFrameHeader frameHeader;
+	const unsigned char* record = getRecord(frame, frameHeader);
+	if(record == NULL || frameHeader.streamSizes[stream] == 0)
+	{
+		return NULL;
+	}
+	return record + Kv2RecordingLayout::getStreamOffset(frameHeader, stream);
+}
+
+const Kv2RecordedBody* ofxKinectPlayer::getBodies(int frame) const
+{
+	Kv2RecordedFrameHeader frameHeader;
+	const unsigned char* record = getRecord(frame, frameHeader);
+	if(record == NULL || frameHeader.bodiesSize == 0)
+	{
+		return NULL;
+	}
+	return (const Kv2RecordedBody*)(record + Kv2RecordingLayout::getBodiesOffset(frameHeader));
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectPlayer::readFrame(int frame, Kv2FrameBundle& bundle) const
+{
+	Kv2RecordedFrameHeader frameHeader;
+	const unsigned char* record = getRecord(frame, frameHeader);
+	if(record == NULL)
+	{
+		return false;
+	}
+
+	const unsigned char* streams[KV2_STREAM_COUNT];
+	for(int i = 0; i < KV2_STREAM_COUNT; i++)
+	{
+		streams[i] = frameHeader.streamSizes[i] > 0 ? record + Kv2RecordingLayout::getStreamOffset(frameHeader, (Kv2RecordedStream)i) : NULL;
+	}
+
+	if(frameHeader.compressedStreams & (1 << KV2_STREAM_DEPTH))
+	{
+		readCompressedStream(streams[KV2_STREAM_DEPTH], frameHeader.streamSizes[KV2_STREAM_DEPTH], frameHeader.streamTimeStamps[KV2_STREAM_DEPTH], bundle.depth);
+	}
+	else
+	{
+		readStream(streams[KV2_STREAM_DEPTH], frameHeader.streamSizes[KV2_STREAM_DEPTH], frameHeader.streamTimeStamps[KV2_STREAM_DEPTH], bundle.depth);
+	}
+	if(frameHeader.compressedStreams & (1 << KV2_STREAM_INFRARED))
+	{
+		readCompressedStream(streams[KV2_STREAM_INFRARED], frameHeader.streamSizes[KV2_STREAM_INFRARED], frameHeader.streamTimeStamps[KV2_STREAM_INFRARED], bundle.infrared);
+	}
+	else
+	{
+		readStream(streams[KV2_STREAM_INFRARED], frameHeader.streamSizes[KV2_STREAM_INFRARED], frameHeader.streamTimeStamps[KV2_STREAM_INFRARED], bundle.infrared);
+	}
+	readStream(streams[KV2_STREAM_COLOR], frameHeader.streamSizes[KV2_STREAM_COLOR], frameHeader.streamTimeStamps[KV2_STREAM_COLOR], bundle.color);
+	readStream(streams[KV2_STREAM_BODY_INDEX], frameHeader.streamSizes[KV2_STREAM_BODY_INDEX], frameHeader.streamTimeStamps[KV2_STREAM_BODY_INDEX], bundle.bodyIndex);
+
+	const Kv2RecordedBody* bodies = frameHeader.bodiesSize > 0 ? (const Kv2RecordedBody*)(record + Kv2RecordingLayout::getBodiesOffset(frameHeader)) : NULL;
+	if(bodies == NULL)
+	{
+		bundle.bodies.clear();
+		return true;
+	}
+	for(unsigned int b = 0; b < Kv2SkeletonFrame::MAX_BODIES; b++)
+	{
+		if(b < header.bodyCount && bodies[b].tracked != 0)
+		{
+			// recordings without ids still tell the slots apart
+			bundle.bodies.setBody(b, bodies[b].trackingId != 0 ? bodies[b].trackingId : b + 1, bodies[b].joints, bodies[b].orientations);
+		}
+		else
+		{
+			bundle.bodies.setUntracked(b);
+		}
+	}
+
+	bundle.bodies.timeStamp = frameHeader.bodyTimeStamp;
+	return true;
+}
+
+void ofxKinectPlayer::prefetch(int frame, int count) const
+{
+	int last = MIN(frame + count, (int)index.size()) - 1;
+	if(frame < 0 || last < frame || view == NULL)
+	{
+		return;
+	}
+
+	// only within the current window, the next window is mapped when playback gets there
+	unsigned long long begin = MAX(index[frame].offset, viewOffset);
+	unsigned long long end = last + 1 < (int)index.size() ? index[last + 1].offset : (header.indexOffset > 0 ? header.indexOffset : fileSize);
+	end = MIN(end, viewOffset + viewSize);
+	if(begin >= end)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = view + (begin - viewOffset);
+	range.NumberOfBytes = (SIZE_T)(end - begin);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+	// before windows 8 the sequential scan hint on the file is all there is
+#else
+	unsigned long long pageBegin = begin - begin % granularity;
+	madvise(view + (pageBegin - viewOffset), end - pageBegin, MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectRecordingFormat.h"
+
+class Kv2FrameBundle;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// reads a recording written by ofxKinectRecorder
+//
+// the file is memory mapped, so a frame's pixels can be read in place through getStreamData() and
+// readFrame() is one copy per stream from the page cache into a bundle. a 32 bit process can't map a
+// recording of several gigabytes at once, so the file is mapped through a window that moves along with
+// the frames being read; on 64 bit the window is the whole file. prefetch() asks the os to start reading
+// frames that are coming up, so playback doesn't stall on page faults. frames are found by number or by
+// timestamp through the index; a recording that was never closed is indexed by walking its records.
+// not thread safe, and pointers into the file stay valid only until the next call that reads a frame.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectPlayer
+{
+  public:
+	ofxKinectPlayer();
+	~ofxKinectPlayer();
+
+	bool open(const string& path);
+	void close();
+	bool isOpen() const;
+
+	const Kv2RecordingHeader& getHeader() const;
+	bool hasStream(Kv2RecordedStream stream) const;
+	bool hasBodies() const;
+
+	int getNumFrames() const;
+	/// earliest stream timestamp of a frame, in 100ns ticks
+	LONGLONG getTimeStamp(int frame) const;
+	/// the last frame at or before a timestamp, 0 if the timestamp is before the first frame
+	int getFrameAt(LONGLONG timeStamp) const;
+
+	Kv2RecordedFrameHeader getFrameHeader(int frame) const;
+	/// a stream's pixels straight from the mapped file, NULL if the stream isn't recorded. streams in the
+	/// frame header's compressedStreams are ofxKinectDepthCodec data rather than pixels
+	const unsigned char* getStreamData(int frame, Kv2RecordedStream stream) const;
+	/// getHeader().bodyCount bodies, NULL without skeletons
+	const Kv2RecordedBody* getBodies(int frame) const;
+
+	/// copy a frame into a bundle, every recorded stream the bundle has allocated and the skeletons. streams
+	/// and skeletons the frame lacks are cleared, with a timestamp of 0
+	bool readFrame(int frame, Kv2FrameBundle& bundle) const;
+
+	/// start reading count frames from frame on in the background
+	void prefetch(int frame, int count) const;
+
+  protected:
+	/// length bytes of the file from offset on, NULL past the end
+	const unsigned char* getRange(unsigned long long offset, unsigned long long length) const;
+	/// a frame's whole record, NULL if its streams or bodies don't fit inside it or it runs past the file
+	const unsigned char* getRecord(int frame, Kv2RecordedFrameHeader& frameHeader) const;
+	void unmapView() const;
+	bool buildIndex();
+
+	unsigned long long fileSize;
+	unsigned long long windowSize;
+	unsigned long long granularity;
+#ifdef _WIN32
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+	mutable unsigned char* view;
+	mutable unsigned long long viewOffset;
+	mutable unsigned long long viewSize;
+
+	Kv2RecordingHeader header;
+	vector<Kv2RecordingIndexEntry> index;
+};
@@ -0,0 +1,671 @@
+#include "ofxKinectPoseClassifier.h"
+
+#include "ofxKinectPlayer.h"
+
+#include <float.h>
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define OFX_KINECT_HAS_AVX2
+#endif
+
+// parent and child of every bone, the way the sdk's samples draw them
+static const JointType bones[ofxKinectPoseClassifier::NUM_BONES][2] = {
+	{ JointType_SpineBase, JointType_SpineMid }, { JointType_SpineMid, JointType_SpineShoulder },
+	{ JointType_SpineShoulder, JointType_Neck }, { JointType_Neck, JointType_Head },
+	{ JointType_SpineShoulder, JointType_ShoulderLeft }, { JointType_ShoulderLeft, JointType_ElbowLeft },
+	{ JointType_ElbowLeft, JointType_WristLeft }, { JointType_WristLeft, JointType_HandLeft },
+	{ JointType_HandLeft, JointType_HandTipLeft }, { JointType_WristLeft, JointType_ThumbLeft },
+	{ JointType_SpineShoulder, JointType_ShoulderRight }, { JointType_ShoulderRight, JointType_ElbowRight },
+	{ JointType_ElbowRight, JointType_WristRight }, { JointType_WristRight, JointType_HandRight },
+	{ JointType_HandRight, JointType_HandTipRight }, { JointType_WristRight, JointType_ThumbRight },
+	{ JointType_SpineBase, JointType_HipLeft }, { JointType_HipLeft, JointType_KneeLeft },
+	{ JointType_KneeLeft, JointType_AnkleLeft }, { JointType_AnkleLeft, JointType_FootLeft },
+	{ JointType_SpineBase, JointType_HipRight }, { JointType_HipRight, JointType_KneeRight },
+	{ JointType_KneeRight, JointType_AnkleRight }, { JointType_AnkleRight, JointType_FootRight }
+};
+
+// hands, thumbs and feet jump around the most
+static const float boneWeights[ofxKinectPoseClassifier::NUM_BONES] = {
+	1, 1, 1, 1,
+	1, 1, 1, 0.25f, 0.25f, 0.25f,
+	1, 1, 1, 0.25f, 0.25f, 0.25f,
+	1, 1, 1, 0.25f,
+	1, 1, 1, 0.25f
+};
+
+//---------------------------------------------------------------------------
+// the weighted squared distance of every query to every pose of the library. each block is compared with
+// all queries while it is in the cache, so the library is read once per frame however many bodies there
+// are. the sums are split over the descriptor so the adds don't wait on each other
+static void distancesScalar(const float* library, int numBlocks, const float* queries, const float* weights, int numQueries, float* distances)
+{
+	const int size = ofxKinectPoseClassifier::DESCRIPTOR_SIZE, lanes = ofxKinectPoseClassifier::BLOCK_SIZE;
+	for(int b = 0; b < numBlocks; b++)
+	{
+		const float* block = library + b * size * lanes;
+		for(int q = 0; q < numQueries; q++)
+		{
+			const float* query = queries + q * size;
+			const float* weight = weights + q * size;
+			for(int lane = 0; lane < lanes; lane++)
+			{
+				float sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+				for(int d = 0; d < size; d += 4)
+				{
+					float difference0 = block[d * lanes + lane] - query[d];
+					float difference1 = block[(d + 1) * lanes + lane] - query[d + 1];
+					float difference2 = block[(d + 2) * lanes + lane] - query[d + 2];
+					float difference3 = block[(d + 3) * lanes + lane] - query[d + 3];
+					sum0 += weight[d] * (difference0 * difference0);
+					sum1 += weight[d + 1] * (difference1 * difference1);
+					sum2 += weight[d + 2] * (difference2 * difference2);
+					sum3 += weight[d + 3] * (difference3 * difference3);
+				}
+				distances[q * numBlocks * lanes + b * lanes + lane] = (sum0 + sum1) + (sum2 + sum3);
+			}
+		}
+	}
+}
+
+static inline __m128 addWeightedSquareSSE2(__m128 sum, const float* values, const float* query, const float* weight)
+{
+	__m128 difference = _mm_sub_ps(_mm_loadu_ps(values), _mm_set1_ps(*query));
+	return _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(*weight), _mm_mul_ps(difference, difference)));
+}
+
+static void distancesSSE2(const float* library, int numBlocks, const float* queries, const float* weights, int numQueries, float* distances)
+{
+	const int size = ofxKinectPoseClassifier::DESCRIPTOR_SIZE, lanes = ofxKinectPoseClassifier::BLOCK_SIZE;
+	for(int b = 0; b < numBlocks; b++)
+	{
+		const float* block = library + b * size * lanes;
+		for(int q = 0; q < numQueries; q++)
+		{
+			const float* query = queries + q * size;
+			const float* weight = weights + q * size;
+			__m128 low0 = _mm_setzero_ps(), low1 = _mm_setzero_ps(), high0 = _mm_setzero_ps(), high1 = _mm_setzero_ps();
+			for(int d = 0; d < size; d += 2)
+			{
+				low0 = addWeightedSquareSSE2(low0, block + d * lanes, query + d, weight + d);
+				high0 = addWeightedSquareSSE2(high0, block + d * lanes + 4, query + d, weight + d);
+				low1 = addWeightedSquareSSE2(low1, block + (d + 1) * lanes, query + d + 1, weight + d + 1);
+				high1 = addWeightedSquareSSE2(high1, block + (d + 1) * lanes + 4, query + d + 1, weight + d + 1);
+			}
+			float* out = distances + q * numBlocks * lanes + b * lanes;
+			_mm_storeu_ps(out, _mm_add_ps(low0, low1));
+			_mm_storeu_ps(out + 4, _mm_add_ps(high0, high1));
+		}
+	}
+}
+
+#ifdef OFX_KINECT_HAS_AVX2
+static inline __m256 addWeightedSquareAVX2(__m256 sum, const float* values, const float* query, const float* weight)
+{
+	__m256 difference = _mm256_sub_ps(_mm256_loadu_ps(values), _mm256_set1_ps(*query));
+	return _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(*weight), _mm256_mul_ps(difference, difference)));
+}
+
+static void distancesAVX2(const float* library, int numBlocks, const float* queries, const float* weights, int numQueries, float* distances)
+{
+	const int size = ofxKinectPoseClassifier::DESCRIPTOR_SIZE, lanes = ofxKinectPoseClassifier::BLOCK_SIZE;
+	for(int b = 0; b < numBlocks; b++)
+	{
+		const float* block = library + b * size * lanes;
+		for(int q = 0; q < numQueries; q++)
+		{
+			const float* query = queries + q * size;
+			const float* weight = weights + q * size;
+			__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+			for(int d = 0; d < size; d += 4)
+			{
+				sum0 = addWeightedSquareAVX2(sum0, block + d * lanes, query + d, weight + d);
+				sum1 = addWeightedSquareAVX2(sum1, block + (d + 1) * lanes, query + d + 1, weight + d + 1);
+				sum2 = addWeightedSquareAVX2(sum2, block + (d + 2) * lanes, query + d + 2, weight + d + 2);
+				sum3 = addWeightedSquareAVX2(sum3, block + (d + 3) * lanes, query + d + 3, weight + d + 3);
+			}
+			_mm256_storeu_ps(distances + q * numBlocks * lanes + b * lanes, _mm256_add_ps(_mm256_add_ps(sum0, sum1), _mm256_add_ps(sum2, sum3)));
+		}
+	}
+}
+#endif
+
+static const ofxKinectPoseClassifier::DistanceFunction distanceKernels[3] = {
+	distancesScalar,
+	distancesSSE2,
+#ifdef OFX_KINECT_HAS_AVX2
+	distancesAVX2
+#else
+	distancesSSE2
+#endif
+};
+
+//---------------------------------------------------------------------------
+Kv2PoseFrame::Kv2PoseFrame()
+{
+	clear();
+}
+
+void Kv2PoseFrame::clear()
+{
+	timeStamp = 0;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		trackingIds[body] = 0;
+		labels[body] = -1;
+		distances[body] = 0;
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectPoseClassifier::getDescriptor(const Kv2SkeletonFrame& frame, int body, Descriptor& descriptor)
+{
+	if(!frame.tracked[body])
+	{
+		return false;
+	}
+
+	// turned about y so the hips, or the shoulders without them, point along x
+	const ofVec3f* positions = frame.positions[body];
+	const TrackingState* states = frame.trackingStates[body];
+	ofVec3f across = positions[JointType_HipRight] - positions[JointType_HipLeft];
+	if(states[JointType_HipLeft] == TrackingState_NotTracked || states[JointType_HipRight] == TrackingState_NotTracked)
+	{
+		across = positions[JointType_ShoulderRight] - positions[JointType_ShoulderLeft];
+	}
+	float yaw = atan2f(across.z, across.x);
+	float c = cosf(yaw), s = sinf(yaw);
+
+	bool bAny = false;
+	for(int i = 0; i < NUM_BONES; i++)
+	{
+		TrackingState parent = states[bones[i][0]], child = states[bones[i][1]];
+		ofVec3f direction = positions[bones[i][1]] - positions[bones[i][0]];
+		float length = direction.length();
+
+		float weight = boneWeights[i];
+		weight *= parent == TrackingState_NotTracked || child == TrackingState_NotTracked || length < 0.001f ? 0.0f : 1.0f;
+		weight *= parent == TrackingState_Inferred || child == TrackingState_Inferred ? 0.5f : 1.0f;
+		descriptor.weights[i] = weight;
+		bAny = bAny || weight > 0;
+
+		direction /= MAX(length, 0.001f);
+		descriptor.directions[i * 3 + 0] = direction.x * c + direction.z * s;
+		descriptor.directions[i * 3 + 1] = direction.y;
+		descriptor.directions[i * 3 + 2] = direction.z * c - direction.x * s;
+	}
+	return bAny;
+}
+
+//---------------------------------------------------------------------------
+ofxKinectPoseClassifier::ofxKinectPoseClassifier()
+	: numPoses(0)
+	, enterDistance(0.3f)
+	, exitDistance(0.4f)
+	, holdFrames(4)
+	, isa(ofxKinectDepthKernel::getBestSupportedIsa())
+	, classifyMicros(0)
+{
+	reset();
+}
+
+int ofxKinectPoseClassifier::addLabel(const string& name)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	return insertLabel(name);
+}
+
+int ofxKinectPoseClassifier::findLabel(const string& name) const
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	return indexOfLabel(name);
+}
+
+string ofxKinectPoseClassifier::getLabelName(int label) const
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	return labelNames[label];
+}
+
+int ofxKinectPoseClassifier::getNumLabels() const
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	return (int)labelNames.size();
+}
+
+int ofxKinectPoseClassifier::indexOfLabel(const string& name) const
+{
+	for(size_t i = 0; i < labelNames.size(); i++)
+	{
+		if(labelNames[i] == name)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+int ofxKinectPoseClassifier::insertLabel(const string& name)
+{
+	int label = indexOfLabel(name);
+	if(label < 0)
+	{
+		labelNames.push_back(name);
+		label = (int)labelNames.size() - 1;
+	}
+	return label;
+}
+
+int ofxKinectPoseClassifier::addPose(const string& label, const Kv2SkeletonFrame& frame, int body)
+{
+	Descriptor descriptor;
+	if(!getDescriptor(frame, body, descriptor))
+	{
+		return -1;
+	}
+	return addPose(label, descriptor);
+}
+
+int ofxKinectPoseClassifier::addPose(const string& label, const Descriptor& descriptor)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	int index = numPoses++;
+	int numBlocks = (numPoses + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	library.resize(numBlocks * DESCRIPTOR_SIZE * BLOCK_SIZE, 0.0f);
+	distances.resize(Kv2SkeletonFrame::MAX_BODIES * numBlocks * BLOCK_SIZE);
+	poseLabels.push_back(insertLabel(label));
+
+	float* block = &library[(index / BLOCK_SIZE) * DESCRIPTOR_SIZE * BLOCK_SIZE];
+	for(int d = 0; d < DESCRIPTOR_SIZE; d++)
+	{
+		block[d * BLOCK_SIZE + index % BLOCK_SIZE] = descriptor.directions[d];
+	}
+	return index;
+}
+
+int ofxKinectPoseClassifier::loadPoses(const string& path, const string& label, int firstFrame, int lastFrame, int step)
+{
+	ofxKinectPlayer player;
+	if(!player.open(path))
+	{
+		ofLogError("ofxKinectPoseClassifier::loadPoses") << "Couldn't open " << path;
+		return 0;
+	}
+	if(!player.hasBodies())
+	{
+		ofLogError("ofxKinectPoseClassifier::loadPoses") << path << " doesn't have bodies";
+		return 0;
+	}
+	lastFrame = lastFrame < 0 ? player.getNumFrames() - 1 : MIN(lastFrame, player.getNumFrames() - 1);
+
+	int added = 0;
+	Kv2SkeletonFrame frame;
+	unsigned int bodyCount = MIN(player.getHeader().bodyCount, (unsigned int)Kv2SkeletonFrame::MAX_BODIES);
+	for(int f = MAX(firstFrame, 0); f <= lastFrame; f += MAX(step, 1))
+	{
+		const Kv2RecordedBody* bodies = player.getBodies(f);
+		for(unsigned int b = 0; bodies != NULL && b < bodyCount; b++)
+		{
+			if(bodies[b].tracked == 0)
+			{
+				continue;
+			}
+			frame.setBody(b, bodies[b].trackingId != 0 ? bodies[b].trackingId : b + 1, bodies[b].joints, bodies[b].orientations);
+			added += addPose(label, frame, b) >= 0 ? 1 : 0;
+		}
+	}
+	return added;
+}
+
+void ofxKinectPoseClassifier::clearPoses()
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	labelNames.clear();
+	library.clear();
+	poseLabels.clear();
+	numPoses = 0;
+	distances.clear();
+	resetBodies();
+}
+
+int ofxKinectPoseClassifier::getNumPoses() const
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	return numPoses;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectPoseClassifier::setDistances(float _enterDistance, float _exitDistance)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	enterDistance = _enterDistance;
+	exitDistance = MAX(_exitDistance, _enterDistance);
+}
+
+void ofxKinectPoseClassifier::setHoldFrames(int frames)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	holdFrames = MAX(frames, 1);
+}
+
+void ofxKinectPoseClassifier::setIsa(ofxKinectDepthKernel::Isa requested)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	isa = (ofxKinectDepthKernel::Isa)MIN((int)requested, (int)ofxKinectDepthKernel::getBestSupportedIsa());
+}
+
+ofxKinectDepthKernel::Isa ofxKinectPoseClassifier::getIsa() const
+{
+	return isa;
+}
+
+void ofxKinectPoseClassifier::reset()
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	resetBodies();
+}
+
+void ofxKinectPoseClassifier::resetBodies()
+{
+	poses.clear();
+	poses.timeStamp = -1;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		candidates[body] = -1;
+		candidateFrames[body] = 0;
+	}
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectPoseClassifier::setQuery(int query, const Descriptor& descriptor)
+{
+	// bones without a weight are compared with a weight of nothing, which is cheaper than skipping them
+	queryWeights[query] = 0;
+	for(int i = 0; i < NUM_BONES; i++)
+	{
+		for(int axis = 0; axis < 3; axis++)
+		{
+			queries[query * DESCRIPTOR_SIZE + i * 3 + axis] = descriptor.directions[i * 3 + axis];
+			weights[query * DESCRIPTOR_SIZE + i * 3 + axis] = descriptor.weights[i];
+		}
+		queryWeights[query] += descriptor.weights[i];
+	}
+	return queryWeights[query] > 0;
+}
+
+void ofxKinectPoseClassifier::measure(int numQueries)
+{
+	distanceKernels[isa](&library[0], (numPoses + BLOCK_SIZE - 1) / BLOCK_SIZE, queries, weights, numQueries, &distances[0]);
+}
+
+int ofxKinectPoseClassifier::getNearest(int query, int label, float& distance) const
+{
+	const float* measured = &distances[query * ((numPoses + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE];
+	int nearest = -1;
+	for(int i = 0; i < numPoses; i++)
+	{
+		bool bCloser = (label < 0 || poseLabels[i] == label) && (nearest < 0 || measured[i] < measured[nearest]);
+		nearest = bCloser ? i : nearest;
+	}
+	distance = nearest < 0 ? FLT_MAX : sqrtf(measured[nearest] / queryWeights[query]);
+	return nearest < 0 ? -1 : poseLabels[nearest];
+}
+
+int ofxKinectPoseClassifier::findNearest(const Descriptor& descriptor, float& distance)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	distance = 0;
+	if(numPoses == 0 || !setQuery(0, descriptor))
+	{
+		return -1;
+	}
+	measure(1);
+	return getNearest(0, -1, distance);
+}
+
+const Kv2PoseFrame& ofxKinectPoseClassifier::classify(const Kv2SkeletonFrame& frame)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	classifyBodies(frame);
+	return poses;
+}
+
+void ofxKinectPoseClassifier::classify(const Kv2SkeletonFrame& frame, Kv2PoseFrame& labels)
+{
+	std::lock_guard<std::mutex> guard(libraryMutex);
+	classifyBodies(frame);
+	labels = poses;
+}
+
+void ofxKinectPoseClassifier::classifyBodies(const Kv2SkeletonFrame& frame)
+{
+	if(frame.timeStamp == poses.timeStamp)
+	{
+		return;
+	}
+	unsigned long long start = ofGetElapsedTimeMicros();
+	poses.timeStamp = frame.timeStamp;
+
+	// every body that can be described goes against the library in one pass
+	Descriptor descriptor;
+	int bodyQueries[Kv2SkeletonFrame::MAX_BODIES];
+	int numQueries = 0;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		UINT64 trackingId = frame.tracked[body] ? frame.trackingIds[body] : 0;
+		if(trackingId != poses.trackingIds[body])
+		{
+			poses.trackingIds[body] = trackingId;
+			poses.labels[body] = -1;
+			candidates[body] = -1;
+			candidateFrames[body] = 0;
+		}
+		bool bQuery = trackingId != 0 && numPoses > 0 && getDescriptor(frame, body, descriptor) && setQuery(numQueries, descriptor);
+		bodyQueries[body] = bQuery ? numQueries++ : -1;
+	}
+	if(numQueries > 0)
+	{
+		measure(numQueries);
+	}
+
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		float distance = 0;
+		int nearest = bodyQueries[body] >= 0 ? getNearest(bodyQueries[body], -1, distance) : -1;
+		poses.distances[body] = nearest >= 0 ? distance : 0;
+
+		// what this frame says: a label close enough to enter, or the current one while it is close enough to stay
+		int current = poses.labels[body];
+		int seen = nearest >= 0 && distance < enterDistance ? nearest : -1;
+		if(seen < 0 && current >= 0 && nearest >= 0)
+		{
+			getNearest(bodyQueries[body], current, distance);
+			seen = distance < exitDistance ? current : -1;
+		}
+
+		// and only after it has said so for holdFrames in a row
+		if(seen == current)
+		{
+			candidateFrames[body] = 0;
+			continue;
+		}
+		candidateFrames[body] = seen == candidates[body] ? candidateFrames[body] + 1 : 1;
+		candidates[body] = seen;
+		if(candidateFrames[body] >= holdFrames)
+		{
+			poses.labels[body] = seen;
+			candidateFrames[body] = 0;
+		}
+	}
+
+	float micros = (float)(ofGetElapsedTimeMicros() - start);
+	classifyMicros = classifyMicros == 0 ? micros : classifyMicros * 0.9f + micros * 0.1f;
+}
+
+const Kv2PoseFrame& ofxKinectPoseClassifier::getPoses() const
+{
+	return poses;
+}
+
+float ofxKinectPoseClassifier::getClassifyMicros() const
+{
+	return classifyMicros;
+}
+
+//---------------------------------------------------------------------------
+static float uniform(unsigned int& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) / 16777216.0f;
+}
+
+// arm angles up from hanging down in the body's plane, elbow bend towards the sensor, knee bend, degrees
+class ofxKinectBenchmarkPose
+{
+  public:
+	ofxKinectBenchmarkPose(float _left = 0, float _right = 0, float _elbows = 0, float _knees = 0)
+		: left(_left), right(_right), elbows(_elbows), knees(_knees) {}
+
+	ofxKinectBenchmarkPose getJittered(float degrees, unsigned int& seed) const
+	{
+		return ofxKinectBenchmarkPose(left + (uniform(seed) * 2 - 1) * degrees, right + (uniform(seed) * 2 - 1) * degrees,
+			MAX(elbows + (uniform(seed) * 2 - 1) * degrees, 0.0f), MAX(knees + (uniform(seed) * 2 - 1) * degrees, 0.0f));
+	}
+
+	void setBody(Kv2SkeletonFrame& frame, int body, float yaw, float scale, const ofVec3f& position) const
+	{
+		ofVec3f* p = frame.positions[body];
+		p[JointType_SpineBase].set(0, 0, 0);
+		p[JointType_SpineMid].set(0, 0.3f, 0);
+		p[JointType_SpineShoulder].set(0, 0.5f, 0);
+		p[JointType_Neck].set(0, 0.56f, 0);
+		p[JointType_Head].set(0, 0.72f, 0);
+		setArm(p, JointType_ShoulderLeft, -1, left);
+		setArm(p, JointType_ShoulderRight, 1, right);
+
+		// crouching, the thighs come forward towards the sensor and the shins lean back
+		float k = knees * DEG_TO_RAD;
+		for(int side = 0; side < 2; side++)
+		{
+			float x = side == 0 ? -0.09f : 0.09f;
+			JointType hip = side == 0 ? JointType_HipLeft : JointType_HipRight;
+			p[hip].set(x, -0.06f, 0);
+			p[hip + 1] = p[hip] + ofVec3f(0, -cosf(k), -sinf(k)) * 0.42f;
+			p[hip + 2] = p[hip + 1] + ofVec3f(0, -cosf(k * 0.5f), sinf(k * 0.5f)) * 0.4f;
+			p[hip + 3] = p[hip + 2] + ofVec3f(0, -0.05f, -0.12f);
+		}
+
+		// and then somewhere in the room, facing somewhere
+		ofQuaternion turn;
+		turn.makeRotate(yaw, ofVec3f(0, 1, 0));
+		frame.tracked[body] = true;
+		frame.trackingIds[body] = body + 1;
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			p[j] = turn * (p[j] * scale) + position;
+			frame.trackingStates[body][j] = TrackingState_Tracked;
+		}
+	}
+
+	float left, right, elbows, knees;
+
+  protected:
+	void setArm(ofVec3f* p, JointType shoulder, float side, float degrees) const
+	{
+		// shoulder, elbow, wrist and hand follow each other in the sdk's joint order, hand tip and thumb after
+		float a = degrees * DEG_TO_RAD, e = elbows * DEG_TO_RAD;
+		ofVec3f upper(side * sinf(a), -cosf(a), 0);
+		ofVec3f lower = upper * cosf(e) + ofVec3f(0, 0, -sinf(e));
+		p[shoulder] = ofVec3f(side * 0.18f, 0.48f, 0);
+		p[shoulder + 1] = p[shoulder] + upper * 0.28f;
+		p[shoulder + 2] = p[shoulder + 1] + lower * 0.25f;
+		p[shoulder + 3] = p[shoulder + 2] + lower * 0.08f;
+		JointType tip = shoulder == JointType_ShoulderLeft ? JointType_HandTipLeft : JointType_HandTipRight;
+		JointType thumb = shoulder == JointType_ShoulderLeft ? JointType_ThumbLeft : JointType_ThumbRight;
+		p[tip] = p[shoulder + 3] + lower * 0.06f;
+		p[thumb] = p[shoulder + 2] + lower * 0.05f + ofVec3f(0, 0, -0.03f);
+	}
+};
+
+void ofxKinectPoseClassifier::benchmark(int posesPerLabel, int numFrames)
+{
+	const char* names[8] = { "arms down", "t-pose", "hands up", "left hand up", "right hand up", "crouch", "left arm out", "right arm out" };
+	const ofxKinectBenchmarkPose shapes[8] = {
+		ofxKinectBenchmarkPose(10, 10), ofxKinectBenchmarkPose(90, 90), ofxKinectBenchmarkPose(170, 170), ofxKinectBenchmarkPose(170, 10),
+		ofxKinectBenchmarkPose(10, 170), ofxKinectBenchmarkPose(10, 10, 60, 80), ofxKinectBenchmarkPose(90, 10), ofxKinectBenchmarkPose(10, 90)
+	};
+	const int holdLength = 30;
+	const int numIsas = (int)ofxKinectDepthKernel::getBestSupportedIsa() + 1;
+
+	vector<int> reference;
+	for(int i = 0; i < numIsas; i++)
+	{
+		// the library as if recorded by people facing the sensor
+		ofxKinectPoseClassifier classifier;
+		classifier.setIsa((ofxKinectDepthKernel::Isa)i);
+		unsigned int seed = 3;
+		Kv2SkeletonFrame frame;
+		for(int label = 0; label < 8; label++)
+		{
+			for(int n = 0; n < posesPerLabel; n++)
+			{
+				shapes[label].getJittered(15, seed).setBody(frame, 0, (uniform(seed) * 2 - 1) * 10, 1, ofVec3f(0, 0, 2.5f));
+				classifier.addPose(names[label], frame, 0);
+			}
+		}
+
+		// six people of different sizes around the room holding a pose for a second at a time, turned up to 40
+		// degrees and never quite the same way twice
+		int truth[Kv2SkeletonFrame::MAX_BODIES];
+		float yaw[Kv2SkeletonFrame::MAX_BODIES], scale[Kv2SkeletonFrame::MAX_BODIES];
+		int right = 0, counted = 0;
+		unsigned long long micros = 0;
+		vector<int> labels;
+		for(int n = 0; n < numFrames; n++)
+		{
+			frame.timeStamp = (LONGLONG)n * 333333;
+			for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+			{
+				if((n + body * 5) % holdLength == 0 || n == 0)
+				{
+					truth[body] = (int)(uniform(seed) * 8) % 8;
+					yaw[body] = (uniform(seed) * 2 - 1) * 40;
+					scale[body] = 0.8f + uniform(seed) * 0.4f;
+				}
+				ofVec3f position(body * 0.7f - 1.75f, -0.3f, 2 + body * 0.3f);
+				shapes[truth[body]].getJittered(10, seed).setBody(frame, body, yaw[body], scale[body], position);
+			}
+
+			unsigned long long start = ofGetElapsedTimeMicros();
+			const Kv2PoseFrame& result = classifier.classify(frame);
+			micros += ofGetElapsedTimeMicros() - start;
+
+			// once the hold has had time to switch over
+			for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+			{
+				labels.push_back(result.labels[body]);
+				if((n + body * 5) % holdLength >= classifier.holdFrames || n < holdLength)
+				{
+					right += result.labels[body] >= 0 && classifier.getLabelName(result.labels[body]) == names[truth[body]] ? 1 : 0;
+					counted++;
+				}
+			}
+		}
+
+		int differences = 0;
+		if(i == 0)
+		{
+			reference = labels;
+		}
+		for(size_t k = 0; k < labels.size() && k < reference.size(); k++)
+		{
+			differences += labels[k] != reference[k] ? 1 : 0;
+		}
+		ofLogNotice("ofxKinectPoseClassifier::benchmark") << ofxKinectDepthKernel::getIsaName((ofxKinectDepthKernel::Isa)i) << ": "
+			<< micros / (float)numFrames << " us/frame for " << (int)Kv2SkeletonFrame::MAX_BODIES << " bodies against " << classifier.getNumPoses()
+			<< " poses, " << right * 100.0f / counted << "% of held labels right, " << differences << " labels differ from scalar";
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectDepthKernel.h"
+#include "ofxKinectSkeletonFrame.h"
+
+#include <mutex>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// held poses by nearest neighbour in a library of labelled ones
+//
+// a pose is described by the direction of each of the skeleton's 24 bones, turned about the vertical so
+// the hips run along x: where the body stands, how tall it is and which way it faces drop out. bones
+// with a joint the sensor doesn't track get no weight, inferred ones half and the hands and feet a
+// quarter, since they are the noisiest. the distance between two poses is the weighted mean of the
+// squared differences between their bone directions, square rooted, which is about the angle between
+// the bones in radians.
+//
+// the library is stored eight poses to a block, each descriptor value of the eight next to each other,
+// so a block is compared on all eight at once on avx2, as two halves on sse2, and with every body of the
+// frame before the next block is read: the library goes through the cache once per frame, not per body.
+// a body's nearest pose only becomes its label once it has been for a few frames in a row, and a label
+// is kept while the body stays within a larger distance of it, so a pose doesn't flicker at the edge.
+//
+// the bridge classifies the filtered bodies of every frame on the capture thread once the frame has gone
+// out, and hands the labels to update() on their own. the library, labels and settings are behind a lock
+// taken for each call, so poses can be added or cleared from any thread while frames are classified.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// the label of every body of one body frame
+class Kv2PoseFrame
+{
+  public:
+	Kv2PoseFrame();
+	void clear();
+
+	LONGLONG timeStamp;
+	UINT64 trackingIds[Kv2SkeletonFrame::MAX_BODIES];
+	int labels[Kv2SkeletonFrame::MAX_BODIES];		///< -1 without one
+	float distances[Kv2SkeletonFrame::MAX_BODIES];	///< to the nearest pose of the library, about radians
+};
+
+class ofxKinectPoseClassifier
+{
+  public:
+	enum
+	{
+		NUM_BONES = 24,
+		DESCRIPTOR_SIZE = NUM_BONES * 3,
+		BLOCK_SIZE = 8	///< poses compared at once
+	};
+
+	class Descriptor
+	{
+	  public:
+		float directions[DESCRIPTOR_SIZE];	///< x, y, z of each bone
+		float weights[NUM_BONES];
+	};
+
+	/// false if the body isn't tracked or no bone has a direction
+	static bool getDescriptor(const Kv2SkeletonFrame& frame, int body, Descriptor& descriptor);
+
+	ofxKinectPoseClassifier();
+
+	/// the label's index, added if it is new
+	int addLabel(const string& name);
+	/// -1 if there is no such label
+	int findLabel(const string& name) const;
+	string getLabelName(int label) const;
+	int getNumLabels() const;
+
+	/// returns the pose's index, -1 if the body can't be described
+	int addPose(const string& label, const Kv2SkeletonFrame& frame, int body);
+	int addPose(const string& label, const Descriptor& descriptor);
+	/// every tracked body of every step'th frame of a recording, returns how many were added
+	int loadPoses(const string& path, const string& label, int firstFrame = 0, int lastFrame = -1, int step = 1);
+	void clearPoses();
+	int getNumPoses() const;
+
+	/// a body takes a label within enterDistance of it and keeps it up to exitDistance, about radians
+	void setDistances(float enterDistance = 0.3f, float exitDistance = 0.4f);
+	/// frames a new label or no label has to hold before it replaces the last
+	void setHoldFrames(int frames = 4);
+	/// use a slower instruction set than the cpu supports, e.g. to compare them
+	void setIsa(ofxKinectDepthKernel::Isa isa);
+	ofxKinectDepthKernel::Isa getIsa() const;
+
+	/// forget every body's label
+	void reset();
+	/// labels every body of the frame, the same frame again returns the last labels. the reference is only
+	/// safe while no other thread calls reset() or clearPoses()
+	const Kv2PoseFrame& classify(const Kv2SkeletonFrame& frame);
+	/// the same, copying the labels out before the lock is let go
+	void classify(const Kv2SkeletonFrame& frame, Kv2PoseFrame& labels);
+	const Kv2PoseFrame& getPoses() const;
+	/// the nearest pose's label without holding it, -1 for an empty library
+	int findNearest(const Descriptor& descriptor, float& distance);
+	/// time classify() took, smoothed over frames
+	float getClassifyMicros() const;
+
+	/// times classify() for six bodies against eight labels of posesPerLabel poses each on every supported
+	/// instruction set, logs how often the held labels are right, and checks the instruction sets agree
+	static void benchmark(int posesPerLabel = 512, int numFrames = 600);
+
+	typedef void (*DistanceFunction)(const float* library, int numBlocks, const float* queries, const float* weights, int numQueries, float* distances);
+
+  protected:
+	// the unlocked parts of the calls above, with libraryMutex held
+	int indexOfLabel(const string& name) const;
+	int insertLabel(const string& name);
+	void resetBodies();
+	void classifyBodies(const Kv2SkeletonFrame& frame);
+
+	/// false if the descriptor has no weight
+	bool setQuery(int query, const Descriptor& descriptor);
+	/// every query against every pose, into distances
+	void measure(int numQueries);
+	/// the query's nearest pose of the label, any with -1
+	int getNearest(int query, int label, float& distance) const;
+
+	mutable std::mutex libraryMutex;
+	vector<string> labelNames;
+
+	// BLOCK_SIZE poses per DESCRIPTOR_SIZE x BLOCK_SIZE block, the last one padded
+	vector<float> library;
+	vector<int> poseLabels;
+	int numPoses;
+
+	// up to one query per body, DESCRIPTOR_SIZE each
+	float queries[Kv2SkeletonFrame::MAX_BODIES * DESCRIPTOR_SIZE];
+	float weights[Kv2SkeletonFrame::MAX_BODIES * DESCRIPTOR_SIZE];
+	float queryWeights[Kv2SkeletonFrame::MAX_BODIES];	///< the sum of the bone weights
+	vector<float> distances;	///< squared and weighted, of every query to every pose, query major
+
+	float enterDistance;
+	float exitDistance;
+	int holdFrames;
+	ofxKinectDepthKernel::Isa isa;
+
+	// per body
+	int candidates[Kv2SkeletonFrame::MAX_BODIES];
+	int candidateFrames[Kv2SkeletonFrame::MAX_BODIES];
+	Kv2PoseFrame poses;
+	float classifyMicros;
+};
@@ -0,0 +1,379 @@
+#include "ofxKinectRecorder.h"
+#include "ofxKinectFrameBundle.h"
+#include "ofxKinectDepthCodec.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// grow or shrink the file without writing anything into it
+static bool resizeFile(FILE* file, unsigned long long size)
+{
+	fflush(file);
+#ifdef _WIN32
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	LARGE_INTEGER zero, current, end;
+	zero.QuadPart = 0;
+	end.QuadPart = size;
+	if(!SetFilePointerEx(handle, zero, &current, FILE_CURRENT))
+	{
+		return false;
+	}
+	bool bResized = SetFilePointerEx(handle, end, NULL, FILE_BEGIN) && SetEndOfFile(handle);
+	SetFilePointerEx(handle, current, NULL, FILE_BEGIN);
+	return bResized;
+#else
+	return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+static bool seekFile(FILE* file, unsigned long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, offset, SEEK_SET) == 0;
+#endif
+}
+
+template<typename Slot>
+static unsigned int getSlotSize(const Slot& slot)
+{
+	return slot.pixels.getWidth() * slot.pixels.getHeight() * slot.pixels.getNumChannels() * sizeof(*slot.pixels.getPixels());
+}
+
+//---------------------------------------------------------------------------
+ofxKinectRecorder::ofxKinectRecorder()
+	: file(NULL)
+	, bCompress(false)
+	, position(0)
+	, allocated(0)
+	, preallocationSize(1ULL << 30)
+	, bFailed(false)
+	, maxQueuedFrames(4)
+	, bClosing(false)
+	, framesWritten(0)
+	, framesDropped(0)
+	, bytesWritten(0)
+	, openedMicros(0)
+{
+}
+
+ofxKinectRecorder::~ofxKinectRecorder()
+{
+	close();
+}
+
+void ofxKinectRecorder::setMaxQueuedFrames(int count)
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	maxQueuedFrames = MAX(count, 1);
+}
+
+void ofxKinectRecorder::setPreallocationSize(unsigned long long bytes)
+{
+	preallocationSize = bytes;
+}
+
+void ofxKinectRecorder::setCompression(bool _bCompress)
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	bCompress = _bCompress;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectRecorder::open(const string& path, const Kv2RecordingHeader& _header)
+{
+	close();
+
+	file = fopen(ofToDataPath(path).c_str(), "wb");
+	if(file == NULL)
+	{
+		ofLogError("ofxKinectRecorder::open") << "Cannot open " << path;
+		return false;
+	}
+	// the pixels go out in large pieces straight from the bundles, a stdio buffer would only add a copy
+	setvbuf(file, NULL, _IONBF, 0);
+
+	header = _header;
+	header.frameCount = 0;
+	header.indexOffset = 0;
+	index.clear();
+	position = 0;
+	allocated = 0;
+	bFailed = false;
+	bClosing = false;
+	framesWritten = framesDropped = bytesWritten = 0;
+	openedMicros = ofGetElapsedTimeMicros();
+
+	// the final header goes over this one on close()
+	scratch.assign(Kv2RecordingLayout::align(sizeof(header)), 0);
+	memcpy(&scratch[0], &header, sizeof(header));
+	if(!reserve(scratch.size()) || fwrite(&scratch[0], 1, scratch.size(), file) != scratch.size())
+	{
+		ofLogError("ofxKinectRecorder::open") << "Cannot write to " << path;
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	position = scratch.size();
+
+	startThread(true, false);
+	return true;
+}
+
+void ofxKinectRecorder::close()
+{
+	if(file == NULL)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> guard(queueMutex);
+		bClosing = true;
+	}
+	queueChanged.notify_all();
+	waitForThread(true);
+
+	if(!bFailed)
+	{
+		header.indexOffset = position;
+		header.frameCount = index.size();
+		size_t indexBytes = index.size() * sizeof(Kv2RecordingIndexEntry);
+		if(indexBytes > 0 && fwrite(&index[0], 1, indexBytes, file) != indexBytes)
+		{
+			ofLogError("ofxKinectRecorder::close") << "Failed to write the index, the player will rebuild it";
+			header.indexOffset = 0;
+			header.frameCount = 0;
+		}
+		position += indexBytes;
+	}
+
+	// give back what was grown ahead and put the final header in place
+	resizeFile(file, position);
+	seekFile(file, 0);
+	fwrite(&header, 1, sizeof(header), file);
+	fclose(file);
+	file = NULL;
+
+	ofLogVerbose("ofxKinectRecorder::close") << framesWritten << " frames written, " << framesDropped << " dropped, "
+		<< getMegabytesPerSecond() << " MB/s";
+}
+
+bool ofxKinectRecorder::isRecording()
+{
+	return file != NULL && isThreadRunning();
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectRecorder::write(const ofxKinectFrameRef<Kv2FrameBundle>& frame)
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	if(file == NULL || bClosing || !frame.isValid())
+	{
+		return false;
+	}
+	if(bFailed || (int)queue.size() >= maxQueuedFrames)
+	{
+		framesDropped++;
+		return false;
+	}
+	queue.push_back(frame);
+	queueChanged.notify_one();
+	return true;
+}
+
+unsigned long long ofxKinectRecorder::getNumFramesWritten()
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	return framesWritten;
+}
+
+unsigned long long ofxKinectRecorder::getNumFramesDropped()
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	return framesDropped;
+}
+
+int ofxKinectRecorder::getNumQueuedFrames()
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	return queue.size();
+}
+
+float ofxKinectRecorder::getMegabytesPerSecond()
+{
+	std::unique_lock<std::mutex> guard(queueMutex);
+	unsigned long long elapsed = ofGetElapsedTimeMicros() - openedMicros;
+	return elapsed > 0 ? bytesWritten / (float)elapsed : 0;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectRecorder::threadedFunction()
+{
+	while(true)
+	{
+		ofxKinectFrameRef<Kv2FrameBundle> frame;
+		{
+			std::unique_lock<std::mutex> guard(queueMutex);
+			while(queue.empty() && !bClosing)
+			{
+				queueChanged.wait(guard);
+			}
+			if(queue.empty())
+			{
+				break;
+			}
+			frame = queue.front();
+			queue.pop_front();
+		}
+
+		if(!writeFrame(*frame))
+		{
+			ofLogError("ofxKinectRecorder::threadedFunction") << "Failed to write a frame, the rest of the recording is dropped";
+			std::unique_lock<std::mutex> guard(queueMutex);
+			bFailed = true;
+			framesDropped += queue.size() + 1;
+			queue.clear();
+		}
+		// back to the pool as soon as it is on disk
+		frame.release();
+	}
+}
+
+bool ofxKinectRecorder::reserve(unsigned long long size)
+{
+	if(size > allocated)
+	{
+		// not being able to grow ahead only costs speed
+		allocated = size + preallocationSize;
+		if(!resizeFile(file, allocated))
+		{
+			ofLogVerbose("ofxKinectRecorder::reserve") << "Cannot grow the file ahead of the writes";
+		}
+	}
+	return true;
+}
+
+bool ofxKinectRecorder::writeFrame(Kv2FrameBundle& bundle)
+{
+	if(bFailed)
+	{
+		return false;
+	}
+
+	Kv2RecordedFrameHeader frame;
+	memset(&frame, 0, sizeof(frame));
+	memcpy(frame.magic, "KV2F", 4);
+	frame.sequence = bundle.sequence;
+	frame.timeStamp = bundle.timeStamp;
+	frame.bodyTimeStamp = bundle.bodies.timeStamp;
+
+	const void* data[KV2_STREAM_COUNT] = { NULL };
+	unsigned int available[KV2_STREAM_COUNT] = { 0 };
+	data[KV2_STREAM_DEPTH] = bundle.depth.pixels.getPixels();
+	available[KV2_STREAM_DEPTH] = getSlotSize(bundle.depth);
+	frame.streamTimeStamps[KV2_STREAM_DEPTH] = bundle.depth.frame.TimeStamp;
+	data[KV2_STREAM_INFRARED] = bundle.infrared.pixels.getPixels();
+	available[KV2_STREAM_INFRARED] = getSlotSize(bundle.infrared);
+	frame.streamTimeStamps[KV2_STREAM_INFRARED] = bundle.infrared.frame.TimeStamp;
+	data[KV2_STREAM_COLOR] = bundle.color.pixels.getPixels();
+	available[KV2_STREAM_COLOR] = getSlotSize(bundle.color);
+	frame.streamTimeStamps[KV2_STREAM_COLOR] = bundle.color.frame.TimeStamp;
+	data[KV2_STREAM_BODY_INDEX] = bundle.bodyIndex.pixels.getPixels();
+	available[KV2_STREAM_BODY_INDEX] = getSlotSize(bundle.bodyIndex);
+	frame.streamTimeStamps[KV2_STREAM_BODY_INDEX] = bundle.bodyIndex.frame.TimeStamp;
+
+	bool bCompressing;
+	{
+		std::unique_lock<std::mutex> guard(queueMutex);
+		bCompressing = bCompress;
+	}
+
+	for(int i = 0; i < KV2_STREAM_COUNT; i++)
+	{
+		frame.streamSizes[i] = header.getStreamSize((Kv2RecordedStream)i);
+		if(frame.streamSizes[i] > available[i])
+		{
+			ofLogError("ofxKinectRecorder::writeFrame") << "Stream " << i << " of the bundle is smaller than the recording header says";
+			return false;
+		}
+
+		bool bCodecStream = i == KV2_STREAM_DEPTH || i == KV2_STREAM_INFRARED;
+		if(bCompressing && bCodecStream && frame.streamSizes[i] > 0 && header.streams[i].bytesPerPixel == sizeof(unsigned short)
+			&& ofxKinectDepthCodec::encode((const unsigned short*)data[i], header.streams[i].width, header.streams[i].height, encoded[i]))
+		{
+			data[i] = &encoded[i][0];
+			frame.streamSizes[i] = encoded[i].size();
+			frame.compressedStreams |= 1 << i;
+		}
+	}
+	frame.bodiesSize = header.bodyCount * sizeof(Kv2RecordedBody);
+	frame.size = Kv2RecordingLayout::getBodiesOffset(frame) + Kv2RecordingLayout::align(frame.bodiesSize);
+	reserve(position + frame.size);
+
+	static const unsigned char padding[Kv2RecordingLayout::ALIGNMENT] = { 0 };
+	unsigned int headerSize = Kv2RecordingLayout::align(sizeof(frame));
+	scratch.assign(headerSize, 0);
+	memcpy(&scratch[0], &frame, sizeof(frame));
+	bool bWritten = fwrite(&scratch[0], 1, headerSize, file) == headerSize;
+
+	for(int i = 0; i < KV2_STREAM_COUNT && bWritten; i++)
+	{
+		unsigned int size = frame.streamSizes[i];
+		unsigned int pad = Kv2RecordingLayout::align(size) - size;
+		bWritten = (size == 0 || fwrite(data[i], 1, size, file) == size) && (pad == 0 || fwrite(padding, 1, pad, file) == pad);
+	}
+
+	if(frame.bodiesSize > 0 && bWritten)
+	{
+		scratch.assign(Kv2RecordingLayout::align(frame.bodiesSize), 0);
+		Kv2RecordedBody* bodies = (Kv2RecordedBody*)&scratch[0];
+		const Kv2SkeletonFrame& skeletons = bundle.bodies;
+		for(unsigned int b = 0; b < header.bodyCount && b < Kv2SkeletonFrame::MAX_BODIES; b++)
+		{
+			bodies[b].tracked = skeletons.tracked[b];
+			bodies[b].trackingId = (unsigned int)skeletons.trackingIds[b];
+
+			for(int j = 0; j < JointType_Count; j++)
+			{
+				const ofVec3f& position = skeletons.positions[b][j];
+				const ofQuaternion& orientation = skeletons.orientations[b][j];
+
+				Joint& joint = bodies[b].joints[j];
+				joint.JointType = (JointType)j;
+				joint.Position.X = position.x;
+				joint.Position.Y = position.y;
+				joint.Position.Z = position.z;
+				joint.TrackingState = skeletons.trackingStates[b][j];
+
+				JointOrientation& jointOrientation = bodies[b].orientations[j];
+				jointOrientation.JointType = (JointType)j;
+				jointOrientation.Orientation.x = orientation.x();
+				jointOrientation.Orientation.y = orientation.y();
+				jointOrientation.Orientation.z = orientation.z();
+				jointOrientation.Orientation.w = orientation.w();
+			}
+		}
+		bWritten = fwrite(&scratch[0], 1, scratch.size(), file) == scratch.size();
+	}
+
+	if(!bWritten)
+	{
+		return false;
+	}
+
+	Kv2RecordingIndexEntry entry;
+	entry.offset = position;
+	entry.timeStamp = frame.timeStamp;
+	index.push_back(entry);
+	position += frame.size;
+
+	std::unique_lock<std::mutex> guard(queueMutex);
+	framesWritten++;
+	bytesWritten += frame.size;
+	return true;
+}
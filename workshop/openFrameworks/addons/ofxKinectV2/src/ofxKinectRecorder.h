@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+#include "ofxKinectFramePool.h"
+#include "ofxKinectRecordingFormat.h"
+
+class Kv2FrameBundle;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// writes frame bundles to a recording on its own thread
+//
+// write() only queues a reference to the pooled bundle, nothing is copied and the capture thread never
+// waits on the disk. the writer thread puts the pixels straight from the bundle into the file and
+// releases the reference. the file is grown in large steps ahead of the writes so the file system
+// doesn't have to extend it on every frame, and trimmed to what was written on close(). raw color and
+// depth at 30 fps is about 250 MB/s; when the disk can't keep up the queue fills and frames are dropped
+// and counted instead of holding up capture. the queued frames come out of the bridge's frame pool, so
+// raise setFramePoolSize() by the queue length.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectRecorder : protected ofThread
+{
+  public:
+	ofxKinectRecorder();
+	~ofxKinectRecorder();
+
+	/// frames waiting for the disk before write() starts dropping them
+	void setMaxQueuedFrames(int count = 4);
+	/// how far ahead of the writes the file is grown
+	void setPreallocationSize(unsigned long long bytes = 1ULL << 30);
+	/// store depth and infrared losslessly compressed with ofxKinectDepthCodec, to about a third of the
+	/// disk bandwidth for a few milliseconds of the writer thread per frame
+	void setCompression(bool bCompress);
+
+	/// header describes the streams every frame will have
+	bool open(const string& path, const Kv2RecordingHeader& header);
+	/// writes what is still queued, the index and the final header
+	void close();
+	bool isRecording();
+
+	/// queue a frame, false if it was dropped because the queue was full
+	bool write(const ofxKinectFrameRef<Kv2FrameBundle>& frame);
+
+	unsigned long long getNumFramesWritten();
+	unsigned long long getNumFramesDropped();
+	int getNumQueuedFrames();
+	/// average write rate since open()
+	float getMegabytesPerSecond();
+
+  protected:
+	void threadedFunction();
+	bool writeFrame(Kv2FrameBundle& bundle);
+	bool reserve(unsigned long long size);
+
+	FILE* file;
+	Kv2RecordingHeader header;
+	vector<Kv2RecordingIndexEntry> index;
+	vector<unsigned char> scratch;
+	bool bCompress;
+	vector<unsigned char> encoded[KV2_STREAM_COUNT];
+	unsigned long long position;
+	unsigned long long allocated;
+	unsigned long long preallocationSize;
+	bool bFailed;
+
+	std::mutex queueMutex;
+	std::condition_variable queueChanged;
+	std::deque<ofxKinectFrameRef<Kv2FrameBundle> > queue;
+	int maxQueuedFrames;
+	bool bClosing;
+
+	unsigned long long framesWritten;
+	unsigned long long framesDropped;
+	unsigned long long bytesWritten;
+	unsigned long long openedMicros;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string.h>
+
+#include "ofxKinectTypes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// layout of a recording, shared by ofxKinectRecorder and ofxKinectPlayer
+//
+// a file header, then one record per frame, then an index of every frame's offset and timestamp. a record
+// is a frame header followed by the pixels of each recorded stream and the bodies, every part starting on
+// a 64 byte boundary so the pixels can be used straight from a memory mapped file. the recorder patches
+// the index position into the file header when it closes; a recording that was cut short has none and
+// the player rebuilds the index by walking the records. depth and infrared can be stored compressed, so
+// the stream sizes differ from frame to frame. all values are little endian.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+enum Kv2RecordedStream
+{
+	KV2_STREAM_DEPTH,
+	KV2_STREAM_INFRARED,
+	KV2_STREAM_COLOR,
+	KV2_STREAM_BODY_INDEX,
+	KV2_STREAM_COUNT
+};
+
+class Kv2RecordingHeader
+{
+  public:
+	Kv2RecordingHeader()
+	{
+		memset(this, 0, sizeof(*this));
+		memcpy(magic, "KV2R", 4);
+		version = 1;
+	}
+
+	bool hasStream(Kv2RecordedStream stream) const
+	{
+		return (streamMask & (1 << stream)) != 0;
+	}
+
+	/// bytes of one frame of a stream, 0 if it isn't recorded
+	unsigned int getStreamSize(Kv2RecordedStream stream) const
+	{
+		return hasStream(stream) ? streams[stream].width * streams[stream].height * streams[stream].bytesPerPixel : 0;
+	}
+
+	char magic[4];
+	unsigned int version;
+	unsigned int streamMask;	///< 1 << Kv2RecordedStream for every recorded stream
+	unsigned int bodyCount;		///< bodies per frame, 0 without skeletons
+	KCBFrameDescription streams[KV2_STREAM_COUNT];
+	int colorFormat;			///< ColorImageFormat of the color stream
+	unsigned int frameCount;	///< 0 until the recorder closes the file
+	unsigned long long indexOffset;
+};
+
+class Kv2RecordedFrameHeader
+{
+  public:
+	char magic[4];				///< KV2F
+	unsigned int size;			///< the whole record, header and padding included
+	unsigned long long sequence;
+	LONGLONG timeStamp;
+	LONGLONG bodyTimeStamp;
+	LONGLONG streamTimeStamps[KV2_STREAM_COUNT];
+	unsigned int streamSizes[KV2_STREAM_COUNT];	///< bytes stored for each stream, 0 if it isn't recorded
+	unsigned int bodiesSize;
+	unsigned int compressedStreams;	///< 1 << Kv2RecordedStream for every stream stored with ofxKinectDepthCodec
+};
+
+class Kv2RecordedBody
+{
+  public:
+	unsigned int tracked;
+	unsigned int trackingId;	///< the low bits of the sensor's tracking id, 0 in older recordings
+	Joint joints[JointType_Count];
+	JointOrientation orientations[JointType_Count];
+};
+
+class Kv2RecordingIndexEntry
+{
+  public:
+	unsigned long long offset;
+	LONGLONG timeStamp;
+};
+
+class Kv2RecordingLayout
+{
+  public:
+	enum { ALIGNMENT = 64 };
+
+	static unsigned int align(unsigned int size)
+	{
+		return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
+	/// where a stream's data starts inside a record, the streams follow each other in Kv2RecordedStream order
+	static unsigned int getStreamOffset(const Kv2RecordedFrameHeader& frame, Kv2RecordedStream stream)
+	{
+		unsigned int offset = align(sizeof(Kv2RecordedFrameHeader));
+		for(int i = 0; i < stream; i++)
+		{
+			offset += align(frame.streamSizes[i]);
+		}
+		return offset;
+	}
+
+	static unsigned int getBodiesOffset(const Kv2RecordedFrameHeader& frame)
+	{
+		return getStreamOffset(frame, KV2_STREAM_COUNT);
+	}
+
+	/// whether the streams and bodies end inside the record, summed wide so damaged sizes can't wrap around
+	static bool fits(const Kv2RecordedFrameHeader& frame)
+	{
+		unsigned long long end = align(sizeof(Kv2RecordedFrameHeader));
+		for(int i = 0; i < KV2_STREAM_COUNT; i++)
+		{
+			end += (frame.streamSizes[i] + (unsigned long long)ALIGNMENT - 1) & ~(unsigned long long)(ALIGNMENT - 1);
+		}
+		return end + frame.bodiesSize <= frame.size;
+	}
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectRecordingFormat.h"
+#include "ofxKinectDepthProjector.h"
+
+class Kv2FrameBundle;
+class Kv2SkeletonFrame;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// where ofxKinectCommonBridge's frames come from
+//
+// the bridge opens a backend in initSensor(), asks it for the size of every stream it enables and then
+// polls isFrameReady() and calls readFrame() from its capture thread, so the whole pipeline behind it
+// (frame pool, triple buffer, recorder, mappings) is the same whatever produces the frames.
+// ofxKinectKCBBackend is the sensor through the common bridge library, ofxKinectSyntheticBackend renders
+// a scene without any hardware. readFrame() is only ever called from the capture thread, the rest
+// before start() or after stop().
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectSensorBackend
+{
+  public:
+	virtual ~ofxKinectSensorBackend() {}
+
+	virtual bool open() = 0;
+	virtual void close() = 0;
+	virtual bool isOpen() const = 0;
+
+	/// size of a stream's frames, false if the backend doesn't have the stream
+	virtual bool getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description) = 0;
+	/// called before readFrame() is asked for bodies
+	virtual bool openBodyStream() = 0;
+
+	/// time between frames, 0 if the backend delivers as fast as it is read
+	virtual float getFramePeriodMicros() const = 0;
+	/// a frame can be read without waiting
+	virtual bool isFrameReady() = 0;
+	/// the streams in streamMask (1 << Kv2RecordedStream) into the bundle's slots, which are allocated to
+	/// the stream descriptions, and the bundle's bodies with bBodies. timestamps in 100ns ticks
+	virtual bool readFrame(Kv2FrameBundle& bundle, unsigned int streamMask, bool bBodies) = 0;
+
+	/// the ray of every depth pixel, false until the backend knows them
+	virtual bool setupDepthProjector(ofxKinectDepthProjector& projector, int width, int height) = 0;
+	/// the common bridge library's handle for its coordinate mapping, 0 without a sensor behind the backend
+	virtual KCBHANDLE getHandle() const { return 0; }
+};
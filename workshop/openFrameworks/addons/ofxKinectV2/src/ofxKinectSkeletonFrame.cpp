@@ -0,0 +1,68 @@
+#include "ofxKinectSkeletonFrame.h"
+
+//---------------------------------------------------------------------------
+Kv2SkeletonFrame::Kv2SkeletonFrame()
+{
+	clear();
+}
+
+void Kv2SkeletonFrame::clear()
+{
+	timeStamp = 0;
+	for(int body = 0; body < MAX_BODIES; body++)
+	{
+		setUntracked(body);
+	}
+}
+
+//---------------------------------------------------------------------------
+void Kv2SkeletonFrame::setBody(int body, UINT64 trackingId, const _Joint* kcbJoints, const _JointOrientation* kcbOrientations)
+{
+	tracked[body] = true;
+	trackingIds[body] = trackingId;
+	for(int j = 0; j < NUM_JOINTS; j++)
+	{
+		// the sdk hands them out in JointType order, but nothing promises it
+		const _Joint& joint = kcbJoints[j];
+		positions[body][joint.JointType].set(joint.Position.X, joint.Position.Y, joint.Position.Z);
+		trackingStates[body][joint.JointType] = joint.TrackingState;
+
+		const Vector4& q = kcbOrientations[j].Orientation;
+		orientations[body][kcbOrientations[j].JointType].set(q.x, q.y, q.z, q.w);
+	}
+}
+
+void Kv2SkeletonFrame::setUntracked(int body)
+{
+	tracked[body] = false;
+	trackingIds[body] = 0;
+	for(int j = 0; j < NUM_JOINTS; j++)
+	{
+		positions[body][j].set(0, 0, 0);
+		orientations[body][j].set(0, 0, 0, 1);
+		trackingStates[body][j] = TrackingState_NotTracked;
+	}
+}
+
+//---------------------------------------------------------------------------
+int Kv2SkeletonFrame::getNumTracked() const
+{
+	int count = 0;
+	for(int body = 0; body < MAX_BODIES; body++)
+	{
+		count += tracked[body] ? 1 : 0;
+	}
+	return count;
+}
+
+int Kv2SkeletonFrame::findBody(UINT64 trackingId) const
+{
+	for(int body = 0; body < MAX_BODIES; body++)
+	{
+		if(tracked[body] && trackingIds[body] == trackingId)
+		{
+			return body;
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTypes.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// every body of one body frame, by joint
+//
+// positions, orientations and tracking states are arrays of BODY_COUNT x JointType_Count, each joint at
+// its JointType, so a reader indexes straight into them and a frame is filled and copied without touching
+// the heap. bodies keep the slot the sensor gave them for as long as they are tracked; trackingIds tells
+// the people apart across frames. the bundle's frame is only written by the capture thread before the
+// bundle is published, the bridge hands it out as a const reference.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class Kv2SkeletonFrame
+{
+  public:
+	enum
+	{
+		MAX_BODIES = BODY_COUNT,
+		NUM_JOINTS = JointType_Count
+	};
+
+	Kv2SkeletonFrame();
+
+	/// no body tracked
+	void clear();
+	/// a tracked body from the sdk's joint and orientation arrays, each joint lands at its JointType
+	void setBody(int body, UINT64 trackingId, const _Joint* kcbJoints, const _JointOrientation* kcbOrientations);
+	void setUntracked(int body);
+
+	int getNumTracked() const;
+	/// the slot of the body with the tracking id, -1 if it isn't tracked
+	int findBody(UINT64 trackingId) const;
+
+	const ofVec3f& getPosition(int body, JointType joint) const { return positions[body][joint]; }
+	const ofQuaternion& getOrientation(int body, JointType joint) const { return orientations[body][joint]; }
+	TrackingState getTrackingState(int body, JointType joint) const { return trackingStates[body][joint]; }
+
+	LONGLONG timeStamp;		///< 100ns ticks, of the sensor's body frame
+	bool tracked[MAX_BODIES];
+	UINT64 trackingIds[MAX_BODIES];	///< 0 for a slot without a body
+	ofVec3f positions[MAX_BODIES][NUM_JOINTS];	///< camera space, meters
+	ofQuaternion orientations[MAX_BODIES][NUM_JOINTS];
+	TrackingState trackingStates[MAX_BODIES][NUM_JOINTS];
+};
@@ -0,0 +1,252 @@
+#include "ofxKinectSkeletonInterpolator.h"
+
+//---------------------------------------------------------------------------
+ofxKinectSkeletonInterpolator::ofxKinectSkeletonInterpolator()
+	: horizonMicros(50000)
+{
+	reset();
+}
+
+void ofxKinectSkeletonInterpolator::setHorizonMicros(float micros)
+{
+	horizonMicros = MAX(micros, 0.0f);
+}
+
+float ofxKinectSkeletonInterpolator::getHorizonMicros() const
+{
+	return horizonMicros;
+}
+
+void ofxKinectSkeletonInterpolator::reset()
+{
+	previous.clear();
+	newest.clear();
+	result.clear();
+	numFrames = 0;
+	numOffsets = 0;
+	nextOffset = 0;
+	clockOffset = 0;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectSkeletonInterpolator::push(const Kv2SkeletonFrame& frame, unsigned long long arrivalMicros)
+{
+	if(numFrames > 0 && frame.timeStamp == newest.timeStamp)
+	{
+		return;
+	}
+	// a recording that looped, nothing carries over
+	if(numFrames > 0 && frame.timeStamp < newest.timeStamp)
+	{
+		reset();
+	}
+
+	previous = newest;
+	newest = frame;
+	numFrames = MIN(numFrames + 1, 2);
+	// blending across a gap of a second says nothing about the motion in between
+	if(numFrames == 2 && newest.timeStamp - previous.timeStamp > 10000000)
+	{
+		numFrames = 1;
+	}
+	if(numFrames == 2)
+	{
+		prepare();
+	}
+
+	// a frame that waited in a queue only makes the offset larger, the smallest is the closest to the truth
+	offsets[nextOffset] = (LONGLONG)arrivalMicros * 10 - frame.timeStamp;
+	nextOffset = (nextOffset + 1) % NUM_OFFSETS;
+	numOffsets = MIN(numOffsets + 1, (int)NUM_OFFSETS);
+	clockOffset = offsets[0];
+	for(int i = 1; i < numOffsets; i++)
+	{
+		clockOffset = MIN(clockOffset, offsets[i]);
+	}
+}
+
+bool ofxKinectSkeletonInterpolator::hasFrames() const
+{
+	return numFrames > 0;
+}
+
+void ofxKinectSkeletonInterpolator::prepare()
+{
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		blending[body] = newest.tracked[body] && previous.tracked[body] && newest.trackingIds[body] == previous.trackingIds[body];
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS && blending[body]; j++)
+		{
+			jointBlending[body][j] = newest.trackingStates[body][j] != TrackingState_NotTracked
+				&& previous.trackingStates[body][j] != TrackingState_NotTracked;
+			delta[body][j] = newest.positions[body][j] - previous.positions[body][j];
+
+			// q and -q are the same turn, take the short way round
+			const ofVec4f& a = previous.orientations[body][j].asVec4();
+			ofVec4f b = newest.orientations[body][j].asVec4();
+			float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+			if(cosine < 0)
+			{
+				b.set(-b.x, -b.y, -b.z, -b.w);
+				cosine = -cosine;
+			}
+			target[body][j].set(b.x, b.y, b.z, b.w);
+
+			// below a few hundredths of a degree the sines lose their digits, a lerp is as close
+			if(cosine > 0.99999f)
+			{
+				angle[body][j] = 0;
+				inverseSin[body][j] = 0;
+			}
+			else
+			{
+				angle[body][j] = acosf(cosine);
+				inverseSin[body][j] = 1.0f / sinf(angle[body][j]);
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+const Kv2SkeletonFrame& ofxKinectSkeletonInterpolator::getFrameAt(LONGLONG timeStamp)
+{
+	if(numFrames < 2)
+	{
+		return newest;
+	}
+
+	// 0 is the previous frame, 1 the newest, past it the same path carries on up to the horizon
+	double period = (double)(newest.timeStamp - previous.timeStamp);
+	double t = (timeStamp - previous.timeStamp) / period;
+	t = MAX(t, 0.0);
+	t = MIN(t, 1.0 + horizonMicros * 10 / period);
+	float weight = (float)t;
+
+	result = newest;
+	result.timeStamp = previous.timeStamp + (LONGLONG)(t * period);
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		if(!blending[body])
+		{
+			continue;
+		}
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			if(!jointBlending[body][j])
+			{
+				continue;
+			}
+			result.positions[body][j] = previous.positions[body][j] + delta[body][j] * weight;
+
+			const ofVec4f& a = previous.orientations[body][j].asVec4();
+			const ofVec4f& b = target[body][j].asVec4();
+			if(angle[body][j] > 0)
+			{
+				float from = sinf((1 - weight) * angle[body][j]) * inverseSin[body][j];
+				float to = sinf(weight * angle[body][j]) * inverseSin[body][j];
+				result.orientations[body][j].set(a.x * from + b.x * to, a.y * from + b.y * to, a.z * from + b.z * to, a.w * from + b.w * to);
+			}
+			else
+			{
+				ofVec4f q = a + (b - a) * weight;
+				float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+				result.orientations[body][j].set(q.x / length, q.y / length, q.z / length, q.w / length);
+			}
+		}
+	}
+	return result;
+}
+
+const Kv2SkeletonFrame& ofxKinectSkeletonInterpolator::getFrameAtMicros(unsigned long long micros)
+{
+	return getFrameAt(getTimeStampAt(micros));
+}
+
+LONGLONG ofxKinectSkeletonInterpolator::getTimeStampAt(unsigned long long micros) const
+{
+	if(numOffsets == 0)
+	{
+		return 0;
+	}
+	return (LONGLONG)micros * 10 - clockOffset;
+}
+
+const Kv2SkeletonFrame& ofxKinectSkeletonInterpolator::getPreviousFrame() const
+{
+	return previous;
+}
+
+const Kv2SkeletonFrame& ofxKinectSkeletonInterpolator::getNewestFrame() const
+{
+	return newest;
+}
+
+//---------------------------------------------------------------------------
+static void setBenchmarkFrame(Kv2SkeletonFrame& frame, double seconds)
+{
+	// six people, each joint circling 15cm at half a hertz and turning 90 degrees a second
+	frame.timeStamp = (LONGLONG)(seconds * 10000000 + 0.5);
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		frame.tracked[body] = true;
+		frame.trackingIds[body] = body + 1;
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			double phase = seconds * PI + j * 0.2;
+			frame.positions[body][j].set(body * 0.3f - 0.75f + (float)cos(phase) * 0.15f, j * 0.07f - 0.8f, 2.5f + (float)sin(phase) * 0.15f);
+			frame.orientations[body][j].makeRotate((float)(seconds * 90 + j * 10), ofVec3f(0.3f, 1, 0.1f));
+			frame.trackingStates[body][j] = TrackingState_Tracked;
+		}
+	}
+}
+
+static void measureBenchmarkError(const Kv2SkeletonFrame& frame, const Kv2SkeletonFrame& truth, float& positionError, float& angleError)
+{
+	positionError = 0;
+	angleError = 0;
+	for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+	{
+		for(int j = 0; j < Kv2SkeletonFrame::NUM_JOINTS; j++)
+		{
+			positionError = MAX(positionError, frame.positions[body][j].distance(truth.positions[body][j]));
+			const ofVec4f& a = frame.orientations[body][j].asVec4();
+			const ofVec4f& b = truth.orientations[body][j].asVec4();
+			double cosine = fabs((double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z + (double)a.w * b.w);
+			angleError = MAX(angleError, (float)(2 * acos(MIN(cosine, 1.0)) * RAD_TO_DEG));
+		}
+	}
+}
+
+void ofxKinectSkeletonInterpolator::benchmark(int iterations)
+{
+	const double period = 1 / 30.0;
+	Kv2SkeletonFrame frame, truth;
+
+	ofxKinectSkeletonInterpolator interpolator;
+	interpolator.setHorizonMicros((float)(period * 1000000));
+	setBenchmarkFrame(frame, 0);
+	interpolator.push(frame, 0);
+	setBenchmarkFrame(frame, period);
+	interpolator.push(frame, 1000);
+
+	// halfway between the frames and half a frame past the newest
+	const char* names[2] = { "between", "ahead" };
+	double times[2] = { period * 0.5, period * 1.5 };
+	for(int k = 0; k < 2; k++)
+	{
+		LONGLONG timeStamp = (LONGLONG)(times[k] * 10000000 + 0.5);
+		unsigned long long start = ofGetElapsedTimeMicros();
+		for(int n = 0; n < iterations; n++)
+		{
+			interpolator.getFrameAt(timeStamp);
+		}
+		float micros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+
+		setBenchmarkFrame(truth, times[k]);
+		float positionError, angleError;
+		measureBenchmarkError(interpolator.getFrameAt(timeStamp), truth, positionError, angleError);
+		ofLogNotice("ofxKinectSkeletonInterpolator::benchmark") << names[k] << ": " << micros << " us per query of "
+			<< (int)Kv2SkeletonFrame::MAX_BODIES << " bodies, " << positionError * 1000 << " mm and " << angleError
+			<< " degrees from the path at most";
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectSkeletonFrame.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// bodies at any time, between sensor frames or a little past the newest
+//
+// bodies come at 30hz, frames are drawn at 60 to 144. the interpolator keeps the last two frames and
+// answers for a time between them by lerping the positions and slerping the orientations, or past the
+// newest by carrying on along the same path, which is extrapolating with the velocity between the two
+// frames, at most the horizon ahead. the slerp angles are worked out once per frame pushed, so a query
+// is a lerp and two sines per joint. a body is only blended while its slot keeps the same tracking id,
+// a joint while it is tracked in both frames, otherwise they come out as in the newest frame.
+//
+// times are either sensor timestamps or ofGetElapsedTimeMicros(). the offset between the two clocks is
+// the smallest seen over the last second of frames, the time a frame takes to arrive past that can't
+// be seen from the timestamps, ask for a time further ahead to cover it.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectSkeletonInterpolator
+{
+  public:
+	ofxKinectSkeletonInterpolator();
+
+	/// how far past the newest frame to extrapolate, later times get the bodies at the horizon
+	void setHorizonMicros(float micros = 50000);
+	float getHorizonMicros() const;
+
+	/// forget both frames
+	void reset();
+	/// a frame and when it arrived, by ofGetElapsedTimeMicros(). the same frame again is ignored, an older one
+	/// starts over
+	void push(const Kv2SkeletonFrame& frame, unsigned long long arrivalMicros);
+	bool hasFrames() const;
+
+	/// the bodies at a sensor timestamp, valid until the next call. allocates nothing
+	const Kv2SkeletonFrame& getFrameAt(LONGLONG timeStamp);
+	/// the bodies at a time of ofGetElapsedTimeMicros(), e.g. when the frame being drawn will be shown
+	const Kv2SkeletonFrame& getFrameAtMicros(unsigned long long micros);
+	/// the sensor timestamp at a time of ofGetElapsedTimeMicros()
+	LONGLONG getTimeStampAt(unsigned long long micros) const;
+
+	const Kv2SkeletonFrame& getPreviousFrame() const;
+	const Kv2SkeletonFrame& getNewestFrame() const;
+
+	/// times getFrameAt() between and past two frames of six bodies moving and turning, and logs how far the
+	/// midpoint is from the exact path
+	static void benchmark(int iterations = 10000);
+
+	enum
+	{
+		NUM_OFFSETS = 32	///< about a second of frames
+	};
+
+  protected:
+	void prepare();
+
+	float horizonMicros;
+
+	Kv2SkeletonFrame previous;
+	Kv2SkeletonFrame newest;
+	Kv2SkeletonFrame result;
+	int numFrames;
+
+	// from prepare(), per body of the newest frame and per joint
+	bool blending[Kv2SkeletonFrame::MAX_BODIES];
+	bool jointBlending[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];
+	ofVec3f delta[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];	///< newest minus previous position
+	ofQuaternion target[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];	///< the newest orientation on the previous one's side
+	float angle[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];		///< between the orientations, 0 to lerp
+	float inverseSin[Kv2SkeletonFrame::MAX_BODIES][Kv2SkeletonFrame::NUM_JOINTS];
+
+	// arrival micros x 10 minus timestamp of the last frames
+	LONGLONG offsets[NUM_OFFSETS];
+	int numOffsets;
+	int nextOffset;
+	LONGLONG clockOffset;
+};
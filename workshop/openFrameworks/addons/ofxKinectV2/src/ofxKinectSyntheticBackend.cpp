@@ -0,0 +1,746 @@
+#include "ofxKinectSyntheticBackend.h"
+#include "ofxKinectFrameBundle.h"
+
+#include <float.h>
+
+namespace
+{
+	// the sensor's frame sizes and roughly its intrinsics
+	const int DEPTH_WIDTH = 512;
+	const int DEPTH_HEIGHT = 424;
+	const float DEPTH_FOCAL = 365.5f;
+	const int COLOR_WIDTH = 1920;
+	const int COLOR_HEIGHT = 1080;
+	const float COLOR_FOCAL = 1081.4f;
+
+	// the room around the camera, in meters of camera space
+	const float FLOOR_Y = -1.0f;
+	const float CEILING_Y = 1.5f;
+	const float SIDE_WALL_X = 2.5f;
+	const float BACK_WALL_Z = 5.0f;
+
+	// infrared that comes back from a surface of albedo 1 at a meter, and the least that gives a reading
+	const float INFRARED_GAIN = 3000;
+	const float MIN_INFRARED = 40;
+	const float BODY_ALBEDO = 0.7f;
+
+	// shirts by body, and skin and trousers for the joints that aren't covered by one
+	const unsigned char SHIRTS[BODY_COUNT][3] =
+	{
+		{ 200, 60, 50 }, { 50, 110, 200 }, { 70, 160, 80 }, { 220, 180, 60 }, { 150, 80, 170 }, { 60, 170, 170 }
+	};
+	const unsigned char SKIN[3] = { 225, 180, 150 };
+	const unsigned char TROUSERS[3] = { 60, 60, 80 };
+
+	const int GAUSSIAN_COUNT = 4096;
+
+	// the joint every joint hangs from, and the radius of the capsule from the parent to it
+	const JointType PARENTS[JointType_Count] =
+	{
+		JointType_SpineBase, JointType_SpineBase, JointType_SpineShoulder, JointType_Neck,
+		JointType_SpineShoulder, JointType_ShoulderLeft, JointType_ElbowLeft, JointType_WristLeft,
+		JointType_SpineShoulder, JointType_ShoulderRight, JointType_ElbowRight, JointType_WristRight,
+		JointType_SpineBase, JointType_HipLeft, JointType_KneeLeft, JointType_AnkleLeft,
+		JointType_SpineBase, JointType_HipRight, JointType_KneeRight, JointType_AnkleRight,
+		JointType_SpineMid, JointType_HandLeft, JointType_HandLeft, JointType_HandRight, JointType_HandRight
+	};
+	const float RADII[JointType_Count] =
+	{
+		0, 0.14f, 0.05f, 0.1f,
+		0.06f, 0.05f, 0.04f, 0.04f,
+		0.06f, 0.05f, 0.04f, 0.04f,
+		0.08f, 0.07f, 0.055f, 0.045f,
+		0.08f, 0.07f, 0.055f, 0.045f,
+		0.15f, 0.025f, 0.02f, 0.025f, 0.02f
+	};
+
+	// a limb of a length swung forward by an angle from hanging straight down. forward is -z, towards the camera
+	inline ofVec3f getLimb(float length, float angle)
+	{
+		return ofVec3f(0, -length * cosf(angle), -length * sinf(angle));
+	}
+
+	inline ofVec3f toVec3f(const CameraSpacePoint& point)
+	{
+		return ofVec3f(point.X, point.Y, point.Z);
+	}
+
+	// rgba to y0 u y1 v for every pair of pixels, bt.601
+	void toYuy2(const unsigned char* rgba, unsigned char* yuy2, int count)
+	{
+		for(int i = 0; i < count; i += 2)
+		{
+			const unsigned char* p = rgba + i * 4;
+			float y0 = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+			float y1 = 0.299f * p[4] + 0.587f * p[5] + 0.114f * p[6];
+			float u = -0.169f * p[0] - 0.331f * p[1] + 0.5f * p[2] + 128;
+			float v = 0.5f * p[0] - 0.419f * p[1] - 0.081f * p[2] + 128;
+			yuy2[i * 2] = (unsigned char)ofClamp(16 + y0 * 219 / 255, 0, 255);
+			yuy2[i * 2 + 1] = (unsigned char)ofClamp(u, 0, 255);
+			yuy2[i * 2 + 2] = (unsigned char)ofClamp(16 + y1 * 219 / 255, 0, 255);
+			yuy2[i * 2 + 3] = (unsigned char)ofClamp(v, 0, 255);
+		}
+	}
+
+	// distance along a normalized ray from the camera to a capsule, -1 for a miss (after Inigo Quilez)
+	float intersectCapsule(const ofVec3f& ray, const ofVec3f& a, const ofVec3f& b, float radius)
+	{
+		ofVec3f ba = b - a;
+		ofVec3f oa = a * -1;
+		float baba = ba.dot(ba);
+		float bard = ba.dot(ray);
+		float baoa = ba.dot(oa);
+		float rdoa = ray.dot(oa);
+		float oaoa = oa.dot(oa);
+		float qa = baba - bard * bard;
+		float qb = baba * rdoa - baoa * bard;
+		float qc = baba * oaoa - baoa * baoa - radius * radius * baba;
+		float h = qb * qb - qa * qc;
+		if(h >= 0 && qa > 1e-9f)
+		{
+			float t = (-qb - sqrtf(h)) / qa;
+			float y = baoa + t * bard;
+			if(y > 0 && y < baba)
+			{
+				return t;
+			}
+		}
+
+		// the caps, the end nearer along the ray's hit
+		float best = -1;
+		for(int k = 0; k < 2; k++)
+		{
+			ofVec3f oc = (k == 0 ? a : b) * -1;
+			float cb = ray.dot(oc);
+			float cc = oc.dot(oc) - radius * radius;
+			float ch = cb * cb - cc;
+			if(ch > 0)
+			{
+				float t = -cb - sqrtf(ch);
+				if(t > 0 && (best < 0 || t < best))
+				{
+					best = t;
+				}
+			}
+		}
+		return best;
+	}
+}
+
+//---------------------------------------------------------------------------
+ofxKinectSyntheticBackend::ofxKinectSyntheticBackend()
+{
+	framePeriodMicros = 1000000.0f / 30.0f;
+	bodyCount = 2;
+	noise = 1;
+	randomState = 0x9e3779b9;
+	bOpen = false;
+	nextFrameMicros = 0;
+	startMicros = 0;
+	colorLeft = COLOR_WIDTH;
+	colorRight = -1;
+	colorTop = COLOR_HEIGHT;
+	colorBottom = -1;
+	memset(bodyJoints, 0, sizeof(bodyJoints));
+	memset(bodyOrientations, 0, sizeof(bodyOrientations));
+}
+
+void ofxKinectSyntheticBackend::setFrameRate(float fps)
+{
+	framePeriodMicros = fps > 0 ? 1000000.0f / fps : 0;
+}
+
+void ofxKinectSyntheticBackend::setNumBodies(int count)
+{
+	bodyCount = ofClamp(count, 0, BODY_COUNT);
+}
+
+void ofxKinectSyntheticBackend::setNoise(float scale)
+{
+	noise = MAX(scale, 0.0f);
+}
+
+void ofxKinectSyntheticBackend::setSeed(unsigned int seed)
+{
+	// xorshift never leaves 0
+	randomState = seed != 0 ? seed : 1;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectSyntheticBackend::open()
+{
+	if(!bOpen)
+	{
+		buildRoom();
+		bOpen = true;
+	}
+	startMicros = ofGetElapsedTimeMicros();
+	nextFrameMicros = startMicros;
+	return true;
+}
+
+void ofxKinectSyntheticBackend::close()
+{
+	bOpen = false;
+}
+
+bool ofxKinectSyntheticBackend::isOpen() const
+{
+	return bOpen;
+}
+
+bool ofxKinectSyntheticBackend::getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description)
+{
+	memset(&description, 0, sizeof(description));
+	bool bColor = stream == KV2_STREAM_COLOR;
+	description.width = bColor ? COLOR_WIDTH : DEPTH_WIDTH;
+	description.height = bColor ? COLOR_HEIGHT : DEPTH_HEIGHT;
+	float focal = bColor ? COLOR_FOCAL : DEPTH_FOCAL;
+	description.horizontalFieldOfView = 2 * atanf(description.width * 0.5f / focal) * RAD_TO_DEG;
+	description.verticalFieldOfView = 2 * atanf(description.height * 0.5f / focal) * RAD_TO_DEG;
+	description.diagonalFieldOfView = 2 * atanf(ofVec2f(description.width, description.height).length() * 0.5f / focal) * RAD_TO_DEG;
+	description.lengthInPixels = description.width * description.height;
+	description.bytesPerPixel = bColor ? 4 : stream == KV2_STREAM_BODY_INDEX ? 1 : 2;
+	return stream >= 0 && stream < KV2_STREAM_COUNT;
+}
+
+bool ofxKinectSyntheticBackend::openBodyStream()
+{
+	return true;
+}
+
+//---------------------------------------------------------------------------
+float ofxKinectSyntheticBackend::getFramePeriodMicros() const
+{
+	return framePeriodMicros;
+}
+
+bool ofxKinectSyntheticBackend::isFrameReady()
+{
+	return bOpen && (framePeriodMicros == 0 || ofGetElapsedTimeMicros() >= nextFrameMicros);
+}
+
+bool ofxKinectSyntheticBackend::readFrame(Kv2FrameBundle& bundle, unsigned int streamMask, bool bBodies)
+{
+	if(!bOpen)
+	{
+		return false;
+	}
+
+	unsigned long long now = ofGetElapsedTimeMicros();
+	nextFrameMicros += (unsigned long long)framePeriodMicros;
+	if(nextFrameMicros < now)
+	{
+		// fell behind, keep the rate from here rather than catching up
+		nextFrameMicros = now + (unsigned long long)framePeriodMicros;
+	}
+
+	renderFrame(bundle, (now - startMicros) * 0.000001, streamMask, bBodies);
+	return true;
+}
+
+bool ofxKinectSyntheticBackend::setupDepthProjector(ofxKinectDepthProjector& projector, int width, int height)
+{
+	if(width != DEPTH_WIDTH || height != DEPTH_HEIGHT)
+	{
+		return false;
+	}
+
+	vector<PointF> table(width * height);
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < width; x++)
+		{
+			table[y * width + x].X = (x - (width - 1) * 0.5f) / DEPTH_FOCAL;
+			table[y * width + x].Y = ((height - 1) * 0.5f - y) / DEPTH_FOCAL;
+		}
+	}
+	projector.setRayTable(&table[0], width, height);
+	return true;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectSyntheticBackend::castRoom(const ofVec3f& ray, float& z, float& albedo) const
+{
+	// ray has z = 1, so the distance along it to a plane is the plane's z
+	z = BACK_WALL_Z;
+	albedo = 0.55f;
+	if(ray.y < 0 && FLOOR_Y / ray.y < z)
+	{
+		z = FLOOR_Y / ray.y;
+		// tiles make the infrared worth looking at
+		int tile = (int)floorf(ray.x * z * 2) + (int)floorf(z * 2);
+		albedo = (tile & 1) ? 0.3f : 0.45f;
+	}
+	if(ray.y > 0 && CEILING_Y / ray.y < z)
+	{
+		z = CEILING_Y / ray.y;
+		albedo = 0.5f;
+	}
+	if(ray.x != 0 && fabsf(SIDE_WALL_X / ray.x) < z)
+	{
+		z = fabsf(SIDE_WALL_X / ray.x);
+		albedo = 0.6f;
+	}
+}
+
+void ofxKinectSyntheticBackend::buildRoom()
+{
+	int count = DEPTH_WIDTH * DEPTH_HEIGHT;
+	roomDepth.resize(count);
+	roomAlbedo.resize(count);
+	rays.resize(count);
+	for(int y = 0; y < DEPTH_HEIGHT; y++)
+	{
+		for(int x = 0; x < DEPTH_WIDTH; x++)
+		{
+			int i = y * DEPTH_WIDTH + x;
+			ofVec3f ray((x - (DEPTH_WIDTH - 1) * 0.5f) / DEPTH_FOCAL, ((DEPTH_HEIGHT - 1) * 0.5f - y) / DEPTH_FOCAL, 1);
+			castRoom(ray, roomDepth[i], roomAlbedo[i]);
+			rays[i] = ray.getNormalized();
+		}
+	}
+
+	// the color camera sees the same room, lit from above, from the same place
+	roomColor.allocate(COLOR_WIDTH, COLOR_HEIGHT, 4);
+	unsigned char* color = roomColor.getPixels();
+	for(int y = 0; y < COLOR_HEIGHT; y++)
+	{
+		for(int x = 0; x < COLOR_WIDTH; x++)
+		{
+			ofVec3f ray((x - (COLOR_WIDTH - 1) * 0.5f) / COLOR_FOCAL, ((COLOR_HEIGHT - 1) * 0.5f - y) / COLOR_FOCAL, 1);
+			float z, albedo;
+			castRoom(ray, z, albedo);
+			float light = ofClamp(1.1f - z * 0.12f, 0.2f, 1) * albedo * 2;
+			unsigned char* p = color + (y * COLOR_WIDTH + x) * 4;
+			p[0] = (unsigned char)ofClamp(light * 230, 0, 255);
+			p[1] = (unsigned char)ofClamp(light * 205, 0, 255);
+			p[2] = (unsigned char)ofClamp(light * 170, 0, 255);
+			p[3] = 255;
+		}
+	}
+	roomColorYuy2.clear();
+	frameColor = roomColor;
+	colorDepth.assign(COLOR_WIDTH * COLOR_HEIGHT, FLT_MAX);
+	colorLeft = COLOR_WIDTH;
+	colorRight = -1;
+	colorTop = COLOR_HEIGHT;
+	colorBottom = -1;
+
+	gaussians.resize(GAUSSIAN_COUNT);
+	for(int i = 0; i < GAUSSIAN_COUNT; i++)
+	{
+		gaussians[i] = sqrtf(-2 * logf(ofRandom(1e-6f, 1))) * cosf(ofRandom(TWO_PI));
+	}
+
+	frameDepth.resize(count);
+	frameAlbedo.resize(count);
+	frameBodyIndex.resize(count);
+	frameEdge.resize(count);
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectSyntheticBackend::poseBody(int body, double time, Joint* joints, JointOrientation* orientations) const
+{
+	// every body walks its own lane at its own pace, turning a little towards where it is going
+	float phase = body * 1.7f;
+	float walk = (float)time * (0.35f + 0.05f * body) + phase;
+	ofVec3f root(1.4f * sinf(walk), FLOOR_Y + 0.95f, 1.5f + 0.55f * body + 0.2f * sinf(walk * 0.7f));
+	float yaw = 25 * cosf(walk);
+	float stride = (float)time * 5.5f + phase;
+	float swing = 0.45f * sinf(stride);
+
+	ofVec3f local[JointType_Count];
+	local[JointType_SpineBase].set(0, 0, 0);
+	local[JointType_SpineMid].set(0, 0.3f, 0);
+	local[JointType_SpineShoulder].set(0, 0.52f, 0);
+	local[JointType_Neck].set(0, 0.6f, 0);
+	local[JointType_Head].set(0, 0.75f, 0);
+
+	// left is +x, on the camera's right like in the sensor's mirrored view
+	for(int side = 0; side < 2; side++)
+	{
+		float sign = side == 0 ? 1 : -1;
+		JointType shoulder = side == 0 ? JointType_ShoulderLeft : JointType_ShoulderRight;
+		JointType elbow = side == 0 ? JointType_ElbowLeft : JointType_ElbowRight;
+		JointType wrist = side == 0 ? JointType_WristLeft : JointType_WristRight;
+		JointType hand = side == 0 ? JointType_HandLeft : JointType_HandRight;
+		JointType handTip = side == 0 ? JointType_HandTipLeft : JointType_HandTipRight;
+		JointType thumb = side == 0 ? JointType_ThumbLeft : JointType_ThumbRight;
+		JointType hip = side == 0 ? JointType_HipLeft : JointType_HipRight;
+		JointType knee = side == 0 ? JointType_KneeLeft : JointType_KneeRight;
+		JointType ankle = side == 0 ? JointType_AnkleLeft : JointType_AnkleRight;
+		JointType foot = side == 0 ? JointType_FootLeft : JointType_FootRight;
+
+		// arms swing against the legs, elbows bend on the way forward
+		float armSwing = -swing * sign * 0.8f;
+		local[shoulder].set(0.19f * sign, 0.5f, 0);
+		local[elbow] = local[shoulder] + getLimb(0.28f, armSwing);
+		ofVec3f forearm = getLimb(0.25f, armSwing + 0.3f + MAX(armSwing, 0.0f));
+		local[wrist] = local[elbow] + forearm;
+		ofVec3f along = forearm.getNormalized();
+		local[hand] = local[wrist] + along * 0.08f;
+		local[handTip] = local[hand] + along * 0.07f;
+		local[thumb] = local[wrist] + along * 0.05f + ofVec3f(-0.03f * sign, 0, -0.02f);
+
+		float legSwing = swing * sign;
+		local[hip].set(0.09f * sign, -0.02f, 0);
+		local[knee] = local[hip] + getLimb(0.43f, legSwing);
+		local[ankle] = local[knee] + getLimb(0.42f, legSwing - MAX(-sinf(stride) * sign, 0.0f) * 0.6f);
+		local[foot] = local[ankle] + ofVec3f(0, -0.04f, -0.12f);
+	}
+
+	ofQuaternion turn;
+	turn.makeRotate(yaw, ofVec3f(0, 1, 0));
+	ofVec3f position[JointType_Count];
+	for(int j = 0; j < JointType_Count; j++)
+	{
+		position[j] = root + turn * local[j];
+		joints[j].JointType = (JointType)j;
+		joints[j].Position.X = position[j].x;
+		joints[j].Position.Y = position[j].y;
+		joints[j].Position.Z = position[j].z;
+		joints[j].TrackingState = TrackingState_Tracked;
+	}
+
+	// a bone's orientation has y along the bone from its parent, the root just turns
+	for(int j = 0; j < JointType_Count; j++)
+	{
+		ofQuaternion orientation = turn;
+		if(j != JointType_SpineBase)
+		{
+			orientation.makeRotate(ofVec3f(0, 1, 0), position[j] - position[PARENTS[j]]);
+		}
+		orientations[j].JointType = (JointType)j;
+		orientations[j].Orientation.x = orientation.x();
+		orientations[j].Orientation.y = orientation.y();
+		orientations[j].Orientation.z = orientation.z();
+		orientations[j].Orientation.w = orientation.w();
+	}
+}
+
+void ofxKinectSyntheticBackend::castBody(int body, const Joint* joints)
+{
+	for(int j = 0; j < JointType_Count; j++)
+	{
+		if(j == JointType_SpineBase)
+		{
+			continue;
+		}
+
+		Capsule capsule = { toVec3f(joints[PARENTS[j]].Position), toVec3f(joints[j].Position), RADII[j] };
+		float nearest = MIN(capsule.a.z, capsule.b.z) - capsule.radius;
+		if(nearest < 0.2f)
+		{
+			continue;
+		}
+
+		// only the pixels the capsule can cover
+		float radius = DEPTH_FOCAL * capsule.radius / nearest + 1;
+		float ax = (DEPTH_WIDTH - 1) * 0.5f + DEPTH_FOCAL * capsule.a.x / capsule.a.z;
+		float ay = (DEPTH_HEIGHT - 1) * 0.5f - DEPTH_FOCAL * capsule.a.y / capsule.a.z;
+		float bx = (DEPTH_WIDTH - 1) * 0.5f + DEPTH_FOCAL * capsule.b.x / capsule.b.z;
+		float by = (DEPTH_HEIGHT - 1) * 0.5f - DEPTH_FOCAL * capsule.b.y / capsule.b.z;
+		int left = MAX((int)floorf(MIN(ax, bx) - radius), 0);
+		int right = MIN((int)ceilf(MAX(ax, bx) + radius), DEPTH_WIDTH - 1);
+		int top = MAX((int)floorf(MIN(ay, by) - radius), 0);
+		int bottom = MIN((int)ceilf(MAX(ay, by) + radius), DEPTH_HEIGHT - 1);
+
+		ofVec3f axis = capsule.b - capsule.a;
+		float axisLength2 = MAX(axis.lengthSquared(), 1e-9f);
+		for(int y = top; y <= bottom; y++)
+		{
+			for(int x = left; x <= right; x++)
+			{
+				int i = y * DEPTH_WIDTH + x;
+				const ofVec3f& ray = rays[i];
+				float t = intersectCapsule(ray, capsule.a, capsule.b, capsule.radius);
+				if(t <= 0)
+				{
+					continue;
+				}
+				float z = t * ray.z;
+				if(z >= frameDepth[i])
+				{
+					continue;
+				}
+
+				// where the surface turns away from the camera the pixel mixes body and background
+				ofVec3f hit = ray * t;
+				float along = ofClamp((hit - capsule.a).dot(axis) / axisLength2, 0, 1);
+				ofVec3f normal = (hit - (capsule.a + axis * along)) / capsule.radius;
+				frameDepth[i] = z;
+				frameAlbedo[i] = BODY_ALBEDO;
+				frameBodyIndex[i] = body;
+				frameEdge[i] = -normal.dot(ray) < 0.25f;
+			}
+		}
+	}
+}
+
+void ofxKinectSyntheticBackend::castBodyColor(int body, const Joint* joints)
+{
+	ofVec3f light = ofVec3f(0.3f, 0.8f, -0.5f).getNormalized();
+	for(int j = 0; j < JointType_Count; j++)
+	{
+		if(j == JointType_SpineBase)
+		{
+			continue;
+		}
+
+		Capsule capsule = { toVec3f(joints[PARENTS[j]].Position), toVec3f(joints[j].Position), RADII[j] };
+		float nearest = MIN(capsule.a.z, capsule.b.z) - capsule.radius;
+		if(nearest < 0.2f)
+		{
+			continue;
+		}
+
+		const unsigned char* cloth = SHIRTS[body];
+		if(j == JointType_Head || j == JointType_HandLeft || j == JointType_HandRight || j >= JointType_HandTipLeft)
+		{
+			cloth = SKIN;
+		}
+		else if(j >= JointType_HipLeft && j <= JointType_FootRight)
+		{
+			cloth = TROUSERS;
+		}
+
+		// the capsule on screen is within radius of the segment between its projected ends, stretched
+		// towards the corners where the rays get oblique
+		float slopeA = (capsule.a.x * capsule.a.x + capsule.a.y * capsule.a.y) / (capsule.a.z * capsule.a.z);
+		float slopeB = (capsule.b.x * capsule.b.x + capsule.b.y * capsule.b.y) / (capsule.b.z * capsule.b.z);
+		float radius = COLOR_FOCAL * capsule.radius / nearest * (1 + MAX(slopeA, slopeB)) + 1;
+		float ax = (COLOR_WIDTH - 1) * 0.5f + COLOR_FOCAL * capsule.a.x / capsule.a.z;
+		float ay = (COLOR_HEIGHT - 1) * 0.5f - COLOR_FOCAL * capsule.a.y / capsule.a.z;
+		float bx = (COLOR_WIDTH - 1) * 0.5f + COLOR_FOCAL * capsule.b.x / capsule.b.z;
+		float by = (COLOR_HEIGHT - 1) * 0.5f - COLOR_FOCAL * capsule.b.y / capsule.b.z;
+		int top = MAX((int)floorf(MIN(ay, by) - radius), 0);
+		int bottom = MIN((int)ceilf(MAX(ay, by) + radius), COLOR_HEIGHT - 1);
+
+		ofVec3f axis = capsule.b - capsule.a;
+		float axisLength2 = MAX(axis.lengthSquared(), 1e-9f);
+		float screenX = bx - ax, screenY = by - ay;
+		float screenLength2 = MAX(screenX * screenX + screenY * screenY, 1e-6f);
+		for(int y = top; y <= bottom; y++)
+		{
+			// the part of the segment within radius of the row, so a slanted limb isn't tested over its whole box
+			float begin = 0, end = 1;
+			if(fabsf(by - ay) > 1e-3f)
+			{
+				begin = (y - radius - ay) / (by - ay);
+				end = (y + radius - ay) / (by - ay);
+				if(begin > end)
+				{
+					std::swap(begin, end);
+				}
+				begin = MAX(begin, 0.0f);
+				end = MIN(end, 1.0f);
+				if(begin > end)
+				{
+					continue;
+				}
+			}
+			float x0 = ax + (bx - ax) * begin;
+			float x1 = ax + (bx - ax) * end;
+			int left = MAX((int)floorf(MIN(x0, x1) - radius), 0);
+			int right = MIN((int)ceilf(MAX(x0, x1) + radius), COLOR_WIDTH - 1);
+
+			float rayY = ((COLOR_HEIGHT - 1) * 0.5f - y) / COLOR_FOCAL;
+			for(int x = left; x <= right; x++)
+			{
+				// far enough from the segment on screen to miss, without casting
+				float dx = x - ax, dy = y - ay;
+				float s = ofClamp((dx * screenX + dy * screenY) / screenLength2, 0, 1);
+				dx -= screenX * s;
+				dy -= screenY * s;
+				if(dx * dx + dy * dy > radius * radius)
+				{
+					continue;
+				}
+
+				ofVec3f ray = ofVec3f((x - (COLOR_WIDTH - 1) * 0.5f) / COLOR_FOCAL, rayY, 1).getNormalized();
+				float t = intersectCapsule(ray, capsule.a, capsule.b, capsule.radius);
+				if(t <= 0)
+				{
+					continue;
+				}
+				int i = y * COLOR_WIDTH + x;
+				float z = t * ray.z;
+				if(z >= colorDepth[i])
+				{
+					continue;
+				}
+				colorDepth[i] = z;
+
+				// lit from above and behind the camera, and dimmer further in like the room
+				ofVec3f hit = ray * t;
+				float along = ofClamp((hit - capsule.a).dot(axis) / axisLength2, 0, 1);
+				ofVec3f normal = (hit - (capsule.a + axis * along)) / capsule.radius;
+				float shade = ofClamp(1.1f - z * 0.12f, 0.2f, 1) * (0.4f + 0.6f * MAX(normal.dot(light), 0.0f));
+				unsigned char* p = frameColor.getPixels() + i * 4;
+				p[0] = (unsigned char)(cloth[0] * shade);
+				p[1] = (unsigned char)(cloth[1] * shade);
+				p[2] = (unsigned char)(cloth[2] * shade);
+
+				colorLeft = MIN(colorLeft, x);
+				colorRight = MAX(colorRight, x);
+				colorTop = MIN(colorTop, y);
+				colorBottom = MAX(colorBottom, y);
+			}
+		}
+	}
+}
+
+inline unsigned int ofxKinectSyntheticBackend::getRandom()
+{
+	// xorshift32
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+void ofxKinectSyntheticBackend::writeColor(Kv2FrameBundle& bundle)
+{
+	ofPixels& pixels = bundle.color.pixels;
+	int channels = pixels.getNumChannels();
+	if(pixels.getWidth() != COLOR_WIDTH || pixels.getHeight() != COLOR_HEIGHT || (channels != 4 && channels != 2))
+	{
+		return;
+	}
+
+	// put back the empty room where the bodies were last frame
+	for(int y = colorTop; y <= colorBottom; y++)
+	{
+		int i = y * COLOR_WIDTH + colorLeft;
+		int count = colorRight - colorLeft + 1;
+		memcpy(frameColor.getPixels() + i * 4, roomColor.getPixels() + i * 4, count * 4);
+		std::fill(colorDepth.begin() + i, colorDepth.begin() + i + count, FLT_MAX);
+	}
+	colorLeft = COLOR_WIDTH;
+	colorRight = -1;
+	colorTop = COLOR_HEIGHT;
+	colorBottom = -1;
+
+	for(int body = 0; body < bodyCount; body++)
+	{
+		castBodyColor(body, bodyJoints[body]);
+	}
+
+	if(channels == 4)
+	{
+		memcpy(pixels.getPixels(), frameColor.getPixels(), COLOR_WIDTH * COLOR_HEIGHT * 4);
+		return;
+	}
+
+	if(!roomColorYuy2.isAllocated())
+	{
+		roomColorYuy2.allocate(COLOR_WIDTH, COLOR_HEIGHT, 2);
+		toYuy2(roomColor.getPixels(), roomColorYuy2.getPixels(), COLOR_WIDTH * COLOR_HEIGHT);
+	}
+	memcpy(pixels.getPixels(), roomColorYuy2.getPixels(), COLOR_WIDTH * COLOR_HEIGHT * 2);
+
+	// only the pairs of pixels the bodies touched need converting
+	int left = colorLeft & ~1;
+	for(int y = colorTop; y <= colorBottom; y++)
+	{
+		int i = y * COLOR_WIDTH + left;
+		toYuy2(frameColor.getPixels() + i * 4, pixels.getPixels() + i * 2, colorRight - left + 1);
+	}
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectSyntheticBackend::renderFrame(Kv2FrameBundle& bundle, double time, unsigned int streamMask, bool bBodies)
+{
+	if(roomDepth.empty())
+	{
+		buildRoom();
+	}
+	LONGLONG timeStamp = (LONGLONG)(time * 10000000.0);
+
+	for(int body = 0; body < bodyCount; body++)
+	{
+		poseBody(body, time, bodyJoints[body], bodyOrientations[body]);
+	}
+
+	bool bDepth = (streamMask & (1 << KV2_STREAM_DEPTH)) != 0 && bundle.depth.pixels.getWidth() == DEPTH_WIDTH;
+	bool bInfrared = (streamMask & (1 << KV2_STREAM_INFRARED)) != 0 && bundle.infrared.pixels.getWidth() == DEPTH_WIDTH;
+	bool bBodyIndex = (streamMask & (1 << KV2_STREAM_BODY_INDEX)) != 0 && bundle.bodyIndex.pixels.getWidth() == DEPTH_WIDTH;
+	if(bDepth || bInfrared || bBodyIndex)
+	{
+		std::copy(roomDepth.begin(), roomDepth.end(), frameDepth.begin());
+		std::copy(roomAlbedo.begin(), roomAlbedo.end(), frameAlbedo.begin());
+		std::fill(frameBodyIndex.begin(), frameBodyIndex.end(), 255);
+		std::fill(frameEdge.begin(), frameEdge.end(), 0);
+		for(int body = 0; body < bodyCount; body++)
+		{
+			castBody(body, bodyJoints[body]);
+		}
+
+		unsigned short* depth = bDepth ? bundle.depth.pixels.getPixels() : NULL;
+		unsigned short* infrared = bInfrared ? bundle.infrared.pixels.getPixels() : NULL;
+		unsigned char* bodyIndex = bBodyIndex ? bundle.bodyIndex.pixels.getPixels() : NULL;
+		unsigned int dropout = (unsigned int)(noise * 0.003f * 65536);
+		for(int y = 0; y < DEPTH_HEIGHT; y++)
+		{
+			float cornerY = (y - DEPTH_HEIGHT * 0.5f) / (DEPTH_HEIGHT * 0.5f);
+			for(int x = 0; x < DEPTH_WIDTH; x++)
+			{
+				int i = y * DEPTH_WIDTH + x;
+				float z = frameDepth[i];
+				float albedo = frameAlbedo[i];
+				unsigned int random = getRandom();
+
+				// shot noise on the infrared, depth noise growing with distance and with less light
+				float intensity = INFRARED_GAIN * albedo / (z * z);
+				float shot = gaussians[random & (GAUSSIAN_COUNT - 1)];
+				float sigma = noise * (1 + 0.15f * z * z) * sqrtf(0.5f / albedo);
+				float gaussian = gaussians[(random >> 12) & (GAUSSIAN_COUNT - 1)];
+
+				float cornerX = (x - DEPTH_WIDTH * 0.5f) / (DEPTH_WIDTH * 0.5f);
+				bool bValid = intensity >= MIN_INFRARED && cornerX * cornerX + cornerY * cornerY <= 1.7f
+					&& (random >> 16) >= dropout && !(frameEdge[i] && (random & 0x80000000) != 0 && noise > 0);
+
+				if(depth != NULL)
+				{
+					depth[i] = bValid ? (unsigned short)ofClamp(z * 1000 + gaussian * sigma, 0, 8000) : 0;
+				}
+				if(infrared != NULL)
+				{
+					infrared[i] = (unsigned short)ofClamp(intensity + shot * sqrtf(intensity) * 2 * noise, 0, 65535);
+				}
+				if(bodyIndex != NULL)
+				{
+					bodyIndex[i] = bValid ? frameBodyIndex[i] : 255;
+				}
+			}
+		}
+	}
+
+	bundle.depth.frame.TimeStamp = timeStamp;
+	bundle.infrared.frame.TimeStamp = timeStamp;
+	bundle.bodyIndex.frame.TimeStamp = timeStamp;
+
+	if((streamMask & (1 << KV2_STREAM_COLOR)) != 0)
+	{
+		writeColor(bundle);
+		bundle.color.frame.TimeStamp = timeStamp;
+	}
+
+	if(bBodies)
+	{
+		for(int body = 0; body < Kv2SkeletonFrame::MAX_BODIES; body++)
+		{
+			if(body < bodyCount)
+			{
+				// the people never leave the room, so each keeps an id for good
+				bundle.bodies.setBody(body, body + 1, bodyJoints[body], bodyOrientations[body]);
+			}
+			else
+			{
+				bundle.bodies.setUntracked(body);
+			}
+		}
+		bundle.bodies.timeStamp = timeStamp;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ofxKinectSensorBackend.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// a procedural room standing in for the sensor
+//
+// floor, walls and ceiling around a camera a meter above the floor, and people made of capsules walking
+// back and forth in it. every frame has the same sizes as the sensor's: depth, infrared and body index
+// are ray cast against the room and the capsules, and the skeletons are the joints the capsules were
+// built from, so body index, depth and skeleton always agree. depth gets time of flight noise growing with
+// distance, no reading where too little light comes back, random dropouts, mixed pixels dropped along
+// silhouettes and a dark corner vignette. color is the room rendered once with the people ray cast into
+// it every frame, only over the rows of each capsule they can cover, in shirts of their own color.
+//
+// the frame rate is kept to the clock, or frames come as fast as they are read at rate 0, which with the
+// sensor's frame sizes makes the whole bridge pipeline testable for load and latency without hardware.
+// the rays of the depth camera are known exactly, so mapDepthToCameraSpace() works as well; the sdk's
+// coordinate mapping does not.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectSyntheticBackend : public ofxKinectSensorBackend
+{
+  public:
+	ofxKinectSyntheticBackend();
+
+	/// frames per second, 0 renders a frame whenever the capture thread asks. set before start()
+	void setFrameRate(float fps = 30);
+	/// people in the room, at most BODY_COUNT
+	void setNumBodies(int count = 2);
+	/// scales the sensor noise and dropouts, 0 gives clean depth
+	void setNoise(float scale = 1);
+	/// same seed, same noise
+	void setSeed(unsigned int seed);
+
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	bool getStreamDescription(Kv2RecordedStream stream, KCBFrameDescription& description);
+	bool openBodyStream();
+
+	float getFramePeriodMicros() const;
+	bool isFrameReady();
+	bool readFrame(Kv2FrameBundle& bundle, unsigned int streamMask, bool bBodies);
+
+	bool setupDepthProjector(ofxKinectDepthProjector& projector, int width, int height);
+
+	/// the scene at a time in seconds, what readFrame() does with the clock
+	void renderFrame(Kv2FrameBundle& bundle, double time, unsigned int streamMask, bool bBodies);
+
+  protected:
+	struct Capsule
+	{
+		ofVec3f a;
+		ofVec3f b;
+		float radius;
+	};
+
+	void buildRoom();
+	/// the room surface along a ray from the camera, z in meters
+	void castRoom(const ofVec3f& ray, float& z, float& albedo) const;
+	void poseBody(int body, double time, Joint* joints, JointOrientation* orientations) const;
+	void castBody(int body, const Joint* joints);
+	/// the body into frameColor, nearest surface in colorDepth wins
+	void castBodyColor(int body, const Joint* joints);
+	void writeColor(Kv2FrameBundle& bundle);
+	inline unsigned int getRandom();
+
+	float framePeriodMicros;
+	int bodyCount;
+	float noise;
+	unsigned int randomState;
+	bool bOpen;
+	unsigned long long nextFrameMicros;
+	unsigned long long startMicros;
+
+	// the empty room per depth pixel, z in meters and infrared albedo
+	vector<float> roomDepth;
+	vector<float> roomAlbedo;
+	// normalized ray of every depth pixel
+	vector<ofVec3f> rays;
+	ofPixels roomColor;
+	ofPixels roomColorYuy2;
+
+	// the color frame being rendered and the z of the body seen in every color pixel. only the rows and
+	// columns the bodies covered last frame are put back to the empty room
+	ofPixels frameColor;
+	vector<float> colorDepth;
+	int colorLeft;
+	int colorRight;
+	int colorTop;
+	int colorBottom;
+
+	// scratch of the frame being rendered
+	vector<float> frameDepth;
+	vector<float> frameAlbedo;
+	vector<unsigned char> frameBodyIndex;
+	vector<unsigned char> frameEdge;
+	Joint bodyJoints[BODY_COUNT][JointType_Count];
+	JointOrientation bodyOrientations[BODY_COUNT][JointType_Count];
+
+	// standard normal samples picked by random bits, cheaper than drawing one per pixel
+	vector<float> gaussians;
+};
@@ -0,0 +1,256 @@
+#include "ofxKinectTextureStreamer.h"
+
+//---------------------------------------------------------------------------
+ofxKinectTextureStreamer::ofxKinectTextureStreamer()
+	: texture(NULL)
+	, width(0)
+	, height(0)
+	, glFormat(0)
+	, glType(0)
+	, rowBytes(0)
+	, frameBytes(0)
+	, current(0)
+	, bPersistent(false)
+	, bMapped(false)
+	, uploadStart(0)
+	, uploadMicros(0)
+	, numUploads(0)
+{
+	for(int i = 0; i < NUM_BUFFERS; i++)
+	{
+		buffers[i] = 0;
+		mapped[i] = NULL;
+		fences[i] = NULL;
+	}
+}
+
+ofxKinectTextureStreamer::~ofxKinectTextureStreamer()
+{
+	clear();
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectTextureStreamer::isSupported()
+{
+	return GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
+}
+
+//---------------------------------------------------------------------------
+bool ofxKinectTextureStreamer::setup(ofTexture& _texture, int _width, int _height, int _glFormat, int _glType, int bytesPerPixel)
+{
+	clear();
+	if(!isSupported())
+	{
+		ofLogWarning("ofxKinectTextureStreamer::setup") << "No pixel buffer objects, textures are loaded directly";
+		return false;
+	}
+
+	texture = &_texture;
+	width = _width;
+	height = _height;
+	glFormat = _glFormat;
+	glType = _glType;
+	rowBytes = width * bytesPerPixel;
+	frameBytes = rowBytes * height;
+	uploadMicros = 0;
+	numUploads = 0;
+
+	glGenBuffers(NUM_BUFFERS, buffers);
+
+	// storage that stays mapped needs a fence to know when the gpu is done reading it
+	bPersistent = GLEW_ARB_buffer_storage && GLEW_ARB_sync;
+	if(bPersistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		for(int i = 0; i < NUM_BUFFERS && bPersistent; i++)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, frameBytes, NULL, flags);
+			mapped[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBytes, flags);
+			bPersistent = mapped[i] != NULL;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		if(!bPersistent)
+		{
+			// storage is immutable once given, start over with plain buffers
+			ofTexture* t = texture;
+			clear();
+			texture = t;
+			glGenBuffers(NUM_BUFFERS, buffers);
+		}
+	}
+	if(!bPersistent)
+	{
+		for(int i = 0; i < NUM_BUFFERS; i++)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	return true;
+}
+
+void ofxKinectTextureStreamer::clear()
+{
+	if(buffers[0] != 0)
+	{
+		for(int i = 0; i < NUM_BUFFERS; i++)
+		{
+			if(mapped[i] != NULL)
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				mapped[i] = NULL;
+			}
+			if(fences[i] != NULL)
+			{
+				glDeleteSync(fences[i]);
+				fences[i] = NULL;
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(NUM_BUFFERS, buffers);
+	}
+	for(int i = 0; i < NUM_BUFFERS; i++)
+	{
+		buffers[i] = 0;
+	}
+	texture = NULL;
+	current = 0;
+	bPersistent = false;
+	bMapped = false;
+}
+
+bool ofxKinectTextureStreamer::isReady() const
+{
+	return texture != NULL;
+}
+
+bool ofxKinectTextureStreamer::isPersistent() const
+{
+	return bPersistent;
+}
+
+//---------------------------------------------------------------------------
+void* ofxKinectTextureStreamer::beginUpload()
+{
+	if(!isReady())
+	{
+		return NULL;
+	}
+	if(bMapped)
+	{
+		return mapped[current];
+	}
+
+	uploadStart = ofGetElapsedTimeMicros();
+
+	if(bPersistent)
+	{
+		if(fences[current] != NULL)
+		{
+			// the copy out of this buffer was queued a frame ago, it has nearly always finished
+			glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+			glDeleteSync(fences[current]);
+			fences[current] = NULL;
+		}
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+		// dropping the old storage lets the driver hand out fresh memory instead of waiting for the gpu
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBytes, NULL, GL_STREAM_DRAW);
+		mapped[current] = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if(mapped[current] == NULL)
+		{
+			ofLogError("ofxKinectTextureStreamer::beginUpload") << "Couldn't map the pixel buffer";
+			return NULL;
+		}
+	}
+
+	bMapped = true;
+	return mapped[current];
+}
+
+void ofxKinectTextureStreamer::endUpload()
+{
+	if(!bMapped)
+	{
+		return;
+	}
+	bMapped = false;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+	bool bIntact = true;
+	if(!bPersistent)
+	{
+		// the contents can be lost while mapped, on a display mode change for one
+		bIntact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+		mapped[current] = NULL;
+	}
+
+	if(bIntact)
+	{
+		ofTextureData& data = texture->getTextureData();
+		int alignment = (rowBytes % 8 == 0) ? 8 : (rowBytes % 4 == 0) ? 4 : (rowBytes % 2 == 0) ? 2 : 1;
+		GLint previousAlignment;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+		glBindTexture(data.textureTarget, data.textureID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+		// with a buffer bound the pointer is an offset into it, the call returns once the copy is queued
+		glTexSubImage2D(data.textureTarget, 0, 0, 0, width, height, glFormat, glType, 0);
+		glBindTexture(data.textureTarget, 0);
+		// loadData() and everyone else's uploads expect what was set before
+		glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if(bPersistent)
+	{
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	current = (current + 1) % NUM_BUFFERS;
+
+	float micros = ofGetElapsedTimeMicros() - uploadStart;
+	uploadMicros = numUploads == 0 ? micros : uploadMicros * 0.9f + micros * 0.1f;
+	numUploads++;
+}
+
+void ofxKinectTextureStreamer::upload(const void* pixels, ofxKinectTileExecutor* executor)
+{
+	unsigned char* dst = (unsigned char*)beginUpload();
+	if(dst == NULL)
+	{
+		return;
+	}
+
+	const unsigned char* src = (const unsigned char*)pixels;
+	if(executor != NULL)
+	{
+		int stride = rowBytes;
+		executor->forEachRowTile(height, [&](int rowBegin, int rowEnd){
+			memcpy(dst + rowBegin * stride, src + rowBegin * stride, (rowEnd - rowBegin) * stride);
+		});
+	}
+	else
+	{
+		memcpy(dst, src, frameBytes);
+	}
+
+	endUpload();
+}
+
+//---------------------------------------------------------------------------
+float ofxKinectTextureStreamer::getUploadMicros() const
+{
+	return uploadMicros;
+}
+
+unsigned long long ofxKinectTextureStreamer::getNumUploads() const
+{
+	return numUploads;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include "ofxKinectTileExecutor.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// streams frames into a texture through pixel buffer objects
+//
+// ofTexture::loadData() hands the driver a pointer to client memory, and the driver has to copy all of it
+// before glTexSubImage2D() returns. here a frame is written into buffer memory the gl has mapped, on the
+// tile executor's threads, and the texture then reads it from the buffer: the call only queues the copy
+// and returns, the gpu does it while the render thread goes on. two buffers take turns so the one being
+// written is never the one still being copied from. with GL_ARB_buffer_storage the buffers are mapped once
+// for good and a fence per buffer says when it is free again, otherwise every upload maps a fresh buffer,
+// which lets the driver hand out new memory instead of waiting for the old.
+// every call needs the gl context the texture belongs to.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectTextureStreamer
+{
+  public:
+	ofxKinectTextureStreamer();
+	~ofxKinectTextureStreamer();
+
+	/// frames of width x height pixels in glFormat and glType, uploaded to the whole of a texture that must
+	/// stay allocated at that size. false if the gl can't stream, then keep calling loadData()
+	bool setup(ofTexture& texture, int width, int height, int glFormat, int glType, int bytesPerPixel);
+	void clear();
+	bool isReady() const;
+	/// the buffers are mapped once rather than per upload
+	bool isPersistent() const;
+
+	/// memory the next frame is written into, any thread may write it until endUpload()
+	void* beginUpload();
+	/// queues the copy of the frame written since beginUpload() into the texture
+	void endUpload();
+	/// beginUpload(), rows copied in tiles on the executor, endUpload()
+	void upload(const void* pixels, ofxKinectTileExecutor* executor = NULL);
+
+	/// time from beginUpload() to the return of endUpload() on the calling thread, smoothed over frames
+	float getUploadMicros() const;
+	unsigned long long getNumUploads() const;
+
+	/// pixel buffer objects are there, call with the gl context current
+	static bool isSupported();
+
+  protected:
+	static const int NUM_BUFFERS = 2;
+
+	ofTexture* texture;
+	int width;
+	int height;
+	int glFormat;
+	int glType;
+	int rowBytes;
+	int frameBytes;
+
+	GLuint buffers[NUM_BUFFERS];
+	void* mapped[NUM_BUFFERS];
+	GLsync fences[NUM_BUFFERS];
+	int current;
+	bool bPersistent;
+	bool bMapped;
+
+	unsigned long long uploadStart;
+	float uploadMicros;
+	unsigned long long numUploads;
+};
@@ -0,0 +1,322 @@
+#include "ofxKinectTileExecutor.h"
+
+#include "ofxKinectDepthKernel.h"
+#include "ofxKinectColorKernel.h"
+#include "ofxKinectDepthCodec.h"
+
+//---------------------------------------------------------------------------
+ofxKinectTileExecutor::ofxKinectTileExecutor()
+	: generation(0)
+	, busyWorkers(0)
+	, bQuit(false)
+	, bRunning(false)
+	, job(NULL)
+	, jobCount(0)
+	, jobTileSize(1)
+	, queues(1)
+	, tileRows(16)
+	, bTileTiming(true)
+	, lastRunMicros(0)
+{
+	setNumThreads();
+}
+
+ofxKinectTileExecutor::~ofxKinectTileExecutor()
+{
+	stopWorkers();
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectTileExecutor::setNumThreads(int numThreads)
+{
+	if(numThreads <= 0)
+	{
+		numThreads = MAX((int)std::thread::hardware_concurrency(), 1);
+	}
+
+	if(bRunning)
+	{
+		ofLogError("ofxKinectTileExecutor::setNumThreads") << "Cannot change the thread count from inside a tile";
+		return;
+	}
+
+	stopWorkers();
+	startWorkers(numThreads - 1);
+}
+
+int ofxKinectTileExecutor::getNumThreads() const
+{
+	return (int)workers.size() + 1;
+}
+
+int ofxKinectTileExecutor::getCurrentThread() const
+{
+	std::thread::id id = std::this_thread::get_id();
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		if(workers[i].get_id() == id)
+		{
+			return (int)i + 1;
+		}
+	}
+	return 0;
+}
+
+void ofxKinectTileExecutor::setTileRows(int rows)
+{
+	tileRows = MAX(rows, 1);
+}
+
+int ofxKinectTileExecutor::getTileRows() const
+{
+	return tileRows;
+}
+
+void ofxKinectTileExecutor::setTileTimingEnabled(bool bEnabled)
+{
+	bTileTiming = bEnabled;
+}
+
+const vector<ofxKinectTileExecutor::TileTiming>& ofxKinectTileExecutor::getLastTileTimings() const
+{
+	return tileTimings;
+}
+
+float ofxKinectTileExecutor::getLastRunMicros() const
+{
+	return lastRunMicros;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectTileExecutor::startWorkers(int numWorkers)
+{
+	bQuit = false;
+	queues = std::vector<TileQueue>(numWorkers + 1);
+	for(int i = 0; i < numWorkers; i++)
+	{
+		workers.push_back(std::thread(&ofxKinectTileExecutor::workerLoop, this, i + 1));
+	}
+}
+
+void ofxKinectTileExecutor::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		bQuit = true;
+	}
+	wake.notify_all();
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	workers.clear();
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectTileExecutor::forEachRowTile(int numRows, const TileFunction& fn)
+{
+	forEachTile(numRows, tileRows, fn);
+}
+
+void ofxKinectTileExecutor::forEachTile(int count, int tileSize, const TileFunction& fn)
+{
+	if(count <= 0)
+	{
+		return;
+	}
+	tileSize = MAX(tileSize, 1);
+	int numTiles = (count + tileSize - 1) / tileSize;
+
+	// nested calls, and work too small to split, stay on this thread
+	bool bWasRunning = bRunning.exchange(true);
+	if(bWasRunning || workers.empty() || numTiles == 1)
+	{
+		fn(0, count);
+		if(!bWasRunning)
+		{
+			bRunning = false;
+		}
+		return;
+	}
+
+	unsigned long long start = ofGetElapsedTimeMicros();
+
+	job = &fn;
+	jobCount = count;
+	jobTileSize = tileSize;
+	tileTimings.resize(numTiles);
+
+	// contiguous runs of tiles so neighbouring rows stay on one core unless they get stolen
+	int numQueues = (int)queues.size();
+	for(int i = 0; i < numQueues; i++)
+	{
+		queues[i].next = numTiles * i / numQueues;
+		queues[i].end = numTiles * (i + 1) / numQueues;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		busyWorkers = (int)workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runTiles(0);
+
+	{
+		std::unique_lock<std::mutex> guard(mutex);
+		while(busyWorkers > 0)
+		{
+			done.wait(guard);
+		}
+	}
+
+	job = NULL;
+	lastRunMicros = ofGetElapsedTimeMicros() - start;
+	bRunning = false;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectTileExecutor::workerLoop(int thread)
+{
+	unsigned long long seenGeneration = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> guard(mutex);
+			while(!bQuit && generation == seenGeneration)
+			{
+				wake.wait(guard);
+			}
+			if(bQuit)
+			{
+				return;
+			}
+			seenGeneration = generation;
+		}
+
+		runTiles(thread);
+
+		bool bLast;
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			bLast = --busyWorkers == 0;
+		}
+		if(bLast)
+		{
+			done.notify_one();
+		}
+	}
+}
+
+void ofxKinectTileExecutor::runTiles(int thread)
+{
+	int numQueues = (int)queues.size();
+
+	// own tiles first, then go round the others taking what is left
+	for(int i = 0; i < numQueues; i++)
+	{
+		TileQueue& queue = queues[(thread + i) % numQueues];
+		while(true)
+		{
+			int tile = queue.next.fetch_add(1);
+			if(tile >= queue.end)
+			{
+				break;
+			}
+			runTile(thread, tile);
+		}
+	}
+}
+
+void ofxKinectTileExecutor::runTile(int thread, int tile)
+{
+	int begin = tile * jobTileSize;
+	int end = MIN(begin + jobTileSize, jobCount);
+
+	if(!bTileTiming)
+	{
+		(*job)(begin, end);
+		return;
+	}
+
+	unsigned long long start = ofGetElapsedTimeMicros();
+	(*job)(begin, end);
+
+	TileTiming& timing = tileTimings[tile];
+	timing.begin = begin;
+	timing.end = end;
+	timing.thread = thread;
+	timing.micros = ofGetElapsedTimeMicros() - start;
+}
+
+//---------------------------------------------------------------------------
+void ofxKinectTileExecutor::benchmark(int iterations)
+{
+	// the two per pixel loops the bridge runs every frame: depth is light work on few pixels, color
+	// heavier work on many
+	const int depthWidth = 512, depthHeight = 424, colorWidth = 1920, colorHeight = 1080;
+	vector<unsigned short> depth, infrared;
+	ofxKinectDepthCodec::makeTestFrames(depthWidth, depthHeight, depth, infrared);
+	vector<unsigned char> visual(depthWidth * depthHeight);
+	vector<float> normalized(depthWidth * depthHeight);
+	ofxKinectDepthKernel depthKernel;
+
+	vector<unsigned char> yuy2(colorWidth * colorHeight * 2);
+	for(size_t i = 0; i < yuy2.size(); i++)
+	{
+		yuy2[i] = (unsigned char)(i * 7 + (i >> 11));
+	}
+	vector<unsigned char> rgba(colorWidth * colorHeight * 4);
+	ofxKinectColorKernel colorKernel;
+
+	vector<int> threadCounts;
+	threadCounts.push_back(1);
+	threadCounts.push_back(2);
+	threadCounts.push_back(4);
+	int hardwareThreads = MAX((int)std::thread::hardware_concurrency(), 1);
+	if(hardwareThreads != 1 && hardwareThreads != 2 && hardwareThreads != 4)
+	{
+		threadCounts.push_back(hardwareThreads);
+	}
+
+	for(int workload = 0; workload < 2; workload++)
+	{
+		int width = workload == 0 ? depthWidth : colorWidth;
+		int height = workload == 0 ? depthHeight : colorHeight;
+		TileFunction fn = [&](int rowBegin, int rowEnd)
+		{
+			if(workload == 0)
+			{
+				int offset = rowBegin * width;
+				depthKernel.convert(&depth[offset], (rowEnd - rowBegin) * width, &visual[offset], NULL, &normalized[offset]);
+			}
+			else
+			{
+				colorKernel.convert(&yuy2[rowBegin * width * 2], (rowEnd - rowBegin) * width, &rgba[rowBegin * width * 4], ofxKinectColorKernel::OUTPUT_RGBA);
+			}
+		};
+
+		float singleMicros = 0;
+		for(size_t t = 0; t < threadCounts.size(); t++)
+		{
+			ofxKinectTileExecutor executor;
+			executor.setNumThreads(threadCounts[t]);
+			executor.setTileTimingEnabled(false);
+			executor.forEachRowTile(height, fn);
+
+			unsigned long long start = ofGetElapsedTimeMicros();
+			for(int i = 0; i < iterations; i++)
+			{
+				executor.forEachRowTile(height, fn);
+			}
+			float micros = (ofGetElapsedTimeMicros() - start) / (float)iterations;
+			singleMicros = t == 0 ? micros : singleMicros;
+
+			ofLogNotice("ofxKinectTileExecutor::benchmark") << (workload == 0 ? "depth " : "yuy2 ") << width << "x" << height << " on "
+				<< threadCounts[t] << " thread" << (threadCounts[t] > 1 ? "s: " : ": ") << micros << " us/frame, "
+				<< width * height / micros << " Mpixels/s, " << singleMicros / micros << "x one thread ("
+				<< 100 * singleMicros / micros / threadCounts[t] << "% per thread), " << hardwareThreads << " hardware threads";
+		}
+	}
+}
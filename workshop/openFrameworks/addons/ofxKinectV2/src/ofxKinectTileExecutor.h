@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ofMain.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// small work stealing pool for per pixel work
+//
+// forEachTile() cuts a range (usually image rows) into tiles and deals them out to the workers in
+// contiguous runs. a worker that runs out of its own tiles steals from the others, so a slow tile on one
+// core doesn't hold up the frame. the calling thread works too and forEachTile() returns once every tile
+// is done, so callers see plain synchronous code. calls from inside a tile run inline.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+class ofxKinectTileExecutor
+{
+  public:
+	/// fn(begin, end) processes [begin, end) of the range
+	typedef std::function<void(int, int)> TileFunction;
+
+	struct TileTiming
+	{
+		int begin;
+		int end;
+		int thread;			///< 0 is the calling thread
+		float micros;
+	};
+
+	ofxKinectTileExecutor();
+	~ofxKinectTileExecutor();
+
+	/// total threads including the caller, 0 picks one per hardware thread. 1 runs everything inline
+	void setNumThreads(int numThreads = 0);
+	int getNumThreads() const;
+	/// which of getNumThreads() threads is calling, 0 for the calling thread and outside forEachTile(). lets
+	/// tiles use scratch allocated once per thread
+	int getCurrentThread() const;
+
+	/// rows per tile for image work
+	void setTileRows(int rows);
+	int getTileRows() const;
+
+	void forEachTile(int count, int tileSize, const TileFunction& fn);
+	/// rows of an image in tiles of getTileRows()
+	void forEachRowTile(int numRows, const TileFunction& fn);
+
+	/// timing of each tile of the last forEachTile() call, in tile order
+	void setTileTimingEnabled(bool bEnabled);
+	const vector<TileTiming>& getLastTileTimings() const;
+	float getLastRunMicros() const;
+
+	/// runs the depth conversion of a depth frame and the yuy2 conversion of a color frame on 1, 2, 4 and
+	/// one thread per hardware thread, and logs each one's time per frame, throughput and speedup over one
+	static void benchmark(int iterations = 200);
+
+  protected:
+	// each thread's run of tiles, others steal from the front of it with the same atomic
+	struct TileQueue
+	{
+		std::atomic<int> next;
+		int end;
+	};
+
+	void startWorkers(int numWorkers);
+	void stopWorkers();
+	void workerLoop(int thread);
+	void runTiles(int thread);
+	void runTile(int thread, int tile);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned long long generation;
+	int busyWorkers;
+	bool bQuit;
+	std::atomic<bool> bRunning;
+
+	// the job being run, only changed while no worker is busy
+	const TileFunction* job;
+	int jobCount;
+	int jobTileSize;
+	std::vector<TileQueue> queues;
+
+	int tileRows;
+	bool bTileTiming;
+	vector<TileTiming> tileTimings;
+	float lastRunMicros;
+
+  private:
+	ofxKinectTileExecutor(const ofxKinectTileExecutor&);
+	ofxKinectTileExecutor& operator=(const ofxKinectTileExecutor&);
+};
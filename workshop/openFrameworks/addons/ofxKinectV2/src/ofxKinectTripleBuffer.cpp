@@ -0,0 +1,122 @@
+#include "ofxKinectTripleBuffer.h"
+
+#include "ofMain.h"
+
+#include <thread>
+#include <chrono>
+
+//---------------------------------------------------------------------------
+// a frame is big enough that copying it takes a while, every word of frame n is n * 2654435761 + word
+class ofxKinectTripleBufferTestFrame
+{
+  public:
+	enum { NUM_WORDS = 16384 };
+
+	ofxKinectTripleBufferTestFrame() : sequence(0) {}
+
+	void fill(unsigned long long _sequence)
+	{
+		sequence = _sequence;
+		for(int i = 0; i < NUM_WORDS; i++)
+		{
+			words[i] = (unsigned int)(sequence * 2654435761u) + i;
+		}
+	}
+
+	bool isWhole() const
+	{
+		bool bWhole = true;
+		for(int i = 0; i < NUM_WORDS; i++)
+		{
+			bWhole = bWhole && words[i] == (unsigned int)(sequence * 2654435761u) + i;
+		}
+		return bWhole;
+	}
+
+	unsigned long long sequence;
+	unsigned int words[NUM_WORDS];
+};
+
+class ofxKinectTripleBufferTestProducer : public ofThread
+{
+  public:
+	ofxKinectTripleBufferTestProducer(ofxKinectTripleBuffer<ofxKinectTripleBufferTestFrame>& _buffer, float hz)
+		: buffer(_buffer), periodMicros((unsigned long long)(1000000 / hz)), published(0) {}
+
+	void threadedFunction()
+	{
+		unsigned long long next = ofGetElapsedTimeMicros();
+		while(isThreadRunning())
+		{
+			buffer.getBackBuffer().fill(published + 1);
+			buffer.publish();
+			published++;
+
+			next += periodMicros;
+			unsigned long long now = ofGetElapsedTimeMicros();
+			if(next > now)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+			}
+		}
+	}
+
+	ofxKinectTripleBuffer<ofxKinectTripleBufferTestFrame>& buffer;
+	unsigned long long periodMicros;
+	std::atomic<unsigned long long> published;
+};
+
+bool ofxKinectTripleBufferTest::stressTest(float producerHz, float seconds)
+{
+	ofxKinectTripleBuffer<ofxKinectTripleBufferTestFrame>* buffer = new ofxKinectTripleBuffer<ofxKinectTripleBufferTestFrame>();
+	ofxKinectTripleBufferTestProducer producer(*buffer, producerHz);
+	producer.startThread(false, false);
+
+	const float consumerHz[3] = { 0, 60, 500 };
+	bool bPassed = true;
+	unsigned long long last = 0;
+	for(int phase = 0; phase < 3; phase++)
+	{
+		unsigned long long swaps = 0, skipped = 0, torn = 0, older = 0, changed = 0;
+		unsigned long long start = ofGetElapsedTimeMicros(), end = start + (unsigned long long)(seconds / 3 * 1000000);
+		unsigned long long firstPublished = producer.published;
+		for(unsigned long long now = start; now < end; now = ofGetElapsedTimeMicros())
+		{
+			// the front buffer must stay as it was picked up for as long as it is held
+			const ofxKinectTripleBufferTestFrame& held = buffer->getFrontBuffer();
+			changed += last != 0 && (held.sequence != last || !held.isWhole()) ? 1 : 0;
+			if(buffer->swap())
+			{
+				const ofxKinectTripleBufferTestFrame& frame = buffer->getFrontBuffer();
+				torn += frame.isWhole() ? 0 : 1;
+				older += frame.sequence <= last ? 1 : 0;
+				skipped += frame.sequence > last + 1 ? frame.sequence - last - 1 : 0;
+				last = MAX(last, frame.sequence);
+				swaps++;
+			}
+			if(consumerHz[phase] > 0)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(1000000 / consumerHz[phase])));
+			}
+		}
+
+		ofLogNotice("ofxKinectTripleBufferTest::stressTest") << "consumer at " << (consumerHz[phase] > 0 ? ofToString(consumerHz[phase]) + "hz" : string("full speed"))
+			<< ": " << producer.published - firstPublished << " published, " << swaps << " picked up, " << skipped << " overwritten unseen, "
+			<< torn << " torn, " << older << " repeated or older, " << changed << " changed while held";
+		bPassed = bPassed && torn == 0 && older == 0 && changed == 0 && swaps > 0;
+	}
+
+	// nothing published may be lost for good: once the producer is done the newest frame is there to take
+	producer.waitForThread(true);
+	buffer->swap();
+	bool bNewest = buffer->getFrontBuffer().sequence == producer.published && buffer->getFrontBuffer().isWhole();
+	if(!bNewest)
+	{
+		ofLogError("ofxKinectTripleBufferTest::stressTest") << "The last frame published was " << producer.published << ", the consumer got " << buffer->getFrontBuffer().sequence;
+	}
+	bPassed = bPassed && bNewest;
+
+	ofLogNotice("ofxKinectTripleBufferTest::stressTest") << (bPassed ? "passed" : "FAILED");
+	delete buffer;
+	return bPassed;
+}
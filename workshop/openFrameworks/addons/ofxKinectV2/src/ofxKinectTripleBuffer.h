@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// single producer / single consumer triple buffer
+//
+// the producer always owns a back buffer and the consumer always owns a front buffer. the third slot sits
+// in the middle and is handed back and forth with one atomic exchange, so neither side ever blocks, waits
+// on the other or copies the contents. the consumer always sees the newest complete buffer; frames the
+// consumer was too slow to pick up are simply overwritten.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+class ofxKinectTripleBuffer
+{
+  public:
+	ofxKinectTripleBuffer()
+		: backIndex(0)
+		, frontIndex(1)
+		, middle(2)
+	{
+	}
+
+	/// producer side: the buffer to fill, only ever touched by the producer
+	T& getBackBuffer()
+	{
+		return buffers[backIndex];
+	}
+
+	/// producer side: make the back buffer the newest frame and take the middle slot as the new back buffer
+	void publish()
+	{
+		unsigned int previous = middle.exchange(backIndex | DIRTY, std::memory_order_acq_rel);
+		backIndex = previous & INDEX_MASK;
+	}
+
+	/// producer side: true while the last published buffer hasn't been picked up by swap()
+	bool isPending() const
+	{
+		return (middle.load(std::memory_order_acquire) & DIRTY) != 0;
+	}
+
+	/// consumer side: pick up the newest published buffer, returns false if nothing new was published
+	bool swap()
+	{
+		if((middle.load(std::memory_order_acquire) & DIRTY) == 0)
+		{
+			return false;
+		}
+		unsigned int previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+		frontIndex = previous & INDEX_MASK;
+		return true;
+	}
+
+	/// consumer side: the newest buffer picked up by swap(), stays valid until the next swap()
+	T& getFrontBuffer()
+	{
+		return buffers[frontIndex];
+	}
+
+	const T& getFrontBuffer() const
+	{
+		return buffers[frontIndex];
+	}
+
+	/// all three slots, only safe to use for allocation before the producer starts
+	T& operator[](int index)
+	{
+		return buffers[index];
+	}
+
+	static int size()
+	{
+		return 3;
+	}
+
+  protected:
+	static const unsigned int INDEX_MASK = 3;
+	static const unsigned int DIRTY = 4;
+
+	T buffers[3];
+	unsigned int backIndex;
+	unsigned int frontIndex;
+	std::atomic<unsigned int> middle;
+
+  private:
+	ofxKinectTripleBuffer(const ofxKinectTripleBuffer&);
+	ofxKinectTripleBuffer& operator=(const ofxKinectTripleBuffer&);
+};
+
+class ofxKinectTripleBufferTest
+{
+  public:
+	/// a thread publishes frames at producerHz while this one swaps as fast as it can, at 60hz and at 500hz,
+	/// a third of the time each. every frame picked up is checked word by word for being torn, for being
+	/// older than the last and for changing while it is held, and after the producer stops the last
+	/// published frame must come through. logs the counts, returns false on any failure
+	static bool stressTest(float producerHz = 300, float seconds = 9);
+};
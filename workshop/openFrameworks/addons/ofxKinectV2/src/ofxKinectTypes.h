@@ -0,0 +1,144 @@
+#pragma once
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// the sdk types the frames are made of
+//
+// by default these come from the common bridge library and the kinect sdk. define OFX_KINECT_NO_SDK to get
+// plain copies of the few the frames, skeletons, recordings and backends use instead. the whole addon then
+// builds on a machine without the sdk or windows: ofxKinectKCBBackend is left out, the calls that need a
+// sensor fail, and the bridge runs on the synthetic backend, recordings and saved calibrations. the copies
+// keep the sdk's names and layouts, so recordings read the same either way.
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFX_KINECT_NO_SDK
+
+#include "KCBv2LIB.h"
+
+#else
+
+#include <stdint.h>
+
+#ifndef _WIN32
+typedef long long LONGLONG;
+typedef unsigned long long UINT64;
+typedef unsigned int UINT32;
+typedef unsigned short UINT16;
+typedef unsigned char BYTE;
+typedef unsigned char BOOLEAN;
+typedef unsigned int UINT;
+typedef unsigned long ULONG;
+typedef int32_t HRESULT;
+#endif
+
+#ifndef SUCCEEDED
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#endif
+#ifndef FAILED
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#endif
+
+#define BODY_COUNT 6
+
+enum JointType
+{
+	JointType_SpineBase = 0,
+	JointType_SpineMid,
+	JointType_Neck,
+	JointType_Head,
+	JointType_ShoulderLeft,
+	JointType_ElbowLeft,
+	JointType_WristLeft,
+	JointType_HandLeft,
+	JointType_ShoulderRight,
+	JointType_ElbowRight,
+	JointType_WristRight,
+	JointType_HandRight,
+	JointType_HipLeft,
+	JointType_KneeLeft,
+	JointType_AnkleLeft,
+	JointType_FootLeft,
+	JointType_HipRight,
+	JointType_KneeRight,
+	JointType_AnkleRight,
+	JointType_FootRight,
+	JointType_SpineShoulder,
+	JointType_HandTipLeft,
+	JointType_ThumbLeft,
+	JointType_HandTipRight,
+	JointType_ThumbRight,
+	JointType_Count
+};
+
+enum TrackingState
+{
+	TrackingState_NotTracked = 0,
+	TrackingState_Inferred = 1,
+	TrackingState_Tracked = 2
+};
+
+enum ColorImageFormat
+{
+	ColorImageFormat_None = 0,
+	ColorImageFormat_Rgba = 1,
+	ColorImageFormat_Yuv = 2,
+	ColorImageFormat_Bgra = 3,
+	ColorImageFormat_Bayer = 4,
+	ColorImageFormat_Yuy2 = 5
+};
+
+typedef struct _CameraSpacePoint { float X; float Y; float Z; } CameraSpacePoint;
+typedef struct _DepthSpacePoint { float X; float Y; } DepthSpacePoint;
+typedef struct _ColorSpacePoint { float X; float Y; } ColorSpacePoint;
+typedef struct _PointF { float X; float Y; } PointF;
+typedef struct _Vector4 { float x; float y; float z; float w; } Vector4;
+
+typedef struct _Joint
+{
+	::JointType JointType;
+	CameraSpacePoint Position;
+	::TrackingState TrackingState;
+} Joint;
+
+typedef struct _JointOrientation
+{
+	::JointType JointType;
+	Vector4 Orientation;
+} JointOrientation;
+
+typedef int KCBHANDLE;
+static const int KCB_INVALID_HANDLE = 0xffffffff;
+
+typedef struct KCBFrameDescription
+{
+	int width;
+	int height;
+	float horizontalFieldOfView;
+	float verticalFieldOfView;
+	float diagonalFieldOfView;
+	unsigned int lengthInPixels;
+	unsigned int bytesPerPixel;
+} KCBFrameDescription;
+
+typedef struct KCBBodyIndexFrame
+{
+	ULONG Size;
+	BYTE* Buffer;
+	LONGLONG TimeStamp;
+} KCBBodyIndexFrame;
+
+typedef struct KCBColorFrame
+{
+	::ColorImageFormat Format;
+	ULONG Size;
+	BYTE* Buffer;
+	LONGLONG TimeStamp;
+} KCBColorFrame;
+
+typedef struct KCBDepthFrame
+{
+	ULONG Size;
+	UINT16* Buffer;
+	LONGLONG TimeStamp;
+} KCBDepthFrame, KCBInfraredFrame, KCBLongExposureInfraredFrame;
+
+#endif
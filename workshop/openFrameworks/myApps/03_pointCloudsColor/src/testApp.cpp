@@ -53,11 +53,10 @@ void testApp::updateMesh()
 
 	// GRAB THE MAPPED COLORS FOR DEPTH
 	// ************************************************
-	// NOTE: THIS IS AN EXPENSIVE OPERATION.
-	// LOOK INTO KCBv2 TO DETERMINE MORE OPTIMIZED
-	// SOLUTION. ALTERNATIVE WOULD BE TO SEND RAW
-	// ARRAY OF DEPTH TO COLOR MAPPING TO GPU AND PERFORM
-	// LOOK UPS THERE, ETC.
+	// NOTE: THE BRIDGE KEEPS A REGISTRAR AROUND FOR THIS
+	// SO IT DOESN'T ALLOCATE PER FRAME AND RUNS ACROSS
+	// ALL CORES. IT ALSO HIDES BACKGROUND PIXELS THE COLOR
+	// CAMERA CAN'T SEE, SEE getDepthToColorRegistrar().
     kinect.mapDepthToColor(pxlsMappedColor);
 
     texColorMappedToDepth.loadData(pxlsMappedColor);
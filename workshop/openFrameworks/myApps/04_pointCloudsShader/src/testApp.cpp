@@ -58,7 +58,6 @@ void testApp::updateMesh()
 	pxlBodyIndex = kinect.getBodyIndexPixelsRef();
 
 	kinect.mapDepthToColor(pxlsMappedColor);
-	//kinect.altMapColorToDepth(pxlsMappedColor);
 
 	texColorMappedToDepth.loadData(pxlsMappedColor);
 